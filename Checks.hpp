@@ -0,0 +1,45 @@
+#ifndef ___INANITY_CHECKS_HPP___
+#define ___INANITY_CHECKS_HPP___
+
+#include "config.hpp"
+#include <iostream>
+
+/* Named checks for executables of tests and benchmarks.
+Failed checks are printed and counted, and the summary is printed
+at the end, with exit code of the test. Header-only, as every test
+is a single translation unit. */
+
+BEGIN_INANITY
+
+/// Number of failed checks.
+inline int& FailedChecksCount()
+{
+	static int count = 0;
+	return count;
+}
+
+/// Check condition, and print name of check if it's failed.
+inline void Check(const char* name, bool ok)
+{
+	if(!ok)
+	{
+		std::cout << "FAILED " << name << "\n";
+		++FailedChecksCount();
+	}
+}
+
+/// Print summary of checks.
+/** \returns Exit code of test: 0 if all checks passed, 1 otherwise. */
+inline int ReportChecks()
+{
+	int count = FailedChecksCount();
+	if(count)
+		std::cout << count << " checks FAILED\n";
+	else
+		std::cout << "all checks passed\n";
+	return count ? 1 : 0;
+}
+
+END_INANITY
+
+#endif
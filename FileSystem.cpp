@@ -27,6 +27,11 @@ ptr<File> FileSystem::TryLoadFile(const String& fileName)
 	}
 }
 
+bool FileSystem::IsFileExists(const String& fileName)
+{
+	return !!TryLoadFile(fileName);
+}
+
 ptr<InputStream> FileSystem::LoadStream(const String& fileName)
 {
 	try
@@ -56,6 +56,11 @@ public:
 	*/
 	virtual ptr<File> TryLoadFile(const String& fileName);
 
+	/// Check if file exists.
+	/** Default implementation tries to load file, so file systems
+	should override it if they can check it cheaper. */
+	virtual bool IsFileExists(const String& fileName);
+
 	/// Открыть файл как поток ввода.
 	/** Возвращает поток ввода, предназначенный для чтения файла.
 	\param fileName Имя файла.
@@ -0,0 +1,49 @@
+#include "FixedStepTicker.hpp"
+
+BEGIN_INANITY
+
+FixedStepTicker::FixedStepTicker(float step, int maxStepsCount) :
+	step(step),
+	maxStepsCount(maxStepsCount),
+	accumulatedTime(0)
+{}
+
+void FixedStepTicker::Pause()
+{
+	ticker.Pause();
+}
+
+int FixedStepTicker::Tick()
+{
+	return Advance(ticker.Tick());
+}
+
+int FixedStepTicker::Advance(float time)
+{
+	accumulatedTime += time;
+
+	int stepsCount = (int)(accumulatedTime / step);
+	if(stepsCount > maxStepsCount)
+	{
+		// drop time which can't be simulated
+		stepsCount = maxStepsCount;
+		accumulatedTime = 0;
+	}
+	else
+		accumulatedTime -= stepsCount * step;
+
+	return stepsCount;
+}
+
+float FixedStepTicker::GetInterpolation() const
+{
+	float interpolation = accumulatedTime / step;
+	return interpolation < 1 ? interpolation : 0;
+}
+
+float FixedStepTicker::GetStep() const
+{
+	return step;
+}
+
+END_INANITY
@@ -0,0 +1,47 @@
+#ifndef ___INANITY_FIXED_STEP_TICKER_HPP___
+#define ___INANITY_FIXED_STEP_TICKER_HPP___
+
+#include "Ticker.hpp"
+
+BEGIN_INANITY
+
+/// Helper class to run simulation with fixed time step.
+/** Accumulates real time between ticks, and tells how many
+steps of fixed length to simulate. So simulation doesn't depend
+on frame rate, and is deterministic if steps are (for example,
+in lockstep networking with HardFloat math). Real time is only
+used to schedule steps, and never gets into simulation. */
+class FixedStepTicker
+{
+private:
+	Ticker ticker;
+	/// Length of step in seconds.
+	float step;
+	/// Maximum number of steps per tick.
+	int maxStepsCount;
+	/// Time accumulated but not simulated yet.
+	float accumulatedTime;
+
+public:
+	FixedStepTicker(float step, int maxStepsCount = 8);
+
+	/// Sets ticker on pause.
+	void Pause();
+	/// Marks a new tick, returns number of steps to simulate.
+	/** Never returns more than maxStepsCount: if simulation can't keep up,
+	extra time is dropped, instead of falling behind more and more.
+	If ticker was paused, it resumes. */
+	int Tick();
+	/// Accumulates given time, returns number of steps to simulate.
+	/** Same as Tick, but time is passed explicitly (for example, by
+	replay or test) instead of measured by clock. */
+	int Advance(float time);
+	/// Get part of step accumulated after last simulated step, in [0, 1).
+	/** Useful to interpolate rendered state between two last steps. */
+	float GetInterpolation() const;
+	float GetStep() const;
+};
+
+END_INANITY
+
+#endif
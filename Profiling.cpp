@@ -3,6 +3,7 @@
 #ifdef ___INANITY_PROFILING
 
 #include "Time.hpp"
+#include "SampledProfile.hpp"
 #include <unordered_map>
 #include <algorithm>
 #include <functional>
@@ -14,13 +15,19 @@ namespace Profiling
 {
 
 // Профилирование по умолчанию выключено.
-bool profiling = false;
+PROFILE_THREAD_LOCAL bool profiling = false;
 
 long long recordTimes[PROFILE_MAXIMUM_RECORDS_COUNT];
 RecordType recordTypes[PROFILE_MAXIMUM_RECORDS_COUNT];
 const char* recordPositions[PROFILE_MAXIMUM_RECORDS_COUNT];
 size_t recordsCount = 0;
 
+PROFILE_THREAD_LOCAL const char* scopesStack[PROFILE_MAXIMUM_SCOPES_DEPTH];
+PROFILE_THREAD_LOCAL size_t scopesDepth = 0;
+
+/// Collected samples.
+static ptr<SampledProfile> samples;
+
 void Start()
 {
 	if(!profiling)
@@ -42,6 +49,30 @@ void Stop()
 void Reset()
 {
 	recordsCount = 0;
+	if(samples)
+		samples->Clear();
+}
+
+void Sample(const char* stack, long long weight, bool prependScopes)
+{
+	if(!profiling)
+		return;
+
+	if(!samples)
+		samples = NEW(SampledProfile());
+
+	String fullStack;
+	size_t depth = scopesDepth < PROFILE_MAXIMUM_SCOPES_DEPTH ? scopesDepth : PROFILE_MAXIMUM_SCOPES_DEPTH;
+	if(!prependScopes)
+		depth = 0;
+	for(size_t i = 0; i < depth; ++i)
+	{
+		fullStack += scopesStack[i];
+		fullStack += ';';
+	}
+	fullStack += stack;
+
+	samples->AddSample(fullStack, weight);
 }
 
 void Report(std::ostream& stream)
@@ -102,6 +133,19 @@ void Report(std::ostream& stream)
 	stream.precision(6);
 	for(size_t i = 0; i < 10 && i < scopes.size(); ++i)
 		stream << scopes[i].second << " === " << (double(scopes[i].first) * coef) << " sec\n";
+
+	// рейтинг функций по сэмплам
+	if(samples)
+	{
+		stream << "Sampled " << (double(samples->GetTotalWeight()) * 1e-9) << " sec\n";
+		samples->WriteReport(stream);
+	}
+}
+
+void ReportFlameGraph(std::ostream& stream)
+{
+	if(samples)
+		samples->WriteCollapsed(stream);
 }
 
 }
@@ -6,6 +6,8 @@
 выполнения различных функций.
 
 Пока профилирование поддерживает только один поток выполнения.
+Profiling is enabled only in the thread which called Start,
+so scopes and samples in other threads (e.g. workers of thread pool) are ignored.
 */
 
 #ifdef _DEBUG
@@ -26,6 +28,16 @@
 /// Максимальное количество записей профилирования.
 #define PROFILE_MAXIMUM_RECORDS_COUNT 0x1000000
 
+/// Maximum depth of nested scopes, prepended to samples.
+#define PROFILE_MAXIMUM_SCOPES_DEPTH 0x100
+
+/// Storage of per-thread profiling state.
+#ifdef _MSC_VER
+#define PROFILE_THREAD_LOCAL __declspec(thread)
+#else
+#define PROFILE_THREAD_LOCAL thread_local
+#endif
+
 
 
 // ******* Макросы, используемые в коде.
@@ -70,8 +82,8 @@ namespace Profiling
 		recordTypeScopeLeave
 	};
 
-	/// Включено ли профилирование.
-	extern bool profiling;
+	/// Включено ли профилирование (in current thread).
+	extern PROFILE_THREAD_LOCAL bool profiling;
 
 	// Для большей эффективности записи хранятся не структурами, а массивами.
 	/// Времена записей.
@@ -83,6 +95,12 @@ namespace Profiling
 	/// Текущее количество записей.
 	extern size_t recordsCount;
 
+	/// Stack of currently entered scopes.
+	/** Per-thread, maintained even if profiling is stopped. */
+	extern PROFILE_THREAD_LOCAL const char* scopesStack[PROFILE_MAXIMUM_SCOPES_DEPTH];
+	/// Current depth of scopes (may exceed maximum).
+	extern PROFILE_THREAD_LOCAL size_t scopesDepth;
+
 	/// Сделать запись.
 	inline void Record(RecordType recordType, const char* position)
 	{
@@ -96,6 +114,7 @@ namespace Profiling
 	}
 
 	/// Начать профилирование.
+	/** In current thread only. */
 	void Start();
 
 	/// Завершить профилирование.
@@ -106,9 +125,19 @@ namespace Profiling
 	/** Можно вызывать и при работающем профилировании. */
 	void Reset();
 
+	/// Add sample of call stack (for example, from script profiler).
+	/** Stack is in collapsed form (see SampledProfile), weight
+	is in nanoseconds. Current stack of scopes is prepended to it,
+	unless prependScopes is false (for samples collected earlier,
+	not at the current point). Ignored if profiling is stopped. */
+	void Sample(const char* stack, long long weight, bool prependScopes = true);
+
 	/// Сформировать красивый отчёт :)
 	void Report(std::ostream& stream);
 
+	/// Write collected samples in collapsed stacks format (for flamegraph.pl).
+	void ReportFlameGraph(std::ostream& stream);
+
 	/// Класс, выполняющий записи о входе-выходе в область видимости.
 	class Scope
 	{
@@ -119,11 +148,15 @@ namespace Profiling
 	public:
 		inline Scope(const char* position) : position(position)
 		{
+			if(scopesDepth < PROFILE_MAXIMUM_SCOPES_DEPTH)
+				scopesStack[scopesDepth] = position;
+			++scopesDepth;
 			Record(recordTypeScopeEnter, position);
 		}
 		inline ~Scope()
 		{
 			Record(recordTypeScopeLeave, position);
+			--scopesDepth;
 		}
 	};
 }
@@ -0,0 +1,88 @@
+#include "SampledProfile.hpp"
+#include <unordered_set>
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+BEGIN_INANITY
+
+void SampledProfile::AddSample(const String& stack, long long weight)
+{
+	samples[stack] += weight;
+}
+
+void SampledProfile::Merge(ptr<SampledProfile> profile)
+{
+	for(Samples::const_iterator i = profile->samples.begin(); i != profile->samples.end(); ++i)
+		samples[i->first] += i->second;
+}
+
+void SampledProfile::Clear()
+{
+	samples.clear();
+}
+
+long long SampledProfile::GetTotalWeight() const
+{
+	long long totalWeight = 0;
+	for(Samples::const_iterator i = samples.begin(); i != samples.end(); ++i)
+		totalWeight += i->second;
+	return totalWeight;
+}
+
+void SampledProfile::WriteCollapsed(std::ostream& stream) const
+{
+	// sort stacks, so output is stable
+	std::vector<std::pair<String, long long> > sortedSamples(samples.begin(), samples.end());
+	std::sort(sortedSamples.begin(), sortedSamples.end());
+	for(size_t i = 0; i < sortedSamples.size(); ++i)
+		stream << sortedSamples[i].first << ' ' << sortedSamples[i].second << '\n';
+}
+
+void SampledProfile::WriteReport(std::ostream& stream, size_t functionsCount) const
+{
+	// self time is a time of the last frame,
+	// total time is counted once for every function in stack
+	std::unordered_map<String, long long> selfTimes, totalTimes;
+	std::unordered_set<String> stackFunctions;
+	for(Samples::const_iterator i = samples.begin(); i != samples.end(); ++i)
+	{
+		const String& stack = i->first;
+		stackFunctions.clear();
+		for(size_t begin = 0; begin <= stack.length(); )
+		{
+			size_t end = stack.find(';', begin);
+			if(end == String::npos)
+				end = stack.length();
+			String function = stack.substr(begin, end - begin);
+			if(stackFunctions.insert(function).second)
+				totalTimes[function] += i->second;
+			if(end == stack.length())
+				selfTimes[function] += i->second;
+			begin = end + 1;
+		}
+	}
+
+	struct Helper
+	{
+		static void Write(std::ostream& stream, const char* title, const std::unordered_map<String, long long>& times, size_t functionsCount)
+		{
+			std::vector<std::pair<long long, String> > sortedTimes;
+			sortedTimes.reserve(times.size());
+			for(std::unordered_map<String, long long>::const_iterator i = times.begin(); i != times.end(); ++i)
+				sortedTimes.push_back(std::pair<long long, String>(i->second, i->first));
+			std::sort(sortedTimes.begin(), sortedTimes.end(), std::greater<std::pair<long long, String> >());
+
+			stream << title << ":\n";
+			for(size_t i = 0; i < functionsCount && i < sortedTimes.size(); ++i)
+				stream << sortedTimes[i].second << " === " << (double(sortedTimes[i].first) * 1e-9) << " sec\n";
+		}
+	};
+
+	stream << std::fixed;
+	stream.precision(6);
+	Helper::Write(stream, "Top functions by self time", selfTimes, functionsCount);
+	Helper::Write(stream, "Top functions by total time", totalTimes, functionsCount);
+}
+
+END_INANITY
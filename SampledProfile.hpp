@@ -0,0 +1,39 @@
+#ifndef ___INANITY_SAMPLED_PROFILE_HPP___
+#define ___INANITY_SAMPLED_PROFILE_HPP___
+
+#include "String.hpp"
+#include <unordered_map>
+#include <ostream>
+
+BEGIN_INANITY
+
+/// Collection of sampled call stacks.
+/** Stack is stored in collapsed form: frames from the outermost one,
+separated by ';'. Weight of stack is its time in nanoseconds. */
+class SampledProfile : public Object
+{
+private:
+	typedef std::unordered_map<String, long long> Samples;
+	Samples samples;
+
+public:
+	/// Add weight to stack.
+	void AddSample(const String& stack, long long weight);
+	/// Add all samples from other profile.
+	void Merge(ptr<SampledProfile> profile);
+	void Clear();
+
+	/// Get total weight of all samples.
+	long long GetTotalWeight() const;
+
+	/// Write profile in collapsed stacks format.
+	/** One stack per line, followed by weight. This is the input
+	format of flamegraph.pl and compatible tools. */
+	void WriteCollapsed(std::ostream& stream) const;
+	/// Write functions with the most self and total time.
+	void WriteReport(std::ostream& stream, size_t functionsCount = 10) const;
+};
+
+END_INANITY
+
+#endif
@@ -0,0 +1,132 @@
+#include "ThreadPool.hpp"
+#include "CriticalCode.hpp"
+#include "Exception.hpp"
+#if defined(___INANITY_PLATFORM_WINDOWS)
+#include "platform/windows.hpp"
+#elif defined(___INANITY_PLATFORM_POSIX)
+#include <unistd.h>
+#endif
+
+BEGIN_INANITY
+
+ThreadPool::ThreadPool(int threadsCount) : stopping(false)
+{
+	BEGIN_TRY();
+
+	if(threadsCount <= 0)
+		threadsCount = GetHardwareThreadsCount();
+
+	threads.resize(threadsCount);
+	for(int i = 0; i < threadsCount; ++i)
+		threads[i] = NEW(Thread(Thread::ThreadHandler::BindCall([this](const Thread::ThreadHandler::Result&)
+		{
+			WorkerRoutine();
+		})));
+
+	END_TRY("Can't create thread pool");
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		CriticalCode cc(criticalSection);
+		stopping = true;
+	}
+	queueSemaphore.Release((int)threads.size());
+
+	for(size_t i = 0; i < threads.size(); ++i)
+		if(threads[i])
+			threads[i]->WaitEnd();
+
+	// workers execute all queued tasks before stopping
+	for(size_t i = 0; i < pendingTasks.size(); ++i)
+		pendingTasks[i]->Dereference();
+}
+
+void ThreadPool::WorkerRoutine()
+{
+	for(;;)
+	{
+		queueSemaphore.Acquire();
+
+		Handler* task;
+		{
+			CriticalCode cc(criticalSection);
+			if(queue.empty())
+			{
+				if(stopping)
+					break;
+				continue;
+			}
+			task = queue.front();
+			queue.pop_front();
+		}
+
+		try
+		{
+			task->Fire();
+		}
+		catch(Exception* exception)
+		{
+			CriticalCode cc(criticalSection);
+			if(this->exception)
+				MakePointer(exception);
+			else
+				this->exception = exception;
+		}
+
+		doneSemaphore.Release();
+	}
+}
+
+int ThreadPool::GetThreadsCount() const
+{
+	return (int)threads.size();
+}
+
+void ThreadPool::Queue(ptr<Handler> task)
+{
+	task->Reference();
+	pendingTasks.push_back(task);
+
+	{
+		CriticalCode cc(criticalSection);
+		queue.push_back(task);
+	}
+	queueSemaphore.Release();
+}
+
+void ThreadPool::Wait()
+{
+	for(size_t i = 0; i < pendingTasks.size(); ++i)
+		doneSemaphore.Acquire();
+
+	for(size_t i = 0; i < pendingTasks.size(); ++i)
+		pendingTasks[i]->Dereference();
+	pendingTasks.clear();
+
+	ptr<Exception> exception;
+	{
+		CriticalCode cc(criticalSection);
+		exception = this->exception;
+		this->exception = nullptr;
+	}
+	if(exception)
+		THROW_SECONDARY("Thread pool task failed", exception);
+}
+
+int ThreadPool::GetHardwareThreadsCount()
+{
+#if defined(___INANITY_PLATFORM_WINDOWS)
+	SYSTEM_INFO systemInfo;
+	GetSystemInfo(&systemInfo);
+	int count = (int)systemInfo.dwNumberOfProcessors;
+#elif defined(___INANITY_PLATFORM_POSIX)
+	int count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#else
+#error Unknown platform
+#endif
+	return count > 0 ? count : 1;
+}
+
+END_INANITY
@@ -0,0 +1,61 @@
+#ifndef ___INANITY_THREAD_POOL_HPP___
+#define ___INANITY_THREAD_POOL_HPP___
+
+#include "Thread.hpp"
+#include "CriticalSection.hpp"
+#include "Semaphore.hpp"
+#include <vector>
+#include <deque>
+
+BEGIN_INANITY
+
+/// Pool of worker threads executing queued tasks.
+/** Pool is owned by one thread, which queues tasks and waits for them.
+Reference counters are not thread-safe, so pool never changes counters
+of tasks in worker threads: task is referenced in Queue and released
+in Wait, both called by owner thread. Task itself should only touch
+objects not used concurrently by other threads. */
+class ThreadPool : public Object
+{
+private:
+	std::vector<ptr<Thread> > threads;
+
+	CriticalSection criticalSection;
+	/// Tasks waiting for execution. Protected by critical section.
+	std::deque<Handler*> queue;
+	/// First exception thrown by task. Protected by critical section.
+	ptr<Exception> exception;
+	/// Stop flag. Protected by critical section.
+	bool stopping;
+
+	/// Released once for each queued task (and for each thread on stop).
+	Semaphore queueSemaphore;
+	/// Released once for each completed task.
+	Semaphore doneSemaphore;
+
+	/// Tasks queued since last Wait. Used only by owner thread.
+	std::vector<Handler*> pendingTasks;
+
+	void WorkerRoutine();
+
+public:
+	/// Create pool.
+	/** \param threadsCount Number of worker threads, 0 for number of hardware threads. */
+	ThreadPool(int threadsCount = 0);
+	~ThreadPool();
+
+	int GetThreadsCount() const;
+
+	/// Queue task for execution.
+	void Queue(ptr<Handler> task);
+	/// Wait until all queued tasks are done.
+	/** Rethrows first exception thrown by tasks, if any. */
+	void Wait();
+
+	/// Get number of hardware threads.
+	static int GetHardwareThreadsCount();
+};
+
+END_INANITY
+
+#endif
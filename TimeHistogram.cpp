@@ -0,0 +1,24 @@
+#include "TimeHistogram.hpp"
+
+BEGIN_INANITY
+
+TimeHistogram::TimeHistogram()
+: count(0), totalTime(0), maxTime(0)
+{
+	for(int i = 0; i < bucketsCount; ++i)
+		buckets[i] = 0;
+}
+
+void TimeHistogram::Add(long long microseconds)
+{
+	int bucket = 0;
+	for(long long t = microseconds >> 1; t && bucket < bucketsCount - 1; t >>= 1)
+		++bucket;
+	++buckets[bucket];
+	++count;
+	totalTime += microseconds;
+	if(microseconds > maxTime)
+		maxTime = microseconds;
+}
+
+END_INANITY
@@ -0,0 +1,33 @@
+#ifndef ___INANITY_TIME_HISTOGRAM_HPP___
+#define ___INANITY_TIME_HISTOGRAM_HPP___
+
+#include "config.hpp"
+#include <cstddef>
+
+BEGIN_INANITY
+
+/// Histogram of durations, with buckets of powers of two.
+struct TimeHistogram
+{
+	/// Number of buckets.
+	static const int bucketsCount = 16;
+	/// Counts of durations in buckets.
+	/** Bucket i counts durations from 2^i to 2^(i+1) microseconds;
+	first bucket includes shorter durations, last one - longer. */
+	size_t buckets[bucketsCount];
+	/// Number of durations.
+	size_t count;
+	/// Total duration, in microseconds.
+	long long totalTime;
+	/// Maximum duration, in microseconds.
+	long long maxTime;
+
+	TimeHistogram();
+
+	/// Register a duration, in microseconds.
+	void Add(long long microseconds);
+};
+
+END_INANITY
+
+#endif
@@ -1,8 +1,12 @@
 #include "AssimpConvertor.hpp"
 #include "Vertex.hpp"
+#include "GeometryOptimization.hpp"
+#include "../ThreadPool.hpp"
 #include "../deps/assimp/repo/include/assimp/Importer.hpp"
 #include "../deps/assimp/repo/include/assimp/scene.h"
 #include "../deps/assimp/repo/include/assimp/postprocess.h"
+#include <sstream>
+#include <algorithm>
 
 String AssimpConvertor::GetCommand() const
 {
@@ -12,16 +16,116 @@ String AssimpConvertor::GetCommand() const
 void AssimpConvertor::PrintHelp() const
 {
 	std::cout << "Converts model to Inanity geometry format.\n";
-	std::cout << "assimp [--bump] [--] <source model file> <result .geo>\n";
+	std::cout << "assimp [--bump] [<LOD flags>] [--] <source model file> <result .geo>\n";
+	std::cout << "If model has several meshes, mesh i is saved as <result .geo>.<i>.\n";
+	LodParameters::PrintHelp();
 	Assimp::Importer importer;
 	aiString extensions;
 	importer.GetExtensionList(extensions);
 	std::cout << "Supported extensions: " << extensions.C_Str() << "\n";
 }
 
+/// Result of converting a mesh.
+struct ConvertedMesh
+{
+	/// Files of LOD levels.
+	std::vector<ptr<File> > verticesFiles;
+	std::vector<ptr<File> > indicesFiles;
+	/// Log of conversion.
+	String log;
+};
+
+template <typename Vertex>
+static void ConvertGeometry(ptr<Graphics::EditableGeometry<Vertex, size_t> > geometry, const LodParameters& lodParameters, ConvertedMesh& result)
+{
+	std::ostringstream log;
+
+	std::vector<ptr<Graphics::EditableGeometry<Vertex, size_t> > > levels;
+	BuildLodChain(OptimizeGeometry(geometry, log), lodParameters, levels, log);
+
+	for(size_t i = 0; i < levels.size(); ++i)
+	{
+		if(levels[i]->GetVertices().size() > 0x10000)
+			THROW("Too many vertices for 16-bit indices");
+		ptr<Graphics::EditableGeometry<Vertex, unsigned short> > typedGeometry = levels[i]->template CastIndices<unsigned short>();
+		result.verticesFiles.push_back(typedGeometry->SerializeVertices());
+		result.indicesFiles.push_back(typedGeometry->SerializeIndices());
+	}
+
+	result.log = log.str();
+}
+
+/// Convert mesh in worker thread.
+/** Uses only objects of the mesh and result. */
+static void ConvertMesh(const aiMesh* mesh, bool needBump, const LodParameters& lodParameters, ConvertedMesh& result)
+{
+	if(mesh->GetNumUVChannels() != 1)
+		THROW("Number of UV channels is not one");
+
+	int facesCount = (int)mesh->mNumFaces;
+	std::vector<size_t> indices(facesCount * 3);
+	for(int i = 0; i < facesCount; ++i)
+	{
+		for(int j = 0; j < 3; ++j)
+			indices[i * 3 + j] = mesh->mFaces[i].mIndices[j];
+	}
+
+	if(needBump)
+	{
+		std::vector<BumpVertex> vertices(mesh->mNumVertices);
+		for(int i = 0; i < (int)mesh->mNumVertices; ++i)
+		{
+			// inverse bump matrix
+			Eigen::Matrix3f bump;
+			bump.row(0)(0) = mesh->mTangents[i].x;
+			bump.row(0)(1) = mesh->mTangents[i].y;
+			bump.row(0)(2) = mesh->mTangents[i].z;
+			bump.row(1)(0) = mesh->mBitangents[i].x;
+			bump.row(1)(1) = mesh->mBitangents[i].y;
+			bump.row(1)(2) = mesh->mBitangents[i].z;
+			bump.row(2)(0) = mesh->mNormals[i].x;
+			bump.row(2)(1) = mesh->mNormals[i].y;
+			bump.row(2)(2) = mesh->mNormals[i].z;
+
+			Eigen::Matrix3f invBump = bump.inverse();
+
+			BumpVertex& vertex = vertices[i];
+			vertex.position.x = mesh->mVertices[i].x;
+			vertex.position.y = mesh->mVertices[i].y;
+			vertex.position.z = mesh->mVertices[i].z;
+			vertex.transform1 = vec3(invBump.row(0)(0), invBump.row(0)(1), invBump.row(0)(2));
+			vertex.transform2 = vec3(invBump.row(1)(0), invBump.row(1)(1), invBump.row(1)(2));
+			vertex.transform3 = vec3(invBump.row(2)(0), invBump.row(2)(1), invBump.row(2)(2));
+			vertex.texcoord.x = mesh->mTextureCoords[0][i].x;
+			vertex.texcoord.y = mesh->mTextureCoords[0][i].y;
+		}
+
+		ConvertGeometry(MakePointer(NEW(Graphics::EditableGeometry<BumpVertex, size_t>(vertices, indices))), lodParameters, result);
+	}
+	else
+	{
+		std::vector<Vertex> vertices(mesh->mNumVertices);
+		for(int i = 0; i < (int)mesh->mNumVertices; ++i)
+		{
+			Vertex& vertex = vertices[i];
+			vertex.position.x = mesh->mVertices[i].x;
+			vertex.position.y = mesh->mVertices[i].y;
+			vertex.position.z = mesh->mVertices[i].z;
+			vertex.normal.x = mesh->mNormals[i].x;
+			vertex.normal.y = mesh->mNormals[i].y;
+			vertex.normal.z = mesh->mNormals[i].z;
+			vertex.texcoord.x = mesh->mTextureCoords[0][i].x;
+			vertex.texcoord.y = mesh->mTextureCoords[0][i].y;
+		}
+
+		ConvertGeometry(MakePointer(NEW(Graphics::EditableGeometry<Vertex, size_t>(vertices, indices))), lodParameters, result);
+	}
+}
+
 void AssimpConvertor::Run(const std::vector<String>& arguments)
 {
 	bool needBump = false;
+	LodParameters lodParameters;
 	String sourceFileName, destFileName;
 
 	for(size_t i = 0; i < arguments.size(); ++i)
@@ -32,7 +136,7 @@ void AssimpConvertor::Run(const std::vector<String>& arguments)
 			String flag = arg.substr(2);
 			if(flag == "bump")
 				needBump = true;
-			else
+			else if(!lodParameters.ParseFlag(flag))
 				THROW("Unknown flag: " + arg);
 		}
 		else
@@ -63,8 +167,6 @@ void AssimpConvertor::Run(const std::vector<String>& arguments)
 		aiProcess_JoinIdenticalVertices |
 		// only 3-vertex faces
 		aiProcess_Triangulate |
-		// optimize order of vertices
-		aiProcess_ImproveCacheLocality |
 		// sort by primitive type
 		aiProcess_SortByPType |
 		// get right Y uv coord
@@ -76,75 +178,55 @@ void AssimpConvertor::Run(const std::vector<String>& arguments)
 	if(!scene)
 		THROW(String("Can't load geometry with assimp: ") + importer.GetErrorString());
 
-	if(scene->mNumMeshes != 1)
-		THROW("Number of meshes is not one");
-
-	const aiMesh* mesh = scene->mMeshes[0];
+	int meshesCount = (int)scene->mNumMeshes;
+	if(!meshesCount)
+		THROW("No meshes in model");
 
-	if(mesh->GetNumUVChannels() != 1)
-		THROW("Number of UV channels is not one");
-
-	ptr<File> verticesFile;
-
-	if(needBump)
+	// convert meshes in parallel
+	std::vector<ConvertedMesh> results(meshesCount);
 	{
-		verticesFile = NEW(MemoryFile(mesh->mNumVertices * sizeof(BumpVertex)));
-		BumpVertex* vertices = (BumpVertex*)verticesFile->GetData();
-		for(int i = 0; i < (int)mesh->mNumVertices; ++i)
+		ptr<ThreadPool> threadPool = NEW(ThreadPool(std::min(meshesCount, ThreadPool::GetHardwareThreadsCount())));
+		for(int i = 0; i < meshesCount; ++i)
 		{
-			// inverse bump matrix
-			Eigen::Matrix3f bump;
-			bump.row(0)(0) = mesh->mTangents[i].x;
-			bump.row(0)(1) = mesh->mTangents[i].y;
-			bump.row(0)(2) = mesh->mTangents[i].z;
-			bump.row(1)(0) = mesh->mBitangents[i].x;
-			bump.row(1)(1) = mesh->mBitangents[i].y;
-			bump.row(1)(2) = mesh->mBitangents[i].z;
-			bump.row(2)(0) = mesh->mNormals[i].x;
-			bump.row(2)(1) = mesh->mNormals[i].y;
-			bump.row(2)(2) = mesh->mNormals[i].z;
-
-			Eigen::Matrix3f invBump = bump.inverse();
-
-			BumpVertex& vertex = vertices[i];
-			vertex.position.x = mesh->mVertices[i].x;
-			vertex.position.y = mesh->mVertices[i].y;
-			vertex.position.z = mesh->mVertices[i].z;
-			vertex.transform1 = vec3(invBump.row(0)(0), invBump.row(0)(1), invBump.row(0)(2));
-			vertex.transform2 = vec3(invBump.row(1)(0), invBump.row(1)(1), invBump.row(1)(2));
-			vertex.transform3 = vec3(invBump.row(2)(0), invBump.row(2)(1), invBump.row(2)(2));
-			vertex.texcoord.x = mesh->mTextureCoords[0][i].x;
-			vertex.texcoord.y = mesh->mTextureCoords[0][i].y;
+			const aiMesh* mesh = scene->mMeshes[i];
+			ConvertedMesh* result = &results[i];
+			const LodParameters* meshLodParameters = &lodParameters;
+			threadPool->Queue(Handler::BindCall([mesh, needBump, meshLodParameters, result, i]()
+			{
+				try
+				{
+					ConvertMesh(mesh, needBump, *meshLodParameters, *result);
+				}
+				catch(Exception* exception)
+				{
+					std::ostringstream s;
+					s << "Can't convert mesh " << i;
+					THROW_SECONDARY(s.str(), exception);
+				}
+			}));
 		}
+		threadPool->Wait();
 	}
-	else
+
+	for(int i = 0; i < meshesCount; ++i)
 	{
-		verticesFile = NEW(MemoryFile(mesh->mNumVertices * sizeof(Vertex)));
-		Vertex* vertices = (Vertex*)verticesFile->GetData();
-		for(int i = 0; i < (int)mesh->mNumVertices; ++i)
+		ConvertedMesh& result = results[i];
+
+		String meshFileName = destFileName;
+		if(meshesCount > 1)
 		{
-			Vertex& vertex = vertices[i];
-			vertex.position.x = mesh->mVertices[i].x;
-			vertex.position.y = mesh->mVertices[i].y;
-			vertex.position.z = mesh->mVertices[i].z;
-			vertex.normal.x = mesh->mNormals[i].x;
-			vertex.normal.y = mesh->mNormals[i].y;
-			vertex.normal.z = mesh->mNormals[i].z;
-			vertex.texcoord.x = mesh->mTextureCoords[0][i].x;
-			vertex.texcoord.y = mesh->mTextureCoords[0][i].y;
+			std::ostringstream s;
+			s << destFileName << '.' << i;
+			meshFileName = s.str();
 		}
-	}
 
-	int facesCount = (int)mesh->mNumFaces;
-	int indicesCount = facesCount * 3;
-	ptr<File> indicesFile = NEW(MemoryFile(indicesCount * sizeof(unsigned short)));
-	unsigned short* indices = (unsigned short*)indicesFile->GetData();
-	for(int i = 0; i < facesCount; ++i)
-	{
-		for(int j = 0; j < 3; ++j)
-			indices[i * 3 + j] = mesh->mFaces[i].mIndices[j];
-	}
+		std::cout << "Mesh " << i << ":\n" << result.log;
 
-	fileSystem->SaveFile(verticesFile, destFileName + ".vertices");
-	fileSystem->SaveFile(indicesFile, destFileName + ".indices");
+		for(size_t j = 0; j < result.verticesFiles.size(); ++j)
+		{
+			String fileName = GetLodFileName(meshFileName, (int)j);
+			fileSystem->SaveFile(result.verticesFiles[j], fileName + ".vertices");
+			fileSystem->SaveFile(result.indicesFiles[j], fileName + ".indices");
+		}
+	}
 }
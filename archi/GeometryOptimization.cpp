@@ -0,0 +1,45 @@
+#include "GeometryOptimization.hpp"
+#include <sstream>
+
+LodParameters::LodParameters() : levelsCount(0), ratio(0.5f), maxError(1e30f) {}
+
+bool LodParameters::ParseFlag(const String& flag)
+{
+	size_t equalPosition = flag.find('=');
+	if(equalPosition == String::npos)
+		return false;
+	String name = flag.substr(0, equalPosition);
+	std::istringstream value(flag.substr(equalPosition + 1));
+
+	if(name == "lods")
+		value >> levelsCount;
+	else if(name == "lod-ratio")
+		value >> ratio;
+	else if(name == "lod-error")
+		value >> maxError;
+	else
+		return false;
+
+	if(!value)
+		THROW("Invalid value of flag: " + flag);
+
+	return true;
+}
+
+void LodParameters::PrintHelp()
+{
+	std::cout << "LOD flags:\n";
+	std::cout << "--lods=<count> - number of simplified levels to generate (default 0)\n";
+	std::cout << "--lod-ratio=<ratio> - ratio of triangles count between levels (default 0.5)\n";
+	std::cout << "--lod-error=<error> - maximum error of level in model units (default unlimited)\n";
+	std::cout << "Level i > 0 is saved as <result .geo>.lod<i>.vertices/indices.\n";
+}
+
+String GetLodFileName(const String& fileName, int level)
+{
+	if(!level)
+		return fileName;
+	std::ostringstream s;
+	s << fileName << ".lod" << level;
+	return s.str();
+}
@@ -0,0 +1,82 @@
+#ifndef ___INANITY_ARCHI_GEOMETRY_OPTIMIZATION_HPP___
+#define ___INANITY_ARCHI_GEOMETRY_OPTIMIZATION_HPP___
+
+#include "general.hpp"
+#include <iostream>
+
+/// Prepare geometry for rendering.
+/** Welds equal vertices, reorders triangles for vertex cache and
+overdraw, then reorders vertices for fetch locality.
+Writes vertex cache statistics before and after to log. */
+template <typename Vertex, typename Index>
+ptr<Graphics::EditableGeometry<Vertex, Index> > OptimizeGeometry(ptr<Graphics::EditableGeometry<Vertex, Index> > geometry, std::ostream& log = std::cout)
+{
+	typename Graphics::EditableGeometry<Vertex, Index>::VertexCacheStats statsBefore = geometry->AnalyzeVertexCache();
+	size_t verticesCountBefore = geometry->GetVertices().size();
+
+	geometry = geometry->Optimize()->OptimizeVertexCache()->OptimizeOverdraw()->OptimizeVertexFetch();
+
+	typename Graphics::EditableGeometry<Vertex, Index>::VertexCacheStats statsAfter = geometry->AnalyzeVertexCache();
+	log << "Vertices: " << verticesCountBefore << " -> " << geometry->GetVertices().size()
+		<< ", triangles: " << geometry->GetIndices().size() / 3 << "\n";
+	log << "ACMR: " << statsBefore.acmr << " -> " << statsAfter.acmr
+		<< ", ATVR: " << statsBefore.atvr << " -> " << statsAfter.atvr << "\n";
+
+	return geometry;
+}
+
+/// Parameters of LOD chain.
+struct LodParameters
+{
+	/// Number of levels besides base one.
+	int levelsCount;
+	/// Ratio of triangles count of level to previous one.
+	float ratio;
+	/// Maximum error of level, in units of positions.
+	float maxError;
+
+	LodParameters();
+
+	/// Try to parse command line flag (without leading --).
+	/** Supported flags: lods=<count>, lod-ratio=<ratio>, lod-error=<error>.
+	\returns true if flag is LOD one. */
+	bool ParseFlag(const String& flag);
+	/// Print help on flags.
+	static void PrintHelp();
+};
+
+/// Build chain of simplified geometries.
+/** First level is the geometry itself (should be optimized already).
+Every next level is simplified from previous one and optimized
+for vertex cache and fetch. Chain stops early if simplification can't
+reduce geometry within maximum error. Writes triangles counts and
+errors of levels to log. */
+template <typename Vertex, typename Index>
+void BuildLodChain(ptr<Graphics::EditableGeometry<Vertex, Index> > geometry, const LodParameters& parameters, std::vector<ptr<Graphics::EditableGeometry<Vertex, Index> > >& levels, std::ostream& log = std::cout)
+{
+	levels.assign(1, geometry);
+	log << "LOD 0: triangles: " << geometry->GetIndices().size() / 3 << "\n";
+
+	// error relative to base geometry is bounded by sum of errors of levels
+	float totalError = 0;
+	for(int i = 1; i <= parameters.levelsCount; ++i)
+	{
+		size_t indicesCount = levels.back()->GetIndices().size();
+		size_t targetIndicesCount = (size_t)((float)indicesCount * parameters.ratio) / 3 * 3;
+		float error;
+		ptr<Graphics::EditableGeometry<Vertex, Index> > level = levels.back()->Simplify(targetIndicesCount, parameters.maxError, &error);
+		if(level->GetIndices().size() >= indicesCount)
+			break;
+		level = level->OptimizeVertexCache()->OptimizeVertexFetch();
+		levels.push_back(level);
+		totalError += error;
+
+		log << "LOD " << i << ": triangles: " << level->GetIndices().size() / 3
+			<< ", error: " << error << ", accumulated error: " << totalError << "\n";
+	}
+}
+
+/// Get name of LOD file.
+String GetLodFileName(const String& fileName, int level);
+
+#endif
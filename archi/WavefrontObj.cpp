@@ -1,4 +1,5 @@
 #include "WavefrontObj.hpp"
+#include "GeometryOptimization.hpp"
 #include <vector>
 #include <iostream>
 #include <sstream>
@@ -19,11 +20,27 @@ void WavefrontObj::PrintHelp() const
 {
 	std::cout << "Converts a Wavefront OBJ formatted geometry to Inanity geometry.\n";
 	std::cout << "Optional with skin dronimal-formatted text file. Usage:\n";
-	std::cout << "wobj <source .obj> <result .geo> [<skin text file>]\n";
+	std::cout << "wobj [<LOD flags>] <source .obj> <result .geo> [<skin text file>]\n";
+	LodParameters::PrintHelp();
 }
 
-void WavefrontObj::Run(const std::vector<String>& arguments)
+void WavefrontObj::Run(const std::vector<String>& allArguments)
 {
+	// parse flags
+	LodParameters lodParameters;
+	std::vector<String> arguments;
+	for(size_t i = 0; i < allArguments.size(); ++i)
+	{
+		const String& arg = allArguments[i];
+		if(arguments.empty() && arg.length() > 2 && arg[0] == '-' && arg[1] == '-')
+		{
+			if(!lodParameters.ParseFlag(arg.substr(2)))
+				THROW("Unknown flag: " + arg);
+		}
+		else
+			arguments.push_back(arg);
+	}
+
 	if(arguments.size() < 2)
 		THROW("Must be at least 2 arguments for command");
 
@@ -122,38 +139,37 @@ void WavefrontObj::Run(const std::vector<String>& arguments)
 
 		ptr<Graphics::EditableGeometry<SkinnedVertex, size_t> > skinnedGeometry = NEW(Graphics::EditableGeometry<SkinnedVertex, size_t>(skinnedVertices, geometry->GetIndices()));
 
-		ptr<Graphics::EditableGeometry<SkinnedVertex, uint16_t> > optimizedSkinnedGeometry = skinnedGeometry->Optimize()->CastIndices<uint16_t>();
+		std::vector<ptr<Graphics::EditableGeometry<SkinnedVertex, size_t> > > levels;
+		BuildLodChain(OptimizeGeometry(skinnedGeometry), lodParameters, levels);
 
-		if(0)
+		for(size_t i = 0; i < levels.size(); ++i)
 		{
-			const std::vector<SkinnedVertex>& vs = optimizedSkinnedGeometry->GetVertices();
-			const std::vector<unsigned short>& is = optimizedSkinnedGeometry->GetIndices();
-			for(size_t i = 0; i < vs.size(); ++i)
-			{
-				std::cout << vs[i].position;
-				for(size_t j = 0; j < 4; ++j)
-					std::cout << " (" << vs[i].boneNumbers[j] << ' ' << vs[i].boneWeights[j] << ")";
-				std::cout << '\n';
-			}
+			ptr<Graphics::EditableGeometry<SkinnedVertex, uint16_t> > typedGeometry = levels[i]->CastIndices<uint16_t>();
+			String fileName = GetLodFileName(arguments[1], (int)i);
+			fileSystem->SaveFile(typedGeometry->SerializeVertices(), fileName + ".vertices");
+			fileSystem->SaveFile(typedGeometry->SerializeIndices(), fileName + ".indices");
 		}
-
-		fileSystem->SaveFile(optimizedSkinnedGeometry->SerializeVertices(), arguments[1] + ".vertices");
-		fileSystem->SaveFile(optimizedSkinnedGeometry->SerializeIndices(), arguments[1] + ".indices");
 	}
 	else
 	{
-		ptr<Graphics::EditableGeometry<Vertex, size_t> > optimizedGeometry = geometry->Optimize();
-		if(optimizedGeometry->GetVertices().size() > 0x10000)
-		{
-			ptr<Graphics::EditableGeometry<Vertex, uint32_t> > typedGeometry = optimizedGeometry->CastIndices<uint32_t>();
-			fileSystem->SaveFile(typedGeometry->SerializeVertices(), arguments[1] + ".vertices");
-			fileSystem->SaveFile(typedGeometry->SerializeIndices(), arguments[1] + ".indices");
-		}
-		else
+		std::vector<ptr<Graphics::EditableGeometry<Vertex, size_t> > > levels;
+		BuildLodChain(OptimizeGeometry(geometry), lodParameters, levels);
+
+		for(size_t i = 0; i < levels.size(); ++i)
 		{
-			ptr<Graphics::EditableGeometry<Vertex, uint16_t> > typedGeometry = optimizedGeometry->CastIndices<uint16_t>();
-			fileSystem->SaveFile(typedGeometry->SerializeVertices(), arguments[1] + ".vertices");
-			fileSystem->SaveFile(typedGeometry->SerializeIndices(), arguments[1] + ".indices");
+			String fileName = GetLodFileName(arguments[1], (int)i);
+			if(levels[i]->GetVertices().size() > 0x10000)
+			{
+				ptr<Graphics::EditableGeometry<Vertex, uint32_t> > typedGeometry = levels[i]->CastIndices<uint32_t>();
+				fileSystem->SaveFile(typedGeometry->SerializeVertices(), fileName + ".vertices");
+				fileSystem->SaveFile(typedGeometry->SerializeIndices(), fileName + ".indices");
+			}
+			else
+			{
+				ptr<Graphics::EditableGeometry<Vertex, uint16_t> > typedGeometry = levels[i]->CastIndices<uint16_t>();
+				fileSystem->SaveFile(typedGeometry->SerializeVertices(), fileName + ".vertices");
+				fileSystem->SaveFile(typedGeometry->SerializeIndices(), fileName + ".indices");
+			}
 		}
 	}
 }
@@ -0,0 +1,85 @@
+#include "AlStreamDecoder.hpp"
+#include "AlStreamedPlayer.hpp"
+#include "../Thread.hpp"
+#include "../CriticalCode.hpp"
+#include "../Exception.hpp"
+#include <algorithm>
+
+BEGIN_INANITY_AUDIO
+
+AlStreamDecoder::AlStreamDecoder() : stopping(false)
+{
+	BEGIN_TRY();
+
+	thread = NEW(Thread(Thread::ThreadHandler::BindCall([this](const Thread::ThreadHandler::Result&)
+	{
+		WorkerRoutine();
+	})));
+
+	END_TRY("Can't create OpenAL stream decoder");
+}
+
+AlStreamDecoder::~AlStreamDecoder()
+{
+	{
+		CriticalCode cc(criticalSection);
+		stopping = true;
+	}
+	semaphore.Release();
+
+	if(thread)
+		thread->WaitEnd();
+}
+
+void AlStreamDecoder::WorkerRoutine()
+{
+	for(;;)
+	{
+		semaphore.Acquire();
+		// coalesce pending wake-ups
+		while(semaphore.TryAcquire());
+
+		// decode chunks round-robin, until all buffers are full
+		bool decoded;
+		do
+		{
+			decoded = false;
+			for(size_t i = 0; ; ++i)
+			{
+				CriticalCode cc(criticalSection);
+				if(stopping)
+					return;
+				if(i >= players.size())
+					break;
+				decoded |= players[i]->Decode();
+			}
+		}
+		while(decoded);
+	}
+}
+
+CriticalSection& AlStreamDecoder::GetCriticalSection()
+{
+	return criticalSection;
+}
+
+void AlStreamDecoder::RegisterPlayer(AlStreamedPlayer* player)
+{
+	CriticalCode cc(criticalSection);
+	players.push_back(player);
+}
+
+void AlStreamDecoder::UnregisterPlayer(AlStreamedPlayer* player)
+{
+	CriticalCode cc(criticalSection);
+	std::vector<AlStreamedPlayer*>::iterator i = std::find(players.begin(), players.end(), player);
+	if(i != players.end())
+		players.erase(i);
+}
+
+void AlStreamDecoder::Wake()
+{
+	semaphore.Release();
+}
+
+END_INANITY_AUDIO
@@ -0,0 +1,58 @@
+#ifndef ___INANITY_AUDIO_AL_STREAM_DECODER_HPP___
+#define ___INANITY_AUDIO_AL_STREAM_DECODER_HPP___
+
+#include "audio.hpp"
+#include "../CriticalSection.hpp"
+#include "../Semaphore.hpp"
+#include <vector>
+
+BEGIN_INANITY
+
+class Thread;
+
+END_INANITY
+
+BEGIN_INANITY_AUDIO
+
+class AlStreamedPlayer;
+
+/// Background decoder of OpenAL streamed players.
+/** Worker thread decodes streams into players' ring buffers
+ahead of time, so AlSystem::Tick only uploads ready data.
+Player's stream is touched by worker thread only with
+critical section entered, so player changes stream under it too.
+Worker thread never changes reference counters of players' objects
+(see ThreadPool). */
+class AlStreamDecoder : public Object
+{
+private:
+	ptr<Thread> thread;
+
+	CriticalSection criticalSection;
+	/// Players to decode. Protected by critical section.
+	std::vector<AlStreamedPlayer*> players;
+	/// Stop flag. Protected by critical section.
+	bool stopping;
+
+	/// Released to wake up worker thread.
+	Semaphore semaphore;
+
+	void WorkerRoutine();
+
+public:
+	AlStreamDecoder();
+	~AlStreamDecoder();
+
+	/// Critical section protecting players' decoding state.
+	CriticalSection& GetCriticalSection();
+
+	void RegisterPlayer(AlStreamedPlayer* player);
+	void UnregisterPlayer(AlStreamedPlayer* player);
+
+	/// Wake up worker thread to decode more data.
+	void Wake();
+};
+
+END_INANITY_AUDIO
+
+#endif
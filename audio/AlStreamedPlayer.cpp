@@ -1,29 +1,41 @@
 #include "AlStreamedPlayer.hpp"
 #include "AlDevice.hpp"
 #include "AlSystem.hpp"
+#include "AlStreamDecoder.hpp"
 #include "Source.hpp"
 #include "AlBuffer.hpp"
 #include "../InputStream.hpp"
+#include "../CriticalCode.hpp"
 #include "../Exception.hpp"
+#include <algorithm>
 
 BEGIN_INANITY_AUDIO
 
-AlStreamedPlayer::AlStreamedPlayer(ptr<AlDevice> device, ptr<Source> source)
-: AlPlayer(device), source(source), playing(false), looping(false)
+/// Get size of whole frames of specified length, in bytes.
+static size_t GetTimeSize(const Format& format, size_t time)
 {
-	// calculate size of one buffer in bytes
-	Format format = source->GetFormat();
-	bufferSize =
-		format.samplesPerSecond
-		* (format.bitsPerSample / 8)
-		* format.channelsCount
-		* bufferTime / 1000;
+	return format.samplesPerSecond * time / 1000 * (format.bitsPerSample / 8) * format.channelsCount;
+}
 
-	device->GetSystem()->RegisterStreamedPlayer(this);
+AlStreamedPlayer::AlStreamedPlayer(ptr<AlDevice> device, ptr<Source> source)
+: AlPlayer(device), source(source),
+	frameSize((source->GetFormat().bitsPerSample / 8) * source->GetFormat().channelsCount),
+	bufferSize(GetTimeSize(source->GetFormat(), bufferTime)),
+	decodeSize(GetTimeSize(source->GetFormat(), decodeTime)),
+	ringBuffer(GetTimeSize(source->GetFormat(), readAheadTime)),
+	decodeEnded(false), decodeTicks(0), underrunsCount(0),
+	playing(false), looping(false), sourceStarted(false),
+	uploadBuffer(bufferSize)
+{
+	ptr<AlSystem> system = device->GetSystem();
+	system->RegisterStreamedPlayer(this);
+	decoder = system->GetStreamDecoder();
+	decoder->RegisterPlayer(this);
 }
 
 AlStreamedPlayer::~AlStreamedPlayer()
 {
+	decoder->UnregisterPlayer(this);
 	Stop();
 	device->GetSystem()->UnregisterStreamedPlayer(this);
 
@@ -37,8 +49,24 @@ AlStreamedPlayer::~AlStreamedPlayer()
 	}
 }
 
-size_t AlStreamedPlayer::Fill(ptr<AlBuffer>& buffer)
+void AlStreamedPlayer::Restart()
 {
+	CriticalCode cc(decoder->GetCriticalSection());
+	ringBuffer.Reset();
+	stream = source->CreateStream();
+	decodeEnded = false;
+	decodeException = nullptr;
+}
+
+bool AlStreamedPlayer::Fill(ptr<AlBuffer>& buffer)
+{
+	// check end flag before size, so size is final if stream is over
+	bool ended = decodeEnded;
+	size_t size = std::min(ringBuffer.GetReadSize(), bufferSize);
+	// incomplete buffer is uploaded only at the end of sound
+	if(!size || (size < bufferSize && !ended))
+		return false;
+
 	if(!buffer)
 	{
 		ALuint bufferName;
@@ -47,40 +75,64 @@ size_t AlStreamedPlayer::Fill(ptr<AlBuffer>& buffer)
 		buffer = NEW(AlBuffer(device, bufferName));
 	}
 
-	void* data = alloca(bufferSize);
-	size_t read = stream->Read(data, bufferSize);
-	if(read < bufferSize)
+	ringBuffer.Read(&uploadBuffer[0], size);
+
+	Format format = source->GetFormat();
+	alBufferData(
+		buffer->GetName(),
+		AlSystem::ConvertFormat(format),
+		&uploadBuffer[0], (ALsizei)size,
+		format.samplesPerSecond
+	);
+	AlSystem::CheckErrors("Can't upload data to buffer");
+
+	return true;
+}
+
+bool AlStreamedPlayer::Decode()
+{
+	if(!stream || decodeEnded)
+		return false;
+
+	size_t size;
+	char* data = ringBuffer.BeginWrite(size);
+	size = std::min(size, decodeSize);
+	size -= size % frameSize;
+	if(!size)
+		return false;
+
+	Time::Tick startTick = Time::GetTick();
+	size_t readSize;
+	try
 	{
-		if(looping)
-			stream = source->CreateStream();
-		else
-			stream = 0;
+		readSize = stream->Read(data, size);
 	}
-
-	if(read)
+	catch(Exception* exception)
 	{
-		Format format = source->GetFormat();
-		alBufferData(
-			buffer->GetName(),
-			AlSystem::ConvertFormat(format),
-			data, (ALsizei)read,
-			format.samplesPerSecond
-		);
-		AlSystem::CheckErrors("Can't upload data to buffer");
+		decodeException = exception;
+		readSize = 0;
 	}
+	decodeTicks += Time::GetTick() - startTick;
+
+	ringBuffer.EndWrite(readSize);
+	if(readSize < size)
+		decodeEnded = true;
 
-	return read;
+	return true;
 }
 
 void AlStreamedPlayer::Play(bool looped)
 {
 	// get a stream
 	if(!stream)
-		stream = source->CreateStream();
+		Restart();
 
 	// set playing state
 	playing = true;
 	looping = looped;
+
+	// start decoding right now
+	decoder->Wake();
 }
 
 void AlStreamedPlayer::Process()
@@ -109,6 +161,25 @@ void AlStreamedPlayer::Process()
 		std::copy(freeBuffers, freeBuffers + buffersProcessed, buffers + (buffersCount - buffersProcessed));
 	}
 
+	// if stream is decoded to the end, check for errors and loop
+	if(stream && decodeEnded)
+	{
+		CriticalCode cc(decoder->GetCriticalSection());
+		if(decodeException)
+		{
+			ptr<Exception> exception = decodeException;
+			decodeException = nullptr;
+			stream = nullptr;
+			THROW_SECONDARY("Can't decode OpenAL streamed sound", exception);
+		}
+		// decoded data is still in ring buffer, so new stream simply continues it
+		if(looping)
+		{
+			stream = source->CreateStream();
+			decodeEnded = false;
+		}
+	}
+
 	// if there is a stream, and some free buffers, upload and queue data
 	if(stream)
 	{
@@ -118,8 +189,8 @@ void AlStreamedPlayer::Process()
 
 		ALint initialBuffersQueued = buffersQueued;
 
-		while(buffersQueued < buffersCount && stream)
-			Fill(buffers[buffersQueued++]);
+		while(buffersQueued < buffersCount && Fill(buffers[buffersQueued]))
+			++buffersQueued;
 
 		// queue new buffers
 		if(buffersQueued > initialBuffersQueued)
@@ -136,7 +207,7 @@ void AlStreamedPlayer::Process()
 		}
 
 		// ensure playing
-		if(playing)
+		if(playing && buffersQueued)
 		{
 			ALint state;
 			alGetSourcei(sourceName, AL_SOURCE_STATE, &state);
@@ -144,13 +215,36 @@ void AlStreamedPlayer::Process()
 
 			if(state != AL_PLAYING)
 			{
+				// source has played all queued data, while sound is not over
+				if(state == AL_STOPPED && sourceStarted)
+					++underrunsCount;
+
 				alSourcePlay(sourceName);
 				AlSystem::CheckErrors("Can't play source");
+				sourceStarted = true;
 			}
 		}
+
+		// all data is uploaded
+		if(decodeEnded && !ringBuffer.GetReadSize())
+		{
+			CriticalCode cc(decoder->GetCriticalSection());
+			stream = nullptr;
+		}
 	}
 }
 
+float AlStreamedPlayer::GetDecodeTime()
+{
+	CriticalCode cc(decoder->GetCriticalSection());
+	return (float)((double)decodeTicks / (double)Time::GetTicksPerSecond());
+}
+
+int AlStreamedPlayer::GetUnderrunsCount() const
+{
+	return underrunsCount;
+}
+
 void AlStreamedPlayer::Pause()
 {
 	alSourcePause(sourceName);
@@ -160,10 +254,17 @@ void AlStreamedPlayer::Pause()
 
 void AlStreamedPlayer::Stop()
 {
-	stream = 0;
+	{
+		CriticalCode cc(decoder->GetCriticalSection());
+		stream = nullptr;
+		ringBuffer.Reset();
+		decodeEnded = false;
+		decodeException = nullptr;
+	}
 	alSourceStop(sourceName);
 	AlSystem::CheckErrors("Can't stop OpenAL streamed player");
 	playing = false;
+	sourceStarted = false;
 }
 
 bool AlStreamedPlayer::IsPlaying() const
@@ -2,10 +2,14 @@
 #define ___INANITY_AUDIO_AL_STREAMED_PLAYER_HPP___
 
 #include "AlPlayer.hpp"
+#include "PcmRingBuffer.hpp"
+#include "../Time.hpp"
+#include <vector>
 
 BEGIN_INANITY
 
 class InputStream;
+class Exception;
 
 END_INANITY
 
@@ -13,8 +17,11 @@ BEGIN_INANITY_AUDIO
 
 class Source;
 class AlBuffer;
+class AlStreamDecoder;
 
 /// OpenAL player with streaming.
+/** Stream is decoded ahead by AlStreamDecoder's thread into
+ring buffer; Process only uploads ready data into OpenAL buffers. */
 class AlStreamedPlayer : public AlPlayer
 {
 private:
@@ -22,25 +29,54 @@ private:
 	static const size_t bufferTime = 500;
 	/// Number of buffers.
 	static const int buffersCount = 3;
+	/// Length of sound decoded ahead, in ms.
+	static const size_t readAheadTime = 1000;
+	/// Length of sound decoded at once, in ms.
+	static const size_t decodeTime = 100;
 
 	ptr<Source> source;
+	ptr<AlStreamDecoder> decoder;
 
+	/// Size of one frame in bytes.
+	size_t frameSize;
 	/// Size of one buffer in bytes.
 	size_t bufferSize;
+	/// Size of chunk decoded at once, in bytes.
+	size_t decodeSize;
 
 	/// Currently played stream.
-	/** Non-zero only if there is some data in it. */
+	/** Non-zero only if there is some data in it.
+	Changed only with decoder's critical section entered. */
 	ptr<InputStream> stream;
+	/// Decoded data.
+	PcmRingBuffer ringBuffer;
+	/// Is stream decoded to the end.
+	/** Set by decoder thread. */
+	std::atomic<bool> decodeEnded;
+	/// Exception thrown by stream. Protected by decoder's critical section.
+	ptr<Exception> decodeException;
+
+	/// Time of decoding. Protected by decoder's critical section.
+	Time::Tick decodeTicks;
+	/// Number of times the source ran out of data.
+	int underrunsCount;
+
 	/// Is playing in progress.
 	bool playing;
 	/// Is playing looped.
 	bool looping;
+	/// Was source started since last stop.
+	bool sourceStarted;
 
 	ptr<AlBuffer> buffers[buffersCount];
+	/// Temporary buffer for uploading data.
+	std::vector<char> uploadBuffer;
 
-	/// Reads data from source, and uploads to specified buffer.
-	/** \returns size of uploaded data. */
-	size_t Fill(ptr<AlBuffer>& buffer);
+	/// Start stream from the beginning.
+	void Restart();
+	/// Uploads decoded data to specified buffer.
+	/** \returns true if data has been uploaded. */
+	bool Fill(ptr<AlBuffer>& buffer);
 
 public:
 	AlStreamedPlayer(ptr<AlDevice> device, ptr<Source> source);
@@ -48,6 +84,15 @@ public:
 
 	/// Process streaming.
 	void Process();
+	/// Decode next chunk of stream.
+	/** Called by decoder thread with its critical section entered.
+	\returns true if something has been decoded. */
+	bool Decode();
+
+	/// Get total time spent on decoding this stream, in seconds.
+	float GetDecodeTime();
+	/// Get number of times sound was interrupted because of lack of decoded data.
+	int GetUnderrunsCount() const;
 
 	//** Player's methods.
 	void Play(bool looped = false);
@@ -2,12 +2,17 @@
 #include "AlDevice.hpp"
 #include "Format.hpp"
 #include "AlStreamedPlayer.hpp"
+#include "AlStreamDecoder.hpp"
 #include "../Thread.hpp"
 #include "../Exception.hpp"
 #include <algorithm>
 
 BEGIN_INANITY_AUDIO
 
+AlSystem::AlSystem() {}
+
+AlSystem::~AlSystem() {}
+
 void AlSystem::CheckErrors(const char* primaryExceptionString)
 {
 	ALenum error = alGetError();
@@ -68,6 +73,8 @@ ALenum AlSystem::ConvertFormat(const Format& format)
 
 void AlSystem::RegisterStreamedPlayer(AlStreamedPlayer* player)
 {
+	if(!streamDecoder)
+		streamDecoder = NEW(AlStreamDecoder());
 	streamedPlayers.push_back(player);
 }
 
@@ -79,6 +86,11 @@ void AlSystem::UnregisterStreamedPlayer(AlStreamedPlayer* player)
 		streamedPlayers.erase(i);
 }
 
+ptr<AlStreamDecoder> AlSystem::GetStreamDecoder() const
+{
+	return streamDecoder;
+}
+
 ptr<Device> AlSystem::CreateDefaultDevice()
 {
 	BEGIN_TRY();
@@ -96,6 +108,10 @@ void AlSystem::Tick()
 {
 	for(size_t i = 0; i < streamedPlayers.size(); ++i)
 		streamedPlayers[i]->Process();
+
+	// let decoder refill consumed data
+	if(!streamedPlayers.empty())
+		streamDecoder->Wake();
 }
 
 END_INANITY_AUDIO
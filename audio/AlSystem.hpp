@@ -8,6 +8,7 @@
 BEGIN_INANITY_AUDIO
 
 class AlStreamedPlayer;
+class AlStreamDecoder;
 struct Format;
 
 /// Class of OpenAL sound system.
@@ -16,13 +17,19 @@ class AlSystem : public System
 private:
 	/// List of streamed players.
 	std::vector<AlStreamedPlayer*> streamedPlayers;
+	/// Decoder of streamed players, created with first player.
+	ptr<AlStreamDecoder> streamDecoder;
 
 public:
+	AlSystem();
+	~AlSystem();
+
 	static void CheckErrors(const char* primaryExceptionString = 0);
 	static ALenum ConvertFormat(const Format& format);
 
 	void RegisterStreamedPlayer(AlStreamedPlayer* player);
 	void UnregisterStreamedPlayer(AlStreamedPlayer* player);
+	ptr<AlStreamDecoder> GetStreamDecoder() const;
 
 	//** System's methods.
 	ptr<Device> CreateDefaultDevice();
@@ -1,7 +1,6 @@
 #include "OggVorbisSource.hpp"
 #include "OggVorbisStream.hpp"
 #include "../File.hpp"
-#include "../MemoryStream.hpp"
 
 BEGIN_INANITY_AUDIO
 
@@ -25,12 +24,9 @@ size_t OggVorbisSource::GetSamplesCount() const
 
 ptr<File> OggVorbisSource::GetData()
 {
+	// size is known, so memory is allocated at once
 	if(!dataFile)
-	{
-		ptr<MemoryStream> stream = NEW(MemoryStream());
-		stream->ReadAllFromStream(CreateStream());
-		dataFile = stream->ToFile();
-	}
+		dataFile = Source::GetData();
 
 	return dataFile;
 }
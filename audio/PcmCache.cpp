@@ -0,0 +1,149 @@
+#include "PcmCache.hpp"
+#include "PcmSource.hpp"
+#include "../File.hpp"
+#include "../ThreadPool.hpp"
+#include "../Exception.hpp"
+
+BEGIN_INANITY_AUDIO
+
+PcmCache::PreloadItem::PreloadItem(const String& name, ptr<Source> source)
+: name(name), source(source) {}
+
+PcmCache::PcmCache(size_t budget)
+: budget(budget), size(0), hitsCount(0), missesCount(0), evictionsCount(0) {}
+
+PcmCache::~PcmCache() {}
+
+void PcmCache::Add(const String& name, ptr<PcmSource> source)
+{
+	Entry entry;
+	entry.name = name;
+	entry.source = source;
+	entry.size = source->GetData()->GetSize();
+	entries.push_front(entry);
+	entriesByName[name] = entries.begin();
+	size += entry.size;
+
+	Evict();
+}
+
+void PcmCache::Evict()
+{
+	while(size > budget && !entries.empty())
+	{
+		Entry& entry = entries.back();
+		size -= entry.size;
+		entriesByName.erase(entry.name);
+		entries.pop_back();
+		++evictionsCount;
+	}
+}
+
+ptr<PcmSource> PcmCache::Get(const String& name)
+{
+	std::unordered_map<String, Entries::iterator>::const_iterator i = entriesByName.find(name);
+	if(i == entriesByName.end())
+		return nullptr;
+
+	// make entry most recently used
+	entries.splice(entries.begin(), entries, i->second);
+	++hitsCount;
+	return entries.front().source;
+}
+
+ptr<PcmSource> PcmCache::Load(const String& name, ptr<Source> source)
+{
+	ptr<PcmSource> pcmSource = Get(name);
+	if(pcmSource)
+		return pcmSource;
+
+	BEGIN_TRY();
+
+	++missesCount;
+	pcmSource = NEW(PcmSource(source->GetFormat(), source->GetData()));
+	Add(name, pcmSource);
+	return pcmSource;
+
+	END_TRY("Can't load sound " + name + " into PCM cache");
+}
+
+void PcmCache::Preload(const std::vector<PreloadItem>& items, ptr<ThreadPool> threadPool)
+{
+	BEGIN_TRY();
+
+	// select sources to decode
+	std::vector<const PreloadItem*> loadItems;
+	std::unordered_map<String, size_t> loadItemsByName;
+	for(size_t i = 0; i < items.size(); ++i)
+		if(Get(items[i].name))
+			continue;
+		else if(loadItemsByName.insert(std::make_pair(items[i].name, loadItems.size())).second)
+			loadItems.push_back(&items[i]);
+
+	// decode
+	std::vector<ptr<File> > datas(loadItems.size());
+	if(threadPool)
+	{
+		for(size_t i = 0; i < loadItems.size(); ++i)
+		{
+			Source* source = loadItems[i]->source;
+			ptr<File>* data = &datas[i];
+			threadPool->Queue(Handler::BindCall([source, data]()
+			{
+				*data = source->GetData();
+			}));
+		}
+		threadPool->Wait();
+	}
+	else
+		for(size_t i = 0; i < loadItems.size(); ++i)
+			datas[i] = loadItems[i]->source->GetData();
+
+	for(size_t i = 0; i < loadItems.size(); ++i)
+	{
+		++missesCount;
+		Add(loadItems[i]->name, NEW(PcmSource(loadItems[i]->source->GetFormat(), datas[i])));
+	}
+
+	END_TRY("Can't preload sounds into PCM cache");
+}
+
+void PcmCache::Clear()
+{
+	entries.clear();
+	entriesByName.clear();
+	size = 0;
+}
+
+size_t PcmCache::GetBudget() const
+{
+	return budget;
+}
+
+void PcmCache::SetBudget(size_t budget)
+{
+	this->budget = budget;
+	Evict();
+}
+
+size_t PcmCache::GetSize() const
+{
+	return size;
+}
+
+int PcmCache::GetHitsCount() const
+{
+	return hitsCount;
+}
+
+int PcmCache::GetMissesCount() const
+{
+	return missesCount;
+}
+
+int PcmCache::GetEvictionsCount() const
+{
+	return evictionsCount;
+}
+
+END_INANITY_AUDIO
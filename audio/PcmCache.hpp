@@ -0,0 +1,94 @@
+#ifndef ___INANITY_AUDIO_PCM_CACHE_HPP___
+#define ___INANITY_AUDIO_PCM_CACHE_HPP___
+
+#include "audio.hpp"
+#include "../String.hpp"
+#include <list>
+#include <vector>
+#include <unordered_map>
+
+BEGIN_INANITY
+
+class ThreadPool;
+
+END_INANITY
+
+BEGIN_INANITY_AUDIO
+
+class Source;
+class PcmSource;
+
+/// Cache of decoded sound data.
+/** Keeps decoded sources by names (usually names of sound files),
+so sounds used many times (steps, clicks) are decoded once.
+Total size of decoded data is limited by budget, least recently
+used sources are evicted first. Evicted sources stay valid for
+those who hold them.
+Cache should be used by one thread. */
+class PcmCache : public Object
+{
+public:
+	/// Source to preload.
+	struct PreloadItem
+	{
+		String name;
+		ptr<Source> source;
+
+		PreloadItem(const String& name, ptr<Source> source);
+	};
+
+private:
+	struct Entry
+	{
+		String name;
+		ptr<PcmSource> source;
+		size_t size;
+	};
+	typedef std::list<Entry> Entries;
+
+	/// Entries, most recently used first.
+	Entries entries;
+	std::unordered_map<String, Entries::iterator> entriesByName;
+
+	size_t budget;
+	size_t size;
+
+	int hitsCount;
+	int missesCount;
+	int evictionsCount;
+
+	void Add(const String& name, ptr<PcmSource> source);
+	/// Evict entries until size fits in budget.
+	void Evict();
+
+public:
+	/// Create cache.
+	/** \param budget Maximum size of decoded data in bytes. */
+	PcmCache(size_t budget);
+	~PcmCache();
+
+	/// Get cached source.
+	/** \returns Decoded source, or null if it's not in cache. */
+	ptr<PcmSource> Get(const String& name);
+	/// Get cached source, or decode it and add to cache.
+	ptr<PcmSource> Load(const String& name, ptr<Source> source);
+	/// Decode many sources and add them to cache.
+	/** Sources which are not cached yet are decoded in parallel by thread pool.
+	Each source should be used only by one item, and nobody should
+	use them until method returns.
+	\param threadPool Thread pool, or null to decode in current thread. */
+	void Preload(const std::vector<PreloadItem>& items, ptr<ThreadPool> threadPool);
+	void Clear();
+
+	size_t GetBudget() const;
+	void SetBudget(size_t budget);
+	/// Get total size of cached data.
+	size_t GetSize() const;
+	int GetHitsCount() const;
+	int GetMissesCount() const;
+	int GetEvictionsCount() const;
+};
+
+END_INANITY_AUDIO
+
+#endif
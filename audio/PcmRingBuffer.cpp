@@ -0,0 +1,55 @@
+#include "PcmRingBuffer.hpp"
+#include <algorithm>
+#include <cstring>
+
+BEGIN_INANITY_AUDIO
+
+PcmRingBuffer::PcmRingBuffer(size_t capacity)
+: data(capacity), readPosition(0), writePosition(0) {}
+
+size_t PcmRingBuffer::GetCapacity() const
+{
+	return data.size();
+}
+
+char* PcmRingBuffer::BeginWrite(size_t& size)
+{
+	size_t write = writePosition.load(std::memory_order_relaxed);
+	size_t read = readPosition.load(std::memory_order_acquire);
+	size_t offset = write % data.size();
+	size = std::min(data.size() - (write - read), data.size() - offset);
+	return &data[offset];
+}
+
+void PcmRingBuffer::EndWrite(size_t size)
+{
+	writePosition.store(writePosition.load(std::memory_order_relaxed) + size, std::memory_order_release);
+}
+
+size_t PcmRingBuffer::GetReadSize() const
+{
+	return writePosition.load(std::memory_order_acquire) - readPosition.load(std::memory_order_relaxed);
+}
+
+size_t PcmRingBuffer::Read(void* data, size_t size)
+{
+	size_t read = readPosition.load(std::memory_order_relaxed);
+	size = std::min(size, writePosition.load(std::memory_order_acquire) - read);
+
+	// data can wrap around the end of buffer
+	size_t offset = read % this->data.size();
+	size_t firstSize = std::min(size, this->data.size() - offset);
+	memcpy(data, &this->data[offset], firstSize);
+	memcpy((char*)data + firstSize, &this->data[0], size - firstSize);
+
+	readPosition.store(read + size, std::memory_order_release);
+	return size;
+}
+
+void PcmRingBuffer::Reset()
+{
+	readPosition.store(0, std::memory_order_relaxed);
+	writePosition.store(0, std::memory_order_relaxed);
+}
+
+END_INANITY_AUDIO
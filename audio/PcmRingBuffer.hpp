@@ -0,0 +1,47 @@
+#ifndef ___INANITY_AUDIO_PCM_RING_BUFFER_HPP___
+#define ___INANITY_AUDIO_PCM_RING_BUFFER_HPP___
+
+#include "audio.hpp"
+#include <vector>
+#include <atomic>
+
+BEGIN_INANITY_AUDIO
+
+/// Ring buffer of decoded sound data.
+/** Lock-free for one producer thread and one consumer thread:
+producer only moves write position, consumer only moves read position.
+Positions are total numbers of bytes written and read. */
+class PcmRingBuffer
+{
+private:
+	std::vector<char> data;
+	std::atomic<size_t> readPosition;
+	std::atomic<size_t> writePosition;
+
+public:
+	PcmRingBuffer(size_t capacity);
+
+	size_t GetCapacity() const;
+
+	//** Producer's methods.
+	/// Get contiguous free space.
+	/** \param size Receives size of space. */
+	char* BeginWrite(size_t& size);
+	/// Commit written data.
+	void EndWrite(size_t size);
+
+	//** Consumer's methods.
+	/// Get size of data ready for reading.
+	size_t GetReadSize() const;
+	/// Read data.
+	/** \returns Size of data read, less than requested if there is no more ready data. */
+	size_t Read(void* data, size_t size);
+
+	/// Discard all data.
+	/** Neither producer nor consumer should use buffer at the moment. */
+	void Reset();
+};
+
+END_INANITY_AUDIO
+
+#endif
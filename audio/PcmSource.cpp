@@ -0,0 +1,24 @@
+#include "PcmSource.hpp"
+#include "../File.hpp"
+
+BEGIN_INANITY_AUDIO
+
+PcmSource::PcmSource(const Format& format, ptr<File> data)
+: format(format), data(data) {}
+
+Format PcmSource::GetFormat() const
+{
+	return format;
+}
+
+size_t PcmSource::GetSamplesCount() const
+{
+	return data->GetSize() / (format.bitsPerSample / 8 * format.channelsCount);
+}
+
+ptr<File> PcmSource::GetData()
+{
+	return data;
+}
+
+END_INANITY_AUDIO
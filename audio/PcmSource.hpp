@@ -0,0 +1,26 @@
+#ifndef ___INANITY_AUDIO_PCM_SOURCE_HPP___
+#define ___INANITY_AUDIO_PCM_SOURCE_HPP___
+
+#include "Source.hpp"
+
+BEGIN_INANITY_AUDIO
+
+/// Source of already decoded sound data.
+class PcmSource : public Source
+{
+private:
+	Format format;
+	ptr<File> data;
+
+public:
+	PcmSource(const Format& format, ptr<File> data);
+
+	//** Source's methods.
+	Format GetFormat() const override;
+	size_t GetSamplesCount() const override;
+	ptr<File> GetData() override;
+};
+
+END_INANITY_AUDIO
+
+#endif
@@ -0,0 +1,96 @@
+#include "SwAlSink.hpp"
+#include "AlDevice.hpp"
+#include "AlSystem.hpp"
+#include "../Exception.hpp"
+
+BEGIN_INANITY_AUDIO
+
+SwAlSink::SwAlSink(ptr<AlDevice> device, int samplesPerSecond)
+: device(device), samplesPerSecond(samplesPerSecond), sourceName(0)
+{
+	BEGIN_TRY();
+
+	alGenSources(1, &sourceName);
+	AlSystem::CheckErrors("Can't gen source");
+
+	alGenBuffers(buffersCount, bufferNames);
+	AlSystem::CheckErrors("Can't gen buffers");
+
+	freeBuffers.assign(bufferNames, bufferNames + buffersCount);
+	pendingSamples.reserve(bufferFramesCount * 2);
+
+	END_TRY("Can't create OpenAL sink for software sound");
+}
+
+SwAlSink::~SwAlSink()
+{
+	// source should be deleted before buffers
+	if(sourceName)
+	{
+		alSourceStop(sourceName);
+		alDeleteSources(1, &sourceName);
+		AlSystem::CheckErrors("Can't delete source");
+		alDeleteBuffers(buffersCount, bufferNames);
+		AlSystem::CheckErrors("Can't delete buffers");
+	}
+}
+
+void SwAlSink::UnqueueBuffers()
+{
+	ALint buffersProcessed;
+	alGetSourcei(sourceName, AL_BUFFERS_PROCESSED, &buffersProcessed);
+	AlSystem::CheckErrors("Can't get number of processed buffers");
+
+	if(buffersProcessed)
+	{
+		ALuint unqueuedBuffers[buffersCount];
+		alSourceUnqueueBuffers(sourceName, buffersProcessed, unqueuedBuffers);
+		AlSystem::CheckErrors("Can't unqueue buffers");
+		freeBuffers.insert(freeBuffers.end(), unqueuedBuffers, unqueuedBuffers + buffersProcessed);
+	}
+}
+
+int SwAlSink::GetFramesToWrite()
+{
+	UnqueueBuffers();
+	return (int)freeBuffers.size() * bufferFramesCount - (int)pendingSamples.size() / 2;
+}
+
+void SwAlSink::Write(const int16_t* samples, int framesCount)
+{
+	pendingSamples.insert(pendingSamples.end(), samples, samples + framesCount * 2);
+
+	// upload and queue full buffers
+	bool queued = false;
+	size_t bufferSamplesCount = bufferFramesCount * 2;
+	size_t uploadedSamplesCount = 0;
+	while(pendingSamples.size() - uploadedSamplesCount >= bufferSamplesCount && !freeBuffers.empty())
+	{
+		ALuint bufferName = freeBuffers.back();
+		freeBuffers.pop_back();
+		alBufferData(bufferName, AL_FORMAT_STEREO16,
+			&pendingSamples[uploadedSamplesCount], (ALsizei)(bufferSamplesCount * sizeof(int16_t)),
+			samplesPerSecond);
+		AlSystem::CheckErrors("Can't upload data to buffer");
+		alSourceQueueBuffers(sourceName, 1, &bufferName);
+		AlSystem::CheckErrors("Can't queue buffer");
+		uploadedSamplesCount += bufferSamplesCount;
+		queued = true;
+	}
+	pendingSamples.erase(pendingSamples.begin(), pendingSamples.begin() + uploadedSamplesCount);
+
+	// restart source if it has starved
+	if(queued)
+	{
+		ALint state;
+		alGetSourcei(sourceName, AL_SOURCE_STATE, &state);
+		AlSystem::CheckErrors("Can't get OpenAL sink state");
+		if(state != AL_PLAYING)
+		{
+			alSourcePlay(sourceName);
+			AlSystem::CheckErrors("Can't play OpenAL sink");
+		}
+	}
+}
+
+END_INANITY_AUDIO
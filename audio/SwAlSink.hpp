@@ -0,0 +1,46 @@
+#ifndef ___INANITY_AUDIO_SW_AL_SINK_HPP___
+#define ___INANITY_AUDIO_SW_AL_SINK_HPP___
+
+#include "SwSink.hpp"
+#include "al.hpp"
+#include <vector>
+
+BEGIN_INANITY_AUDIO
+
+class AlDevice;
+
+/// Sink of software sound device playing through OpenAL.
+/** Queues mixed sound into single OpenAL source. Allows to use
+software mixing (with unlimited voices) on real hardware. */
+class SwAlSink : public SwSink
+{
+private:
+	/// Number of buffers in queue.
+	static const int buffersCount = 4;
+	/// Length of one buffer, in frames.
+	static const int bufferFramesCount = 1024;
+
+	ptr<AlDevice> device;
+	int samplesPerSecond;
+	ALuint sourceName;
+	ALuint bufferNames[buffersCount];
+	/// Buffers not queued to source.
+	std::vector<ALuint> freeBuffers;
+	/// Written samples not uploaded yet (less than one buffer).
+	std::vector<int16_t> pendingSamples;
+
+	/// Get processed buffers back from source.
+	void UnqueueBuffers();
+
+public:
+	SwAlSink(ptr<AlDevice> device, int samplesPerSecond);
+	~SwAlSink();
+
+	//** SwSink's methods.
+	int GetFramesToWrite();
+	void Write(const int16_t* samples, int framesCount);
+};
+
+END_INANITY_AUDIO
+
+#endif
@@ -0,0 +1,30 @@
+#include "SwBufferedPlayer.hpp"
+#include "SwBufferedSound.hpp"
+#include "SwDevice.hpp"
+
+BEGIN_INANITY_AUDIO
+
+SwBufferedPlayer::SwBufferedPlayer(ptr<SwBufferedSound> sound)
+: SwPlayer(sound->GetDevice(), sound->GetChannelsCount(), sound->GetSamplesPerSecond()),
+	sound(sound), position(0) {}
+
+int SwBufferedPlayer::GetFrames(const float*& frames)
+{
+	frames = sound->GetFrames() + position * channelsCount;
+	return sound->GetFramesCount() - position;
+}
+
+void SwBufferedPlayer::Advance(int framesCount)
+{
+	position += framesCount;
+	int soundFramesCount = sound->GetFramesCount();
+	if(position > soundFramesCount)
+		position = soundFramesCount;
+}
+
+void SwBufferedPlayer::Rewind()
+{
+	position = 0;
+}
+
+END_INANITY_AUDIO
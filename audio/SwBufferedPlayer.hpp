@@ -0,0 +1,29 @@
+#ifndef ___INANITY_AUDIO_SW_BUFFERED_PLAYER_HPP___
+#define ___INANITY_AUDIO_SW_BUFFERED_PLAYER_HPP___
+
+#include "SwPlayer.hpp"
+
+BEGIN_INANITY_AUDIO
+
+class SwBufferedSound;
+
+/// Player of software buffered sound.
+class SwBufferedPlayer : public SwPlayer
+{
+private:
+	ptr<SwBufferedSound> sound;
+	/// Current position in frames.
+	int position;
+
+	//** SwPlayer's methods.
+	int GetFrames(const float*& frames);
+	void Advance(int framesCount);
+	void Rewind();
+
+public:
+	SwBufferedPlayer(ptr<SwBufferedSound> sound);
+};
+
+END_INANITY_AUDIO
+
+#endif
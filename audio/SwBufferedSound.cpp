@@ -0,0 +1,61 @@
+#include "SwBufferedSound.hpp"
+#include "SwBufferedPlayer.hpp"
+#include "SwDevice.hpp"
+#include "SwSystem.hpp"
+#include "SwMixer.hpp"
+#include "Source.hpp"
+#include "../File.hpp"
+#include "../Exception.hpp"
+
+BEGIN_INANITY_AUDIO
+
+SwBufferedSound::SwBufferedSound(ptr<SwDevice> device, ptr<Source> source)
+: device(device)
+{
+	BEGIN_TRY();
+
+	Format format = source->GetFormat();
+	SwSystem::CheckFormat(format);
+	channelsCount = format.channelsCount;
+	samplesPerSecond = format.samplesPerSecond;
+
+	ptr<File> data = source->GetData();
+	framesCount = (int)(data->GetSize() / (channelsCount * format.bitsPerSample / 8));
+
+	frames.assign((framesCount + 1) * channelsCount, 0.0f);
+	SwMixer::Convert(data->GetData(), format.bitsPerSample, &frames[0], framesCount * channelsCount);
+
+	END_TRY("Can't create software buffered sound");
+}
+
+ptr<SwDevice> SwBufferedSound::GetDevice() const
+{
+	return device;
+}
+
+int SwBufferedSound::GetChannelsCount() const
+{
+	return channelsCount;
+}
+
+int SwBufferedSound::GetSamplesPerSecond() const
+{
+	return samplesPerSecond;
+}
+
+int SwBufferedSound::GetFramesCount() const
+{
+	return framesCount;
+}
+
+const float* SwBufferedSound::GetFrames() const
+{
+	return &frames[0];
+}
+
+ptr<Player3D> SwBufferedSound::CreatePlayer3D()
+{
+	return NEW(SwBufferedPlayer(this));
+}
+
+END_INANITY_AUDIO
@@ -0,0 +1,39 @@
+#ifndef ___INANITY_AUDIO_SW_BUFFERED_SOUND_HPP___
+#define ___INANITY_AUDIO_SW_BUFFERED_SOUND_HPP___
+
+#include "Sound.hpp"
+#include <vector>
+
+BEGIN_INANITY_AUDIO
+
+class SwDevice;
+class Source;
+
+/// Buffered sound for software sound system.
+/** Whole sound is decoded into floats at creation. */
+class SwBufferedSound : public Sound
+{
+private:
+	ptr<SwDevice> device;
+	int channelsCount;
+	int samplesPerSecond;
+	int framesCount;
+	/// Decoded frames, plus one zero frame for interpolation.
+	std::vector<float> frames;
+
+public:
+	SwBufferedSound(ptr<SwDevice> device, ptr<Source> source);
+
+	ptr<SwDevice> GetDevice() const;
+	int GetChannelsCount() const;
+	int GetSamplesPerSecond() const;
+	int GetFramesCount() const;
+	const float* GetFrames() const;
+
+	//** Sound's methods.
+	ptr<Player3D> CreatePlayer3D();
+};
+
+END_INANITY_AUDIO
+
+#endif
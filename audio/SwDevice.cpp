@@ -0,0 +1,148 @@
+#include "SwDevice.hpp"
+#include "SwSystem.hpp"
+#include "SwSink.hpp"
+#include "SwMixer.hpp"
+#include "SwPlayer.hpp"
+#include "SwBufferedSound.hpp"
+#include "SwStreamedSound.hpp"
+#include "Source.hpp"
+#include <algorithm>
+
+BEGIN_INANITY_AUDIO
+
+const int SwDevice::blockFramesCount;
+const float SwDevice::maxTickTime = 0.25f;
+
+SwDevice::SwDevice(ptr<SwSystem> system, ptr<SwSink> sink, int samplesPerSecond)
+: system(system), sink(sink), samplesPerSecond(samplesPerSecond),
+	listenerForward(0, 0, -1), listenerUp(0, 1, 0),
+	mixBuffer(blockFramesCount * 2), outputBuffer(blockFramesCount * 2),
+	pendingFrames(0)
+{
+	system->RegisterDevice(this);
+}
+
+SwDevice::~SwDevice()
+{
+	system->UnregisterDevice(this);
+}
+
+ptr<SwSystem> SwDevice::GetSystem() const
+{
+	return system;
+}
+
+int SwDevice::GetSamplesPerSecond() const
+{
+	return samplesPerSecond;
+}
+
+const Math::vec3& SwDevice::GetListenerPosition() const
+{
+	return listenerPosition;
+}
+
+const Math::vec3& SwDevice::GetListenerForward() const
+{
+	return listenerForward;
+}
+
+const Math::vec3& SwDevice::GetListenerUp() const
+{
+	return listenerUp;
+}
+
+void SwDevice::Render(int framesCount)
+{
+	while(framesCount > 0)
+	{
+		int blockFrames = std::min(framesCount, blockFramesCount);
+
+		// without sink voices are only advanced
+		float* buffer = sink ? &mixBuffer[0] : nullptr;
+		if(buffer)
+			std::fill(buffer, buffer + blockFrames * 2, 0.0f);
+
+		for(size_t i = 0; i < voices.size(); )
+			if(voices[i]->Mix(buffer, blockFrames))
+				++i;
+			else
+			{
+				// voice has finished
+				voices[i] = voices.back();
+				voices.pop_back();
+			}
+
+		if(sink)
+		{
+			SwMixer::Convert(buffer, &outputBuffer[0], blockFrames * 2);
+			sink->Write(&outputBuffer[0], blockFrames);
+		}
+
+		framesCount -= blockFrames;
+	}
+}
+
+void SwDevice::Tick()
+{
+	int framesCount = sink ? sink->GetFramesToWrite() : -1;
+	if(framesCount < 0)
+	{
+		// render by real time
+		float time = std::min(ticker.Tick(), maxTickTime);
+		pendingFrames += time * samplesPerSecond;
+		framesCount = (int)pendingFrames;
+		pendingFrames -= framesCount;
+	}
+
+	Render(framesCount);
+}
+
+void SwDevice::AddVoice(SwPlayer* voice)
+{
+	voices.push_back(voice);
+}
+
+void SwDevice::RemoveVoice(SwPlayer* voice)
+{
+	for(size_t i = 0; i < voices.size(); ++i)
+		if(voices[i] == voice)
+		{
+			voices[i] = voices.back();
+			voices.pop_back();
+			break;
+		}
+}
+
+int SwDevice::GetVoicesCount() const
+{
+	return (int)voices.size();
+}
+
+ptr<Sound> SwDevice::CreateBufferedSound(ptr<Source> source)
+{
+	return NEW(SwBufferedSound(this, source));
+}
+
+ptr<Sound> SwDevice::CreateStreamedSound(ptr<Source> source)
+{
+	return NEW(SwStreamedSound(this, source));
+}
+
+void SwDevice::SetListenerPosition(const Math::vec3& position)
+{
+	listenerPosition = position;
+}
+
+void SwDevice::SetListenerOrientation(const Math::vec3& forward, const Math::vec3& up)
+{
+	listenerForward = forward;
+	listenerUp = up;
+}
+
+void SwDevice::SetListenerVelocity(const Math::vec3& velocity)
+{
+	listenerVelocity = velocity;
+}
+
+END_INANITY_AUDIO
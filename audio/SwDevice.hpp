@@ -0,0 +1,77 @@
+#ifndef ___INANITY_AUDIO_SW_DEVICE_HPP___
+#define ___INANITY_AUDIO_SW_DEVICE_HPP___
+
+#include "Device.hpp"
+#include "../Ticker.hpp"
+#include <vector>
+
+BEGIN_INANITY_AUDIO
+
+class SwSystem;
+class SwSink;
+class SwPlayer;
+
+/// Software sound device.
+/** Mixes playing voices into stereo float buffer by blocks,
+and writes result into sink. Mixing is performed in System::Tick,
+for as many frames as sink accepts; or explicitly by Render. */
+class SwDevice : public Device
+{
+private:
+	ptr<SwSystem> system;
+	ptr<SwSink> sink;
+	int samplesPerSecond;
+
+	Math::vec3 listenerPosition;
+	Math::vec3 listenerForward, listenerUp;
+	Math::vec3 listenerVelocity;
+
+	/// Playing voices.
+	/** Players remove themselves from the list when stopped
+	or destroyed. */
+	std::vector<SwPlayer*> voices;
+
+	/// Number of frames mixed at once.
+	static const int blockFramesCount = 256;
+	/// Maximum length of sound rendered by one tick, in seconds.
+	static const float maxTickTime;
+	std::vector<float> mixBuffer;
+	std::vector<int16_t> outputBuffer;
+
+	/// Ticker for sinks accepting any amount of frames.
+	Ticker ticker;
+	/// Time not rendered yet, in frames.
+	float pendingFrames;
+
+public:
+	SwDevice(ptr<SwSystem> system, ptr<SwSink> sink, int samplesPerSecond);
+	~SwDevice();
+
+	ptr<SwSystem> GetSystem() const;
+	int GetSamplesPerSecond() const;
+	const Math::vec3& GetListenerPosition() const;
+	const Math::vec3& GetListenerForward() const;
+	const Math::vec3& GetListenerUp() const;
+
+	/// Mix and output specified number of frames.
+	/** For offline rendering (tools, tests, replays).
+	Also advances non-mixed voices if there is no sink. */
+	void Render(int framesCount);
+	/// Render as many frames as needed by sink or by real time.
+	void Tick();
+
+	void AddVoice(SwPlayer* voice);
+	void RemoveVoice(SwPlayer* voice);
+	int GetVoicesCount() const;
+
+	//** Device's methods.
+	ptr<Sound> CreateBufferedSound(ptr<Source> source) override;
+	ptr<Sound> CreateStreamedSound(ptr<Source> source) override;
+	void SetListenerPosition(const Math::vec3& position) override;
+	void SetListenerOrientation(const Math::vec3& forward, const Math::vec3& up) override;
+	void SetListenerVelocity(const Math::vec3& velocity) override;
+};
+
+END_INANITY_AUDIO
+
+#endif
@@ -0,0 +1,36 @@
+#include "SwMemorySink.hpp"
+#include "../MemoryFile.hpp"
+#include <cstring>
+
+BEGIN_INANITY_AUDIO
+
+size_t SwMemorySink::GetFramesCount() const
+{
+	return samples.size() / 2;
+}
+
+const int16_t* SwMemorySink::GetSamples() const
+{
+	return samples.empty() ? nullptr : &samples[0];
+}
+
+ptr<File> SwMemorySink::GetData() const
+{
+	size_t size = samples.size() * sizeof(int16_t);
+	ptr<File> file = NEW(MemoryFile(size));
+	if(size)
+		memcpy(file->GetData(), &samples[0], size);
+	return file;
+}
+
+void SwMemorySink::Clear()
+{
+	samples.clear();
+}
+
+void SwMemorySink::Write(const int16_t* samples, int framesCount)
+{
+	this->samples.insert(this->samples.end(), samples, samples + framesCount * 2);
+}
+
+END_INANITY_AUDIO
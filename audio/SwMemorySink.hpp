@@ -0,0 +1,36 @@
+#ifndef ___INANITY_AUDIO_SW_MEMORY_SINK_HPP___
+#define ___INANITY_AUDIO_SW_MEMORY_SINK_HPP___
+
+#include "SwSink.hpp"
+#include <vector>
+
+BEGIN_INANITY
+
+class File;
+
+END_INANITY
+
+BEGIN_INANITY_AUDIO
+
+/// Sink of software sound device, keeping sound in memory.
+class SwMemorySink : public SwSink
+{
+private:
+	std::vector<int16_t> samples;
+
+public:
+	/// Get number of written frames.
+	size_t GetFramesCount() const;
+	/// Get written samples.
+	const int16_t* GetSamples() const;
+	/// Get written sound as a file.
+	ptr<File> GetData() const;
+	void Clear();
+
+	//** SwSink's methods.
+	void Write(const int16_t* samples, int framesCount);
+};
+
+END_INANITY_AUDIO
+
+#endif
@@ -0,0 +1,222 @@
+#include "SwMixer.hpp"
+#include <emmintrin.h>
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+BEGIN_INANITY_AUDIO
+
+const uint64_t SwMixer::one;
+
+/// Coefficient to convert 24 upper bits of fraction into float.
+static const float fractionCoef = 1.0f / 16777216.0f;
+
+/// Mix range of output frames with scalar code.
+static void MixRange(float* output, int begin, int end, const SwMixer::Voice& voice)
+{
+	uint64_t position = voice.fraction + voice.step * begin;
+	for(int i = begin; i < end; ++i, position += voice.step)
+	{
+		size_t index = (size_t)(position >> 32);
+		float t = (float)((uint32_t)position >> 8) * fractionCoef;
+		float leftGain = voice.leftGain + voice.leftGainStep * (float)i;
+		float rightGain = voice.rightGain + voice.rightGainStep * (float)i;
+		if(voice.channelsCount == 1)
+		{
+			float a = voice.frames[index], b = voice.frames[index + 1];
+			float s = a + (b - a) * t;
+			output[i * 2] += s * leftGain;
+			output[i * 2 + 1] += s * rightGain;
+		}
+		else
+		{
+			const float* frame = voice.frames + index * 2;
+			output[i * 2] += (frame[0] + (frame[2] - frame[0]) * t) * leftGain;
+			output[i * 2 + 1] += (frame[1] + (frame[3] - frame[1]) * t) * rightGain;
+		}
+	}
+}
+
+/// Mix voice without resampling.
+static void MixStraight(float* output, int framesCount, const SwMixer::Voice& voice)
+{
+	const float* frames = voice.frames;
+	int i = 0;
+
+#ifdef __AVX__
+	{
+		__m256 base = _mm256_setr_ps(voice.leftGain, voice.rightGain, voice.leftGain, voice.rightGain, voice.leftGain, voice.rightGain, voice.leftGain, voice.rightGain);
+		__m256 step = _mm256_setr_ps(voice.leftGainStep, voice.rightGainStep, voice.leftGainStep, voice.rightGainStep, voice.leftGainStep, voice.rightGainStep, voice.leftGainStep, voice.rightGainStep);
+		__m256 index = _mm256_setr_ps(0, 0, 1, 1, 2, 2, 3, 3);
+		__m256 four = _mm256_set1_ps(4);
+		if(voice.channelsCount == 1)
+			for(; i + 8 <= framesCount; i += 8)
+			{
+				__m256 s = _mm256_loadu_ps(frames + i);
+				__m256 lo = _mm256_unpacklo_ps(s, s), hi = _mm256_unpackhi_ps(s, s);
+				__m256 g0 = _mm256_add_ps(base, _mm256_mul_ps(step, index));
+				index = _mm256_add_ps(index, four);
+				__m256 g1 = _mm256_add_ps(base, _mm256_mul_ps(step, index));
+				index = _mm256_add_ps(index, four);
+				float* o = output + i * 2;
+				_mm256_storeu_ps(o, _mm256_add_ps(_mm256_loadu_ps(o), _mm256_mul_ps(_mm256_permute2f128_ps(lo, hi, 0x20), g0)));
+				_mm256_storeu_ps(o + 8, _mm256_add_ps(_mm256_loadu_ps(o + 8), _mm256_mul_ps(_mm256_permute2f128_ps(lo, hi, 0x31), g1)));
+			}
+		else
+			for(; i + 4 <= framesCount; i += 4)
+			{
+				__m256 g = _mm256_add_ps(base, _mm256_mul_ps(step, index));
+				index = _mm256_add_ps(index, four);
+				float* o = output + i * 2;
+				_mm256_storeu_ps(o, _mm256_add_ps(_mm256_loadu_ps(o), _mm256_mul_ps(_mm256_loadu_ps(frames + i * 2), g)));
+			}
+	}
+#endif
+
+	__m128 base = _mm_setr_ps(voice.leftGain, voice.rightGain, voice.leftGain, voice.rightGain);
+	__m128 step = _mm_setr_ps(voice.leftGainStep, voice.rightGainStep, voice.leftGainStep, voice.rightGainStep);
+	__m128 index = _mm_setr_ps((float)i, (float)i, (float)(i + 1), (float)(i + 1));
+	__m128 two = _mm_set1_ps(2);
+	if(voice.channelsCount == 1)
+		for(; i + 4 <= framesCount; i += 4)
+		{
+			__m128 s = _mm_loadu_ps(frames + i);
+			__m128 g0 = _mm_add_ps(base, _mm_mul_ps(step, index));
+			index = _mm_add_ps(index, two);
+			__m128 g1 = _mm_add_ps(base, _mm_mul_ps(step, index));
+			index = _mm_add_ps(index, two);
+			float* o = output + i * 2;
+			_mm_storeu_ps(o, _mm_add_ps(_mm_loadu_ps(o), _mm_mul_ps(_mm_unpacklo_ps(s, s), g0)));
+			_mm_storeu_ps(o + 4, _mm_add_ps(_mm_loadu_ps(o + 4), _mm_mul_ps(_mm_unpackhi_ps(s, s), g1)));
+		}
+	else
+		for(; i + 2 <= framesCount; i += 2)
+		{
+			__m128 g = _mm_add_ps(base, _mm_mul_ps(step, index));
+			index = _mm_add_ps(index, two);
+			float* o = output + i * 2;
+			_mm_storeu_ps(o, _mm_add_ps(_mm_loadu_ps(o), _mm_mul_ps(_mm_loadu_ps(frames + i * 2), g)));
+		}
+
+	MixRange(output, i, framesCount, voice);
+}
+
+/// Mix voice with linear interpolation.
+/** Positions are calculated in integers, and frames are loaded
+one by one, but interpolation and mixing are vectorized. */
+static void MixResampled(float* output, int framesCount, const SwMixer::Voice& voice)
+{
+	const float* frames = voice.frames;
+	uint64_t position = voice.fraction;
+	uint64_t step = voice.step;
+	__m128 base = _mm_setr_ps(voice.leftGain, voice.rightGain, voice.leftGain, voice.rightGain);
+	__m128 gainStep = _mm_setr_ps(voice.leftGainStep, voice.rightGainStep, voice.leftGainStep, voice.rightGainStep);
+	__m128 index = _mm_setr_ps(0, 0, 1, 1);
+	__m128 two = _mm_set1_ps(2);
+	__m128 coef = _mm_set1_ps(fractionCoef);
+	int i = 0;
+
+	if(voice.channelsCount == 1)
+		for(; i + 4 <= framesCount; i += 4)
+		{
+			uint64_t p0 = position, p1 = p0 + step, p2 = p1 + step, p3 = p2 + step;
+			position = p3 + step;
+			const float* f0 = frames + (size_t)(p0 >> 32);
+			const float* f1 = frames + (size_t)(p1 >> 32);
+			const float* f2 = frames + (size_t)(p2 >> 32);
+			const float* f3 = frames + (size_t)(p3 >> 32);
+			__m128 a = _mm_setr_ps(f0[0], f1[0], f2[0], f3[0]);
+			__m128 b = _mm_setr_ps(f0[1], f1[1], f2[1], f3[1]);
+			__m128 t = _mm_mul_ps(_mm_cvtepi32_ps(_mm_setr_epi32(
+				(uint32_t)p0 >> 8, (uint32_t)p1 >> 8, (uint32_t)p2 >> 8, (uint32_t)p3 >> 8)), coef);
+			__m128 s = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+
+			__m128 g0 = _mm_add_ps(base, _mm_mul_ps(gainStep, index));
+			index = _mm_add_ps(index, two);
+			__m128 g1 = _mm_add_ps(base, _mm_mul_ps(gainStep, index));
+			index = _mm_add_ps(index, two);
+			float* o = output + i * 2;
+			_mm_storeu_ps(o, _mm_add_ps(_mm_loadu_ps(o), _mm_mul_ps(_mm_unpacklo_ps(s, s), g0)));
+			_mm_storeu_ps(o + 4, _mm_add_ps(_mm_loadu_ps(o + 4), _mm_mul_ps(_mm_unpackhi_ps(s, s), g1)));
+		}
+	else
+		for(; i + 2 <= framesCount; i += 2)
+		{
+			uint64_t p0 = position, p1 = p0 + step;
+			position = p1 + step;
+			const float* f0 = frames + (size_t)(p0 >> 32) * 2;
+			const float* f1 = frames + (size_t)(p1 >> 32) * 2;
+			__m128 a = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*)f0), (const __m64*)f1);
+			__m128 b = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*)(f0 + 2)), (const __m64*)(f1 + 2));
+			__m128 t = _mm_mul_ps(_mm_cvtepi32_ps(_mm_setr_epi32(
+				(uint32_t)p0 >> 8, (uint32_t)p0 >> 8, (uint32_t)p1 >> 8, (uint32_t)p1 >> 8)), coef);
+			__m128 s = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+
+			__m128 g = _mm_add_ps(base, _mm_mul_ps(gainStep, index));
+			index = _mm_add_ps(index, two);
+			float* o = output + i * 2;
+			_mm_storeu_ps(o, _mm_add_ps(_mm_loadu_ps(o), _mm_mul_ps(s, g)));
+		}
+
+	MixRange(output, i, framesCount, voice);
+}
+
+void SwMixer::Mix(float* output, int framesCount, const Voice& voice)
+{
+	if(voice.step == one && voice.fraction == 0)
+		MixStraight(output, framesCount, voice);
+	else
+		MixResampled(output, framesCount, voice);
+}
+
+void SwMixer::MixScalar(float* output, int framesCount, const Voice& voice)
+{
+	MixRange(output, 0, framesCount, voice);
+}
+
+void SwMixer::Convert(const float* input, int16_t* output, int samplesCount)
+{
+	__m128 minValue = _mm_set1_ps(-1), maxValue = _mm_set1_ps(1), scale = _mm_set1_ps(32767);
+	int i = 0;
+	for(; i + 8 <= samplesCount; i += 8)
+	{
+		__m128 a = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(input + i), minValue), maxValue), scale);
+		__m128 b = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(input + i + 4), minValue), maxValue), scale);
+		_mm_storeu_si128((__m128i*)(output + i), _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+	}
+	for(; i < samplesCount; ++i)
+	{
+		float s = input[i];
+		s = s < -1 ? -1 : s > 1 ? 1 : s;
+		output[i] = (int16_t)_mm_cvtss_si32(_mm_set_ss(s * 32767));
+	}
+}
+
+void SwMixer::Convert(const void* input, int bitsPerSample, float* output, int samplesCount)
+{
+	int i = 0;
+	if(bitsPerSample == 16)
+	{
+		const int16_t* samples = (const int16_t*)input;
+		__m128 scale = _mm_set1_ps(1.0f / 32768);
+		for(; i + 8 <= samplesCount; i += 8)
+		{
+			__m128i s = _mm_loadu_si128((const __m128i*)(samples + i));
+			// sign-extend to 32 bits
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16);
+			_mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+			_mm_storeu_ps(output + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+		}
+		for(; i < samplesCount; ++i)
+			output[i] = (float)samples[i] * (1.0f / 32768);
+	}
+	else
+	{
+		const uint8_t* samples = (const uint8_t*)input;
+		for(; i < samplesCount; ++i)
+			output[i] = (float)((int)samples[i] - 128) * (1.0f / 128);
+	}
+}
+
+END_INANITY_AUDIO
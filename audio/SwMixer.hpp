@@ -0,0 +1,53 @@
+#ifndef ___INANITY_AUDIO_SW_MIXER_HPP___
+#define ___INANITY_AUDIO_SW_MIXER_HPP___
+
+#include "audio.hpp"
+
+BEGIN_INANITY_AUDIO
+
+/// Kernels of software audio mixer.
+/** Mixing is done into interleaved stereo float buffers.
+Source position is in 32.32 fixed point, so it's exact and
+doesn't drift over long sounds. Kernels use SSE2 (and AVX, if
+compiled with it); scalar versions are kept for reference and tails. */
+class SwMixer
+{
+public:
+	/// Fixed point one (source frame step without resampling).
+	static const uint64_t one = 1ULL << 32;
+
+	/// Parameters of mixing one voice into buffer.
+	struct Voice
+	{
+		/// Source frames, mono or interleaved stereo.
+		/** One more frame after the last one used must be readable,
+		for interpolation. */
+		const float* frames;
+		/// 1 or 2.
+		int channelsCount;
+		/// Fractional part of position of the first output frame, 0.32.
+		uint32_t fraction;
+		/// Step of source position per output frame, 32.32.
+		uint64_t step;
+		/// Gains for left and right output channel at the first frame.
+		float leftGain, rightGain;
+		/// Change of gains per output frame.
+		float leftGainStep, rightGainStep;
+	};
+
+	/// Mix voice into stereo buffer.
+	/** Chooses kernel for the voice: straight one if there is
+	no resampling, or linear interpolating one. */
+	static void Mix(float* output, int framesCount, const Voice& voice);
+	/// Mix voice with scalar code only.
+	static void MixScalar(float* output, int framesCount, const Voice& voice);
+
+	/// Convert stereo float buffer into 16-bit samples with saturation.
+	static void Convert(const float* input, int16_t* output, int samplesCount);
+	/// Convert 8-bit unsigned or 16-bit signed samples into floats.
+	static void Convert(const void* input, int bitsPerSample, float* output, int samplesCount);
+};
+
+END_INANITY_AUDIO
+
+#endif
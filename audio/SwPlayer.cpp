@@ -0,0 +1,177 @@
+#include "SwPlayer.hpp"
+#include "SwDevice.hpp"
+#include "SwMixer.hpp"
+#include <algorithm>
+#include <cmath>
+
+BEGIN_INANITY_AUDIO
+
+SwPlayer::SwPlayer(ptr<SwDevice> device, int channelsCount, int samplesPerSecond)
+: device(device), channelsCount(channelsCount), samplesPerSecond(samplesPerSecond),
+	volume(1), pitch(1), playing(false), looping(false),
+	fraction(0), leftGain(0), rightGain(0), gainsSet(false) {}
+
+SwPlayer::~SwPlayer()
+{
+	if(playing)
+		device->RemoveVoice(this);
+}
+
+void SwPlayer::CalculateGains(float& left, float& right) const
+{
+	// stereo sounds are not positioned
+	if(channelsCount != 1)
+	{
+		left = right = volume;
+		return;
+	}
+
+	float gain = volume;
+	float pan = 0;
+	Math::vec3 toSource = position - device->GetListenerPosition();
+	float distance = Math::length(toSource);
+	// inverse distance attenuation with reference distance 1
+	if(distance > 1)
+		gain /= distance;
+	if(distance > 1e-6f)
+	{
+		Math::vec3 rightAxis = Math::cross(device->GetListenerForward(), device->GetListenerUp());
+		float rightLength = Math::length(rightAxis);
+		if(rightLength > 1e-6f)
+			pan = Math::dot(toSource, rightAxis) / (distance * rightLength);
+	}
+
+	// equal power panning
+	float angle = (pan + 1) * 0.78539816f;
+	left = gain * std::cos(angle);
+	right = gain * std::sin(angle);
+}
+
+bool SwPlayer::Mix(float* output, int framesCount)
+{
+	float targetLeftGain, targetRightGain;
+	CalculateGains(targetLeftGain, targetRightGain);
+	if(!gainsSet)
+	{
+		leftGain = targetLeftGain;
+		rightGain = targetRightGain;
+		gainsSet = true;
+	}
+
+	SwMixer::Voice voice;
+	voice.channelsCount = channelsCount;
+	voice.step = (uint64_t)((double)pitch * samplesPerSecond / device->GetSamplesPerSecond() * (double)SwMixer::one);
+	if(!voice.step)
+		voice.step = 1;
+	voice.leftGainStep = (targetLeftGain - leftGain) / framesCount;
+	voice.rightGainStep = (targetRightGain - rightGain) / framesCount;
+
+	int done = 0;
+	while(done < framesCount)
+	{
+		const float* frames;
+		int availableFramesCount = GetFrames(frames);
+		if(!availableFramesCount)
+		{
+			if(!looping)
+				break;
+			Rewind();
+			availableFramesCount = GetFrames(frames);
+			// empty sound
+			if(!availableFramesCount)
+				break;
+		}
+
+		// number of output frames which can be made from available frames
+		uint64_t limit = ((uint64_t)availableFramesCount << 32) - fraction;
+		int count = (int)std::min<uint64_t>((limit - 1) / voice.step + 1, (uint64_t)(framesCount - done));
+
+		if(output)
+		{
+			voice.frames = frames;
+			voice.fraction = fraction;
+			voice.leftGain = leftGain + voice.leftGainStep * (float)done;
+			voice.rightGain = rightGain + voice.rightGainStep * (float)done;
+			SwMixer::Mix(output + done * 2, count, voice);
+		}
+
+		uint64_t end = fraction + voice.step * (uint64_t)count;
+		Advance((int)(end >> 32));
+		fraction = (uint32_t)end;
+		done += count;
+	}
+
+	leftGain = targetLeftGain;
+	rightGain = targetRightGain;
+
+	if(done < framesCount)
+	{
+		// sound is over
+		playing = false;
+		Rewind();
+		fraction = 0;
+		gainsSet = false;
+		return false;
+	}
+
+	return true;
+}
+
+void SwPlayer::Play(bool looped)
+{
+	looping = looped;
+	if(!playing)
+	{
+		playing = true;
+		device->AddVoice(this);
+	}
+}
+
+void SwPlayer::Pause()
+{
+	if(playing)
+	{
+		playing = false;
+		device->RemoveVoice(this);
+	}
+}
+
+void SwPlayer::Stop()
+{
+	Pause();
+	Rewind();
+	fraction = 0;
+	gainsSet = false;
+}
+
+bool SwPlayer::IsPlaying() const
+{
+	return playing;
+}
+
+void SwPlayer::SetVolume(float volume)
+{
+	this->volume = volume;
+}
+
+void SwPlayer::SetPitch(float pitch)
+{
+	this->pitch = pitch;
+}
+
+void SwPlayer::SetPosition(const Math::vec3& position)
+{
+	this->position = position;
+}
+
+void SwPlayer::SetDirection(const Math::vec3& direction)
+{
+	this->direction = direction;
+}
+
+void SwPlayer::SetVelocity(const Math::vec3& velocity)
+{
+	this->velocity = velocity;
+}
+
+END_INANITY_AUDIO
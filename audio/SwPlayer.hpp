@@ -0,0 +1,77 @@
+#ifndef ___INANITY_AUDIO_SW_PLAYER_HPP___
+#define ___INANITY_AUDIO_SW_PLAYER_HPP___
+
+#include "Player3D.hpp"
+
+BEGIN_INANITY_AUDIO
+
+class SwDevice;
+
+/// Base player class of software sound system.
+/** Resamples source (for pitch and different sample rates) with
+linear interpolation, attenuates by distance and pans mono sources
+by position relative to listener (as OpenAL does, stereo
+sources are not positioned). Velocity (doppler effect)
+and direction (cones) are not supported. */
+class SwPlayer : public Player3D
+{
+protected:
+	ptr<SwDevice> device;
+	int channelsCount;
+	int samplesPerSecond;
+
+	float volume;
+	float pitch;
+	Math::vec3 position, direction, velocity;
+
+	bool playing;
+	bool looping;
+
+	/// Fractional part of source position, 0.32 fixed point.
+	uint32_t fraction;
+	/// Gains at the end of last mixed block.
+	/** Gains change smoothly during a block, to prevent clicks. */
+	float leftGain, rightGain;
+	/// Are gains set. If not, first block starts with target gains.
+	bool gainsSet;
+
+	/// Get source frames from current position.
+	/** \param frames Receives pointer to frames. One more frame after
+	returned ones must be readable, for interpolation.
+	\returns Number of frames, 0 if sound is over. */
+	virtual int GetFrames(const float*& frames) = 0;
+	/// Advance current position.
+	/** Position can go beyond frames returned by GetFrames. */
+	virtual void Advance(int framesCount) = 0;
+	/// Set position to the beginning.
+	virtual void Rewind() = 0;
+
+	/// Calculate target gains by volume and 3D position.
+	void CalculateGains(float& left, float& right) const;
+
+public:
+	SwPlayer(ptr<SwDevice> device, int channelsCount, int samplesPerSecond);
+	~SwPlayer();
+
+	/// Mix next frames of sound into stereo buffer.
+	/** \param output Buffer to mix to, or null to skip frames.
+	\returns false if sound has finished. */
+	bool Mix(float* output, int framesCount);
+
+	//** Player's methods.
+	void Play(bool looped = false);
+	void Pause();
+	void Stop();
+	bool IsPlaying() const;
+	void SetVolume(float volume);
+	void SetPitch(float pitch);
+
+	//** Player3D's methods
+	void SetPosition(const Math::vec3& position);
+	void SetDirection(const Math::vec3& direction);
+	void SetVelocity(const Math::vec3& velocity);
+};
+
+END_INANITY_AUDIO
+
+#endif
@@ -0,0 +1,10 @@
+#include "SwSink.hpp"
+
+BEGIN_INANITY_AUDIO
+
+int SwSink::GetFramesToWrite()
+{
+	return -1;
+}
+
+END_INANITY_AUDIO
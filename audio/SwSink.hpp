@@ -0,0 +1,24 @@
+#ifndef ___INANITY_AUDIO_SW_SINK_HPP___
+#define ___INANITY_AUDIO_SW_SINK_HPP___
+
+#include "audio.hpp"
+
+BEGIN_INANITY_AUDIO
+
+/// Abstract output of software sound device.
+/** Receives mixed sound as interleaved 16-bit stereo samples. */
+class SwSink : public Object
+{
+public:
+	/// Get number of frames sink is ready to accept now.
+	/** Real-time outputs return free space in their queues.
+	Default implementation returns -1, which means sink accepts
+	any amount, and device renders frames at real-time pace. */
+	virtual int GetFramesToWrite();
+	/// Write frames.
+	virtual void Write(const int16_t* samples, int framesCount) = 0;
+};
+
+END_INANITY_AUDIO
+
+#endif
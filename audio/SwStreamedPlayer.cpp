@@ -0,0 +1,92 @@
+#include "SwStreamedPlayer.hpp"
+#include "SwDevice.hpp"
+#include "SwSystem.hpp"
+#include "SwMixer.hpp"
+#include "Source.hpp"
+#include "../InputStream.hpp"
+#include "../Exception.hpp"
+#include <algorithm>
+
+BEGIN_INANITY_AUDIO
+
+SwStreamedPlayer::SwStreamedPlayer(ptr<SwDevice> device, ptr<Source> source)
+: SwPlayer(device, source->GetFormat().channelsCount, source->GetFormat().samplesPerSecond),
+	source(source), streamEnded(false), framesCount(0), position(0)
+{
+	Format format = source->GetFormat();
+	SwSystem::CheckFormat(format);
+	bitsPerSample = format.bitsPerSample;
+
+	window.assign((windowFramesCount + 1) * channelsCount, 0.0f);
+	rawBuffer.resize(windowFramesCount * channelsCount * bitsPerSample / 8);
+}
+
+void SwStreamedPlayer::Refill()
+{
+	BEGIN_TRY();
+
+	if(!stream)
+		stream = source->CreateStream();
+
+	size_t frameSize = channelsCount * bitsPerSample / 8;
+
+	if(position < framesCount)
+	{
+		// keep not played frames
+		std::copy(window.begin() + position * channelsCount, window.begin() + framesCount * channelsCount, window.begin());
+		framesCount -= position;
+	}
+	else
+	{
+		// skip frames passed over by resampling
+		bigsize_t skipSize = (bigsize_t)(position - framesCount) * frameSize;
+		if(skipSize && stream->Skip(skipSize) < skipSize)
+			streamEnded = true;
+		framesCount = 0;
+	}
+	position = 0;
+
+	if(!streamEnded)
+	{
+		size_t size = (windowFramesCount - framesCount) * frameSize;
+		size_t readSize = stream->Read(&rawBuffer[0], size);
+		if(readSize < size)
+			streamEnded = true;
+		int readFramesCount = (int)(readSize / frameSize);
+		SwMixer::Convert(&rawBuffer[0], bitsPerSample, &window[framesCount * channelsCount], readFramesCount * channelsCount);
+		framesCount += readFramesCount;
+	}
+
+	// silence after the end, for interpolation
+	if(streamEnded)
+		std::fill(window.begin() + framesCount * channelsCount, window.begin() + (framesCount + 1) * channelsCount, 0.0f);
+
+	END_TRY("Can't refill software streamed player");
+}
+
+int SwStreamedPlayer::GetFrames(const float*& frames)
+{
+	// last frame in window is returned only when the next one is known
+	if(!streamEnded && position + 1 >= framesCount)
+		Refill();
+
+	if(position >= framesCount)
+		return 0;
+	frames = &window[position * channelsCount];
+	return streamEnded ? framesCount - position : framesCount - position - 1;
+}
+
+void SwStreamedPlayer::Advance(int advanceFramesCount)
+{
+	position += advanceFramesCount;
+}
+
+void SwStreamedPlayer::Rewind()
+{
+	stream = nullptr;
+	streamEnded = false;
+	framesCount = 0;
+	position = 0;
+}
+
+END_INANITY_AUDIO
@@ -0,0 +1,57 @@
+#ifndef ___INANITY_AUDIO_SW_STREAMED_PLAYER_HPP___
+#define ___INANITY_AUDIO_SW_STREAMED_PLAYER_HPP___
+
+#include "SwPlayer.hpp"
+#include <vector>
+
+BEGIN_INANITY
+
+class InputStream;
+
+END_INANITY
+
+BEGIN_INANITY_AUDIO
+
+class Source;
+
+/// Player of software streamed sound.
+/** Decodes source stream into a window of float frames,
+refilling it while playing. */
+class SwStreamedPlayer : public SwPlayer
+{
+private:
+	/// Capacity of window, in frames.
+	static const int windowFramesCount = 4096;
+
+	ptr<Source> source;
+	int bitsPerSample;
+
+	/// Current stream, null if not started.
+	ptr<InputStream> stream;
+	/// Is stream over.
+	bool streamEnded;
+
+	/// Decoded frames, plus one frame for interpolation.
+	std::vector<float> window;
+	/// Buffer for raw data read from stream.
+	std::vector<char> rawBuffer;
+	/// Number of decoded frames in window.
+	int framesCount;
+	/// Current position in window, can be beyond decoded frames.
+	int position;
+
+	/// Move rest of window to the beginning and decode more frames.
+	void Refill();
+
+	//** SwPlayer's methods.
+	int GetFrames(const float*& frames);
+	void Advance(int framesCount);
+	void Rewind();
+
+public:
+	SwStreamedPlayer(ptr<SwDevice> device, ptr<Source> source);
+};
+
+END_INANITY_AUDIO
+
+#endif
@@ -0,0 +1,16 @@
+#include "SwStreamedSound.hpp"
+#include "SwStreamedPlayer.hpp"
+#include "SwDevice.hpp"
+#include "Source.hpp"
+
+BEGIN_INANITY_AUDIO
+
+SwStreamedSound::SwStreamedSound(ptr<SwDevice> device, ptr<Source> source)
+: device(device), source(source) {}
+
+ptr<Player3D> SwStreamedSound::CreatePlayer3D()
+{
+	return NEW(SwStreamedPlayer(device, source));
+}
+
+END_INANITY_AUDIO
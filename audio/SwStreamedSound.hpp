@@ -0,0 +1,27 @@
+#ifndef ___INANITY_AUDIO_SW_STREAMED_SOUND_HPP___
+#define ___INANITY_AUDIO_SW_STREAMED_SOUND_HPP___
+
+#include "Sound.hpp"
+
+BEGIN_INANITY_AUDIO
+
+class SwDevice;
+class Source;
+
+/// Streamed sound for software sound system.
+class SwStreamedSound : public Sound
+{
+private:
+	ptr<SwDevice> device;
+	ptr<Source> source;
+
+public:
+	SwStreamedSound(ptr<SwDevice> device, ptr<Source> source);
+
+	//** Sound's methods.
+	ptr<Player3D> CreatePlayer3D();
+};
+
+END_INANITY_AUDIO
+
+#endif
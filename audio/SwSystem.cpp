@@ -0,0 +1,46 @@
+#include "SwSystem.hpp"
+#include "SwDevice.hpp"
+#include "SwSink.hpp"
+#include "Format.hpp"
+#include "../Exception.hpp"
+#include <algorithm>
+
+BEGIN_INANITY_AUDIO
+
+ptr<SwDevice> SwSystem::CreateDevice(ptr<SwSink> sink, int samplesPerSecond)
+{
+	return NEW(SwDevice(this, sink, samplesPerSecond));
+}
+
+void SwSystem::RegisterDevice(SwDevice* device)
+{
+	devices.push_back(device);
+}
+
+void SwSystem::UnregisterDevice(SwDevice* device)
+{
+	std::vector<SwDevice*>::iterator i = std::find(devices.begin(), devices.end(), device);
+	if(i != devices.end())
+		devices.erase(i);
+}
+
+void SwSystem::CheckFormat(const Format& format)
+{
+	if((format.channelsCount != 1 && format.channelsCount != 2) ||
+		(format.bitsPerSample != 8 && format.bitsPerSample != 16) ||
+		format.samplesPerSecond <= 0)
+		THROW("Unsupported software sound format");
+}
+
+ptr<Device> SwSystem::CreateDefaultDevice()
+{
+	return CreateDevice(nullptr);
+}
+
+void SwSystem::Tick()
+{
+	for(size_t i = 0; i < devices.size(); ++i)
+		devices[i]->Tick();
+}
+
+END_INANITY_AUDIO
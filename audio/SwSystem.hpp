@@ -0,0 +1,45 @@
+#ifndef ___INANITY_AUDIO_SW_SYSTEM_HPP___
+#define ___INANITY_AUDIO_SW_SYSTEM_HPP___
+
+#include "System.hpp"
+#include <vector>
+
+BEGIN_INANITY_AUDIO
+
+class SwDevice;
+class SwSink;
+struct Format;
+
+/// Software sound system.
+/** Mixes sound itself, and renders it into a sink (memory,
+WAV file, or OpenAL stream). Doesn't depend on audio drivers,
+so it works on headless servers and in tools, and number of
+voices is limited only by CPU. */
+class SwSystem : public System
+{
+private:
+	/// List of devices.
+	std::vector<SwDevice*> devices;
+
+public:
+	/// Create device rendering into a sink.
+	/** \param sink Sink for mixed sound. If null, voices are
+	played without mixing. */
+	ptr<SwDevice> CreateDevice(ptr<SwSink> sink, int samplesPerSecond = 48000);
+
+	void RegisterDevice(SwDevice* device);
+	void UnregisterDevice(SwDevice* device);
+
+	/// Check that format is supported by mixer.
+	/** Throws exception if it isn't. */
+	static void CheckFormat(const Format& format);
+
+	//** System's methods.
+	/// Create device without sink.
+	ptr<Device> CreateDefaultDevice();
+	void Tick();
+};
+
+END_INANITY_AUDIO
+
+#endif
@@ -0,0 +1,41 @@
+#include "SwWavSink.hpp"
+#include "../MemoryFile.hpp"
+#include <cstring>
+
+BEGIN_INANITY_AUDIO
+
+SwWavSink::SwWavSink(int samplesPerSecond)
+: samplesPerSecond(samplesPerSecond) {}
+
+ptr<File> SwWavSink::GetFile() const
+{
+	const int channelsCount = 2, bitsPerSample = 16;
+	uint32_t dataSize = (uint32_t)(GetFramesCount() * channelsCount * bitsPerSample / 8);
+
+	const uint32_t headerSize = 44;
+	ptr<File> file = NEW(MemoryFile(headerSize + dataSize));
+	uint8_t* data = (uint8_t*)file->GetData();
+
+	// header is little-endian, as well as samples
+	uint32_t fields[] =
+	{
+		0x46464952, // "RIFF"
+		headerSize - 8 + dataSize,
+		0x45564157, // "WAVE"
+		0x20746d66, // "fmt "
+		16,
+		1 | (channelsCount << 16), // PCM format, channels
+		(uint32_t)samplesPerSecond,
+		(uint32_t)(samplesPerSecond * channelsCount * bitsPerSample / 8), // byte rate
+		(channelsCount * bitsPerSample / 8) | (bitsPerSample << 16), // block align, bits per sample
+		0x61746164, // "data"
+		dataSize
+	};
+	memcpy(data, fields, headerSize);
+	if(dataSize)
+		memcpy(data + headerSize, GetSamples(), dataSize);
+
+	return file;
+}
+
+END_INANITY_AUDIO
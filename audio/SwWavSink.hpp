@@ -0,0 +1,25 @@
+#ifndef ___INANITY_AUDIO_SW_WAV_SINK_HPP___
+#define ___INANITY_AUDIO_SW_WAV_SINK_HPP___
+
+#include "SwMemorySink.hpp"
+
+BEGIN_INANITY_AUDIO
+
+/// Sink of software sound device, making WAV file.
+/** Sound is kept in memory, because header of WAV file
+needs size of data. */
+class SwWavSink : public SwMemorySink
+{
+private:
+	int samplesPerSecond;
+
+public:
+	SwWavSink(int samplesPerSecond);
+
+	/// Get written sound as WAV file (16-bit stereo PCM).
+	ptr<File> GetFile() const;
+};
+
+END_INANITY_AUDIO
+
+#endif
@@ -0,0 +1,205 @@
+#include "PcmCache.hpp"
+#include "PcmSource.hpp"
+#include "OggVorbisSource.hpp"
+#include "../MemoryStream.hpp"
+#include "../File.hpp"
+#include "../ThreadPool.hpp"
+#include "../Time.hpp"
+#include "../Exception.hpp"
+#include "../deps/libvorbis/include/vorbis/vorbisenc.h"
+#include "../Checks.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <iostream>
+
+/* Benchmark of decoded PCM cache.
+Encodes a bank of short Ogg Vorbis clips in memory, and measures
+loading of the bank: serial decoding without cache (as every
+buffered sound did), parallel preloading into cache, and loading
+of already cached clips. Also checks that cached data is the same,
+and that budget is respected. */
+
+using namespace Inanity;
+using namespace Inanity::Audio;
+
+static const int clipsCount = 200;
+static const int samplesPerSecond = 44100;
+
+/// Encode clip of noisy tone.
+static ptr<File> EncodeClip(int number)
+{
+	int channelsCount = number % 3 ? 1 : 2;
+	int framesCount = samplesPerSecond / 4 + (number * 997) % samplesPerSecond;
+	float frequency = 200.0f + number * 10;
+
+	vorbis_info info;
+	vorbis_info_init(&info);
+	if(vorbis_encode_init_vbr(&info, channelsCount, samplesPerSecond, 0.4f))
+		THROW("Can't init Vorbis encoder");
+	vorbis_comment comment;
+	vorbis_comment_init(&comment);
+	vorbis_dsp_state dsp;
+	vorbis_analysis_init(&dsp, &info);
+	vorbis_block block;
+	vorbis_block_init(&dsp, &block);
+	ogg_stream_state stream;
+	ogg_stream_init(&stream, number);
+
+	ptr<MemoryStream> output = NEW(MemoryStream());
+	ogg_page page;
+
+	// headers
+	{
+		ogg_packet header, headerComment, headerCode;
+		vorbis_analysis_headerout(&dsp, &comment, &header, &headerComment, &headerCode);
+		ogg_stream_packetin(&stream, &header);
+		ogg_stream_packetin(&stream, &headerComment);
+		ogg_stream_packetin(&stream, &headerCode);
+		while(ogg_stream_flush(&stream, &page))
+		{
+			output->Write(page.header, page.header_len);
+			output->Write(page.body, page.body_len);
+		}
+	}
+
+	unsigned seed = number + 1;
+	for(int written = 0; ; )
+	{
+		int count = std::min(1024, framesCount - written);
+		if(count > 0)
+		{
+			float** buffer = vorbis_analysis_buffer(&dsp, count);
+			for(int i = 0; i < count; ++i)
+				for(int j = 0; j < channelsCount; ++j)
+				{
+					seed = seed * 1103515245 + 12345;
+					buffer[j][i] = 0.5f * std::sin((written + i) * frequency * (j + 1) * 6.2831853f / samplesPerSecond)
+						+ 0.05f * ((float)((seed >> 16) & 0x7fff) / 0x7fff - 0.5f);
+				}
+			written += count;
+		}
+		vorbis_analysis_wrote(&dsp, count > 0 ? count : 0);
+
+		while(vorbis_analysis_blockout(&dsp, &block) == 1)
+		{
+			vorbis_analysis(&block, 0);
+			vorbis_bitrate_addblock(&block);
+			ogg_packet packet;
+			while(vorbis_bitrate_flushpacket(&dsp, &packet))
+			{
+				ogg_stream_packetin(&stream, &packet);
+				while(ogg_stream_pageout(&stream, &page))
+				{
+					output->Write(page.header, page.header_len);
+					output->Write(page.body, page.body_len);
+				}
+			}
+		}
+
+		if(count <= 0)
+			break;
+	}
+	while(ogg_stream_flush(&stream, &page))
+	{
+		output->Write(page.header, page.header_len);
+		output->Write(page.body, page.body_len);
+	}
+
+	ogg_stream_clear(&stream);
+	vorbis_block_clear(&block);
+	vorbis_dsp_clear(&dsp);
+	vorbis_comment_clear(&comment);
+	vorbis_info_clear(&info);
+
+	return output->ToFile();
+}
+
+static String GetClipName(int number)
+{
+	std::ostringstream s;
+	s << "sounds/clip" << number << ".ogg";
+	return s.str();
+}
+
+static double GetTime(Time::Tick startTick)
+{
+	return (double)(Time::GetTick() - startTick) / (double)Time::GetTicksPerSecond();
+}
+
+int main()
+{
+	try
+	{
+		std::vector<ptr<File> > clips(clipsCount);
+		size_t encodedSize = 0;
+		for(int i = 0; i < clipsCount; ++i)
+		{
+			clips[i] = EncodeClip(i);
+			encodedSize += clips[i]->GetSize();
+		}
+		std::cout << clipsCount << " clips, " << (encodedSize / 1024) << " KiB encoded\n";
+
+		// serial decoding without cache
+		Time::Tick startTick = Time::GetTick();
+		std::vector<ptr<File> > serialDatas(clipsCount);
+		size_t decodedSize = 0;
+		for(int i = 0; i < clipsCount; ++i)
+		{
+			serialDatas[i] = ptr<Source>(NEW(OggVorbisSource(clips[i])))->GetData();
+			decodedSize += serialDatas[i]->GetSize();
+		}
+		double serialTime = GetTime(startTick);
+		std::cout << "serial decoding: " << (serialTime * 1000) << " ms, " << (decodedSize / 1024) << " KiB decoded\n";
+
+		// parallel preloading
+		ptr<ThreadPool> threadPool = NEW(ThreadPool());
+		ptr<PcmCache> cache = NEW(PcmCache(decodedSize * 2));
+		startTick = Time::GetTick();
+		{
+			std::vector<PcmCache::PreloadItem> items;
+			for(int i = 0; i < clipsCount; ++i)
+				items.push_back(PcmCache::PreloadItem(GetClipName(i), NEW(OggVorbisSource(clips[i]))));
+			cache->Preload(items, threadPool);
+		}
+		double preloadTime = GetTime(startTick);
+		std::cout << "parallel preloading, " << threadPool->GetThreadsCount() << " threads: " << (preloadTime * 1000)
+			<< " ms, speedup " << (serialTime / preloadTime) << "x\n";
+
+		bool same = cache->GetSize() == decodedSize;
+		for(int i = 0; i < clipsCount && same; ++i)
+		{
+			ptr<File> data = cache->Get(GetClipName(i))->GetData();
+			same = data->GetSize() == serialDatas[i]->GetSize() && !memcmp(data->GetData(), serialDatas[i]->GetData(), data->GetSize());
+		}
+		Check("preloaded data", same);
+
+		// loading of the bank again, as a level restart does
+		startTick = Time::GetTick();
+		int hitsCount = cache->GetHitsCount();
+		for(int i = 0; i < clipsCount; ++i)
+			if(!cache->Get(GetClipName(i)))
+				cache->Load(GetClipName(i), NEW(OggVorbisSource(clips[i])));
+		double cachedTime = GetTime(startTick);
+		Check("cache hits", cache->GetHitsCount() - hitsCount == clipsCount);
+		std::cout << "cached loading: " << (cachedTime * 1000) << " ms\n";
+
+		// budget of half of the bank
+		cache->SetBudget(decodedSize / 2);
+		Check("budget", cache->GetSize() <= decodedSize / 2 && cache->GetEvictionsCount() > 0);
+		// recently used clips are kept
+		Check("LRU", cache->Get(GetClipName(clipsCount - 1)) && !cache->Get(GetClipName(0)));
+		ptr<PcmSource> reloaded = cache->Load(GetClipName(0), NEW(OggVorbisSource(clips[0])));
+		Check("reload", reloaded->GetData()->GetSize() == serialDatas[0]->GetSize() && cache->GetSize() <= decodedSize / 2);
+		std::cout << "budget " << (cache->GetBudget() / 1024) << " KiB: " << (cache->GetSize() / 1024) << " KiB cached, "
+			<< cache->GetEvictionsCount() << " evictions, " << cache->GetHitsCount() << " hits, " << cache->GetMissesCount() << " misses\n";
+	}
+	catch(Exception* exception)
+	{
+		MakePointer(exception)->PrintStack(std::cout);
+		return 1;
+	}
+
+	return ReportChecks();
+}
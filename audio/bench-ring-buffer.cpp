@@ -0,0 +1,160 @@
+#include "PcmRingBuffer.hpp"
+#include "../Thread.hpp"
+#include "../Time.hpp"
+#include "../Exception.hpp"
+#include "../Checks.hpp"
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+/* Benchmark and checks of PCM ring buffer.
+Checks writing and reading across the end of buffer, reading more
+than is ready (underrun), filling buffer up, and reset. Then a
+producer thread streams numbered bytes through a small buffer to
+the consumer, as decoder thread does for streamed player, and
+consumer checks that every byte arrives once and in order. */
+
+using namespace Inanity;
+using namespace Inanity::Audio;
+
+static const size_t streamSize = 64 * 1024 * 1024;
+
+static double GetTime(Time::Tick startTick)
+{
+	return (double)(Time::GetTick() - startTick) / (double)Time::GetTicksPerSecond();
+}
+
+/// Byte number i of stream.
+static inline char GetByte(size_t i)
+{
+	return (char)(i * 7 + (i >> 8));
+}
+
+/// Write bytes [begin, begin + size) of stream into buffer, as much as fits.
+static size_t Write(PcmRingBuffer& buffer, size_t begin, size_t size)
+{
+	size_t written = 0;
+	while(written < size)
+	{
+		size_t space;
+		char* data = buffer.BeginWrite(space);
+		space = std::min(space, size - written);
+		if(!space)
+			break;
+		for(size_t i = 0; i < space; ++i)
+			data[i] = GetByte(begin + written + i);
+		buffer.EndWrite(space);
+		written += space;
+	}
+	return written;
+}
+
+/// Check that data contains bytes [begin, begin + size) of stream.
+static bool IsStream(const char* data, size_t begin, size_t size)
+{
+	for(size_t i = 0; i < size; ++i)
+		if(data[i] != GetByte(begin + i))
+			return false;
+	return true;
+}
+
+static void CheckSingleThread()
+{
+	PcmRingBuffer buffer(100);
+	char data[200];
+	size_t space;
+
+	Check("capacity", buffer.GetCapacity() == 100);
+	buffer.BeginWrite(space);
+	Check("empty space", space == 100);
+	Check("empty read", buffer.GetReadSize() == 0 && buffer.Read(data, 10) == 0);
+
+	// move positions close to the end
+	Check("write", Write(buffer, 0, 70) == 70);
+	Check("read", buffer.Read(data, 70) == 70 && IsStream(data, 0, 70));
+
+	// contiguous space ends at the end of buffer
+	buffer.BeginWrite(space);
+	Check("space before end", space == 30);
+	// write across the end
+	Check("write across end", Write(buffer, 70, 60) == 60);
+	Check("read size across end", buffer.GetReadSize() == 60);
+	buffer.BeginWrite(space);
+	Check("space after wrap", space == 40);
+	// read across the end
+	Check("read across end", buffer.Read(data, 50) == 50 && IsStream(data, 70, 50));
+
+	// underrun: only ready data is read
+	Check("underrun", buffer.Read(data, 50) == 10 && IsStream(data, 120, 10));
+	Check("underrun empty", buffer.GetReadSize() == 0 && buffer.Read(data, 50) == 0);
+
+	// full buffer takes no more data
+	Check("fill", Write(buffer, 130, 150) == 100);
+	buffer.BeginWrite(space);
+	Check("full space", space == 0 && buffer.GetReadSize() == 100);
+	Check("read full", buffer.Read(data, 200) == 100 && IsStream(data, 130, 100));
+
+	buffer.Reset();
+	buffer.BeginWrite(space);
+	Check("reset", buffer.GetReadSize() == 0 && space == 100);
+}
+
+/// Stream data from producer thread to consumer.
+static void RunThreads(size_t capacity, size_t chunkSize)
+{
+	PcmRingBuffer buffer(capacity);
+
+	PcmRingBuffer* b = &buffer;
+	Time::Tick startTick = Time::GetTick();
+	ptr<Thread> producer = NEW(Thread(Thread::ThreadHandler::BindCall([b, chunkSize](const Thread::ThreadHandler::Result&)
+	{
+		for(size_t written = 0; written < streamSize; )
+		{
+			size_t size = Write(*b, written, std::min(chunkSize, streamSize - written));
+			// buffer is full, give time to consumer
+			if(!size)
+				Thread::Sleep(0);
+			written += size;
+		}
+	})));
+
+	std::vector<char> data(chunkSize);
+	size_t readSize = 0, underrunsCount = 0;
+	bool ok = true;
+	while(readSize < streamSize)
+	{
+		size_t size = buffer.Read(&data[0], chunkSize);
+		if(size < chunkSize && readSize + size < streamSize)
+		{
+			++underrunsCount;
+			Thread::Sleep(0);
+		}
+		ok = ok && IsStream(&data[0], readSize, size);
+		readSize += size;
+	}
+	producer->WaitEnd();
+	double time = GetTime(startTick);
+
+	Check("threads data", ok && buffer.GetReadSize() == 0);
+	std::cout << "capacity " << capacity << ", chunk " << chunkSize << ": "
+		<< (streamSize / time / (1024 * 1024)) << " MiB/s, " << underrunsCount << " underruns\n";
+}
+
+int main()
+{
+	try
+	{
+		CheckSingleThread();
+		// odd capacities make chunks wrap at different offsets
+		RunThreads(64 * 1024 + 3, 4096);
+		RunThreads(1024 * 1024 + 7, 16 * 1024);
+	}
+	catch(Exception* exception)
+	{
+		MakePointer(exception)->PrintStack(std::cout);
+		return 1;
+	}
+
+	return ReportChecks();
+}
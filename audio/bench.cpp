@@ -0,0 +1,279 @@
+#include "SwSystem.hpp"
+#include "SwDevice.hpp"
+#include "SwMixer.hpp"
+#include "SwMemorySink.hpp"
+#include "SwWavSink.hpp"
+#include "Source.hpp"
+#include "Sound.hpp"
+#include "Player3D.hpp"
+#include "../MemoryFile.hpp"
+#include "../Time.hpp"
+#include "../Exception.hpp"
+#include "../Checks.hpp"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+/* Benchmark and checks of software sound system.
+Compares SIMD mixing kernels with scalar ones, measures how many
+voices of different kinds device mixes in real time, and checks
+playing logic (buffered and streamed sounds, looping, stopping). */
+
+using namespace Inanity;
+using namespace Inanity::Audio;
+
+/// Source of generated tone.
+class ToneSource : public Source
+{
+private:
+	Format format;
+	ptr<File> data;
+
+public:
+	ToneSource(int samplesPerSecond, int channelsCount, int framesCount, float frequency)
+	{
+		format.samplesPerSecond = samplesPerSecond;
+		format.bitsPerSample = 16;
+		format.channelsCount = (char)channelsCount;
+		data = NEW(MemoryFile(framesCount * channelsCount * sizeof(int16_t)));
+		int16_t* samples = (int16_t*)data->GetData();
+		for(int i = 0; i < framesCount; ++i)
+			for(int j = 0; j < channelsCount; ++j)
+				samples[i * channelsCount + j] = (int16_t)(std::sin((float)i * frequency * (j + 1) * 6.2831853f / samplesPerSecond) * 10000);
+	}
+
+	Format GetFormat() const
+	{
+		return format;
+	}
+
+	size_t GetSamplesCount() const
+	{
+		return data->GetSize() / (format.channelsCount * sizeof(int16_t));
+	}
+
+	ptr<File> GetData()
+	{
+		return data;
+	}
+};
+
+static double GetTime(Time::Tick startTick)
+{
+	return (double)(Time::GetTick() - startTick) / (double)Time::GetTicksPerSecond();
+}
+
+/// Compare SIMD kernels with scalar ones.
+static void BenchKernels()
+{
+	const int framesCount = 256, iterationsCount = 20000;
+	std::vector<float> frames((framesCount * 2 + 1) * 2);
+	for(size_t i = 0; i < frames.size(); ++i)
+		frames[i] = (float)(rand() % 2001 - 1000) * 0.001f;
+	std::vector<float> scalarOutput(framesCount * 2), packedOutput(framesCount * 2);
+
+	struct Case
+	{
+		const char* name;
+		int channelsCount;
+		uint64_t step;
+	} cases[] =
+	{
+		{ "mono straight", 1, SwMixer::one },
+		{ "stereo straight", 2, SwMixer::one },
+		{ "mono resampled", 1, SwMixer::one * 44100 / 48000 },
+		{ "stereo resampled", 2, SwMixer::one * 3 / 2 }
+	};
+
+	for(size_t k = 0; k < sizeof(cases) / sizeof(cases[0]); ++k)
+	{
+		SwMixer::Voice voice;
+		voice.frames = &frames[0];
+		voice.channelsCount = cases[k].channelsCount;
+		voice.fraction = 0;
+		voice.step = cases[k].step;
+		voice.leftGain = 0.3f;
+		voice.rightGain = 0.7f;
+		voice.leftGainStep = 0.001f;
+		voice.rightGainStep = -0.001f;
+
+		Time::Tick startTick = Time::GetTick();
+		for(int i = 0; i < iterationsCount; ++i)
+			SwMixer::MixScalar(&scalarOutput[0], framesCount, voice);
+		double scalarTime = GetTime(startTick);
+		startTick = Time::GetTick();
+		for(int i = 0; i < iterationsCount; ++i)
+			SwMixer::Mix(&packedOutput[0], framesCount, voice);
+		double packedTime = GetTime(startTick);
+
+		// compare results of a single mix
+		std::fill(scalarOutput.begin(), scalarOutput.end(), 0.0f);
+		std::fill(packedOutput.begin(), packedOutput.end(), 0.0f);
+		SwMixer::MixScalar(&scalarOutput[0], framesCount, voice);
+		SwMixer::Mix(&packedOutput[0], framesCount, voice);
+		float maxDifference = 0;
+		for(int i = 0; i < framesCount * 2; ++i)
+			maxDifference = std::max(maxDifference, std::abs(scalarOutput[i] - packedOutput[i]));
+		Check(cases[k].name, maxDifference <= 1e-5f);
+
+		std::cout << "kernel " << cases[k].name << ": scalar " << (scalarTime * 1000) << " ms, SIMD " << (packedTime * 1000)
+			<< " ms, speedup " << (scalarTime / packedTime) << "x\n";
+	}
+}
+
+/// Measure mixing of many voices by device.
+static void BenchDevice(const char* name, int voicesCount, int channelsCount, int samplesPerSecond, float pitch, bool positioned)
+{
+	const int deviceSamplesPerSecond = 48000;
+	const int seconds = 4;
+
+	ptr<SwSystem> system = NEW(SwSystem());
+	ptr<SwMemorySink> sink = NEW(SwMemorySink());
+	ptr<SwDevice> device = system->CreateDevice(sink, deviceSamplesPerSecond);
+	ptr<Sound> sound = device->CreateBufferedSound(NEW(ToneSource(samplesPerSecond, channelsCount, samplesPerSecond, 440)));
+
+	std::vector<ptr<Player3D> > players(voicesCount);
+	for(int i = 0; i < voicesCount; ++i)
+	{
+		players[i] = sound->CreatePlayer3D();
+		players[i]->SetVolume(1.0f / voicesCount);
+		players[i]->SetPitch(pitch);
+		if(positioned)
+			players[i]->SetPosition(Math::vec3((float)(i % 16) - 8, 0, (float)(i / 16) - 8));
+		players[i]->Play(true);
+	}
+
+	Time::Tick startTick = Time::GetTick();
+	for(int i = 0; i < seconds * 10; ++i)
+	{
+		// move sounds every 100 ms
+		if(positioned)
+			for(int j = 0; j < voicesCount; ++j)
+				players[j]->SetPosition(Math::vec3((float)(j % 16) - 8 + i * 0.1f, 0, (float)(j / 16) - 8));
+		device->Render(deviceSamplesPerSecond / 10);
+	}
+	double time = GetTime(startTick);
+
+	Check(name, sink->GetFramesCount() == (size_t)(deviceSamplesPerSecond * seconds));
+	std::cout << "device " << name << ": " << voicesCount << " voices, " << (time * 1000 / seconds)
+		<< " ms of CPU per second of sound, " << (int)(voicesCount * seconds / time) << " voices in real time\n";
+}
+
+/// Render sound with a player, return rendered samples.
+static std::vector<int16_t> RenderSound(ptr<Source> source, bool streamed, float pitch, bool looped, int framesCount, int& voicesCount)
+{
+	ptr<SwSystem> system = NEW(SwSystem());
+	ptr<SwMemorySink> sink = NEW(SwMemorySink());
+	ptr<SwDevice> device = system->CreateDevice(sink, 48000);
+	ptr<Sound> sound = streamed ? device->CreateStreamedSound(source) : device->CreateBufferedSound(source);
+	ptr<Player3D> player = sound->CreatePlayer3D();
+	player->SetPitch(pitch);
+	player->SetPosition(Math::vec3(3, 0, -4));
+	player->Play(looped);
+	device->Render(framesCount);
+	voicesCount = device->GetVoicesCount();
+	return std::vector<int16_t>(sink->GetSamples(), sink->GetSamples() + sink->GetFramesCount() * 2);
+}
+
+/// Check playing logic.
+static void CheckPlaying()
+{
+	// 10000 frames, that is more than streaming window
+	ptr<Source> mono = NEW(ToneSource(44100, 1, 10000, 440));
+	ptr<Source> stereo = NEW(ToneSource(22050, 2, 10000, 440));
+	int voicesCount;
+
+	// streamed sounds must be the same as buffered ones, at any pitch
+	const float pitches[] = { 1.0f, 0.93f, 2.7f };
+	for(int i = 0; i < 3; ++i)
+	{
+		Check("streamed mono", RenderSound(mono, false, pitches[i], true, 40000, voicesCount) == RenderSound(mono, true, pitches[i], true, 40000, voicesCount));
+		Check("streamed stereo", RenderSound(stereo, false, pitches[i], true, 40000, voicesCount) == RenderSound(stereo, true, pitches[i], true, 40000, voicesCount));
+	}
+
+	// not looped sound must end
+	std::vector<int16_t> samples = RenderSound(mono, true, 1, false, 20000, voicesCount);
+	Check("voice removed", voicesCount == 0);
+	int lastFrame = 0;
+	for(int i = 0; i < 20000; ++i)
+		if(samples[i * 2] || samples[i * 2 + 1])
+			lastFrame = i;
+	// 10000 frames at 44100 is 10884 frames at 48000
+	Check("sound length", lastFrame > 10800 && lastFrame < 10890);
+
+	// looped sound continues
+	samples = RenderSound(mono, false, 1, true, 40000, voicesCount);
+	Check("voice looped", voicesCount == 1);
+	bool tail = false;
+	for(int i = 35000; i < 40000; ++i)
+		tail = tail || samples[i * 2];
+	Check("sound looped", tail);
+
+	// source on the right is louder in right channel
+	samples = RenderSound(mono, false, 1, true, 1000, voicesCount);
+	float left = 0, right = 0;
+	for(int i = 0; i < 1000; ++i)
+	{
+		left += std::abs((float)samples[i * 2]);
+		right += std::abs((float)samples[i * 2 + 1]);
+	}
+	Check("panning", right > left * 2);
+
+	// stopped sound doesn't play, and starts from beginning
+	{
+		ptr<SwSystem> system = NEW(SwSystem());
+		ptr<SwMemorySink> sink = NEW(SwMemorySink());
+		ptr<SwDevice> device = system->CreateDevice(sink, 44100);
+		ptr<Player3D> player = device->CreateBufferedSound(mono)->CreatePlayer3D();
+		player->Play();
+		device->Render(500);
+		player->Stop();
+		Check("stopped", !player->IsPlaying() && device->GetVoicesCount() == 0);
+		device->Render(500);
+		player->Play();
+		device->Render(500);
+		const int16_t* s = sink->GetSamples();
+		bool silent = true, same = true;
+		for(int i = 500; i < 1000; ++i)
+			silent = silent && !s[i * 2];
+		for(int i = 0; i < 1000; ++i)
+			same = same && s[i] == s[2000 + i];
+		Check("stop silence", silent);
+		Check("stop rewind", same);
+	}
+
+	// WAV output
+	{
+		ptr<SwSystem> system = NEW(SwSystem());
+		ptr<SwWavSink> sink = NEW(SwWavSink(44100));
+		ptr<SwDevice> device = system->CreateDevice(sink, 44100);
+		ptr<Player3D> player = device->CreateBufferedSound(stereo)->CreatePlayer3D();
+		player->Play();
+		device->Render(1000);
+		ptr<File> file = sink->GetFile();
+		Check("WAV size", file->GetSize() == 44 + 1000 * 4);
+		Check("WAV data", ((const int16_t*)file->GetData())[22 + 1001] != 0);
+	}
+}
+
+int main()
+{
+	try
+	{
+		CheckPlaying();
+		BenchKernels();
+		BenchDevice("mono straight", 256, 1, 48000, 1, false);
+		BenchDevice("stereo straight", 256, 2, 48000, 1, false);
+		BenchDevice("mono resampled", 256, 1, 44100, 1.1f, false);
+		BenchDevice("mono 3D", 256, 1, 48000, 1, true);
+	}
+	catch(Exception* exception)
+	{
+		MakePointer(exception)->PrintStack(std::cout);
+		return 1;
+	}
+
+	return ReportChecks();
+}
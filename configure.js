@@ -25,7 +25,7 @@ exports.configureCompiler = function(objectFile, compiler) {
 	compiler.addMacro('U_STATIC_IMPLEMENTATION');
 
 	// hack for deterministic floats
-	if(source == 'math/HardFloat.cpp' || source == 'math/EmsHardFloat.cpp')
+	if(source == 'math/HardFloat.cpp' || source == 'math/HardFloat4.cpp' || source == 'math/EmsHardFloat.cpp')
 		compiler.fastMath = false;
 };
 
@@ -35,10 +35,10 @@ var libraries = {
 		objects: [
 		'Object', 'ManagedHeap', 'Strings', 'StringTraveler', 'Exception',
 		'MemoryPool', 'ChunkPool', 'PoolObject',
-		'Time', 'Ticker',
+		'Time', 'Ticker', 'FixedStepTicker', 'TimeHistogram',
 		'Log',
-		'Profiling',
-		'Thread', 'CriticalSection', 'CriticalCode', 'Semaphore',
+		'Profiling', 'SampledProfile',
+		'Thread', 'CriticalSection', 'CriticalCode', 'Semaphore', 'ThreadPool',
 		'File', 'EmptyFile', 'PartFile', 'MemoryFile',
 		'InputStream', 'OutputStream', 'FileInputStream', 'MemoryStream',
 		'StreamReader', 'StreamWriter',
@@ -71,7 +71,7 @@ var libraries = {
 	// ******* net
 	'libinanity-net': {
 		objects: [
-		'net.Service', 'net.TcpSocket']
+		'net.Service', 'net.TcpSocket', 'net.BufferedTcpStream', 'net.UdpConnection']
 	},
 	// ******* сетевая библиотека ASIO
 	'libinanity-asio': {
@@ -90,7 +90,7 @@ var libraries = {
 	// ******* библиотека HTTP
 	'libinanity-http': {
 		objects: [
-		'net.HttpStream', 'net.HttpClient']
+		'net.HttpStream', 'net.HttpClient', 'net.HttpServer']
 	},
 	// ******* SQLite поддержка
 	'libinanity-sqlite': {
@@ -100,9 +100,13 @@ var libraries = {
 	'libinanity-sqlitefs': {
 		objects: ['data.SQLiteFileSystem']
 	},
+	// ******* common part of scripts
+	'libinanity-script': {
+		objects: ['script.CodeCache']
+	},
 	// ******* скрипты на lua
 	'libinanity-lua': {
-		objects: ['script.lua.Any', 'script.lua.Function', 'script.lua.MetaProvider', 'script.lua.State', 'script.lua.stuff']
+		objects: ['script.lua.Any', 'script.lua.Function', 'script.lua.MetaProvider', 'script.lua.Profiler', 'script.lua.State', 'script.lua.StatePool', 'script.lua.stuff']
 	},
 	// ******* скрипты на v8
 	'libinanity-v8': {
@@ -202,13 +206,14 @@ var libraries = {
 			'graphics.VertexLayout', 'graphics.VertexLayoutElement',
 			'graphics.PixelFormat', 'graphics.RawTextureData',
 			'graphics.BmpImage', 'graphics.PngImageLoader', 'graphics.TgaImageLoader', 'graphics.UniversalImageLoader',
-			'graphics.RawMesh'
+			'graphics.RawMesh',
+			'graphics.Culler'
 		]
 	},
 	// ******* render graphics (need support for graphics API)
 	'libinanity-graphics-render': {
 		objects: [
-			'graphics.Device', 'graphics.Context',
+			'graphics.Device', 'graphics.Context', 'graphics.CommandList',
 			'graphics.FrameBuffer',
 			'graphics.UniformBuffer', 'graphics.VertexBuffer', 'graphics.IndexBuffer',
 			'graphics.SamplerSettings', 'graphics.DepthStencilState', 'graphics.BlendState',
@@ -266,6 +271,7 @@ var libraries = {
 			'graphics.shaders.Expression',
 			'graphics.shaders.UniformGroup',
 			'graphics.shaders.Sampler',
+			'graphics.shaders.Optimizer',
 			'graphics.shaders.SlGeneratorInstance',
 			'graphics.shaders.GlslGenerator', 'graphics.shaders.GlslGeneratorInstance',
 			'graphics.shaders.Instancer'
@@ -275,7 +281,8 @@ var libraries = {
 	// ******* общее аудио
 	'libinanity-audio': {
 		objects: [
-			'audio.Sound', 'audio.Source', 'audio.WavSource', 'audio.OggVorbisSource', 'audio.OggVorbisStream'
+			'audio.Sound', 'audio.Source', 'audio.WavSource', 'audio.OggVorbisSource', 'audio.OggVorbisStream',
+			'audio.PcmRingBuffer', 'audio.PcmSource', 'audio.PcmCache'
 		]
 	},
 	// ******* OpenAL
@@ -283,7 +290,17 @@ var libraries = {
 		objects: [
 			'audio.AlSystem', 'audio.AlDevice', 'audio.AlBuffer', 'audio.AlPlayer',
 			'audio.AlBufferedSound', 'audio.AlBufferedPlayer',
-			'audio.AlStreamedSound', 'audio.AlStreamedPlayer'
+			'audio.AlStreamedSound', 'audio.AlStreamedPlayer', 'audio.AlStreamDecoder',
+			'audio.SwAlSink'
+		]
+	},
+	// ******* программное аудио
+	'libinanity-swaudio': {
+		objects: [
+			'audio.SwMixer', 'audio.SwSink', 'audio.SwMemorySink', 'audio.SwWavSink',
+			'audio.SwSystem', 'audio.SwDevice', 'audio.SwPlayer',
+			'audio.SwBufferedSound', 'audio.SwBufferedPlayer',
+			'audio.SwStreamedSound', 'audio.SwStreamedPlayer'
 		]
 	},
 	// ******* общая физика
@@ -295,7 +312,7 @@ var libraries = {
 	// ******* физика bullet
 	'libinanity-bullet': {
 		objects: [
-			'physics.BtWorld', 'physics.BtShape', 'physics.BtRigidBody', 'physics.BtCharacter'
+			'physics.BtWorld', 'physics.BtShape', 'physics.BtRigidBody', 'physics.BtCharacter', 'physics.BtThreadSupport'
 		]
 	},
 	// ******* NPAPI plugin
@@ -325,9 +342,9 @@ var libraries = {
 	},
 	// ******* детерминированные числа
 	'libinanity-hardfloat': {
-		'objects-win32': ['math.HardFloat'],
-		'objects-linux': ['math.HardFloat'],
-		'objects-darwin': ['math.HardFloat'],
+		'objects-win32': ['math.HardFloat', 'math.HardFloat4'],
+		'objects-linux': ['math.HardFloat', 'math.HardFloat4'],
+		'objects-darwin': ['math.HardFloat', 'math.HardFloat4'],
 		'objects-emscripten': ['math.EmsHardFloat'],
 	}
 };
@@ -336,7 +353,7 @@ var executables = {
 	archi: {
 		objects: ['archi.main', 'archi.Vertex', 'archi.BlobCreator', /*'archi.FontCreator',*/ /*'archi.SimpleGeometryCreator',*/
 			'archi.SystemFontCreator', 'archi.WavefrontObj', /*'archi.XafConverter'*/ 'archi.SkeletonConverter',
-			'archi.BoneAnimationConverter', 'archi.AssimpConvertor'],
+			'archi.BoneAnimationConverter', 'archi.AssimpConvertor', 'archi.GeometryOptimization'],
 		staticLibraries: [
 			'libinanity-data',
 			'libinanity-graphics-raw',
@@ -379,7 +396,7 @@ var executables = {
 	// TEST
 	, shaderstest: {
 		objects: ['graphics.shaders.test'],
-		staticLibraries: ['libinanity-base', 'libinanity-shaders'],
+		staticLibraries: ['libinanity-graphics-shaders', 'libinanity-graphics-gl', 'libinanity-graphics-raw', 'libinanity-base'],
 		dynamicLibraries: []
 	}
 	// TEST
@@ -392,18 +409,85 @@ var executables = {
 	, audiotest: {
 		objects: ['audio.test'],
 		staticLibraries: ['libinanity-audio', 'libinanity-al', 'libinanity-base', 'deps/libvorbis//libvorbisfile', 'deps/libvorbis//libvorbis', 'deps/libogg//libogg'],
-		dynamicLibraries: ['openal']
+		dynamicLibraries: ['openal'],
+		'dynamicLibraries-linux': ['pthread']
+	}
+	// TEST
+	, audiobench: {
+		objects: ['audio.bench'],
+		staticLibraries: ['libinanity-swaudio', 'libinanity-audio', 'libinanity-base'],
+		dynamicLibraries: []
+	}
+	// TEST
+	, audiocachebench: {
+		objects: ['audio.bench-cache'],
+		staticLibraries: ['libinanity-audio', 'libinanity-base', 'deps/libvorbis//libvorbisfile', 'deps/libvorbis//libvorbis', 'deps/libogg//libogg'],
+		'dynamicLibraries-linux': ['pthread']
+	}
+	// TEST
+	, audiobenchringbuffer: {
+		objects: ['audio.bench-ring-buffer'],
+		staticLibraries: ['libinanity-audio', 'libinanity-base'],
+		'dynamicLibraries-linux': ['pthread']
 	}
 	// TEST
 	, luatest: {
 		objects: ['script.lua.test'],
-		staticLibraries: ['libinanity-platform-filesystem', 'libinanity-lua', 'libinanity-base', 'deps/lua//liblua'],
+		staticLibraries: ['libinanity-platform-filesystem', 'libinanity-lua', 'libinanity-script', 'libinanity-base', 'deps/lua//liblua'],
 		dynamicLibraries: []
 	}
 	// TEST
+	, luabench: {
+		objects: ['script.lua.bench'],
+		staticLibraries: ['libinanity-lua', 'libinanity-script', 'libinanity-base', 'deps/lua//liblua'],
+		dynamicLibraries: []
+	}
+	// TEST
+	, mathtest: {
+		objects: ['math.test'],
+		staticLibraries: ['libinanity-hardfloat', 'libinanity-base'],
+		dynamicLibraries: []
+	}
+	// TEST
+	, mathbench: {
+		objects: ['math.bench'],
+		staticLibraries: ['libinanity-hardfloat', 'libinanity-base'],
+		dynamicLibraries: []
+	}
+	// TEST
+	, mathbenchsimd: {
+		objects: ['math.bench-simd'],
+		staticLibraries: ['libinanity-base'],
+		dynamicLibraries: []
+	}
+	// TEST
+	, graphicsbenchcommandlist: {
+		objects: ['graphics.bench-command-list'],
+		staticLibraries: ['libinanity-graphics-render', 'libinanity-graphics-shaders', 'libinanity-graphics-raw', 'libinanity-base'],
+		'dynamicLibraries-linux': ['pthread']
+	}
+	// TEST
+	, graphicsbenchshadercache: {
+		objects: ['graphics.bench-shader-cache'],
+		staticLibraries: ['libinanity-graphics-render', 'libinanity-graphics-shaders', 'libinanity-graphics-gl', 'libinanity-graphics-raw', 'libinanity-data', 'libinanity-crypto', 'libinanity-base'],
+		'dynamicLibraries-linux': ['pthread']
+	}
+	// TEST
+	, graphicsbenchculling: {
+		objects: ['graphics.bench-culling'],
+		staticLibraries: ['libinanity-graphics-raw', 'libinanity-base'],
+		'dynamicLibraries-linux': ['pthread']
+	}
+	// TEST
+	, physicsbench: {
+		objects: ['physics.bench'],
+		staticLibraries: ['libinanity-bullet', 'libinanity-physics', 'libinanity-base', 'deps/bullet//libbullet-multithreaded', 'deps/bullet//libbullet-dynamics', 'deps/bullet//libbullet-collision', 'deps/bullet//libbullet-linearmath'],
+		'dynamicLibraries-linux': ['pthread']
+	}
+	// TEST
 	, v8test: {
 		objects: ['script.v8.test'],
-		staticLibraries: ['libinanity-platform-filesystem', 'libinanity-v8', 'libinanity-base', 'deps/v8//libv8_base', 'deps/v8//libv8_snapshot'],
+		staticLibraries: ['libinanity-platform-filesystem', 'libinanity-v8', 'libinanity-script', 'libinanity-base', 'deps/v8//libv8_base', 'deps/v8//libv8_snapshot'],
 		'dynamicLibraries-win32': ['ws2_32.lib', 'winmm.lib'],
 		'dynamicLibraries-linux': ['pthread'],
 	}
@@ -432,6 +516,36 @@ var executables = {
 		dynamicLibraries: []
 	}
 	// TEST
+	, netbenchhttp: {
+		objects: ['net.bench-http'],
+		staticLibraries: ['libinanity-http', 'libinanity-asio', 'libinanity-net', 'libinanity-base', 'deps/http-parser//libhttp-parser'],
+		'dynamicLibraries-linux': ['boost_system', 'pthread']
+	}
+	// TEST
+	, netbenchtcpstream: {
+		objects: ['net.bench-tcp-stream'],
+		staticLibraries: ['libinanity-asio', 'libinanity-net', 'libinanity-base'],
+		'dynamicLibraries-linux': ['boost_system', 'pthread']
+	}
+	// TEST
+	, netbenchudpconnection: {
+		objects: ['net.bench-udp-connection'],
+		staticLibraries: ['libinanity-asio', 'libinanity-net', 'libinanity-base'],
+		'dynamicLibraries-linux': ['boost_system', 'pthread']
+	}
+	// TEST
+	, netbenchfcgi: {
+		objects: ['net.bench-fcgi'],
+		staticLibraries: ['libinanity-fcgi', 'libinanity-base', 'deps/fcgi//libfcgi'],
+		'dynamicLibraries-linux': ['pthread']
+	}
+	// TEST
+	, netbenchhttpserver: {
+		objects: ['net.bench-http-server'],
+		staticLibraries: ['libinanity-http', 'libinanity-asio', 'libinanity-net', 'libinanity-data', 'libinanity-platform-filesystem', 'libinanity-base', 'deps/http-parser//libhttp-parser'],
+		'dynamicLibraries-linux': ['boost_system', 'pthread']
+	}
+	// TEST
 	, testft: {
 		objects: ['gui.testft'],
 		staticLibraries: [
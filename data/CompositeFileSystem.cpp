@@ -68,6 +68,15 @@ ptr<File> CompositeFileSystem::TryLoadFile(const String& fileName)
 	return fileSystem->TryLoadFile(path);
 }
 
+bool CompositeFileSystem::IsFileExists(const String& fileName)
+{
+	String path = fileName;
+	ptr<FileSystem> fileSystem = GetFileSystemForPath(path);
+	if(!fileSystem)
+		return false;
+	return fileSystem->IsFileExists(path);
+}
+
 void CompositeFileSystem::SaveFile(ptr<File> file, const String& fileName)
 {
 	try
@@ -32,6 +32,7 @@ public:
 
 	ptr<File> LoadFile(const String& fileName);
 	ptr<File> TryLoadFile(const String& fileName);
+	bool IsFileExists(const String& fileName);
 	void SaveFile(ptr<File> file, const String& fileName);
 };
 
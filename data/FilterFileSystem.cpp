@@ -18,6 +18,11 @@ ptr<File> FilterFileSystem::TryLoadFile(const String& fileName)
 	return fileSystem->TryLoadFile(fileName);
 }
 
+bool FilterFileSystem::IsFileExists(const String& fileName)
+{
+	return fileSystem->IsFileExists(fileName);
+}
+
 ptr<InputStream> FilterFileSystem::LoadStream(const String& fileName)
 {
 	return fileSystem->LoadStream(fileName);
@@ -9,6 +9,11 @@ ptr<File> TempFileSystem::TryLoadFile(const String& fileName)
 	return (i == files.end()) ? nullptr : i->second;
 }
 
+bool TempFileSystem::IsFileExists(const String& fileName)
+{
+	return files.find(fileName) != files.end();
+}
+
 void TempFileSystem::SaveFile(ptr<File> file, const String& fileName)
 {
 	files[fileName] = file;
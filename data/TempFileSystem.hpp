@@ -17,6 +17,7 @@ private:
 
 public:
 	ptr<File> TryLoadFile(const String& fileName);
+	bool IsFileExists(const String& fileName);
 	void SaveFile(ptr<File> file, const String& fileName);
 	void GetFileNames(std::vector<String>& fileNames) const;
 };
@@ -161,6 +161,20 @@ var libraryObjects = {
 		'BulletDynamics.MLCPSolvers.btDantzigLCP',
 		'BulletDynamics.MLCPSolvers.btMLCPSolver'
 		],
+	'libbullet-multithreaded': [
+		'BulletMultiThreaded.btThreadSupportInterface',
+		'BulletMultiThreaded.SpuFakeDma',
+		'BulletMultiThreaded.SpuCollisionObjectWrapper',
+		'BulletMultiThreaded.SpuCollisionTaskProcess',
+		'BulletMultiThreaded.SpuGatheringCollisionDispatcher',
+		'BulletMultiThreaded.SpuContactManifoldCollisionAlgorithm',
+		'BulletMultiThreaded.btParallelConstraintSolver',
+		'BulletMultiThreaded.SpuNarrowPhaseCollisionTask.boxBoxDistance',
+		'BulletMultiThreaded.SpuNarrowPhaseCollisionTask.SpuContactResult',
+		'BulletMultiThreaded.SpuNarrowPhaseCollisionTask.SpuMinkowskiPenetrationDepthSolver',
+		'BulletMultiThreaded.SpuNarrowPhaseCollisionTask.SpuGatheringCollisionTask',
+		'BulletMultiThreaded.SpuNarrowPhaseCollisionTask.SpuCollisionShapes'
+		],
 	'libbullet-softbody': [
 		'BulletSoftBody.btDefaultSoftBodySolver',
 		'BulletSoftBody.btSoftBodyRigidBodyCollisionConfiguration',
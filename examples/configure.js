@@ -20,10 +20,12 @@ var staticLibraries = [
 	'libinanity-compress',
 	'libinanity-base',
 	'libinanity-meta',
-	'libinanity-lua'
+	'libinanity-lua',
+	'libinanity-script'
 ];
 var staticDepsLibraries = [
 	{ dir: 'lua', lib: 'liblua' },
+	{ dir: 'bullet', lib: 'libbullet-multithreaded' },
 	{ dir: 'bullet', lib: 'libbullet-dynamics' },
 	{ dir: 'bullet', lib: 'libbullet-collision' },
 	{ dir: 'bullet', lib: 'libbullet-linearmath' },
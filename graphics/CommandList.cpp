@@ -0,0 +1,243 @@
+#include "CommandList.hpp"
+#include "UniformBuffer.hpp"
+#include "shaders/Sampler.hpp"
+#include "shaders/UniformGroup.hpp"
+#include <cstring>
+
+BEGIN_INANITY_GRAPHICS
+
+CommandList::State::State()
+{
+	memset(this, 0, sizeof(*this));
+}
+
+CommandList::CommandList() : stateStored(false), pendingUploadsBegin(0) {}
+
+CommandList::Key CommandList::MakeKey(int target, int shader, int material, float depth)
+{
+	// 8 bits of target, 16 bits of shader, 16 bits of material, 24 bits of depth
+	if(depth < 0) depth = 0;
+	if(depth > 1) depth = 1;
+	return
+		((Key)(target & 0xff) << 56) |
+		((Key)(shader & 0xffff) << 40) |
+		((Key)(material & 0xffff) << 24) |
+		(Key)(depth * (float)0xffffff);
+}
+
+void CommandList::SetFrameBuffer(FrameBuffer* frameBuffer)
+{
+	state.frameBuffer = frameBuffer;
+	stateStored = false;
+}
+
+void CommandList::SetSampler(int i, Texture* texture, SamplerState* samplerState)
+{
+	THROW_ASSERT(i >= 0 && i < Context::samplersCount);
+	state.textures[i] = texture;
+	state.samplerStates[i] = samplerState;
+	stateStored = false;
+}
+
+void CommandList::SetSampler(const Shaders::SamplerBase& sampler, Texture* texture, SamplerState* samplerState)
+{
+	SetSampler(sampler.GetSlot(), texture, samplerState);
+}
+
+void CommandList::SetUniformBuffer(int i, UniformBuffer* uniformBuffer)
+{
+	THROW_ASSERT(i >= 0 && i < Context::uniformBuffersCount);
+	state.uniformBuffers[i] = uniformBuffer;
+	stateStored = false;
+}
+
+void CommandList::SetUniformBuffer(Shaders::UniformGroup* uniformGroup)
+{
+	SetUniformBuffer(uniformGroup->GetSlot(), uniformGroup->GetBuffer());
+}
+
+void CommandList::SetVertexShader(VertexShader* vertexShader)
+{
+	state.vertexShader = vertexShader;
+	stateStored = false;
+}
+
+void CommandList::SetPixelShader(PixelShader* pixelShader)
+{
+	state.pixelShader = pixelShader;
+	stateStored = false;
+}
+
+void CommandList::SetAttributeBinding(AttributeBinding* attributeBinding)
+{
+	state.attributeBinding = attributeBinding;
+	stateStored = false;
+}
+
+void CommandList::SetVertexBuffer(int i, VertexBuffer* vertexBuffer)
+{
+	THROW_ASSERT(i >= 0 && i < Context::vertexBuffersCount);
+	state.vertexBuffers[i] = vertexBuffer;
+	stateStored = false;
+}
+
+void CommandList::SetIndexBuffer(IndexBuffer* indexBuffer)
+{
+	state.indexBuffer = indexBuffer;
+	stateStored = false;
+}
+
+void CommandList::SetFillMode(Context::FillMode fillMode)
+{
+	state.fillMode = (int)fillMode + 1;
+	stateStored = false;
+}
+
+void CommandList::SetCullMode(Context::CullMode cullMode)
+{
+	state.cullMode = (int)cullMode + 1;
+	stateStored = false;
+}
+
+void CommandList::SetViewport(int viewportWidth, int viewportHeight)
+{
+	state.viewportWidth = viewportWidth;
+	state.viewportHeight = viewportHeight;
+	stateStored = false;
+}
+
+void CommandList::SetDepthStencilState(DepthStencilState* depthStencilState)
+{
+	state.depthStencilState = depthStencilState;
+	stateStored = false;
+}
+
+void CommandList::SetBlendState(BlendState* blendState)
+{
+	state.blendState = blendState;
+	stateStored = false;
+}
+
+void CommandList::ResetState()
+{
+	state = State();
+	stateStored = false;
+}
+
+void CommandList::UploadUniformBufferData(UniformBuffer* uniformBuffer, const void* data, int size)
+{
+	THROW_ASSERT(size == uniformBuffer->GetSize());
+
+	Upload upload;
+	upload.uniformBuffer = uniformBuffer;
+	upload.offset = this->data.size();
+	upload.size = size;
+	uploads.push_back(upload);
+
+	latestUploads[uniformBuffer] = (int)uploads.size() - 1;
+
+	this->data.insert(this->data.end(), (const char*)data, (const char*)data + size);
+}
+
+void CommandList::UploadUniformGroup(Shaders::UniformGroup* uniformGroup)
+{
+	UploadUniformBufferData(uniformGroup->GetBuffer(), uniformGroup->GetData(), uniformGroup->GetSize());
+}
+
+void CommandList::Draw(Key key, int count)
+{
+	DrawInstanced(key, 0, count);
+}
+
+void CommandList::DrawInstanced(Key key, int instancesCount, int count)
+{
+	// store state only if it has changed since last draw
+	if(!stateStored)
+	{
+		states.push_back(state);
+		stateStored = true;
+	}
+
+	Command command;
+	command.key = key;
+	command.state = (int)states.size() - 1;
+	command.uploadsBegin = (int)commandUploads.size();
+
+	// latest uploads of buffers bound by state
+	for(int i = 0; i < Context::uniformBuffersCount; ++i)
+	{
+		UniformBuffer* uniformBuffer = state.uniformBuffers[i];
+		if(!uniformBuffer)
+			continue;
+		bool bound = false;
+		for(int j = 0; j < i && !bound; ++j)
+			bound = state.uniformBuffers[j] == uniformBuffer;
+		if(bound)
+			continue;
+		int upload = GetLatestUpload(uniformBuffer);
+		if(upload >= 0)
+			commandUploads.push_back(upload);
+	}
+	// pending uploads of buffers not bound by state
+	for(int i = pendingUploadsBegin; i < (int)uploads.size(); ++i)
+	{
+		UniformBuffer* uniformBuffer = uploads[i].uniformBuffer;
+		bool bound = false;
+		for(int j = 0; j < Context::uniformBuffersCount && !bound; ++j)
+			bound = state.uniformBuffers[j] == uniformBuffer;
+		if(!bound && GetLatestUpload(uniformBuffer) == i)
+			commandUploads.push_back(i);
+	}
+
+	command.uploadsEnd = (int)commandUploads.size();
+	command.count = count;
+	command.instancesCount = instancesCount;
+	commands.push_back(command);
+
+	pendingUploadsBegin = (int)uploads.size();
+}
+
+int CommandList::GetLatestUpload(UniformBuffer* uniformBuffer) const
+{
+	std::unordered_map<UniformBuffer*, int>::const_iterator i = latestUploads.find(uniformBuffer);
+	return i == latestUploads.end() ? -1 : i->second;
+}
+
+void CommandList::Clear()
+{
+	states.clear();
+	uploads.clear();
+	data.clear();
+	commandUploads.clear();
+	commands.clear();
+	latestUploads.clear();
+	stateStored = false;
+	pendingUploadsBegin = 0;
+}
+
+const CommandList::States& CommandList::GetStates() const
+{
+	return states;
+}
+
+const CommandList::Uploads& CommandList::GetUploads() const
+{
+	return uploads;
+}
+
+const CommandList::CommandUploads& CommandList::GetCommandUploads() const
+{
+	return commandUploads;
+}
+
+const void* CommandList::GetData(size_t offset) const
+{
+	return &data[offset];
+}
+
+const CommandList::Commands& CommandList::GetCommands() const
+{
+	return commands;
+}
+
+END_INANITY_GRAPHICS
@@ -0,0 +1,175 @@
+#ifndef ___INANITY_GRAPHICS_COMMAND_LIST_HPP___
+#define ___INANITY_GRAPHICS_COMMAND_LIST_HPP___
+
+#include "Context.hpp"
+#include <vector>
+#include <unordered_map>
+
+BEGIN_INANITY_SHADERS
+
+class SamplerBase;
+class UniformGroup;
+
+END_INANITY_SHADERS
+
+BEGIN_INANITY_GRAPHICS
+
+/// List of draw commands recorded apart from context.
+/** Command list records draws together with render state they need,
+so a frame could be built by multiple threads, each one filling
+its own list. Lists are then merged, sorted by keys of commands
+and replayed on immediate context by Context::Execute.
+
+Command list stores plain pointers to graphics objects and never
+touches reference counters (they are not thread-safe), so all
+objects passed to list must stay alive until list is executed.
+Command list itself should be used by one thread at a time.
+
+Render state of list is not inherited between commands in any
+other way than by recording order: Set* methods change current state
+of list, and every Draw captures current state. Null (or zero) state
+means "inherit from context": the value set by context's Lets at the
+moment of execution is used. */
+class CommandList : public Object
+{
+public:
+	/// Sort key of command.
+	/** Commands with lesser keys are executed first.
+	Commands with equal keys are executed in order of recording. */
+	typedef unsigned long long Key;
+
+	/// Render state captured by draw command.
+	struct State
+	{
+		FrameBuffer* frameBuffer;
+		Texture* textures[Context::samplersCount];
+		SamplerState* samplerStates[Context::samplersCount];
+		UniformBuffer* uniformBuffers[Context::uniformBuffersCount];
+		VertexShader* vertexShader;
+		PixelShader* pixelShader;
+		AttributeBinding* attributeBinding;
+		VertexBuffer* vertexBuffers[Context::vertexBuffersCount];
+		IndexBuffer* indexBuffer;
+		/// Fill mode + 1, 0 to inherit.
+		int fillMode;
+		/// Cull mode + 1, 0 to inherit.
+		int cullMode;
+		/// Viewport size, zero to inherit.
+		int viewportWidth, viewportHeight;
+		DepthStencilState* depthStencilState;
+		BlendState* blendState;
+
+		State();
+	};
+
+	/// Recorded upload of uniform data.
+	struct Upload
+	{
+		UniformBuffer* uniformBuffer;
+		/// Offset of data in list's data.
+		size_t offset;
+		int size;
+	};
+
+	/// Recorded draw command.
+	struct Command
+	{
+		Key key;
+		/// Index of state in list's states.
+		int state;
+		/// Range in list's command uploads (indices of uploads), performed just before draw.
+		int uploadsBegin, uploadsEnd;
+		int count;
+		/// Instances count, 0 for non-instanced draw.
+		int instancesCount;
+	};
+
+	typedef std::vector<State> States;
+	typedef std::vector<Upload> Uploads;
+	typedef std::vector<int> CommandUploads;
+	typedef std::vector<Command> Commands;
+
+private:
+	/// Current state.
+	State state;
+	/// Is current state already stored in states.
+	bool stateStored;
+	/// Index of first upload not bound to a command yet.
+	int pendingUploadsBegin;
+
+	States states;
+	Uploads uploads;
+	std::vector<char> data;
+	CommandUploads commandUploads;
+	Commands commands;
+
+	/// Index of latest upload of every uploaded buffer.
+	std::unordered_map<UniformBuffer*, int> latestUploads;
+
+	int GetLatestUpload(UniformBuffer* uniformBuffer) const;
+
+public:
+	CommandList();
+
+	//******* Key helpers.
+	/// Build key from components.
+	/** Key is built so it groups draws by target first, then by shader,
+	then by material, and finally by depth.
+	\param target Index of render target (pass), 0..255.
+	\param shader Index of shader program, 0..65535.
+	\param material Index of material (textures, uniforms), 0..65535.
+	\param depth Normalized depth 0..1, pass (1 - depth) for back-to-front order. */
+	static Key MakeKey(int target, int shader, int material, float depth);
+
+	//******* State methods.
+	void SetFrameBuffer(FrameBuffer* frameBuffer);
+	void SetSampler(int i, Texture* texture, SamplerState* samplerState = nullptr);
+	void SetSampler(const Shaders::SamplerBase& sampler, Texture* texture, SamplerState* samplerState = nullptr);
+	void SetUniformBuffer(int i, UniformBuffer* uniformBuffer);
+	void SetUniformBuffer(Shaders::UniformGroup* uniformGroup);
+	void SetVertexShader(VertexShader* vertexShader);
+	void SetPixelShader(PixelShader* pixelShader);
+	void SetAttributeBinding(AttributeBinding* attributeBinding);
+	void SetVertexBuffer(int i, VertexBuffer* vertexBuffer);
+	void SetIndexBuffer(IndexBuffer* indexBuffer);
+	void SetFillMode(Context::FillMode fillMode);
+	void SetCullMode(Context::CullMode cullMode);
+	void SetViewport(int viewportWidth, int viewportHeight);
+	void SetDepthStencilState(DepthStencilState* depthStencilState);
+	void SetBlendState(BlendState* blendState);
+	/// Reset current state to "inherit everything".
+	void ResetState();
+
+	//******* Data methods.
+	/// Record upload of data into uniform buffer.
+	/** Data is copied into list. Commands are reordered by sorting,
+	so every following draw which binds the buffer gets the latest
+	upload of it recorded before the draw, and performs it before
+	drawing (repeated uploads are skipped by Context::Execute).
+	Upload of buffer not bound by list's state (inherited from context)
+	is performed only before next draw of the list. */
+	void UploadUniformBufferData(UniformBuffer* uniformBuffer, const void* data, int size);
+	/// Record upload of uniform group's data.
+	void UploadUniformGroup(Shaders::UniformGroup* uniformGroup);
+
+	//******* Draw methods.
+	/// Record draw with current state.
+	void Draw(Key key, int count = -1);
+	/// Record instanced draw with current state.
+	void DrawInstanced(Key key, int instancesCount, int count = -1);
+
+	/// Remove all commands, keeping allocated memory.
+	/** Current state is preserved. */
+	void Clear();
+
+	//******* Access methods (for replaying).
+	const States& GetStates() const;
+	const Uploads& GetUploads() const;
+	const CommandUploads& GetCommandUploads() const;
+	const void* GetData(size_t offset) const;
+	const Commands& GetCommands() const;
+};
+
+END_INANITY_GRAPHICS
+
+#endif
@@ -13,8 +13,13 @@
 #include "IndexBuffer.hpp"
 #include "DepthStencilState.hpp"
 #include "BlendState.hpp"
+#include "CommandList.hpp"
 #include "shaders/Sampler.hpp"
 #include "shaders/UniformGroup.hpp"
+#include <algorithm>
+#include <vector>
+#include <unordered_map>
+#include <cstring>
 
 BEGIN_INANITY_GRAPHICS
 
@@ -336,4 +341,263 @@ void Context::Reset()
 	cellBlendState.Reset();
 }
 
+//*** Context::ExecuteStats
+
+Context::ExecuteStats::ExecuteStats()
+: commandsCount(0), uploadsCount(0), stateChangesCount(0) {}
+
+//*** Context command lists execution
+
+namespace
+{
+	/// Command reference used for sorting.
+	struct ExecuteEntry
+	{
+		CommandList::Key key;
+		int list;
+		int command;
+
+		bool operator<(const ExecuteEntry& b) const
+		{
+			if(key != b.key) return key < b.key;
+			if(list != b.list) return list < b.list;
+			return command < b.command;
+		}
+	};
+
+	/// Set value of let, if it differs.
+	/** Null value means inherited value. Returns true if value was changed. */
+	template <typename T>
+	inline bool ApplyCommandState(ptr<T>& letValue, T* value, T* inheritedValue)
+	{
+		if(!value) value = inheritedValue;
+		if((T*)letValue == value)
+			return false;
+		letValue = value;
+		return true;
+	}
+}
+
+Context::ExecuteStats Context::Execute(CommandList* const* lists, int listsCount)
+{
+	ExecuteStats stats;
+
+	// gather and sort commands
+	std::vector<ExecuteEntry> entries;
+	{
+		size_t totalCount = 0;
+		for(int i = 0; i < listsCount; ++i)
+			totalCount += lists[i]->GetCommands().size();
+		entries.reserve(totalCount);
+	}
+	for(int i = 0; i < listsCount; ++i)
+	{
+		const CommandList::Commands& commands = lists[i]->GetCommands();
+		for(size_t j = 0; j < commands.size(); ++j)
+		{
+			ExecuteEntry entry;
+			entry.key = commands[j].key;
+			entry.list = i;
+			entry.command = (int)j;
+			entries.push_back(entry);
+		}
+	}
+	if(entries.empty())
+		return stats;
+	std::sort(entries.begin(), entries.end());
+
+	// push lets on top of all cells, initialized with inherited values;
+	// if cell was actual, it stays actual, as the value is the same
+#define INHERIT_LET(cell, let, letType, field) \
+	letType let; \
+	{ \
+		bool actual = cell.top && cell.IsActual(); \
+		letType* top = (letType*)cell.top; \
+		let(this, top ? top->field : nullptr); \
+		if(actual) cell.Actual(); \
+	}
+	INHERIT_LET(cellFrameBuffer, letFrameBuffer, LetFrameBuffer, frameBuffer);
+	INHERIT_LET(cellVertexShader, letVertexShader, LetVertexShader, vertexShader);
+	INHERIT_LET(cellPixelShader, letPixelShader, LetPixelShader, pixelShader);
+	INHERIT_LET(cellAttributeBinding, letAttributeBinding, LetAttributeBinding, attributeBinding);
+	INHERIT_LET(cellIndexBuffer, letIndexBuffer, LetIndexBuffer, indexBuffer);
+	INHERIT_LET(cellDepthStencilState, letDepthStencilState, LetDepthStencilState, depthStencilState);
+	INHERIT_LET(cellBlendState, letBlendState, LetBlendState, blendState);
+#undef INHERIT_LET
+	LetSampler letSamplers[samplersCount];
+	for(int i = 0; i < samplersCount; ++i)
+	{
+		bool actual = cellSamplers[i].top && cellSamplers[i].IsActual();
+		LetSampler* top = (LetSampler*)cellSamplers[i].top;
+		letSamplers[i](this, i, top ? top->texture : nullptr, top ? top->samplerState : nullptr);
+		if(actual) cellSamplers[i].Actual();
+	}
+	LetUniformBuffer letUniformBuffers[uniformBuffersCount];
+	for(int i = 0; i < uniformBuffersCount; ++i)
+	{
+		bool actual = cellUniformBuffers[i].top && cellUniformBuffers[i].IsActual();
+		LetUniformBuffer* top = (LetUniformBuffer*)cellUniformBuffers[i].top;
+		letUniformBuffers[i](this, i, top ? top->uniformBuffer : nullptr);
+		if(actual) cellUniformBuffers[i].Actual();
+	}
+	LetVertexBuffer letVertexBuffers[vertexBuffersCount];
+	for(int i = 0; i < vertexBuffersCount; ++i)
+	{
+		bool actual = cellVertexBuffers[i].top && cellVertexBuffers[i].IsActual();
+		LetVertexBuffer* top = (LetVertexBuffer*)cellVertexBuffers[i].top;
+		letVertexBuffers[i](this, i, top ? top->vertexBuffer : nullptr);
+		if(actual) cellVertexBuffers[i].Actual();
+	}
+	LetFillMode letFillMode;
+	{
+		bool actual = cellFillMode.top && cellFillMode.IsActual();
+		letFillMode(this, ((LetFillMode*)cellFillMode.top)->fillMode);
+		if(actual) cellFillMode.Actual();
+	}
+	LetCullMode letCullMode;
+	{
+		bool actual = cellCullMode.top && cellCullMode.IsActual();
+		letCullMode(this, ((LetCullMode*)cellCullMode.top)->cullMode);
+		if(actual) cellCullMode.Actual();
+	}
+	LetViewport letViewport;
+	{
+		bool actual = cellViewport.top && cellViewport.IsActual();
+		LetViewport* top = (LetViewport*)cellViewport.top;
+		letViewport(this, top ? top->viewportWidth : 0, top ? top->viewportHeight : 0);
+		if(actual) cellViewport.Actual();
+	}
+
+	// remember inherited values
+	CommandList::State inherited;
+	inherited.frameBuffer = letFrameBuffer.frameBuffer;
+	for(int i = 0; i < samplersCount; ++i)
+	{
+		inherited.textures[i] = letSamplers[i].texture;
+		inherited.samplerStates[i] = letSamplers[i].samplerState;
+	}
+	for(int i = 0; i < uniformBuffersCount; ++i)
+		inherited.uniformBuffers[i] = letUniformBuffers[i].uniformBuffer;
+	inherited.vertexShader = letVertexShader.vertexShader;
+	inherited.pixelShader = letPixelShader.pixelShader;
+	inherited.attributeBinding = letAttributeBinding.attributeBinding;
+	for(int i = 0; i < vertexBuffersCount; ++i)
+		inherited.vertexBuffers[i] = letVertexBuffers[i].vertexBuffer;
+	inherited.indexBuffer = letIndexBuffer.indexBuffer;
+	inherited.fillMode = (int)letFillMode.fillMode + 1;
+	inherited.cullMode = (int)letCullMode.cullMode + 1;
+	inherited.viewportWidth = letViewport.viewportWidth;
+	inherited.viewportHeight = letViewport.viewportHeight;
+	inherited.depthStencilState = letDepthStencilState.depthStencilState;
+	inherited.blendState = letBlendState.blendState;
+
+	// data of last performed upload of every buffer, to skip repeated ones
+	std::unordered_map<UniformBuffer*, const void*> lastUploads;
+
+	// execute commands
+	const CommandList::State* lastState = nullptr;
+	for(size_t i = 0; i < entries.size(); ++i)
+	{
+		const CommandList* list = lists[entries[i].list];
+		const CommandList::Command& command = list->GetCommands()[entries[i].command];
+		const CommandList::State& state = list->GetStates()[command.state];
+
+		// apply state only if it is not the same state as in previous command
+		if(&state != lastState)
+		{
+#define APPLY(let, field, cell) \
+			if(ApplyCommandState(let.field, state.field, inherited.field)) \
+			{ \
+				cell.Reset(); \
+				++stats.stateChangesCount; \
+			}
+			APPLY(letFrameBuffer, frameBuffer, cellFrameBuffer);
+			for(int j = 0; j < samplersCount; ++j)
+			{
+				bool changed = ApplyCommandState(letSamplers[j].texture, state.textures[j], inherited.textures[j]);
+				changed = ApplyCommandState(letSamplers[j].samplerState, state.samplerStates[j], inherited.samplerStates[j]) || changed;
+				if(changed)
+				{
+					cellSamplers[j].Reset();
+					++stats.stateChangesCount;
+				}
+			}
+			for(int j = 0; j < uniformBuffersCount; ++j)
+				if(ApplyCommandState(letUniformBuffers[j].uniformBuffer, state.uniformBuffers[j], inherited.uniformBuffers[j]))
+				{
+					cellUniformBuffers[j].Reset();
+					++stats.stateChangesCount;
+				}
+			APPLY(letVertexShader, vertexShader, cellVertexShader);
+			APPLY(letPixelShader, pixelShader, cellPixelShader);
+			APPLY(letAttributeBinding, attributeBinding, cellAttributeBinding);
+			for(int j = 0; j < vertexBuffersCount; ++j)
+				if(ApplyCommandState(letVertexBuffers[j].vertexBuffer, state.vertexBuffers[j], inherited.vertexBuffers[j]))
+				{
+					cellVertexBuffers[j].Reset();
+					++stats.stateChangesCount;
+				}
+			APPLY(letIndexBuffer, indexBuffer, cellIndexBuffer);
+			APPLY(letDepthStencilState, depthStencilState, cellDepthStencilState);
+			APPLY(letBlendState, blendState, cellBlendState);
+#undef APPLY
+			{
+				FillMode fillMode = (FillMode)((state.fillMode ? state.fillMode : inherited.fillMode) - 1);
+				if(letFillMode.fillMode != fillMode)
+				{
+					letFillMode.fillMode = fillMode;
+					cellFillMode.Reset();
+					++stats.stateChangesCount;
+				}
+			}
+			{
+				CullMode cullMode = (CullMode)((state.cullMode ? state.cullMode : inherited.cullMode) - 1);
+				if(letCullMode.cullMode != cullMode)
+				{
+					letCullMode.cullMode = cullMode;
+					cellCullMode.Reset();
+					++stats.stateChangesCount;
+				}
+			}
+			{
+				int viewportWidth = state.viewportWidth ? state.viewportWidth : inherited.viewportWidth;
+				int viewportHeight = state.viewportHeight ? state.viewportHeight : inherited.viewportHeight;
+				if(letViewport.viewportWidth != viewportWidth || letViewport.viewportHeight != viewportHeight)
+				{
+					letViewport.viewportWidth = viewportWidth;
+					letViewport.viewportHeight = viewportHeight;
+					cellViewport.Reset();
+					++stats.stateChangesCount;
+				}
+			}
+
+			lastState = &state;
+		}
+
+		// perform uploads
+		const CommandList::Uploads& uploads = list->GetUploads();
+		const CommandList::CommandUploads& commandUploads = list->GetCommandUploads();
+		for(int j = command.uploadsBegin; j < command.uploadsEnd; ++j)
+		{
+			const CommandList::Upload& upload = uploads[commandUploads[j]];
+			const void* data = list->GetData(upload.offset);
+			const void*& lastData = lastUploads[upload.uniformBuffer];
+			if(lastData && (lastData == data || memcmp(lastData, data, upload.size) == 0))
+				continue;
+			lastData = data;
+			UploadUniformBufferData(upload.uniformBuffer, data, upload.size);
+			++stats.uploadsCount;
+		}
+
+		// draw
+		if(command.instancesCount)
+			DrawInstanced(command.instancesCount, command.count);
+		else
+			Draw(command.count);
+		++stats.commandsCount;
+	}
+
+	return stats;
+}
+
 END_INANITY_GRAPHICS
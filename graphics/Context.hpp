@@ -28,10 +28,17 @@ class BlendState;
 class AttributeLayoutSlot;
 class Presenter;
 class RawTextureData;
+class CommandList;
 
 /// Abstract graphics context class.
 class Context : public Object
 {
+public:
+	//*** Numbers of slots.
+	static const int samplersCount = 16;
+	static const int uniformBuffersCount = 8;
+	static const int vertexBuffersCount = 2;
+
 protected:
 	struct Cell;
 
@@ -219,14 +226,11 @@ public:
 protected:
 	//*** Cells.
 	Cell cellFrameBuffer;
-	static const int samplersCount = 16;
 	Cell cellSamplers[samplersCount];
-	static const int uniformBuffersCount = 8;
 	Cell cellUniformBuffers[uniformBuffersCount];
 	Cell cellVertexShader;
 	Cell cellPixelShader;
 	Cell cellAttributeBinding;
-	static const int vertexBuffersCount = 2;
 	Cell cellVertexBuffers[vertexBuffersCount];
 	Cell cellIndexBuffer;
 	Cell cellFillMode;
@@ -283,6 +287,27 @@ public:
 	/// Do instanced draw.
 	virtual void DrawInstanced(int instancesCount, int count = -1) = 0;
 
+	//******* Command lists.
+	/// Statistics of command lists execution.
+	struct ExecuteStats
+	{
+		/// Number of executed draw commands.
+		int commandsCount;
+		/// Number of uniform buffer uploads.
+		int uploadsCount;
+		/// Number of changed cells (render state changes).
+		int stateChangesCount;
+
+		ExecuteStats();
+	};
+	/// Merge command lists, sort commands by keys and execute them.
+	/** Should be called on a thread owning context, after recording
+	threads finished filling lists. Lists are not cleared.
+	State not specified by commands is inherited from current Lets;
+	Lets are restored after execution. Upload of the same data into
+	buffer as its last upload is skipped. */
+	ExecuteStats Execute(CommandList* const* lists, int listsCount);
+
 	//******* Misc methods.
 	virtual ptr<RawTextureData> GetPresenterTextureData(ptr<Presenter> presenter) = 0;
 };
@@ -0,0 +1,302 @@
+#include "Culler.hpp"
+#include "../ThreadPool.hpp"
+#include <algorithm>
+#include <cmath>
+
+BEGIN_INANITY_GRAPHICS
+
+/* Object is outside of plane (n, w) if distance of center
+d = dot(n, c) + w is less than -r, where r is the smallest of
+sphere radius and box "radius" dot(abs(n), e). All variants of
+test below compute it in the same order of operations, so
+SIMD and scalar code give exactly the same results. */
+
+//** Culler::Frustum's methods.
+
+Culler::Frustum::Frustum(const mat4x4& m)
+{
+	// rows of matrix
+	vec4 r[4];
+	for(int i = 0; i < 4; ++i)
+		r[i] = vec4(m(i, 0), m(i, 1), m(i, 2), m(i, 3));
+
+	// -w <= x <= w, -w <= y <= w, 0 <= z <= w
+	planes[0] = r[3] + r[0];
+	planes[1] = r[3] - r[0];
+	planes[2] = r[3] + r[1];
+	planes[3] = r[3] - r[1];
+	planes[4] = r[2];
+	planes[5] = r[3] - r[2];
+
+	for(int i = 0; i < 6; ++i)
+	{
+		vec4& p = planes[i];
+		float length = std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+		if(length > 0)
+			p = p * (1 / length);
+	}
+}
+
+//** Culler's methods.
+
+Culler::Culler(int clusterSize)
+: clusterSize(std::max(clusterSize, 1)) {}
+
+void Culler::SetBounds(int object, const vec3& center, const vec3& extents, float radius)
+{
+	centersX[object] = center.x;
+	centersY[object] = center.y;
+	centersZ[object] = center.z;
+	extentsX[object] = extents.x;
+	extentsY[object] = extents.y;
+	extentsZ[object] = extents.z;
+	radii[object] = radius;
+	clusters[object / clusterSize].dirty = true;
+}
+
+int Culler::AddSphere(const vec3& center, float radius)
+{
+	int object = GetObjectsCount();
+	centersX.push_back(0);
+	centersY.push_back(0);
+	centersZ.push_back(0);
+	extentsX.push_back(0);
+	extentsY.push_back(0);
+	extentsZ.push_back(0);
+	radii.push_back(0);
+	if(object % clusterSize == 0)
+		clusters.push_back(Cluster());
+	SetSphere(object, center, radius);
+	return object;
+}
+
+int Culler::AddBox(const vec3& min, const vec3& max)
+{
+	int object = AddSphere(vec3(), 0);
+	SetBox(object, min, max);
+	return object;
+}
+
+void Culler::SetSphere(int object, const vec3& center, float radius)
+{
+	SetBounds(object, center, vec3(radius, radius, radius), radius);
+}
+
+void Culler::SetBox(int object, const vec3& min, const vec3& max)
+{
+	vec3 extents = (max - min) * 0.5f;
+	SetBounds(object, (min + max) * 0.5f, extents, length(extents));
+}
+
+int Culler::GetObjectsCount() const
+{
+	return (int)radii.size();
+}
+
+void Culler::Clear()
+{
+	centersX.clear();
+	centersY.clear();
+	centersZ.clear();
+	extentsX.clear();
+	extentsY.clear();
+	extentsZ.clear();
+	radii.clear();
+	clusters.clear();
+}
+
+void Culler::UpdateCluster(int cluster)
+{
+	int begin = cluster * clusterSize;
+	int end = std::min(begin + clusterSize, GetObjectsCount());
+
+	vec3 min(centersX[begin] - extentsX[begin], centersY[begin] - extentsY[begin], centersZ[begin] - extentsZ[begin]);
+	vec3 max(centersX[begin] + extentsX[begin], centersY[begin] + extentsY[begin], centersZ[begin] + extentsZ[begin]);
+	for(int i = begin + 1; i < end; ++i)
+	{
+		min.x = std::min(min.x, centersX[i] - extentsX[i]);
+		min.y = std::min(min.y, centersY[i] - extentsY[i]);
+		min.z = std::min(min.z, centersZ[i] - extentsZ[i]);
+		max.x = std::max(max.x, centersX[i] + extentsX[i]);
+		max.y = std::max(max.y, centersY[i] + extentsY[i]);
+		max.z = std::max(max.z, centersZ[i] + extentsZ[i]);
+	}
+
+	Cluster& c = clusters[cluster];
+	c.center = (min + max) * 0.5f;
+	c.extents = (max - min) * 0.5f;
+	c.dirty = false;
+}
+
+Culler::Intersection Culler::TestCluster(const Frustum& frustum, const Cluster& cluster)
+{
+	Intersection result = intersectionInside;
+	for(int i = 0; i < 6; ++i)
+	{
+		const vec4& p = frustum.planes[i];
+		float d = p.x * cluster.center.x + p.y * cluster.center.y + p.z * cluster.center.z + p.w;
+		float e = std::abs(p.x) * cluster.extents.x + std::abs(p.y) * cluster.extents.y + std::abs(p.z) * cluster.extents.z;
+		if(d + e < 0)
+			return intersectionOutside;
+		if(d - e < 0)
+			result = intersectionPartial;
+	}
+	return result;
+}
+
+void Culler::CullObjects(const Frustum& frustum, int begin, int end, std::vector<int>& visible) const
+{
+	const float* cx = centersX.data();
+	const float* cy = centersY.data();
+	const float* cz = centersZ.data();
+	const float* ex = extentsX.data();
+	const float* ey = extentsY.data();
+	const float* ez = extentsZ.data();
+	const float* r = radii.data();
+
+	int i = begin;
+
+#ifdef INANITY_MATH_AVX
+	{
+		__m256 nx[6], ny[6], nz[6], nw[6], ax[6], ay[6], az[6];
+		for(int j = 0; j < 6; ++j)
+		{
+			const vec4& p = frustum.planes[j];
+			nx[j] = _mm256_set1_ps(p.x);
+			ny[j] = _mm256_set1_ps(p.y);
+			nz[j] = _mm256_set1_ps(p.z);
+			nw[j] = _mm256_set1_ps(p.w);
+			ax[j] = _mm256_set1_ps(std::abs(p.x));
+			ay[j] = _mm256_set1_ps(std::abs(p.y));
+			az[j] = _mm256_set1_ps(std::abs(p.z));
+		}
+		__m256 zero = _mm256_setzero_ps();
+		for(; i + 8 <= end; i += 8)
+		{
+			__m256 vcx = _mm256_loadu_ps(cx + i), vcy = _mm256_loadu_ps(cy + i), vcz = _mm256_loadu_ps(cz + i);
+			__m256 vex = _mm256_loadu_ps(ex + i), vey = _mm256_loadu_ps(ey + i), vez = _mm256_loadu_ps(ez + i);
+			__m256 vr = _mm256_loadu_ps(r + i);
+			__m256 mask = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+			for(int j = 0; j < 6; ++j)
+			{
+				__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx[j], vcx), _mm256_mul_ps(ny[j], vcy)), _mm256_mul_ps(nz[j], vcz)), nw[j]);
+				__m256 e = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax[j], vex), _mm256_mul_ps(ay[j], vey)), _mm256_mul_ps(az[j], vez));
+				mask = _mm256_and_ps(mask, _mm256_cmp_ps(_mm256_add_ps(d, _mm256_min_ps(e, vr)), zero, _CMP_GE_OQ));
+			}
+			int bits = _mm256_movemask_ps(mask);
+			for(int k = 0; k < 8; ++k)
+				if(bits & (1 << k))
+					visible.push_back(i + k);
+		}
+	}
+#endif
+
+#ifdef INANITY_MATH_SSE
+	{
+		__m128 nx[6], ny[6], nz[6], nw[6], ax[6], ay[6], az[6];
+		for(int j = 0; j < 6; ++j)
+		{
+			const vec4& p = frustum.planes[j];
+			nx[j] = _mm_set1_ps(p.x);
+			ny[j] = _mm_set1_ps(p.y);
+			nz[j] = _mm_set1_ps(p.z);
+			nw[j] = _mm_set1_ps(p.w);
+			ax[j] = _mm_set1_ps(std::abs(p.x));
+			ay[j] = _mm_set1_ps(std::abs(p.y));
+			az[j] = _mm_set1_ps(std::abs(p.z));
+		}
+		__m128 zero = _mm_setzero_ps();
+		for(; i + 4 <= end; i += 4)
+		{
+			__m128 vcx = _mm_loadu_ps(cx + i), vcy = _mm_loadu_ps(cy + i), vcz = _mm_loadu_ps(cz + i);
+			__m128 vex = _mm_loadu_ps(ex + i), vey = _mm_loadu_ps(ey + i), vez = _mm_loadu_ps(ez + i);
+			__m128 vr = _mm_loadu_ps(r + i);
+			__m128 mask = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for(int j = 0; j < 6; ++j)
+			{
+				__m128 d = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[j], vcx), _mm_mul_ps(ny[j], vcy)), _mm_mul_ps(nz[j], vcz)), nw[j]);
+				__m128 e = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[j], vex), _mm_mul_ps(ay[j], vey)), _mm_mul_ps(az[j], vez));
+				mask = _mm_and_ps(mask, _mm_cmpge_ps(_mm_add_ps(d, _mm_min_ps(e, vr)), zero));
+			}
+			int bits = _mm_movemask_ps(mask);
+			for(int k = 0; k < 4; ++k)
+				if(bits & (1 << k))
+					visible.push_back(i + k);
+		}
+	}
+#endif
+
+	for(; i < end; ++i)
+	{
+		bool ok = true;
+		for(int j = 0; j < 6 && ok; ++j)
+		{
+			const vec4& p = frustum.planes[j];
+			float d = p.x * cx[i] + p.y * cy[i] + p.z * cz[i] + p.w;
+			float e = std::abs(p.x) * ex[i] + std::abs(p.y) * ey[i] + std::abs(p.z) * ez[i];
+			ok = d + (e < r[i] ? e : r[i]) >= 0;
+		}
+		if(ok)
+			visible.push_back(i);
+	}
+}
+
+void Culler::CullClusters(const Frustum& frustum, int begin, int end, std::vector<int>& visible) const
+{
+	int objectsCount = GetObjectsCount();
+	for(int i = begin; i < end; ++i)
+	{
+		int objectsBegin = i * clusterSize;
+		int objectsEnd = std::min(objectsBegin + clusterSize, objectsCount);
+		switch(TestCluster(frustum, clusters[i]))
+		{
+		case intersectionOutside:
+			break;
+		case intersectionInside:
+			for(int j = objectsBegin; j < objectsEnd; ++j)
+				visible.push_back(j);
+			break;
+		case intersectionPartial:
+			CullObjects(frustum, objectsBegin, objectsEnd, visible);
+			break;
+		}
+	}
+}
+
+void Culler::Cull(const Frustum& frustum, std::vector<int>& visible, ptr<ThreadPool> threadPool)
+{
+	int clustersCount = (int)clusters.size();
+	for(int i = 0; i < clustersCount; ++i)
+		if(clusters[i].dirty)
+			UpdateCluster(i);
+
+	if(!threadPool || clustersCount < 2)
+	{
+		CullClusters(frustum, 0, clustersCount, visible);
+		return;
+	}
+
+	// a few tasks per thread to balance uneven clusters
+	int tasksCount = std::min(threadPool->GetThreadsCount() * 4, clustersCount);
+	int clustersPerTask = (clustersCount + tasksCount - 1) / tasksCount;
+	std::vector<std::vector<int> > results(tasksCount);
+	for(int i = 0; i < tasksCount; ++i)
+	{
+		int begin = i * clustersPerTask;
+		int end = std::min(begin + clustersPerTask, clustersCount);
+		const Culler* culler = this;
+		const Frustum* f = &frustum;
+		std::vector<int>* result = &results[i];
+		threadPool->Queue(Handler::BindCall([culler, f, begin, end, result]()
+		{
+			culler->CullClusters(*f, begin, end, *result);
+		}));
+	}
+	// pool is idle (see header), so this waits only for culling tasks
+	threadPool->Wait();
+
+	for(int i = 0; i < tasksCount; ++i)
+		visible.insert(visible.end(), results[i].begin(), results[i].end());
+}
+
+END_INANITY_GRAPHICS
@@ -0,0 +1,103 @@
+#ifndef ___INANITY_GRAPHICS_CULLER_HPP___
+#define ___INANITY_GRAPHICS_CULLER_HPP___
+
+#include "graphics.hpp"
+#include <vector>
+
+BEGIN_INANITY
+
+class ThreadPool;
+
+END_INANITY
+
+BEGIN_INANITY_GRAPHICS
+
+/// Frustum culling of objects by bounding volumes.
+/** Every object is bounded by both box and sphere (object added as
+sphere gets box around sphere, and vice versa), and is culled if
+any of them is outside of frustum. Bounds are stored in SoA arrays
+and are tested with SSE (4 objects at once) or AVX (8 objects).
+Consecutive objects are grouped into clusters with common bounding
+box, which is tested first: objects of clusters completely outside
+are skipped, and objects of clusters completely inside are accepted
+without testing. So objects close in space should be added in a row.
+Culling of clusters can be split between threads of pool. */
+class Culler : public Object
+{
+public:
+	/// Frustum as six planes (x, y, z, w), with normals pointing inside.
+	struct Frustum
+	{
+		vec4 planes[6];
+
+		/// Extract frustum from view-projection matrix.
+		/** Matrix transforms column vectors, and depth range is [0, 1],
+		as by CreateProjectionPerspectiveFovMatrix. */
+		Frustum(const mat4x4& viewProjection);
+	};
+
+private:
+	/// Bounding box of consecutive objects.
+	struct Cluster
+	{
+		vec3 center;
+		vec3 extents;
+		/// Bounds should be recalculated.
+		bool dirty;
+	};
+
+	/// Result of testing cluster against frustum.
+	enum Intersection
+	{
+		intersectionOutside,
+		intersectionInside,
+		intersectionPartial
+	};
+
+	int clusterSize;
+
+	//*** Bounds of objects: centers and half-sizes of boxes, radii of spheres.
+	std::vector<float> centersX, centersY, centersZ;
+	std::vector<float> extentsX, extentsY, extentsZ;
+	std::vector<float> radii;
+
+	std::vector<Cluster> clusters;
+
+	void SetBounds(int object, const vec3& center, const vec3& extents, float radius);
+	void UpdateCluster(int cluster);
+	static Intersection TestCluster(const Frustum& frustum, const Cluster& cluster);
+	/// Cull range of objects, append indices of visible ones.
+	void CullObjects(const Frustum& frustum, int begin, int end, std::vector<int>& visible) const;
+	/// Cull range of clusters, append indices of visible objects.
+	void CullClusters(const Frustum& frustum, int begin, int end, std::vector<int>& visible) const;
+
+public:
+	/// Create culler.
+	/** \param clusterSize Number of objects in cluster. */
+	Culler(int clusterSize = 64);
+
+	/// Add object bounded by sphere, returns its index.
+	int AddSphere(const vec3& center, float radius);
+	/// Add object bounded by axis-aligned box, returns its index.
+	int AddBox(const vec3& min, const vec3& max);
+	/// Set bounds of object to sphere.
+	void SetSphere(int object, const vec3& center, float radius);
+	/// Set bounds of object to axis-aligned box.
+	void SetBox(int object, const vec3& min, const vec3& max);
+	/// Get number of objects.
+	int GetObjectsCount() const;
+	/// Remove all objects.
+	void Clear();
+
+	/// Get indices of objects intersecting with frustum.
+	/** Indices are appended to vector in ascending order.
+	\param threadPool Pool to split culling between threads, or null
+	to cull in current thread. Culling waits for all tasks of pool,
+	so pool should be idle: other tasks queued before are waited too,
+	and their exceptions are rethrown from here. */
+	void Cull(const Frustum& frustum, std::vector<int>& visible, ptr<ThreadPool> threadPool = nullptr);
+};
+
+END_INANITY_GRAPHICS
+
+#endif
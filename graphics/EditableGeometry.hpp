@@ -7,7 +7,9 @@
 #include <vector>
 #include <map>
 #include <set>
+#include <unordered_map>
 #include <algorithm>
+#include <cmath>
 
 BEGIN_INANITY_GRAPHICS
 
@@ -95,39 +97,638 @@ public:
 		return file;
 	}
 
+	/// Statistics of post-transform vertex cache efficiency.
+	struct VertexCacheStats
+	{
+		/// Average cache miss ratio: transformed vertices per triangle (0.5..3).
+		float acmr;
+		/// Average transform to vertex ratio: transformed vertices per used vertex (1..).
+		float atvr;
+	};
+
 	/// Оптимизировать геометрию
 	/** Выполняется объединение одинаковых вершин, с заданием соответствующих индексов.
-	Для типа Vertex требуется наличие operator< и operator==.
+	Vertices are welded using hash table keyed by raw bytes of vertices,
+	so equal vertices should have equal bytes (no garbage in padding).
+	Для типа Vertex требуется наличие operator==.
 	*/
 	ptr<EditableGeometry> Optimize() const
 	{
-		//скопировать вершины в новый массив с их индексами
-		std::vector<std::pair<Vertex, size_t> > newVertices(vertices.size());
-		for(size_t i = 0; i < vertices.size(); ++i)
-			newVertices[i] = std::make_pair(vertices[i], i);
-		//отсортировать их
-		std::sort(newVertices.begin(), newVertices.end());
-		//выполнить объединение одинаковых вершин
-		//заодно построить массив преобразования индексов
+		// hash table: indices of result vertices, chained by hash
+		struct VertexHash
+		{
+			size_t operator()(const Vertex& vertex) const
+			{
+				// FNV-1a
+				const unsigned char* data = (const unsigned char*)&vertex;
+				size_t hash = 2166136261U;
+				for(size_t i = 0; i < sizeof(Vertex); ++i)
+					hash = (hash ^ data[i]) * 16777619U;
+				return hash;
+			}
+		};
+		std::unordered_map<size_t, size_t> firstByHash;
+		firstByHash.reserve(vertices.size());
+		// next result vertex with the same hash
+		std::vector<size_t> nextByHash;
+		nextByHash.reserve(vertices.size());
+
 		std::vector<Vertex> resultVertices;
 		std::vector<size_t> indexMap(vertices.size());
 		resultVertices.reserve(vertices.size());
-		for(size_t i = 0; i < newVertices.size(); )
+		VertexHash vertexHash;
+		for(size_t i = 0; i < vertices.size(); ++i)
 		{
-			size_t j;
-			for(j = i + 1; j < newVertices.size() && newVertices[i].first == newVertices[j].first; ++j);
 			size_t newIndex = resultVertices.size();
-			resultVertices.push_back(newVertices[i].first);
-			for(; i < j; ++i)
-				indexMap[newVertices[i].second] = newIndex;
+			std::pair<std::unordered_map<size_t, size_t>::iterator, bool> r = firstByHash.insert(std::make_pair(vertexHash(vertices[i]), newIndex));
+			if(!r.second)
+			{
+				size_t j;
+				for(j = r.first->second; j != (size_t)-1 && !(resultVertices[j] == vertices[i]); j = nextByHash[j]);
+				if(j != (size_t)-1)
+				{
+					indexMap[i] = j;
+					continue;
+				}
+				nextByHash.push_back(r.first->second);
+				r.first->second = newIndex;
+			}
+			else
+				nextByHash.push_back((size_t)-1);
+			resultVertices.push_back(vertices[i]);
+			indexMap[i] = newIndex;
 		}
-		//скопировать индексы в новый массив
+
 		std::vector<Index> resultIndices(indices.size());
-		//и преобразовать их
 		for(size_t i = 0; i < resultIndices.size(); ++i)
 			resultIndices[i] = (Index)indexMap[indices[i]];
 		return NEW(EditableGeometry(resultVertices, resultIndices));
 	}
+
+	/// Reorder triangles for post-transform vertex cache.
+	/** Uses Tom Forsyth's linear-speed algorithm: greedily emits triangle
+	with best score, which depends on positions of its vertices in
+	simulated LRU cache and on numbers of triangles still using them.
+	Vertices are not changed. */
+	ptr<EditableGeometry> OptimizeVertexCache(int cacheSize = 32) const
+	{
+		size_t verticesCount = vertices.size();
+		size_t trianglesCount = indices.size() / 3;
+
+		// triangles of every vertex; first remainingCounts[v] ones are not emitted yet
+		std::vector<size_t> trianglesOffsets(verticesCount + 1, 0);
+		for(size_t i = 0; i < trianglesCount * 3; ++i)
+			++trianglesOffsets[indices[i] + 1];
+		for(size_t i = 0; i < verticesCount; ++i)
+			trianglesOffsets[i + 1] += trianglesOffsets[i];
+		std::vector<size_t> vertexTriangles(trianglesCount * 3);
+		std::vector<int> remainingCounts(verticesCount, 0);
+		for(size_t i = 0; i < trianglesCount * 3; ++i)
+		{
+			size_t v = indices[i];
+			vertexTriangles[trianglesOffsets[v] + remainingCounts[v]++] = i / 3;
+		}
+
+		std::vector<float> vertexScores(verticesCount);
+		for(size_t i = 0; i < verticesCount; ++i)
+			vertexScores[i] = GetForsythVertexScore(-1, remainingCounts[i], cacheSize);
+		std::vector<float> triangleScores(trianglesCount);
+		for(size_t i = 0; i < trianglesCount; ++i)
+			triangleScores[i] = vertexScores[indices[i * 3]] + vertexScores[indices[i * 3 + 1]] + vertexScores[indices[i * 3 + 2]];
+		std::vector<bool> emitted(trianglesCount, false);
+
+		std::vector<size_t> cache, newCache;
+		cache.reserve(cacheSize + 3);
+		newCache.reserve(cacheSize + 3);
+
+		std::vector<Index> resultIndices;
+		resultIndices.reserve(trianglesCount * 3);
+
+		size_t bestTriangle = (size_t)-1;
+		size_t nextTriangle = 0;
+		for(size_t k = 0; k < trianglesCount; ++k)
+		{
+			// if there is no candidate in cache, take next not emitted triangle
+			if(bestTriangle == (size_t)-1)
+			{
+				while(emitted[nextTriangle])
+					++nextTriangle;
+				bestTriangle = nextTriangle;
+			}
+
+			// emit triangle
+			emitted[bestTriangle] = true;
+			newCache.clear();
+			for(int j = 0; j < 3; ++j)
+			{
+				size_t v = indices[bestTriangle * 3 + j];
+				resultIndices.push_back((Index)v);
+				newCache.push_back(v);
+
+				// remove triangle from list of not emitted triangles of vertex
+				size_t* triangles = &vertexTriangles[trianglesOffsets[v]];
+				int count = remainingCounts[v]--;
+				for(int l = 0; l < count; ++l)
+					if(triangles[l] == bestTriangle)
+					{
+						std::swap(triangles[l], triangles[count - 1]);
+						break;
+					}
+			}
+
+			// update cache: vertices of emitted triangle go to front
+			for(size_t j = 0; j < cache.size(); ++j)
+				if(cache[j] != newCache[0] && cache[j] != newCache[1] && cache[j] != newCache[2])
+					newCache.push_back(cache[j]);
+			std::swap(cache, newCache);
+
+			// update scores of vertices in cache and evicted ones
+			bestTriangle = (size_t)-1;
+			float bestScore = -1;
+			for(size_t j = 0; j < cache.size(); ++j)
+			{
+				size_t v = cache[j];
+				int position = j < (size_t)cacheSize ? (int)j : -1;
+				float score = GetForsythVertexScore(position, remainingCounts[v], cacheSize);
+				float delta = score - vertexScores[v];
+				vertexScores[v] = score;
+
+				const size_t* triangles = &vertexTriangles[trianglesOffsets[v]];
+				for(int l = 0; l < remainingCounts[v]; ++l)
+				{
+					size_t t = triangles[l];
+					float triangleScore = triangleScores[t] += delta;
+					if(position >= 0 && triangleScore > bestScore)
+					{
+						bestScore = triangleScore;
+						bestTriangle = t;
+					}
+				}
+			}
+			if(cache.size() > (size_t)cacheSize)
+				cache.resize(cacheSize);
+		}
+
+		return NEW(EditableGeometry(vertices, resultIndices));
+	}
+
+	/// Reorder clusters of triangles to reduce overdraw.
+	/** Should be called after OptimizeVertexCache. Triangles are split
+	into clusters at points where vertex cache is (almost) cold anyway,
+	then clusters are sorted so ones facing outwards of the mesh go first,
+	and occlude ones behind them.
+	Requires Vertex::position with x, y and z fields.
+	\param threshold Allowed growth of ACMR, 1.05 means +5%. */
+	ptr<EditableGeometry> OptimizeOverdraw(float threshold = 1.05f, int cacheSize = 32) const
+	{
+		size_t trianglesCount = indices.size() / 3;
+		if(!trianglesCount)
+			return NEW(EditableGeometry(vertices, indices));
+
+		// simulate FIFO cache and find cache misses of every triangle
+		std::vector<int> misses(trianglesCount);
+		int totalMisses = 0;
+		{
+			std::vector<size_t> timestamps(vertices.size(), 0);
+			size_t time = cacheSize + 1;
+			for(size_t i = 0; i < trianglesCount; ++i)
+			{
+				misses[i] = 0;
+				for(int j = 0; j < 3; ++j)
+				{
+					size_t v = indices[i * 3 + j];
+					if(time - timestamps[v] > (size_t)cacheSize)
+					{
+						timestamps[v] = time++;
+						++misses[i];
+					}
+				}
+				totalMisses += misses[i];
+			}
+		}
+		float maxAcmr = (float)totalMisses / (float)trianglesCount * threshold;
+
+		// split into clusters
+		std::vector<size_t> clusters;
+		{
+			int clusterMisses = 0;
+			size_t clusterBegin = 0;
+			for(size_t i = 0; i < trianglesCount; ++i)
+			{
+				bool hardBoundary = misses[i] == 3;
+				bool softBoundary = misses[i] >= 2 && i > clusterBegin && (float)clusterMisses / (float)(i - clusterBegin) <= maxAcmr;
+				if(i == 0 || hardBoundary || softBoundary)
+				{
+					clusters.push_back(i);
+					clusterBegin = i;
+					clusterMisses = 0;
+				}
+				clusterMisses += misses[i];
+			}
+		}
+		clusters.push_back(trianglesCount);
+
+		// mesh centroid
+		float center[3] = { 0, 0, 0 };
+		for(size_t i = 0; i < vertices.size(); ++i)
+		{
+			center[0] += vertices[i].position.x;
+			center[1] += vertices[i].position.y;
+			center[2] += vertices[i].position.z;
+		}
+		for(int j = 0; j < 3; ++j)
+			center[j] /= (float)std::max(vertices.size(), (size_t)1);
+
+		// sort key of cluster: distance of cluster's centroid along cluster's normal
+		std::vector<std::pair<float, size_t> > sortedClusters(clusters.size() - 1);
+		for(size_t c = 0; c + 1 < clusters.size(); ++c)
+		{
+			float clusterCenter[3] = { 0, 0, 0 };
+			float normal[3] = { 0, 0, 0 };
+			float area = 0;
+			for(size_t i = clusters[c]; i < clusters[c + 1]; ++i)
+			{
+				const Vertex& a = vertices[indices[i * 3]];
+				const Vertex& b = vertices[indices[i * 3 + 1]];
+				const Vertex& d = vertices[indices[i * 3 + 2]];
+				float e1[3] = { b.position.x - a.position.x, b.position.y - a.position.y, b.position.z - a.position.z };
+				float e2[3] = { d.position.x - a.position.x, d.position.y - a.position.y, d.position.z - a.position.z };
+				// area-weighted normal
+				float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+				float triangleArea = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+				float triangleCenter[3] =
+				{
+					(a.position.x + b.position.x + d.position.x) / 3,
+					(a.position.y + b.position.y + d.position.y) / 3,
+					(a.position.z + b.position.z + d.position.z) / 3
+				};
+				for(int j = 0; j < 3; ++j)
+				{
+					normal[j] += n[j];
+					clusterCenter[j] += triangleCenter[j] * triangleArea;
+				}
+				area += triangleArea;
+			}
+			float key = 0;
+			if(area > 0)
+				for(int j = 0; j < 3; ++j)
+					key += (clusterCenter[j] / area - center[j]) * normal[j] / area;
+			// greater keys first
+			sortedClusters[c] = std::make_pair(-key, c);
+		}
+		std::stable_sort(sortedClusters.begin(), sortedClusters.end());
+
+		std::vector<Index> resultIndices;
+		resultIndices.reserve(indices.size());
+		for(size_t c = 0; c < sortedClusters.size(); ++c)
+		{
+			size_t cluster = sortedClusters[c].second;
+			resultIndices.insert(resultIndices.end(), indices.begin() + clusters[cluster] * 3, indices.begin() + clusters[cluster + 1] * 3);
+		}
+
+		return NEW(EditableGeometry(vertices, resultIndices));
+	}
+
+	/// Reorder vertices in order of first use by indices.
+	/** Improves locality of vertex fetches. Unused vertices are removed.
+	Should be called after triangles are reordered. */
+	ptr<EditableGeometry> OptimizeVertexFetch() const
+	{
+		std::vector<size_t> indexMap(vertices.size(), (size_t)-1);
+		std::vector<Vertex> resultVertices;
+		resultVertices.reserve(vertices.size());
+		std::vector<Index> resultIndices(indices.size());
+		for(size_t i = 0; i < indices.size(); ++i)
+		{
+			size_t& newIndex = indexMap[indices[i]];
+			if(newIndex == (size_t)-1)
+			{
+				newIndex = resultVertices.size();
+				resultVertices.push_back(vertices[indices[i]]);
+			}
+			resultIndices[i] = (Index)newIndex;
+		}
+		return NEW(EditableGeometry(resultVertices, resultIndices));
+	}
+
+	/// Simplify geometry by collapsing edges using quadric error metric.
+	/** Vertices are collapsed into neighbour vertices, no new vertices
+	are created, so attributes of remaining vertices stay valid.
+	Vertices on attribute seams (several vertices with the same position,
+	but different texcoords, normals, skin weights, etc) and on borders
+	of mesh are never removed, so seams and holes stay in place.
+	Removed vertices are left in vertex array, call OptimizeVertexFetch
+	to get rid of them.
+	Requires Vertex::position with x, y and z fields.
+	\param targetIndicesCount Desired number of indices.
+	Error of collapse is root mean square distance from collapsed vertex
+	to planes of triangles merged into it, weighted by triangles' areas.
+	\param maxError Maximum allowed error of collapse, in units of positions.
+	\param resultError If not null, receives maximum error of performed collapses. */
+	ptr<EditableGeometry> Simplify(size_t targetIndicesCount, float maxError, float* resultError = 0) const
+	{
+		size_t verticesCount = vertices.size();
+		std::vector<size_t> currentIndices(indices.begin(), indices.end());
+
+		// vertices with equal positions; vertex is locked if it is on seam or border
+		std::vector<bool> locked(verticesCount, false);
+		{
+			std::unordered_map<size_t, size_t> firstByPosition;
+			firstByPosition.reserve(verticesCount);
+			std::vector<size_t> nextByPosition(verticesCount, (size_t)-1);
+			std::vector<size_t> positionGroups(verticesCount);
+			for(size_t i = 0; i < verticesCount; ++i)
+			{
+				const float position[3] = { vertices[i].position.x, vertices[i].position.y, vertices[i].position.z };
+				size_t hash = 2166136261U;
+				for(size_t j = 0; j < sizeof(position); ++j)
+					hash = (hash ^ ((const unsigned char*)position)[j]) * 16777619U;
+				std::pair<std::unordered_map<size_t, size_t>::iterator, bool> r = firstByPosition.insert(std::make_pair(hash, i));
+				positionGroups[i] = i;
+				if(r.second)
+					continue;
+				size_t j;
+				for(j = r.first->second; j != (size_t)-1 && !(
+					vertices[j].position.x == position[0] &&
+					vertices[j].position.y == position[1] &&
+					vertices[j].position.z == position[2]); j = nextByPosition[j]);
+				if(j != (size_t)-1)
+				{
+					// seam
+					positionGroups[i] = positionGroups[j];
+					locked[i] = true;
+					locked[positionGroups[j]] = true;
+				}
+				else
+				{
+					nextByPosition[i] = r.first->second;
+					r.first->second = i;
+				}
+			}
+			for(size_t i = 0; i < verticesCount; ++i)
+				if(locked[positionGroups[i]])
+					locked[i] = true;
+
+			// border edges are used by one triangle only (across seams)
+			std::unordered_map<unsigned long long, int> edgesCounts;
+			for(size_t i = 0; i + 2 < currentIndices.size(); i += 3)
+				for(int j = 0; j < 3; ++j)
+				{
+					unsigned long long a = positionGroups[currentIndices[i + j]];
+					unsigned long long b = positionGroups[currentIndices[i + (j + 1) % 3]];
+					++edgesCounts[std::min(a, b) * verticesCount + std::max(a, b)];
+				}
+			for(size_t i = 0; i + 2 < currentIndices.size(); i += 3)
+				for(int j = 0; j < 3; ++j)
+				{
+					size_t a = currentIndices[i + j];
+					size_t b = currentIndices[i + (j + 1) % 3];
+					unsigned long long ga = positionGroups[a], gb = positionGroups[b];
+					if(edgesCounts[std::min(ga, gb) * verticesCount + std::max(ga, gb)] == 1)
+						locked[a] = locked[b] = true;
+				}
+		}
+
+		// quadrics of vertices: symmetric 4x4 matrices, 10 coefficients,
+		// and total areas of their planes to normalize cost per unit area
+		std::vector<double> quadrics(verticesCount * 10, 0.0);
+		std::vector<double> areas(verticesCount, 0.0);
+		for(size_t i = 0; i + 2 < currentIndices.size(); i += 3)
+		{
+			double p[3][3];
+			for(int j = 0; j < 3; ++j)
+			{
+				const Vertex& v = vertices[currentIndices[i + j]];
+				p[j][0] = v.position.x;
+				p[j][1] = v.position.y;
+				p[j][2] = v.position.z;
+			}
+			double n[3];
+			GetTriangleNormal(p, n);
+			double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			if(length <= 0)
+				continue;
+			// plane weighted by area
+			double area = length * 0.5;
+			double plane[4] = { n[0] / length, n[1] / length, n[2] / length, 0 };
+			plane[3] = -(plane[0] * p[0][0] + plane[1] * p[0][1] + plane[2] * p[0][2]);
+			double q[10];
+			for(int a = 0, k = 0; a < 4; ++a)
+				for(int b = a; b < 4; ++b)
+					q[k++] = plane[a] * plane[b] * area;
+			for(int j = 0; j < 3; ++j)
+			{
+				double* quadric = &quadrics[currentIndices[i + j] * 10];
+				for(int k = 0; k < 10; ++k)
+					quadric[k] += q[k];
+				areas[currentIndices[i + j]] += area;
+			}
+		}
+
+		struct Collapse
+		{
+			double cost;
+			size_t from, to;
+			bool operator<(const Collapse& b) const
+			{
+				return cost < b.cost;
+			}
+		};
+		std::vector<Collapse> collapses;
+		std::vector<size_t> collapseTo(verticesCount);
+		std::vector<bool> touched(verticesCount);
+		std::vector<size_t> trianglesOffsets(verticesCount + 1);
+		std::vector<size_t> vertexTriangles;
+		double maxCost = (double)maxError * (double)maxError;
+		double maxPerformedCost = 0;
+
+		while(currentIndices.size() > targetIndicesCount)
+		{
+			// build vertex -> triangles adjacency
+			std::fill(trianglesOffsets.begin(), trianglesOffsets.end(), 0);
+			for(size_t i = 0; i < currentIndices.size(); ++i)
+				++trianglesOffsets[currentIndices[i] + 1];
+			for(size_t i = 0; i < verticesCount; ++i)
+				trianglesOffsets[i + 1] += trianglesOffsets[i];
+			vertexTriangles.resize(currentIndices.size());
+			{
+				std::vector<size_t> filled(trianglesOffsets.begin(), trianglesOffsets.end() - 1);
+				for(size_t i = 0; i < currentIndices.size(); ++i)
+					vertexTriangles[filled[currentIndices[i]]++] = i / 3;
+			}
+
+			// collect possible collapses
+			collapses.clear();
+			for(size_t i = 0; i < currentIndices.size(); ++i)
+			{
+				size_t from = currentIndices[i];
+				size_t to = currentIndices[i - i % 3 + (i + 1) % 3];
+				for(int k = 0; k < 2; ++k, std::swap(from, to))
+				{
+					if(locked[from])
+						continue;
+					const Vertex& v = vertices[to];
+					double x[4] = { v.position.x, v.position.y, v.position.z, 1 };
+					double cost = 0;
+					for(int a = 0, l = 0; a < 4; ++a)
+						for(int b = a; b < 4; ++b, ++l)
+							cost += (quadrics[from * 10 + l] + quadrics[to * 10 + l]) * x[a] * x[b] * (a == b ? 1 : 2);
+					double area = areas[from] + areas[to];
+					Collapse collapse;
+					collapse.cost = area > 0 ? std::max(cost / area, 0.0) : 0.0;
+					collapse.from = from;
+					collapse.to = to;
+					if(collapse.cost <= maxCost)
+						collapses.push_back(collapse);
+				}
+			}
+			std::sort(collapses.begin(), collapses.end());
+
+			// perform independent collapses, cheapest first
+			for(size_t i = 0; i < verticesCount; ++i)
+				collapseTo[i] = i;
+			std::fill(touched.begin(), touched.end(), false);
+			size_t trianglesToRemove = (currentIndices.size() - targetIndicesCount + 2) / 3;
+			size_t removedTriangles = 0;
+			size_t performedCollapses = 0;
+			for(size_t c = 0; c < collapses.size() && removedTriangles < trianglesToRemove; ++c)
+			{
+				const Collapse& collapse = collapses[c];
+				size_t from = collapse.from, to = collapse.to;
+				if(touched[from] || touched[to])
+					continue;
+
+				// check that triangles are not flipped
+				bool flipped = false;
+				size_t sharedTriangles = 0;
+				for(size_t t = trianglesOffsets[from]; t < trianglesOffsets[from + 1] && !flipped; ++t)
+				{
+					const size_t* triangle = &currentIndices[vertexTriangles[t] * 3];
+					if(triangle[0] == to || triangle[1] == to || triangle[2] == to)
+					{
+						++sharedTriangles;
+						continue;
+					}
+					double before[3][3], after[3][3];
+					for(int j = 0; j < 3; ++j)
+					{
+						const Vertex& v = vertices[triangle[j]];
+						const Vertex& w = vertices[triangle[j] == from ? to : triangle[j]];
+						before[j][0] = v.position.x; before[j][1] = v.position.y; before[j][2] = v.position.z;
+						after[j][0] = w.position.x; after[j][1] = w.position.y; after[j][2] = w.position.z;
+					}
+					double nb[3], na[3];
+					GetTriangleNormal(before, nb);
+					GetTriangleNormal(after, na);
+					if(nb[0] * na[0] + nb[1] * na[1] + nb[2] * na[2] <= 0)
+						flipped = true;
+				}
+				if(flipped)
+					continue;
+
+				collapseTo[from] = to;
+				for(int l = 0; l < 10; ++l)
+					quadrics[to * 10 + l] += quadrics[from * 10 + l];
+				areas[to] += areas[from];
+				// neighbours are touched too, so flip checks stay valid
+				for(size_t t = trianglesOffsets[from]; t < trianglesOffsets[from + 1]; ++t)
+					for(int j = 0; j < 3; ++j)
+						touched[currentIndices[vertexTriangles[t] * 3 + j]] = true;
+				removedTriangles += sharedTriangles;
+				maxPerformedCost = std::max(maxPerformedCost, collapse.cost);
+				++performedCollapses;
+			}
+
+			if(!performedCollapses)
+				break;
+
+			// remap indices and remove degenerate triangles
+			size_t newSize = 0;
+			for(size_t i = 0; i < currentIndices.size(); i += 3)
+			{
+				size_t a = collapseTo[currentIndices[i]];
+				size_t b = collapseTo[currentIndices[i + 1]];
+				size_t c = collapseTo[currentIndices[i + 2]];
+				if(a == b || b == c || c == a)
+					continue;
+				currentIndices[newSize++] = a;
+				currentIndices[newSize++] = b;
+				currentIndices[newSize++] = c;
+			}
+			currentIndices.resize(newSize);
+		}
+
+		if(resultError)
+			*resultError = (float)sqrt(maxPerformedCost);
+
+		return NEW(EditableGeometry(vertices, std::vector<Index>(currentIndices.begin(), currentIndices.end())));
+	}
+
+	/// Compute efficiency of post-transform vertex cache.
+	/** Simulates FIFO cache of given size, like most hardware has. */
+	VertexCacheStats AnalyzeVertexCache(int cacheSize = 16) const
+	{
+		std::vector<size_t> timestamps(vertices.size(), 0);
+		std::vector<bool> used(vertices.size(), false);
+		size_t time = cacheSize + 1;
+		size_t missesCount = 0, usedCount = 0;
+		for(size_t i = 0; i < indices.size(); ++i)
+		{
+			size_t v = indices[i];
+			if(time - timestamps[v] > (size_t)cacheSize)
+			{
+				timestamps[v] = time++;
+				++missesCount;
+			}
+			if(!used[v])
+			{
+				used[v] = true;
+				++usedCount;
+			}
+		}
+
+		VertexCacheStats stats;
+		stats.acmr = indices.size() >= 3 ? (float)missesCount / (float)(indices.size() / 3) : 0;
+		stats.atvr = usedCount ? (float)missesCount / (float)usedCount : 0;
+		return stats;
+	}
+
+private:
+	/// Get not normalized normal of triangle.
+	static void GetTriangleNormal(const double p[3][3], double n[3])
+	{
+		double e1[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+		double e2[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+		n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+	}
+
+	/// Score of vertex in Forsyth's algorithm.
+	/** \param cachePosition Position in LRU cache, or -1 if vertex is not in cache.
+	\param remainingCount Number of not emitted triangles using vertex. */
+	static float GetForsythVertexScore(int cachePosition, int remainingCount, int cacheSize)
+	{
+		// vertex is not needed anymore
+		if(remainingCount <= 0)
+			return -1;
+
+		float score = 0;
+		if(cachePosition >= 0)
+		{
+			// vertices of last triangle get fixed score, so algorithm
+			// doesn't prefer to use vertices of the same triangle
+			if(cachePosition < 3)
+				score = 0.75f;
+			else
+				score = powf(1.0f - (float)(cachePosition - 3) / (float)(cacheSize - 3), 1.5f);
+		}
+
+		// bonus for vertices with few triangles left, to get rid of them
+		score += 2.0f / sqrtf((float)remainingCount);
+
+		return score;
+	}
 };
 
 END_INANITY_GRAPHICS
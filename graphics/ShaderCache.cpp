@@ -10,13 +10,111 @@
 #include "../File.hpp"
 #include "../FileSystem.hpp"
 #include "../crypto/HashStream.hpp"
+#include "../crypto/HashAlgorithm.hpp"
+#include "../ThreadPool.hpp"
+#include "../CriticalCode.hpp"
+#include "../StreamReader.hpp"
+#include "../StreamWriter.hpp"
+#include "../MemoryStream.hpp"
+#include "../Time.hpp"
 #include "../File.hpp"
 #include "../Exception.hpp"
+#include <unordered_set>
+#include <algorithm>
 
 BEGIN_INANITY_GRAPHICS
 
 using namespace Shaders;
 
+ShaderCache::Permutation::Permutation() {}
+
+ShaderCache::Permutation::Permutation(const String& key, ptr<ShaderSource> source)
+: key(key), source(source) {}
+
+ShaderCache::BakeStats::BakeStats()
+: permutationsCount(0), compiledCount(0), time(0) {}
+
+/// Task baking permutations in a worker thread.
+/** Tasks take permutations one by one from shared context,
+so work is balanced between threads. */
+class ShaderCache::BakeTask : public Handler
+{
+public:
+	/// Data shared between tasks.
+	struct Context
+	{
+		ShaderCache* cache;
+		const std::vector<Permutation>* permutations;
+		/// Resulting hashes of permutations.
+		std::vector<String> hashes;
+
+		/// Protects fields below and file system.
+		CriticalSection criticalSection;
+		/// Index of next permutation to process.
+		int nextPermutation;
+		/// Hashes already processed, to not compile equal sources twice.
+		std::unordered_set<String> processedHashes;
+		int compiledCount;
+	};
+
+private:
+	Context* context;
+	ptr<Crypto::HashStream> hashStream;
+
+public:
+	BakeTask(Context* context, ptr<Crypto::HashStream> hashStream)
+	: context(context), hashStream(hashStream) {}
+
+	void Fire()
+	{
+		ShaderCache* cache = context->cache;
+		int permutationsCount = (int)context->permutations->size();
+
+		for(;;)
+		{
+			int i;
+			{
+				CriticalCode cc(context->criticalSection);
+				i = context->nextPermutation++;
+			}
+			if(i >= permutationsCount)
+				break;
+
+			const Permutation& permutation = (*context->permutations)[i];
+
+			try
+			{
+				hashStream->Reset();
+				permutation.source->Serialize(hashStream);
+				hashStream->End();
+				String hash = hashStream->GetHashString();
+				// every task writes its own elements
+				context->hashes[i] = hash;
+
+				{
+					CriticalCode cc(context->criticalSection);
+					if(!context->processedHashes.insert(hash).second)
+						continue;
+					if(cache->fileSystem->IsFileExists(hash))
+						continue;
+				}
+
+				ptr<File> file = cache->shaderCompiler->Compile(permutation.source);
+
+				{
+					CriticalCode cc(context->criticalSection);
+					cache->fileSystem->SaveFile(file, hash);
+					++context->compiledCount;
+				}
+			}
+			catch(Exception* exception)
+			{
+				THROW_SECONDARY("Can't bake shader permutation " + permutation.key, exception);
+			}
+		}
+	}
+};
+
 ShaderCache::ShaderCache(ptr<FileSystem> fileSystem, ptr<Device> device, ptr<ShaderCompiler> shaderCompiler, ptr<ShaderGenerator> shaderGenerator, ptr<Crypto::HashStream> hashStream)
 : fileSystem(fileSystem), device(device), shaderCompiler(shaderCompiler), shaderGenerator(shaderGenerator), hashStream(hashStream)
 {}
@@ -103,4 +201,114 @@ ptr<PixelShader> ShaderCache::GetPixelShader(Expression shaderExpression)
 	}
 }
 
+ShaderCache::BakeStats ShaderCache::Bake(const std::vector<Permutation>& permutations, ptr<ThreadPool> threadPool, ptr<Crypto::HashAlgorithm> hashAlgorithm)
+{
+	BEGIN_TRY();
+
+	Time::Tick startTick = Time::GetTick();
+
+	BakeTask::Context context;
+	context.cache = this;
+	context.permutations = &permutations;
+	context.hashes.resize(permutations.size());
+	context.nextPermutation = 0;
+	context.compiledCount = 0;
+
+	// one task per thread, each with its own hash stream
+	int tasksCount = std::min(threadPool->GetThreadsCount(), (int)permutations.size());
+	for(int i = 0; i < tasksCount; ++i)
+		threadPool->Queue(NEW(BakeTask(&context, hashAlgorithm->CreateHashStream())));
+	threadPool->Wait();
+
+	for(size_t i = 0; i < permutations.size(); ++i)
+		manifest[permutations[i].key] = context.hashes[i];
+
+	BakeStats stats;
+	stats.permutationsCount = (int)permutations.size();
+	stats.compiledCount = context.compiledCount;
+	stats.time = float(Time::GetTick() - startTick) / float(Time::GetTicksPerSecond());
+	return stats;
+
+	END_TRY("Can't bake shader permutations");
+}
+
+void ShaderCache::LoadManifest(const String& fileName)
+{
+	BEGIN_TRY();
+
+	ptr<StreamReader> reader = NEW(StreamReader(fileSystem->LoadStream(fileName)));
+	size_t entriesCount = reader->ReadShortly();
+	for(size_t i = 0; i < entriesCount; ++i)
+	{
+		String key = reader->ReadString();
+		manifest[key] = reader->ReadString();
+	}
+	reader->ReadEnd();
+
+	END_TRY("Can't load shader cache manifest");
+}
+
+void ShaderCache::SaveManifest(const String& fileName)
+{
+	BEGIN_TRY();
+
+	// file is written as a whole, not every file system supports streams
+	ptr<MemoryStream> stream = NEW(MemoryStream());
+	ptr<StreamWriter> writer = NEW(StreamWriter(stream));
+	writer->WriteShortly(manifest.size());
+	for(std::unordered_map<String, String>::const_iterator i = manifest.begin(); i != manifest.end(); ++i)
+	{
+		writer->WriteString(i->first);
+		writer->WriteString(i->second);
+	}
+	fileSystem->SaveFile(stream->ToFile(), fileName);
+
+	END_TRY("Can't save shader cache manifest");
+}
+
+ptr<File> ShaderCache::TryGetShader(const String& key)
+{
+	try
+	{
+		std::unordered_map<String, String>::const_iterator i = manifest.find(key);
+		if(i == manifest.end())
+			return nullptr;
+		return fileSystem->LoadFile(i->second);
+	}
+	catch(Exception* exception)
+	{
+		THROW_SECONDARY("Can't get shader " + key + " from shader cache", exception);
+	}
+}
+
+ptr<VertexShader> ShaderCache::GetVertexShader(const String& key)
+{
+	try
+	{
+		ptr<File> file = TryGetShader(key);
+		if(!file)
+			THROW("No such key in manifest");
+		return device->CreateVertexShader(file);
+	}
+	catch(Exception* exception)
+	{
+		THROW_SECONDARY("Can't get baked vertex shader " + key, exception);
+	}
+}
+
+ptr<PixelShader> ShaderCache::GetPixelShader(const String& key)
+{
+	try
+	{
+		ptr<File> file = TryGetShader(key);
+		if(!file)
+			THROW("No such key in manifest");
+		return device->CreatePixelShader(file);
+	}
+	catch(Exception* exception)
+	{
+		THROW_SECONDARY("Can't get baked pixel shader " + key, exception);
+	}
+}
+
 END_INANITY_GRAPHICS
@@ -5,17 +5,21 @@
 #include "shaders/shaders.hpp"
 #include "../crypto/crypto.hpp"
 #include "../String.hpp"
+#include <vector>
+#include <unordered_map>
 
 BEGIN_INANITY
 
 class FileSystem;
 class File;
+class ThreadPool;
 
 END_INANITY
 
 BEGIN_INANITY_CRYPTO
 
 class HashStream;
+class HashAlgorithm;
 
 END_INANITY_CRYPTO
 
@@ -35,8 +39,37 @@ class VertexShader;
 class PixelShader;
 
 /// Класс кэша шейдеров.
+/** Besides lookups by shader source, cache supports baking of shader
+permutations in parallel and lookups of baked permutations by keys.
+Manifest maps keys of permutations to content hashes, so getting
+baked shader doesn't require generating and hashing its source. */
 class ShaderCache : public Object
 {
+public:
+	/// Shader permutation to bake.
+	struct Permutation
+	{
+		/// Key of permutation, used for lookups.
+		String key;
+		/// Generated source of shader.
+		ptr<ShaderSource> source;
+
+		Permutation();
+		Permutation(const String& key, ptr<ShaderSource> source);
+	};
+
+	/// Statistics of baking.
+	struct BakeStats
+	{
+		int permutationsCount;
+		/// Number of shaders which were absent in cache and got compiled.
+		int compiledCount;
+		/// Total time of baking, in seconds.
+		float time;
+
+		BakeStats();
+	};
+
 private:
 	/// Файловая система для шейдеров.
 	ptr<FileSystem> fileSystem;
@@ -50,9 +83,14 @@ private:
 	/// Хеширующий поток.
 	ptr<Crypto::HashStream> hashStream;
 
+	/// Manifest: key of permutation -> hash of shader.
+	std::unordered_map<String, String> manifest;
+
 	/// Вычислить хеш шейдера.
 	String CalculateHash(ptr<ShaderSource> shaderSource);
 
+	class BakeTask;
+
 public:
 	ShaderCache(ptr<FileSystem> fileSystem, ptr<Device> device, ptr<ShaderCompiler> shaderCompiler, ptr<Shaders::ShaderGenerator> shaderGenerator, ptr<Crypto::HashStream> hashStream);
 
@@ -66,6 +104,31 @@ public:
 	/// Получить пиксельный шейдер.
 	ptr<PixelShader> GetPixelShader(ptr<ShaderSource> shaderSource);
 	ptr<PixelShader> GetPixelShader(Shaders::Expression shaderExpression);
+
+	//*** Baking.
+	/// Make sure all permutations are compiled and stored in cache, and add them to manifest.
+	/** Sources should be generated beforehand by the calling thread
+	(generation touches shared nodes of expressions). Hashing, compiling
+	and storing is done by pool's threads; each source, shader compiler
+	and hash algorithm are used concurrently, so they must not share
+	reference-counted objects with each other. Access to file system
+	is serialized.
+	\param hashAlgorithm Algorithm creating hash streams of the same
+	type as cache's hash stream. */
+	BakeStats Bake(const std::vector<Permutation>& permutations, ptr<ThreadPool> threadPool, ptr<Crypto::HashAlgorithm> hashAlgorithm);
+
+	/// Load manifest from file system, merging with current one.
+	void LoadManifest(const String& fileName);
+	/// Save manifest to file system.
+	void SaveManifest(const String& fileName);
+
+	/// Get baked shader by permutation key.
+	/** \returns Compiled shader, or null if key is not in manifest. */
+	ptr<File> TryGetShader(const String& key);
+	/// Get baked vertex shader by permutation key.
+	ptr<VertexShader> GetVertexShader(const String& key);
+	/// Get baked pixel shader by permutation key.
+	ptr<PixelShader> GetPixelShader(const String& key);
 };
 
 END_INANITY_GRAPHICS
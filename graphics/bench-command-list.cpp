@@ -0,0 +1,296 @@
+#include "CommandList.hpp"
+#include "Context.hpp"
+#include "UniformBuffer.hpp"
+#include "Texture.hpp"
+#include "VertexShader.hpp"
+#include "PixelShader.hpp"
+#include "SamplerState.hpp"
+#include "FrameBuffer.hpp"
+#include "AttributeBinding.hpp"
+#include "VertexBuffer.hpp"
+#include "IndexBuffer.hpp"
+#include "DepthStencilState.hpp"
+#include "BlendState.hpp"
+#include "RawTextureData.hpp"
+#include "../ThreadPool.hpp"
+#include "../Time.hpp"
+#include "../Checks.hpp"
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+
+/* Benchmark of command lists on 10k draws.
+Context does no real rendering: it counts state changes which a real
+context would perform (cells which are not actual at draw) and checks
+that every draw sees right uniform data. Frame is submitted directly
+with Lets in scene order, by unsorted command lists, by sorted command
+lists, and by sorted command lists recorded by several threads. */
+
+using namespace Inanity;
+using namespace Inanity::Graphics;
+
+static const int drawsCount = 10000;
+static const int shadersCount = 16;
+static const int materialsCount = 256;
+static const int listsCount = 4;
+static const int iterationsCount = 20;
+
+static double GetTime(Time::Tick startTick)
+{
+	return (double)(Time::GetTick() - startTick) / (double)Time::GetTicksPerSecond();
+}
+
+/// Uniform buffer remembering first int of uploaded data.
+class NullUniformBuffer : public UniformBuffer
+{
+public:
+	int value;
+
+	NullUniformBuffer() : UniformBuffer(sizeof(int)), value(-1) {}
+};
+
+class NullTexture : public Texture
+{
+public:
+	NullTexture() : Texture(1, 1, 1) {}
+};
+
+/// Context counting state changes and checking uniform data.
+class NullContext : public Context
+{
+public:
+	int stateChangesCount;
+	int uploadsCount;
+	/// Expected value of material buffer for every draw, without frame.
+	const std::vector<int>* materialValues;
+	/// Frame number, added to material values.
+	int frame;
+	NullUniformBuffer* objectBuffer;
+	bool dataOk;
+
+private:
+	void Update(Cell& cell)
+	{
+		if(!cell.IsActual())
+		{
+			++stateChangesCount;
+			cell.Actual();
+		}
+	}
+
+public:
+	NullContext() : stateChangesCount(0), uploadsCount(0), materialValues(nullptr), frame(0), objectBuffer(nullptr), dataOk(true) {}
+
+	void ClearColor(int colorBufferIndex, const vec4& color) {}
+	void ClearDepth(float depth) {}
+	void ClearStencil(uint8_t stencil) {}
+	void ClearDepthStencil(float depth, uint8_t stencil) {}
+
+	void UploadUniformBufferData(UniformBuffer* buffer, const void* data, int size)
+	{
+		((NullUniformBuffer*)buffer)->value = *(const int*)data;
+		++uploadsCount;
+	}
+	void UploadVertexBufferData(VertexBuffer* buffer, const void* data, int size) {}
+	void UploadIndexBufferData(IndexBuffer* buffer, const void* data, int size) {}
+
+	/// Draw, count is used as index of draw.
+	void Draw(int count)
+	{
+		Update(cellFrameBuffer);
+		for(int i = 0; i < samplersCount; ++i)
+			Update(cellSamplers[i]);
+		for(int i = 0; i < uniformBuffersCount; ++i)
+			Update(cellUniformBuffers[i]);
+		Update(cellVertexShader);
+		Update(cellPixelShader);
+		Update(cellAttributeBinding);
+		for(int i = 0; i < vertexBuffersCount; ++i)
+			Update(cellVertexBuffers[i]);
+		Update(cellIndexBuffer);
+		Update(cellFillMode);
+		Update(cellCullMode);
+		Update(cellViewport);
+		Update(cellDepthStencilState);
+		Update(cellBlendState);
+
+		LetUniformBuffer* objectLet = (LetUniformBuffer*)cellUniformBuffers[0].top;
+		LetUniformBuffer* materialLet = (LetUniformBuffer*)cellUniformBuffers[1].top;
+		if(!objectLet || (UniformBuffer*)objectLet->uniformBuffer != objectBuffer || objectBuffer->value != count
+			|| !materialLet || ((NullUniformBuffer*)&*materialLet->uniformBuffer)->value != (*materialValues)[count] + frame)
+			dataOk = false;
+	}
+	void DrawInstanced(int instancesCount, int count)
+	{
+		Draw(count);
+	}
+
+	ptr<RawTextureData> GetPresenterTextureData(ptr<Presenter> presenter)
+	{
+		return nullptr;
+	}
+};
+
+struct Scene
+{
+	std::vector<ptr<VertexShader> > vertexShaders;
+	std::vector<ptr<PixelShader> > pixelShaders;
+	std::vector<ptr<Texture> > textures;
+	std::vector<ptr<NullUniformBuffer> > materialBuffers;
+	ptr<NullUniformBuffer> objectBuffer;
+
+	std::vector<int> drawShaders;
+	std::vector<int> drawMaterials;
+	std::vector<float> drawDepths;
+	/// Value of material buffer expected by draw, without frame.
+	std::vector<int> materialValues;
+};
+
+/// Record draws [begin, end) of scene into list.
+static void Record(const Scene& scene, CommandList* list, int begin, int end, bool sort, int frame)
+{
+	list->Clear();
+	list->ResetState();
+	list->SetUniformBuffer(0, scene.objectBuffer);
+	// materials are uploaded once per frame, before the first draw
+	for(int i = 0; i < materialsCount; ++i)
+	{
+		int value = i * 1000 + frame;
+		list->UploadUniformBufferData(scene.materialBuffers[i], &value, sizeof(value));
+	}
+	for(int i = begin; i < end; ++i)
+	{
+		int shader = scene.drawShaders[i];
+		int material = scene.drawMaterials[i];
+		list->SetVertexShader(scene.vertexShaders[shader]);
+		list->SetPixelShader(scene.pixelShaders[shader]);
+		list->SetSampler(0, scene.textures[material]);
+		list->SetUniformBuffer(1, scene.materialBuffers[material]);
+		list->UploadUniformBufferData(scene.objectBuffer, &i, sizeof(i));
+		list->Draw(sort ? CommandList::MakeKey(0, shader, material, scene.drawDepths[i]) : 0, i);
+	}
+}
+
+int main()
+{
+	srand(1);
+
+	Scene scene;
+	for(int i = 0; i < shadersCount; ++i)
+	{
+		scene.vertexShaders.push_back(NEW(VertexShader()));
+		scene.pixelShaders.push_back(NEW(PixelShader()));
+	}
+	for(int i = 0; i < materialsCount; ++i)
+	{
+		scene.textures.push_back(NEW(NullTexture()));
+		scene.materialBuffers.push_back(NEW(NullUniformBuffer()));
+	}
+	scene.objectBuffer = NEW(NullUniformBuffer());
+	for(int i = 0; i < drawsCount; ++i)
+	{
+		scene.drawShaders.push_back(rand() % shadersCount);
+		scene.drawMaterials.push_back(rand() % materialsCount);
+		scene.drawDepths.push_back((float)rand() / (float)RAND_MAX);
+		scene.materialValues.push_back(scene.drawMaterials[i] * 1000);
+	}
+
+	ptr<NullContext> context = NEW(NullContext());
+	context->materialValues = &scene.materialValues;
+	context->objectBuffer = scene.objectBuffer;
+
+	ptr<ThreadPool> threadPool = NEW(ThreadPool());
+	ptr<CommandList> lists[listsCount];
+	for(int i = 0; i < listsCount; ++i)
+		lists[i] = NEW(CommandList());
+	CommandList* listsPointers[listsCount];
+	for(int i = 0; i < listsCount; ++i)
+		listsPointers[i] = lists[i];
+
+	const char* names[] = { "immediate", "unsorted list", "sorted list", "sorted lists, threads" };
+	const int variantsCount = sizeof(names) / sizeof(names[0]);
+	for(int variant = 0; variant < variantsCount; ++variant)
+	{
+		context->stateChangesCount = 0;
+		context->uploadsCount = 0;
+		context->dataOk = true;
+
+		Time::Tick startTick = Time::GetTick();
+		for(int iteration = 0; iteration < iterationsCount; ++iteration)
+		{
+			context->frame = iteration;
+			switch(variant)
+			{
+			case 0:
+				{
+					Context::LetUniformBuffer lo(context, 0, scene.objectBuffer);
+					for(int i = 0; i < drawsCount; ++i)
+					{
+						int shader = scene.drawShaders[i];
+						int material = scene.drawMaterials[i];
+						int value = material * 1000 + iteration;
+						context->UploadUniformBufferData(scene.materialBuffers[material], &value, sizeof(value));
+						context->UploadUniformBufferData(scene.objectBuffer, &i, sizeof(i));
+						Context::LetVertexShader lvs(context, scene.vertexShaders[shader]);
+						Context::LetPixelShader lps(context, scene.pixelShaders[shader]);
+						Context::LetSampler ls(context, 0, scene.textures[material]);
+						Context::LetUniformBuffer lm(context, 1, scene.materialBuffers[material]);
+						context->Draw(i);
+					}
+				}
+				break;
+			case 1:
+			case 2:
+				Record(scene, lists[0], 0, drawsCount, variant == 2, iteration);
+				context->Execute(listsPointers, 1);
+				break;
+			case 3:
+				for(int i = 0; i < listsCount; ++i)
+				{
+					const Scene* s = &scene;
+					CommandList* list = lists[i];
+					int begin = drawsCount * i / listsCount;
+					int end = drawsCount * (i + 1) / listsCount;
+					threadPool->Queue(Handler::BindCall([s, list, begin, end, iteration]()
+					{
+						Record(*s, list, begin, end, true, iteration);
+					}));
+				}
+				threadPool->Wait();
+				context->Execute(listsPointers, listsCount);
+				break;
+			}
+		}
+		double time = GetTime(startTick);
+
+		Check(names[variant], context->dataOk);
+		std::cout << names[variant] << ": " << (time * 1000 / iterationsCount) << " ms per frame, "
+			<< (context->stateChangesCount / iterationsCount) << " state changes, "
+			<< (context->uploadsCount / iterationsCount) << " uploads\n";
+	}
+
+	// upload recorded after draw does not affect it
+	{
+		ptr<CommandList> list = NEW(CommandList());
+		NullUniformBuffer* materialBuffer = scene.materialBuffers[0];
+		std::vector<int> materialValues(2);
+		context->materialValues = &materialValues;
+		context->frame = 0;
+		list->SetUniformBuffer(0, scene.objectBuffer);
+		list->SetUniformBuffer(1, materialBuffer);
+		for(int i = 0; i < 2; ++i)
+		{
+			materialValues[i] = i + 2000;
+			list->UploadUniformBufferData(materialBuffer, &materialValues[i], sizeof(int));
+			list->UploadUniformBufferData(scene.objectBuffer, &i, sizeof(i));
+			// second draw goes first
+			list->Draw(1 - i, i);
+		}
+		CommandList* l = list;
+		context->dataOk = true;
+		context->Execute(&l, 1);
+		Check("upload after draw", context->dataOk);
+	}
+
+	return ReportChecks();
+}
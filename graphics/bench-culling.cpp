@@ -0,0 +1,187 @@
+#include "Culler.hpp"
+#include "../ThreadPool.hpp"
+#include "../Time.hpp"
+#include "../Checks.hpp"
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+/* Benchmark of frustum culling of 100k objects.
+Objects are spheres and boxes scattered over a grid of cells, and
+added cell by cell, so clusters of consecutive objects are compact.
+Culler without clusters (all objects in one cluster), with clusters,
+and with clusters and threads is compared with a plain scalar
+test, and all of them must give the same visible objects. */
+
+using namespace Inanity;
+using namespace Inanity::Graphics;
+
+static const int objectsCount = 100000;
+static const int iterationsCount = 100;
+
+static double GetTime(Time::Tick startTick)
+{
+	return (double)(Time::GetTick() - startTick) / (double)Time::GetTicksPerSecond();
+}
+
+static float Random(float min, float max)
+{
+	return min + (max - min) * (float)rand() / (float)RAND_MAX;
+}
+
+struct Bounds
+{
+	vec3 center;
+	vec3 extents;
+	float radius;
+};
+
+/// Straightforward test of objects one by one.
+static void CullReference(const Culler::Frustum& frustum, const std::vector<Bounds>& objects, std::vector<int>& visible)
+{
+	for(size_t i = 0; i < objects.size(); ++i)
+	{
+		const Bounds& o = objects[i];
+		bool ok = true;
+		for(int j = 0; j < 6 && ok; ++j)
+		{
+			const vec4& p = frustum.planes[j];
+			float d = p.x * o.center.x + p.y * o.center.y + p.z * o.center.z + p.w;
+			float e = std::abs(p.x) * o.extents.x + std::abs(p.y) * o.extents.y + std::abs(p.z) * o.extents.z;
+			ok = d + std::min(e, o.radius) >= 0;
+		}
+		if(ok)
+			visible.push_back((int)i);
+	}
+}
+
+int main()
+{
+	srand(1);
+
+	// scatter objects over 32x32 cells of 1000x1000 area
+	const int cellsCount = 32;
+	const float cellSize = 1000.0f / cellsCount;
+	std::vector<Bounds> objects;
+	objects.reserve(objectsCount);
+	for(int i = 0; i < objectsCount; ++i)
+	{
+		int cell = i * cellsCount * cellsCount / objectsCount;
+		float x = (cell % cellsCount) * cellSize - 500;
+		float z = (cell / cellsCount) * cellSize - 500;
+		Bounds o;
+		o.center = vec3(Random(x, x + cellSize), Random(0, 50), Random(z, z + cellSize));
+		if(i % 2)
+		{
+			o.radius = Random(0.1f, 2);
+			o.extents = vec3(o.radius, o.radius, o.radius);
+		}
+		else
+		{
+			o.extents = vec3(Random(0.1f, 2), Random(0.1f, 2), Random(0.1f, 2));
+			o.radius = length(o.extents);
+		}
+		objects.push_back(o);
+	}
+
+	ptr<Culler> flatCuller = NEW(Culler(objectsCount));
+	ptr<Culler> clusterCuller = NEW(Culler());
+	for(int i = 0; i < objectsCount; ++i)
+	{
+		const Bounds& o = objects[i];
+		for(int j = 0; j < 2; ++j)
+		{
+			Culler* culler = j ? (Culler*)clusterCuller : (Culler*)flatCuller;
+			if(i % 2)
+				culler->AddSphere(o.center, o.radius);
+			else
+				culler->AddBox(o.center - o.extents, o.center + o.extents);
+		}
+	}
+	Check("objects count", clusterCuller->GetObjectsCount() == objectsCount);
+
+	ptr<ThreadPool> threadPool = NEW(ThreadPool());
+
+	// cameras looking around from the middle
+	std::vector<mat4x4> viewProjections;
+	mat4x4 projection = CreateProjectionPerspectiveFovMatrix<float>(1.0f, 16.0f / 9.0f, 0.1f, 400.0f);
+	for(int i = 0; i < iterationsCount; ++i)
+	{
+		float angle = 6.2831853f * i / iterationsCount;
+		vec3 eye(std::cos(angle) * 100, 30, std::sin(angle) * 100);
+		vec3 target(eye.x + std::sin(angle) * 50, 20, eye.z - std::cos(angle) * 50);
+		viewProjections.push_back(projection * CreateLookAtMatrix(eye, target, vec3(0, 1, 0)));
+	}
+
+	Time::Tick startTick;
+	double referenceTime = 0, flatTime = 0, clusterTime = 0, threadsTime = 0;
+	size_t visibleCount = 0;
+	std::vector<int> reference, visible;
+	for(int i = 0; i < iterationsCount; ++i)
+	{
+		const mat4x4& viewProjection = viewProjections[i];
+		Culler::Frustum frustum(viewProjection);
+
+		reference.clear();
+		startTick = Time::GetTick();
+		CullReference(frustum, objects, reference);
+		referenceTime += GetTime(startTick);
+		visibleCount += reference.size();
+
+		visible.clear();
+		startTick = Time::GetTick();
+		flatCuller->Cull(frustum, visible);
+		flatTime += GetTime(startTick);
+		Check("flat", visible == reference);
+
+		visible.clear();
+		startTick = Time::GetTick();
+		clusterCuller->Cull(frustum, visible);
+		clusterTime += GetTime(startTick);
+		Check("clusters", visible == reference);
+
+		visible.clear();
+		startTick = Time::GetTick();
+		clusterCuller->Cull(frustum, visible, threadPool);
+		threadsTime += GetTime(startTick);
+		Check("threads", visible == reference);
+
+		// objects with center inside clip volume must be visible
+		bool ok = true;
+		for(int j = 0, k = 0; j < objectsCount && ok; ++j)
+		{
+			vec4 c = viewProjection * vec4(objects[j].center.x, objects[j].center.y, objects[j].center.z, 1);
+			while(k < (int)reference.size() && reference[k] < j)
+				++k;
+			if(-c.w < c.x && c.x < c.w && -c.w < c.y && c.y < c.w && 0 < c.z && c.z < c.w)
+				ok = k < (int)reference.size() && reference[k] == j;
+		}
+		Check("centers inside", ok);
+	}
+
+	// box of cluster is recalculated after bounds of object change
+	{
+		Culler::Frustum frustum(viewProjections[0]);
+		int object = objectsCount / 2;
+		vec3 eye(100, 30, 0);
+		clusterCuller->SetSphere(object, eye - vec3(0, 0, 50), 1);
+		visible.clear();
+		clusterCuller->Cull(frustum, visible);
+		Check("moved object", std::find(visible.begin(), visible.end(), object) != visible.end());
+		clusterCuller->SetSphere(object, eye + vec3(0, 0, 50), 1);
+		visible.clear();
+		clusterCuller->Cull(frustum, visible);
+		Check("moved object behind", std::find(visible.begin(), visible.end(), object) == visible.end());
+	}
+
+	std::cout << "objects: " << objectsCount << ", visible on average: " << (visibleCount / iterationsCount)
+		<< ", threads: " << threadPool->GetThreadsCount() << "\n";
+	std::cout << "reference: " << (referenceTime * 1000 / iterationsCount) << " ms\n";
+	std::cout << "simd: " << (flatTime * 1000 / iterationsCount) << " ms, speedup " << (referenceTime / flatTime) << "x\n";
+	std::cout << "simd + clusters: " << (clusterTime * 1000 / iterationsCount) << " ms, speedup " << (referenceTime / clusterTime) << "x\n";
+	std::cout << "simd + clusters + threads: " << (threadsTime * 1000 / iterationsCount) << " ms, speedup " << (referenceTime / threadsTime) << "x\n";
+
+	return ReportChecks();
+}
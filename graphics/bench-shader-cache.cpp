@@ -0,0 +1,203 @@
+#include "ShaderCache.hpp"
+#include "GlShaderCompiler.hpp"
+#include "ShaderSource.hpp"
+#include "Device.hpp"
+#include "../inanity-shaders.hpp"
+#include "../crypto/WhirlpoolStream.hpp"
+#include "../crypto/GenericHashAlgorithm.hpp"
+#include "../data/TempFileSystem.hpp"
+#include "../ThreadPool.hpp"
+#include "../File.hpp"
+#include "../Time.hpp"
+#include "../Exception.hpp"
+#include "../Checks.hpp"
+#include <atomic>
+#include <cstring>
+#include <iostream>
+
+/* Benchmark of cold and warm loading of shader permutations.
+Cold load compiles every permutation: one by one with GetShader,
+or in parallel with Bake. Warm load gets them from populated cache:
+by generating and hashing sources (GetShader), or by keys from
+saved manifest, without generating sources at all.
+GLSL "compilation" is only serialization, so compiler here also
+waits a fixed time, emulating an offline compiler like HLSL one.
+Cache is kept in memory, so times don't include disk access. */
+
+using namespace Inanity;
+using namespace Inanity::Graphics;
+using namespace Inanity::Graphics::Shaders;
+
+static const int permutationsCount = 4096;
+/// Emulated time of compilation of one shader, in seconds.
+static const double compileTime = 0.001;
+
+static double GetTime(Time::Tick startTick)
+{
+	return (double)(Time::GetTick() - startTick) / (double)Time::GetTicksPerSecond();
+}
+
+/// GLSL compiler spending fixed time on each shader.
+class SlowShaderCompiler : public ShaderCompiler
+{
+private:
+	ptr<ShaderCompiler> compiler;
+
+public:
+	/// Number of compiled shaders (compiler is used by many threads).
+	std::atomic<int> compiledCount;
+
+	SlowShaderCompiler() : compiler(NEW(GlShaderCompiler())), compiledCount(0) {}
+
+	ptr<File> Compile(ptr<ShaderSource> shaderSource)
+	{
+		Time::Tick startTick = Time::GetTick();
+		ptr<File> file = compiler->Compile(shaderSource);
+		while(GetTime(startTick) < compileTime);
+		++compiledCount;
+		return file;
+	}
+};
+
+struct Permutations
+{
+	ptr<UniformGroup> uniformGroup;
+	UniformArray<vec4> uLightDirections;
+	Uniform<vec3> uFogColor;
+	Interpolant<vec3> iNormal;
+	Interpolant<float> iDepth;
+
+	Permutations() :
+		uniformGroup(NEW(UniformGroup(0))),
+		uLightDirections(uniformGroup->AddUniformArray<vec4>(8)),
+		uFogColor(uniformGroup->AddUniform<vec3>()),
+		iNormal(0),
+		iDepth(1)
+	{}
+
+	static String GetKey(int permutation)
+	{
+		char key[32];
+		sprintf(key, "pixel-%d", permutation);
+		return key;
+	}
+
+	/// Generate source of pixel shader: 1..8 lights, fog, rim lighting, specular,
+	/// gamma correction, tone mapping, one of 16 levels of ambient light.
+	ptr<ShaderSource> Generate(int permutation)
+	{
+		int lightsCount = (permutation & 7) + 1;
+		bool fog = (permutation & 8) != 0;
+		bool rim = (permutation & 16) != 0;
+		bool specular = (permutation & 32) != 0;
+		bool gamma = (permutation & 64) != 0;
+		bool toneMapping = (permutation & 128) != 0;
+		float ambient = (float)((permutation >> 8) & 15) / 16.0f;
+
+		Value<vec3> normal = normalize(iNormal);
+		Value<float> light = ambient;
+		for(int i = 0; i < lightsCount; ++i)
+		{
+			Value<float> d = dot(normal, uLightDirections[i]["xyz"]);
+			light = light + max(d, Value<float>(0.0f));
+			if(specular)
+				light = light + pow(max(d, Value<float>(0.0f)), Value<float>(32.0f));
+		}
+		if(rim)
+			light = light + pow(Value<float>(1.0f) - abs(normal["z"]), Value<float>(4.0f));
+		Value<vec3> color = newvec3(light, light, light);
+		if(fog)
+			color = lerp(uFogColor, color, exp(-iDepth));
+		if(toneMapping)
+			color = color / (color + newvec3(1.0f, 1.0f, 1.0f));
+		if(gamma)
+			color = pow(color, newvec3(0.4545f, 0.4545f, 0.4545f));
+
+		ptr<ShaderGenerator> generator = NEW(GlslGenerator(GlslVersions::opengl33, true));
+		return generator->Generate(fragment(0, newvec4(color, 1.0f)), ShaderTypes::pixel);
+	}
+};
+
+int main()
+{
+	try
+	{
+		ptr<Crypto::HashAlgorithm> hashAlgorithm = NEW(Crypto::GenericHashAlgorithm<Crypto::WhirlpoolStream>());
+		ptr<ThreadPool> threadPool = NEW(ThreadPool());
+		Permutations permutations;
+
+		std::vector<ptr<File> > coldFiles(permutationsCount);
+		Time::Tick startTick;
+
+		// cold, one by one
+		ptr<FileSystem> fileSystem = NEW(Data::TempFileSystem());
+		ptr<SlowShaderCompiler> compiler = NEW(SlowShaderCompiler());
+		{
+			ptr<ShaderCache> cache = NEW(ShaderCache(fileSystem, nullptr, compiler, nullptr, hashAlgorithm->CreateHashStream()));
+			startTick = Time::GetTick();
+			for(int i = 0; i < permutationsCount; ++i)
+				coldFiles[i] = cache->GetShader(permutations.Generate(i));
+			double time = GetTime(startTick);
+			std::cout << "cold, sequential: " << (time * 1000) << " ms, compiled " << compiler->compiledCount << "\n";
+			Check("cold sequential compiled all", compiler->compiledCount == permutationsCount);
+		}
+
+		// cold, baked in parallel
+		fileSystem = NEW(Data::TempFileSystem());
+		compiler = NEW(SlowShaderCompiler());
+		{
+			ptr<ShaderCache> cache = NEW(ShaderCache(fileSystem, nullptr, compiler, nullptr, hashAlgorithm->CreateHashStream()));
+			startTick = Time::GetTick();
+			std::vector<ShaderCache::Permutation> bakePermutations;
+			for(int i = 0; i < permutationsCount; ++i)
+				bakePermutations.push_back(ShaderCache::Permutation(Permutations::GetKey(i), permutations.Generate(i)));
+			ShaderCache::BakeStats stats = cache->Bake(bakePermutations, threadPool, hashAlgorithm);
+			double time = GetTime(startTick);
+			std::cout << "cold, baked by " << threadPool->GetThreadsCount() << " threads: " << (time * 1000) << " ms (bake "
+				<< (stats.time * 1000) << " ms), compiled " << stats.compiledCount << "\n";
+			Check("cold bake compiled all", stats.compiledCount == permutationsCount && compiler->compiledCount == permutationsCount);
+			cache->SaveManifest("manifest");
+		}
+
+		// warm, by sources
+		compiler = NEW(SlowShaderCompiler());
+		{
+			ptr<ShaderCache> cache = NEW(ShaderCache(fileSystem, nullptr, compiler, nullptr, hashAlgorithm->CreateHashStream()));
+			startTick = Time::GetTick();
+			bool ok = true;
+			for(int i = 0; i < permutationsCount; ++i)
+			{
+				ptr<File> file = cache->GetShader(permutations.Generate(i));
+				ok = ok && file->GetSize() == coldFiles[i]->GetSize() && memcmp(file->GetData(), coldFiles[i]->GetData(), file->GetSize()) == 0;
+			}
+			double time = GetTime(startTick);
+			std::cout << "warm, by sources: " << (time * 1000) << " ms, compiled " << compiler->compiledCount << "\n";
+			Check("warm by sources", ok && compiler->compiledCount == 0);
+		}
+
+		// warm, by keys from manifest
+		{
+			ptr<ShaderCache> cache = NEW(ShaderCache(fileSystem, nullptr, compiler, nullptr, hashAlgorithm->CreateHashStream()));
+			startTick = Time::GetTick();
+			cache->LoadManifest("manifest");
+			bool ok = true;
+			for(int i = 0; i < permutationsCount; ++i)
+			{
+				ptr<File> file = cache->TryGetShader(Permutations::GetKey(i));
+				ok = ok && file && file->GetSize() == coldFiles[i]->GetSize() && memcmp(file->GetData(), coldFiles[i]->GetData(), file->GetSize()) == 0;
+			}
+			double time = GetTime(startTick);
+			std::cout << "warm, by keys: " << (time * 1000) << " ms, compiled " << compiler->compiledCount << "\n";
+			Check("warm by keys", ok && compiler->compiledCount == 0);
+			Check("unknown key", !cache->TryGetShader("unknown"));
+		}
+	}
+	catch(Exception* exception)
+	{
+		MakePointer(exception)->PrintStack(std::cout);
+		std::cout << "\n";
+		return 1;
+	}
+
+	return ReportChecks();
+}
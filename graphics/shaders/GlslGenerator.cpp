@@ -1,5 +1,6 @@
 #include "GlslGenerator.hpp"
 #include "GlslGeneratorInstance.hpp"
+#include "Optimizer.hpp"
 #include "../ShaderSource.hpp"
 #include "Expression.hpp"
 #include "Node.hpp"
@@ -13,7 +14,8 @@ GlslGenerator::GlslGenerator(GlslVersion glslVersion, bool supportUniformBuffers
 
 ptr<ShaderSource> GlslGenerator::Generate(Expression code, ShaderType shaderType)
 {
-	GlslGeneratorInstance instance(code.GetNode(), shaderType, glslVersion, supportUniformBuffers);
+	Optimizer optimizer;
+	GlslGeneratorInstance instance(optimizer.Optimize(code.GetNode()), shaderType, glslVersion, supportUniformBuffers);
 
 	return instance.Generate();
 }
@@ -1,5 +1,6 @@
 #include "Hlsl11Generator.hpp"
 #include "Hlsl11GeneratorInstance.hpp"
+#include "Optimizer.hpp"
 #include "../ShaderSource.hpp"
 #include "Expression.hpp"
 #include "Node.hpp"
@@ -8,7 +9,8 @@ BEGIN_INANITY_SHADERS
 
 ptr<ShaderSource> Hlsl11Generator::Generate(Expression code, ShaderType shaderType)
 {
-	Hlsl11GeneratorInstance instance(code.GetNode(), shaderType);
+	Optimizer optimizer;
+	Hlsl11GeneratorInstance instance(optimizer.Optimize(code.GetNode()), shaderType);
 
 	return instance.Generate();
 }
@@ -0,0 +1,851 @@
+#include "Optimizer.hpp"
+#include "FloatConstNode.hpp"
+#include "IntConstNode.hpp"
+#include "AttributeNode.hpp"
+#include "UniformNode.hpp"
+#include "SamplerNode.hpp"
+#include "ReadUniformNode.hpp"
+#include "IndexUniformArrayNode.hpp"
+#include "TransformedNode.hpp"
+#include "InterpolateNode.hpp"
+#include "SequenceNode.hpp"
+#include "SwizzleNode.hpp"
+#include "OperationNode.hpp"
+#include "ActionNode.hpp"
+#include "SampleNode.hpp"
+#include "FragmentNode.hpp"
+#include "DualFragmentNode.hpp"
+#include "CastNode.hpp"
+#include "../../Exception.hpp"
+#include <cstring>
+#include <cmath>
+#include <climits>
+#include <algorithm>
+#include <vector>
+
+BEGIN_INANITY_SHADERS
+
+//*** Optimizer::Stats
+
+Optimizer::Stats::Stats()
+: foldedCount(0), simplifiedCount(0), mergedCount(0) {}
+
+//*** Optimizer::Key
+
+Optimizer::Key::Key(int type, int param, DataType valueType, int data)
+: type(type), param(param), valueType((int)valueType), data(data)
+{
+	for(int i = 0; i < maxChildrenCount; ++i)
+		children[i] = nullptr;
+}
+
+bool Optimizer::Key::operator==(const Key& b) const
+{
+	if(type != b.type || param != b.param || valueType != b.valueType || data != b.data)
+		return false;
+	for(int i = 0; i < maxChildrenCount; ++i)
+		if(children[i] != b.children[i])
+			return false;
+	return true;
+}
+
+size_t Optimizer::KeyHash::operator()(const Key& key) const
+{
+	size_t hash = std::hash<int>()(key.type);
+	hash = hash * 31 + std::hash<int>()(key.param);
+	hash = hash * 31 + std::hash<int>()(key.valueType);
+	hash = hash * 31 + std::hash<int>()(key.data);
+	for(int i = 0; i < Key::maxChildrenCount; ++i)
+		hash = hash * 31 + std::hash<const void*>()(key.children[i]);
+	return hash;
+}
+
+//*** helpers
+
+namespace
+{
+	/// Static storage for all possible swizzle maps.
+	class SwizzleMaps
+	{
+	private:
+		/// Maps of length 1, 2, 3 and 4, 4 + 16 + 64 + 256 in total.
+		char maps[340][5];
+
+		static int GetOffset(int length)
+		{
+			static const int offsets[] = { 0, 0, 4, 20, 84 };
+			return offsets[length];
+		}
+
+	public:
+		SwizzleMaps()
+		{
+			static const char components[] = "xyzw";
+			for(int length = 1; length <= 4; ++length)
+			{
+				int count = 1 << (length * 2);
+				for(int i = 0; i < count; ++i)
+				{
+					char* map = maps[GetOffset(length) + i];
+					for(int j = 0; j < length; ++j)
+						map[j] = components[(i >> ((length - 1 - j) * 2)) & 3];
+					map[length] = 0;
+				}
+			}
+		}
+
+		const char* Get(const char* map) const
+		{
+			int length = (int)strlen(map);
+			if(length < 1 || length > 4)
+				THROW("Invalid swizzle map length");
+			int index = 0;
+			for(int i = 0; i < length; ++i)
+			{
+				const char* component = strchr("xyzw", map[i]);
+				if(!component || !*component)
+					THROW("Invalid swizzle map component");
+				index = index * 4 + (int)(component - "xyzw");
+			}
+			return maps[GetOffset(length) + index];
+		}
+	};
+
+	inline int SwizzleComponent(char c)
+	{
+		switch(c)
+		{
+		case 'x': return 0;
+		case 'y': return 1;
+		case 'z': return 2;
+		case 'w': return 3;
+		default: THROW("Invalid swizzle map component");
+		}
+	}
+
+	inline int FloatBits(float value)
+	{
+		int bits;
+		memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	inline bool IsFloatConst(ValueNode* node, float value)
+	{
+		return node->GetType() == Node::typeFloatConst && fast_cast<FloatConstNode*>(node)->GetValue() == value;
+	}
+
+	inline bool IsIntConst(ValueNode* node, int value)
+	{
+		return node->GetType() == Node::typeIntConst && fast_cast<IntConstNode*>(node)->GetValue() == value;
+	}
+
+	inline bool IsConst(ValueNode* node, int value)
+	{
+		return IsFloatConst(node, (float)value) || IsIntConst(node, value);
+	}
+}
+
+//*** Optimizer
+
+const char* Optimizer::GetStaticSwizzleMap(const char* map)
+{
+	static const SwizzleMaps maps;
+	return maps.Get(map);
+}
+
+ptr<Node> Optimizer::Optimize(ptr<Node> rootNode)
+{
+	BEGIN_TRY();
+	return Process(rootNode);
+	END_TRY("Can't optimize shader graph");
+}
+
+Expression Optimizer::Optimize(Expression code)
+{
+	return Optimize(code.GetNode());
+}
+
+const Optimizer::Stats& Optimizer::GetStats() const
+{
+	return stats;
+}
+
+ptr<Node> Optimizer::Process(Node* node)
+{
+	if(!node)
+		return nullptr;
+
+	std::unordered_map<Node*, ptr<Node> >::const_iterator i = processedNodes.find(node);
+	if(i != processedNodes.end())
+		return i->second;
+
+	ptr<Node> result = ProcessNode(node);
+	processedNodes[node] = result;
+	return result;
+}
+
+ptr<ValueNode> Optimizer::ProcessValue(ValueNode* node)
+{
+	return fast_cast<ValueNode*>(&*Process(node));
+}
+
+ptr<Node> Optimizer::ProcessNode(Node* node)
+{
+	switch(node->GetType())
+	{
+	case Node::typeFloatConst:
+	case Node::typeIntConst:
+	case Node::typeAttribute:
+	case Node::typeReadUniform:
+	case Node::typeTransformed:
+		return Canonicalize(fast_cast<ValueNode*>(node));
+	case Node::typeUniform:
+	case Node::typeSampler:
+		// declarations are kept by identity
+		return node;
+	case Node::typeIndexUniformArray:
+		{
+			IndexUniformArrayNode* indexNode = fast_cast<IndexUniformArrayNode*>(node);
+			ptr<ValueNode> index = ProcessValue(indexNode->GetIndexNode());
+			if(index == indexNode->GetIndexNode())
+				return Canonicalize(indexNode);
+			return Canonicalize(NEW(IndexUniformArrayNode(indexNode->GetUniformNode(), index)));
+		}
+	case Node::typeInterpolate:
+		{
+			InterpolateNode* interpolateNode = fast_cast<InterpolateNode*>(node);
+			ptr<ValueNode> a = ProcessValue(interpolateNode->GetNode());
+			if(a == interpolateNode->GetNode())
+				return node;
+			return NEW(InterpolateNode(interpolateNode->GetValueType(), interpolateNode->GetSemantic(), a));
+		}
+	case Node::typeSequence:
+		{
+			SequenceNode* sequenceNode = fast_cast<SequenceNode*>(node);
+			ptr<Node> a = Process(sequenceNode->GetA());
+			ptr<Node> b = Process(sequenceNode->GetB());
+			if(a == sequenceNode->GetA() && b == sequenceNode->GetB())
+				return node;
+			return NEW(SequenceNode(a, b));
+		}
+	case Node::typeSwizzle:
+		{
+			SwizzleNode* swizzleNode = fast_cast<SwizzleNode*>(node);
+			ptr<ValueNode> a = ProcessValue(swizzleNode->GetA());
+			const char* map = GetStaticSwizzleMap(swizzleNode->GetMap());
+			if(a == swizzleNode->GetA() && map == swizzleNode->GetMap())
+				return SimplifySwizzle(swizzleNode);
+			return SimplifySwizzle(NEW(SwizzleNode(a, map)));
+		}
+	case Node::typeOperation:
+		{
+			OperationNode* operationNode = fast_cast<OperationNode*>(node);
+			int argumentsCount = operationNode->GetArgumentsCount();
+			ptr<ValueNode> arguments[OperationNode::maxArgumentsCount];
+			bool changed = false;
+			for(int i = 0; i < argumentsCount; ++i)
+			{
+				arguments[i] = ProcessValue(operationNode->GetArgument(i));
+				if(arguments[i] != operationNode->GetArgument(i))
+					changed = true;
+			}
+			if(!changed)
+				return SimplifyOperation(operationNode);
+
+			OperationNode::Operation operation = operationNode->GetOperation();
+			DataType valueType = operationNode->GetValueType();
+			ptr<OperationNode> newNode;
+			switch(argumentsCount)
+			{
+			case 1: newNode = NEW(OperationNode(operation, valueType, arguments[0])); break;
+			case 2: newNode = NEW(OperationNode(operation, valueType, arguments[0], arguments[1])); break;
+			case 3: newNode = NEW(OperationNode(operation, valueType, arguments[0], arguments[1], arguments[2])); break;
+			case 4: newNode = NEW(OperationNode(operation, valueType, arguments[0], arguments[1], arguments[2], arguments[3])); break;
+			default: THROW("Invalid arguments count");
+			}
+			return SimplifyOperation(newNode);
+		}
+	case Node::typeAction:
+		{
+			ActionNode* actionNode = fast_cast<ActionNode*>(node);
+			int argumentsCount = actionNode->GetArgumentsCount();
+			ptr<ValueNode> arguments[ActionNode::maxArgumentsCount];
+			bool changed = false;
+			for(int i = 0; i < argumentsCount; ++i)
+			{
+				arguments[i] = ProcessValue(actionNode->GetArgument(i));
+				if(arguments[i] != actionNode->GetArgument(i))
+					changed = true;
+			}
+			if(!changed)
+				return node;
+			switch(argumentsCount)
+			{
+			case 1: return NEW(ActionNode(actionNode->GetAction(), arguments[0]));
+			case 2: return NEW(ActionNode(actionNode->GetAction(), arguments[0], arguments[1]));
+			default: THROW("Invalid arguments count");
+			}
+		}
+	case Node::typeSample:
+		{
+			SampleNode* sampleNode = fast_cast<SampleNode*>(node);
+			ptr<ValueNode> coords = ProcessValue(sampleNode->GetCoordsNode());
+			ptr<ValueNode> offset = ProcessValue(sampleNode->GetOffsetNode());
+			ptr<ValueNode> lod = ProcessValue(sampleNode->GetLodNode());
+			ptr<ValueNode> bias = ProcessValue(sampleNode->GetBiasNode());
+			ptr<ValueNode> gradX = ProcessValue(sampleNode->GetGradXNode());
+			ptr<ValueNode> gradY = ProcessValue(sampleNode->GetGradYNode());
+			if(
+				coords == sampleNode->GetCoordsNode() &&
+				offset == sampleNode->GetOffsetNode() &&
+				lod == sampleNode->GetLodNode() &&
+				bias == sampleNode->GetBiasNode() &&
+				gradX == sampleNode->GetGradXNode() &&
+				gradY == sampleNode->GetGradYNode())
+				return Canonicalize(sampleNode);
+			return Canonicalize(NEW(SampleNode(sampleNode->GetSamplerNode(), coords, offset, lod, bias, gradX, gradY)));
+		}
+	case Node::typeFragment:
+		{
+			FragmentNode* fragmentNode = fast_cast<FragmentNode*>(node);
+			ptr<ValueNode> a = ProcessValue(fragmentNode->GetNode());
+			if(a == fragmentNode->GetNode())
+				return node;
+			return NEW(FragmentNode(fragmentNode->GetTarget(), a));
+		}
+	case Node::typeDualFragment:
+		{
+			DualFragmentNode* dualFragmentNode = fast_cast<DualFragmentNode*>(node);
+			ptr<ValueNode> a = ProcessValue(dualFragmentNode->GetNode0());
+			ptr<ValueNode> b = ProcessValue(dualFragmentNode->GetNode1());
+			if(a == dualFragmentNode->GetNode0() && b == dualFragmentNode->GetNode1())
+				return node;
+			return NEW(DualFragmentNode(a, b));
+		}
+	case Node::typeCast:
+		{
+			CastNode* castNode = fast_cast<CastNode*>(node);
+			ptr<ValueNode> a = ProcessValue(castNode->GetA());
+			if(a == castNode->GetA())
+				return SimplifyCast(castNode);
+			return SimplifyCast(NEW(CastNode(castNode->GetValueType(), a)));
+		}
+	default:
+		THROW("Unknown node type");
+	}
+}
+
+ptr<ValueNode> Optimizer::SimplifyOperation(ptr<OperationNode> node)
+{
+	OperationNode::Operation operation = node->GetOperation();
+	DataType valueType = node->GetValueType();
+	int argumentsCount = node->GetArgumentsCount();
+
+	// constant folding
+	{
+		bool allFloat = argumentsCount > 0, allInt = argumentsCount > 0;
+		for(int i = 0; i < argumentsCount; ++i)
+		{
+			Node::Type type = node->GetArgument(i)->GetType();
+			allFloat = allFloat && type == Node::typeFloatConst;
+			allInt = allInt && type == Node::typeIntConst;
+		}
+
+		if(allFloat && valueType == DataTypes::_float)
+		{
+			float a = fast_cast<FloatConstNode*>(&*node->GetArgument(0))->GetValue();
+			float b = argumentsCount > 1 ? fast_cast<FloatConstNode*>(&*node->GetArgument(1))->GetValue() : 0;
+			float c = argumentsCount > 2 ? fast_cast<FloatConstNode*>(&*node->GetArgument(2))->GetValue() : 0;
+			bool folded = true;
+			float r = 0;
+			switch(operation)
+			{
+			case OperationNode::operationNegate: r = -a; break;
+			case OperationNode::operationAdd: r = a + b; break;
+			case OperationNode::operationSubtract: r = a - b; break;
+			case OperationNode::operationMultiply: r = a * b; break;
+			case OperationNode::operationDivide:
+				folded = b != 0;
+				if(folded) r = a / b;
+				break;
+			case OperationNode::operationLerp: r = a + (b - a) * c; break;
+			case OperationNode::operationPow:
+				folded = a >= 0;
+				if(folded) r = pow(a, b);
+				break;
+			case OperationNode::operationMin: r = std::min(a, b); break;
+			case OperationNode::operationMax: r = std::max(a, b); break;
+			case OperationNode::operationAbs: r = fabs(a); break;
+			case OperationNode::operationSqrt:
+				folded = a >= 0;
+				if(folded) r = sqrt(a);
+				break;
+			case OperationNode::operationSin: r = sin(a); break;
+			case OperationNode::operationCos: r = cos(a); break;
+			case OperationNode::operationAtan2: r = atan2(a, b); break;
+			case OperationNode::operationExp: r = exp(a); break;
+			case OperationNode::operationExp2: r = pow(2.0f, a); break;
+			case OperationNode::operationLog:
+				folded = a > 0;
+				if(folded) r = log(a);
+				break;
+			case OperationNode::operationSaturate: r = std::min(std::max(a, 0.0f), 1.0f); break;
+			case OperationNode::operationDdx:
+			case OperationNode::operationDdy:
+				r = 0;
+				break;
+			case OperationNode::operationFloor: r = floor(a); break;
+			case OperationNode::operationCeil: r = ceil(a); break;
+			default:
+				// mod is not folded, its sign semantics differ between languages
+				folded = false;
+				break;
+			}
+			// inf and nan have no literals in shader languages
+			if(folded && std::isfinite(r))
+			{
+				++stats.foldedCount;
+				return Canonicalize(NEW(FloatConstNode(r)));
+			}
+		}
+
+		if(allInt && valueType == DataTypes::_int)
+		{
+			// computed in 64 bits, results out of int range are not folded
+			long long a = fast_cast<IntConstNode*>(&*node->GetArgument(0))->GetValue();
+			long long b = argumentsCount > 1 ? fast_cast<IntConstNode*>(&*node->GetArgument(1))->GetValue() : 0;
+			bool folded = true;
+			long long r = 0;
+			switch(operation)
+			{
+			case OperationNode::operationNegate: r = -a; break;
+			case OperationNode::operationAdd: r = a + b; break;
+			case OperationNode::operationSubtract: r = a - b; break;
+			case OperationNode::operationMultiply: r = a * b; break;
+			case OperationNode::operationDivide:
+				folded = b != 0;
+				if(folded) r = a / b;
+				break;
+			case OperationNode::operationMin: r = std::min(a, b); break;
+			case OperationNode::operationMax: r = std::max(a, b); break;
+			case OperationNode::operationAbs: r = a < 0 ? -a : a; break;
+			default:
+				folded = false;
+				break;
+			}
+			if(folded && r >= INT_MIN && r <= INT_MAX)
+			{
+				++stats.foldedCount;
+				return Canonicalize(NEW(IntConstNode((int)r)));
+			}
+		}
+	}
+
+	// algebraic simplification
+	// operand can replace the node only if it has the same type
+#define REPLACE_WITH(argument) \
+	if(node->GetArgument(argument)->GetValueType() == valueType) \
+	{ \
+		++stats.simplifiedCount; \
+		return node->GetArgument(argument); \
+	}
+	switch(operation)
+	{
+	case OperationNode::operationNegate:
+		{
+			ValueNode* a = node->GetA();
+			if(a->GetType() == Node::typeOperation && fast_cast<OperationNode*>(a)->GetOperation() == OperationNode::operationNegate)
+			{
+				++stats.simplifiedCount;
+				return fast_cast<OperationNode*>(a)->GetA();
+			}
+		}
+		break;
+	case OperationNode::operationAdd:
+		if(IsConst(node->GetB(), 0)) REPLACE_WITH(0);
+		if(IsConst(node->GetA(), 0)) REPLACE_WITH(1);
+		break;
+	case OperationNode::operationSubtract:
+		if(IsConst(node->GetB(), 0)) REPLACE_WITH(0);
+		break;
+	case OperationNode::operationMultiply:
+		if(IsConst(node->GetB(), 1)) REPLACE_WITH(0);
+		if(IsConst(node->GetA(), 1)) REPLACE_WITH(1);
+		break;
+	case OperationNode::operationDivide:
+		if(IsConst(node->GetB(), 1)) REPLACE_WITH(0);
+		break;
+	default:
+		break;
+	}
+#undef REPLACE_WITH
+
+	return Canonicalize(node);
+}
+
+ptr<ValueNode> Optimizer::SimplifySwizzle(ptr<SwizzleNode> node)
+{
+	ptr<ValueNode> a = node->GetA();
+	const char* map = node->GetMap();
+	int length = (int)strlen(map);
+
+	// swizzle of swizzle
+	if(a->GetType() == Node::typeSwizzle)
+	{
+		SwizzleNode* inner = fast_cast<SwizzleNode*>(&*a);
+		const char* innerMap = inner->GetMap();
+		char newMap[5];
+		for(int i = 0; i < length; ++i)
+			newMap[i] = innerMap[SwizzleComponent(map[i])];
+		newMap[length] = 0;
+		++stats.simplifiedCount;
+		return SimplifySwizzle(NEW(SwizzleNode(inner->GetA(), GetStaticSwizzleMap(newMap))));
+	}
+
+	DataType aValueType = a->GetValueType();
+
+	// identity swizzle
+	if(node->GetValueType() == aValueType && strncmp(map, "xyzw", length) == 0)
+	{
+		++stats.simplifiedCount;
+		return a;
+	}
+
+	// component of vector constructor
+	if(length == 1 && a->GetType() == Node::typeOperation)
+	{
+		OperationNode* constructor = fast_cast<OperationNode*>(&*a);
+		int component = SwizzleComponent(map[0]);
+		int argument = -1;
+		switch(constructor->GetOperation())
+		{
+		case OperationNode::operationFloat11to2:
+		case OperationNode::operationFloat111to3:
+		case OperationNode::operationFloat1111to4:
+		case OperationNode::operationInt11to2:
+			argument = component;
+			break;
+		case OperationNode::operationFloat31to4:
+			if(component == 3) argument = 1;
+			break;
+		case OperationNode::operationFloat211to4:
+			if(component >= 2) argument = component - 1;
+			break;
+		default:
+			break;
+		}
+		if(argument >= 0 && argument < constructor->GetArgumentsCount())
+		{
+			ptr<ValueNode> argumentNode = constructor->GetArgument(argument);
+			if(argumentNode->GetValueType() == node->GetValueType())
+			{
+				++stats.simplifiedCount;
+				return argumentNode;
+			}
+		}
+	}
+
+	return Canonicalize(node);
+}
+
+ptr<ValueNode> Optimizer::SimplifyCast(ptr<CastNode> node)
+{
+	ptr<ValueNode> a = node->GetA();
+	DataType valueType = node->GetValueType();
+
+	// no-op cast
+	if(a->GetValueType() == valueType)
+	{
+		++stats.simplifiedCount;
+		return a;
+	}
+
+	// cast of constant
+	if(a->GetType() == Node::typeIntConst && valueType == DataTypes::_float)
+	{
+		++stats.foldedCount;
+		return Canonicalize(NEW(FloatConstNode((float)fast_cast<IntConstNode*>(&*a)->GetValue())));
+	}
+	if(a->GetType() == Node::typeFloatConst && valueType == DataTypes::_int)
+	{
+		// conversion of value out of int range is undefined
+		float value = fast_cast<FloatConstNode*>(&*a)->GetValue();
+		if(value > -2147483648.0f && value < 2147483648.0f)
+		{
+			++stats.foldedCount;
+			return Canonicalize(NEW(IntConstNode((int)value)));
+		}
+	}
+
+	return Canonicalize(node);
+}
+
+ptr<ValueNode> Optimizer::Canonicalize(ptr<ValueNode> node)
+{
+	Node::Type type = node->GetType();
+	Key key(type, 0, node->GetValueType(), 0);
+	switch(type)
+	{
+	case Node::typeFloatConst:
+		key.data = FloatBits(fast_cast<FloatConstNode*>(&*node)->GetValue());
+		break;
+	case Node::typeIntConst:
+		key.data = fast_cast<IntConstNode*>(&*node)->GetValue();
+		break;
+	case Node::typeAttribute:
+		key.data = fast_cast<AttributeNode*>(&*node)->GetElementIndex();
+		break;
+	case Node::typeReadUniform:
+		key.children[0] = &*fast_cast<ReadUniformNode*>(&*node)->GetUniformNode();
+		break;
+	case Node::typeIndexUniformArray:
+		{
+			IndexUniformArrayNode* indexNode = fast_cast<IndexUniformArrayNode*>(&*node);
+			key.children[0] = &*indexNode->GetUniformNode();
+			key.children[1] = &*indexNode->GetIndexNode();
+		}
+		break;
+	case Node::typeTransformed:
+		key.data = fast_cast<TransformedNode*>(&*node)->GetSemantic();
+		break;
+	case Node::typeSwizzle:
+		{
+			SwizzleNode* swizzleNode = fast_cast<SwizzleNode*>(&*node);
+			key.children[0] = &*swizzleNode->GetA();
+			// maps are always static here
+			key.children[1] = swizzleNode->GetMap();
+		}
+		break;
+	case Node::typeOperation:
+		{
+			OperationNode* operationNode = fast_cast<OperationNode*>(&*node);
+			key.param = (int)operationNode->GetOperation();
+			int argumentsCount = operationNode->GetArgumentsCount();
+			key.data = argumentsCount;
+			for(int i = 0; i < argumentsCount; ++i)
+				key.children[i] = &*operationNode->GetArgument(i);
+		}
+		break;
+	case Node::typeSample:
+		{
+			SampleNode* sampleNode = fast_cast<SampleNode*>(&*node);
+			key.children[0] = &*sampleNode->GetSamplerNode();
+			key.children[1] = &*sampleNode->GetCoordsNode();
+			key.children[2] = &*sampleNode->GetOffsetNode();
+			key.children[3] = &*sampleNode->GetLodNode();
+			key.children[4] = &*sampleNode->GetBiasNode();
+			key.children[5] = &*sampleNode->GetGradXNode();
+			key.children[6] = &*sampleNode->GetGradYNode();
+		}
+		break;
+	case Node::typeCast:
+		key.children[0] = &*fast_cast<CastNode*>(&*node)->GetA();
+		break;
+	default:
+		return node;
+	}
+
+	std::pair<std::unordered_map<Key, ptr<ValueNode>, KeyHash>::iterator, bool> result =
+		canonicalNodes.insert(std::make_pair(key, node));
+	if(!result.second)
+		++stats.mergedCount;
+	return result.first->second;
+}
+
+int Optimizer::CountInstructions(Node* rootNode)
+{
+	std::unordered_set<Node*> visited;
+	std::vector<Node*> stack;
+	int count = 0;
+	if(rootNode)
+		stack.push_back(rootNode);
+	while(!stack.empty())
+	{
+		Node* node = stack.back();
+		stack.pop_back();
+		if(!node || !visited.insert(node).second)
+			continue;
+
+		switch(node->GetType())
+		{
+		case Node::typeUniform:
+		case Node::typeSampler:
+			break;
+		case Node::typeSequence:
+			{
+				SequenceNode* sequenceNode = fast_cast<SequenceNode*>(node);
+				stack.push_back(sequenceNode->GetA());
+				stack.push_back(sequenceNode->GetB());
+			}
+			break;
+		case Node::typeReadUniform:
+			++count;
+			break;
+		case Node::typeIndexUniformArray:
+			++count;
+			stack.push_back(fast_cast<IndexUniformArrayNode*>(node)->GetIndexNode());
+			break;
+		case Node::typeInterpolate:
+			++count;
+			stack.push_back(fast_cast<InterpolateNode*>(node)->GetNode());
+			break;
+		case Node::typeSwizzle:
+			++count;
+			stack.push_back(fast_cast<SwizzleNode*>(node)->GetA());
+			break;
+		case Node::typeOperation:
+			{
+				++count;
+				OperationNode* operationNode = fast_cast<OperationNode*>(node);
+				for(int i = 0; i < operationNode->GetArgumentsCount(); ++i)
+					stack.push_back(operationNode->GetArgument(i));
+			}
+			break;
+		case Node::typeAction:
+			{
+				++count;
+				ActionNode* actionNode = fast_cast<ActionNode*>(node);
+				for(int i = 0; i < actionNode->GetArgumentsCount(); ++i)
+					stack.push_back(actionNode->GetArgument(i));
+			}
+			break;
+		case Node::typeSample:
+			{
+				++count;
+				SampleNode* sampleNode = fast_cast<SampleNode*>(node);
+				stack.push_back(sampleNode->GetCoordsNode());
+				stack.push_back(sampleNode->GetOffsetNode());
+				stack.push_back(sampleNode->GetLodNode());
+				stack.push_back(sampleNode->GetBiasNode());
+				stack.push_back(sampleNode->GetGradXNode());
+				stack.push_back(sampleNode->GetGradYNode());
+			}
+			break;
+		case Node::typeFragment:
+			++count;
+			stack.push_back(fast_cast<FragmentNode*>(node)->GetNode());
+			break;
+		case Node::typeDualFragment:
+			{
+				++count;
+				DualFragmentNode* dualFragmentNode = fast_cast<DualFragmentNode*>(node);
+				stack.push_back(dualFragmentNode->GetNode0());
+				stack.push_back(dualFragmentNode->GetNode1());
+			}
+			break;
+		case Node::typeCast:
+			++count;
+			stack.push_back(fast_cast<CastNode*>(node)->GetA());
+			break;
+		default:
+			// constants, attributes, transformed nodes
+			++count;
+			break;
+		}
+	}
+	return count;
+}
+
+namespace
+{
+	void CollectTransformedSemantics(Node* node, std::unordered_set<Node*>& visited, std::unordered_set<int>& semantics)
+	{
+		if(!node || !visited.insert(node).second)
+			return;
+
+		switch(node->GetType())
+		{
+		case Node::typeTransformed:
+			semantics.insert(fast_cast<TransformedNode*>(node)->GetSemantic());
+			break;
+		case Node::typeIndexUniformArray:
+			CollectTransformedSemantics(fast_cast<IndexUniformArrayNode*>(node)->GetIndexNode(), visited, semantics);
+			break;
+		case Node::typeSequence:
+			CollectTransformedSemantics(fast_cast<SequenceNode*>(node)->GetA(), visited, semantics);
+			CollectTransformedSemantics(fast_cast<SequenceNode*>(node)->GetB(), visited, semantics);
+			break;
+		case Node::typeSwizzle:
+			CollectTransformedSemantics(fast_cast<SwizzleNode*>(node)->GetA(), visited, semantics);
+			break;
+		case Node::typeOperation:
+			{
+				OperationNode* operationNode = fast_cast<OperationNode*>(node);
+				for(int i = 0; i < operationNode->GetArgumentsCount(); ++i)
+					CollectTransformedSemantics(operationNode->GetArgument(i), visited, semantics);
+			}
+			break;
+		case Node::typeAction:
+			{
+				ActionNode* actionNode = fast_cast<ActionNode*>(node);
+				for(int i = 0; i < actionNode->GetArgumentsCount(); ++i)
+					CollectTransformedSemantics(actionNode->GetArgument(i), visited, semantics);
+			}
+			break;
+		case Node::typeSample:
+			{
+				SampleNode* sampleNode = fast_cast<SampleNode*>(node);
+				CollectTransformedSemantics(sampleNode->GetCoordsNode(), visited, semantics);
+				CollectTransformedSemantics(sampleNode->GetOffsetNode(), visited, semantics);
+				CollectTransformedSemantics(sampleNode->GetLodNode(), visited, semantics);
+				CollectTransformedSemantics(sampleNode->GetBiasNode(), visited, semantics);
+				CollectTransformedSemantics(sampleNode->GetGradXNode(), visited, semantics);
+				CollectTransformedSemantics(sampleNode->GetGradYNode(), visited, semantics);
+			}
+			break;
+		case Node::typeFragment:
+			CollectTransformedSemantics(fast_cast<FragmentNode*>(node)->GetNode(), visited, semantics);
+			break;
+		case Node::typeDualFragment:
+			CollectTransformedSemantics(fast_cast<DualFragmentNode*>(node)->GetNode0(), visited, semantics);
+			CollectTransformedSemantics(fast_cast<DualFragmentNode*>(node)->GetNode1(), visited, semantics);
+			break;
+		case Node::typeCast:
+			CollectTransformedSemantics(fast_cast<CastNode*>(node)->GetA(), visited, semantics);
+			break;
+		default:
+			break;
+		}
+	}
+
+	/// Remove unused interpolate nodes from sequences.
+	/** Returns null if the whole node is removed. */
+	ptr<Node> PruneInterpolateNodes(Node* node, const std::unordered_set<int>& semantics)
+	{
+		switch(node->GetType())
+		{
+		case Node::typeInterpolate:
+			if(semantics.find(fast_cast<InterpolateNode*>(node)->GetSemantic()) == semantics.end())
+				return nullptr;
+			return node;
+		case Node::typeSequence:
+			{
+				SequenceNode* sequenceNode = fast_cast<SequenceNode*>(node);
+				ptr<Node> a = PruneInterpolateNodes(sequenceNode->GetA(), semantics);
+				ptr<Node> b = PruneInterpolateNodes(sequenceNode->GetB(), semantics);
+				if(!a) return b;
+				if(!b) return a;
+				if(a == sequenceNode->GetA() && b == sequenceNode->GetB())
+					return node;
+				return NEW(SequenceNode(a, b));
+			}
+		default:
+			return node;
+		}
+	}
+}
+
+Expression Optimizer::PruneInterpolants(Expression vertexCode, Expression pixelCode)
+{
+	std::unordered_set<Node*> visited;
+	std::unordered_set<int> semantics;
+	CollectTransformedSemantics(pixelCode.GetNode(), visited, semantics);
+
+	ptr<Node> vertexNode = vertexCode.GetNode();
+	if(!vertexNode)
+		return vertexCode;
+	return PruneInterpolateNodes(vertexNode, semantics);
+}
+
+END_INANITY_SHADERS
@@ -0,0 +1,107 @@
+#ifndef ___INANITY_GRAPHICS_SHADERS_OPTIMIZER_HPP___
+#define ___INANITY_GRAPHICS_SHADERS_OPTIMIZER_HPP___
+
+#include "Expression.hpp"
+#include "ValueNode.hpp"
+#include "../DataType.hpp"
+#include <unordered_map>
+#include <unordered_set>
+
+BEGIN_INANITY_SHADERS
+
+class OperationNode;
+class SwizzleNode;
+class CastNode;
+
+/// Optimizer of shader node graph.
+/** Runs before code generation. Performs:
+* constant folding of scalar operations on float and int constants;
+* algebraic simplification (x + 0, x * 1, -(-x) and so on);
+* swizzle simplification (identity swizzles, swizzles of swizzles,
+  swizzles of vector constructors) and removing no-op casts;
+* common subexpression elimination by structural hashing
+  of value nodes, so equal expressions are computed once.
+Source graph is not modified; new nodes are created where needed,
+unchanged subgraphs are reused as is. */
+class Optimizer
+{
+public:
+	/// Optimization statistics.
+	struct Stats
+	{
+		/// Number of operations folded into constants.
+		int foldedCount;
+		/// Number of nodes removed by simplification.
+		int simplifiedCount;
+		/// Number of nodes merged by common subexpression elimination.
+		int mergedCount;
+
+		Stats();
+	};
+
+private:
+	/// Structural key of value node.
+	struct Key
+	{
+		static const int maxChildrenCount = 7;
+
+		int type;
+		int param;
+		int valueType;
+		/// Raw scalar data (constant value, semantic, etc).
+		int data;
+		/// Canonical children nodes (or other identity pointers).
+		const void* children[maxChildrenCount];
+
+		Key(int type, int param, DataType valueType, int data);
+
+		bool operator==(const Key& b) const;
+	};
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const;
+	};
+
+	/// Already processed nodes: source node -> optimized node.
+	std::unordered_map<Node*, ptr<Node> > processedNodes;
+	/// Canonical nodes by structural key.
+	std::unordered_map<Key, ptr<ValueNode>, KeyHash> canonicalNodes;
+
+	Stats stats;
+
+	ptr<Node> Process(Node* node);
+	ptr<ValueNode> ProcessValue(ValueNode* node);
+	ptr<Node> ProcessNode(Node* node);
+
+	ptr<ValueNode> SimplifyOperation(ptr<OperationNode> node);
+	ptr<ValueNode> SimplifySwizzle(ptr<SwizzleNode> node);
+	ptr<ValueNode> SimplifyCast(ptr<CastNode> node);
+
+	/// Return canonical node equal to the given one.
+	ptr<ValueNode> Canonicalize(ptr<ValueNode> node);
+
+public:
+	/// Get swizzle map string in static memory.
+	/** Map is a string of 1..4 symbols x, y, z, w. */
+	static const char* GetStaticSwizzleMap(const char* map);
+
+	/// Optimize graph.
+	ptr<Node> Optimize(ptr<Node> rootNode);
+	Expression Optimize(Expression code);
+
+	const Stats& GetStats() const;
+
+	/// Count nodes producing instructions in generated code.
+	/** Declaration-only nodes (uniforms, samplers) and sequences are not counted. */
+	static int CountInstructions(Node* rootNode);
+
+	/// Remove outputs of vertex shader which are not used by pixel shader.
+	/** Vertex shader's InterpolateNodes with semantics not read by pixel
+	shader's TransformedNodes are removed from sequences, so attributes
+	and computations needed only by them are not generated too. */
+	static Expression PruneInterpolants(Expression vertexCode, Expression pixelCode);
+};
+
+END_INANITY_SHADERS
+
+#endif
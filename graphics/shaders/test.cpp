@@ -0,0 +1,179 @@
+#include "../../inanity-base.hpp"
+#include "../../inanity-graphics.hpp"
+#include "../../inanity-shaders.hpp"
+#include "../GlslSource.hpp"
+#ifdef ___INANITY_PLATFORM_WINDOWS
+#include "../Hlsl11Source.hpp"
+#endif
+#include <iostream>
+#include <climits>
+
+using namespace Inanity;
+using namespace Inanity::Graphics;
+using namespace Inanity::Graphics::Shaders;
+
+/* Test for shader graph optimizer.
+Builds shaders with redundant computations, generates GLSL code
+(and HLSL code on Windows) with and without optimization and
+compares them. */
+
+struct Vertex
+{
+	vec3 position;
+	vec3 normal;
+	vec2 texcoord;
+};
+
+static int failures = 0;
+
+static void Check(bool condition, const char* message)
+{
+	std::cout << (condition ? "OK: " : "FAILED: ") << message << "\n";
+	if(!condition)
+		++failures;
+}
+
+static String GenerateGlsl(Expression code, ShaderType shaderType, bool optimize)
+{
+	ptr<ShaderSource> source;
+	if(optimize)
+	{
+		ptr<ShaderGenerator> generator = NEW(GlslGenerator(GlslVersions::opengl33, true));
+		source = generator->Generate(code, shaderType);
+	}
+	else
+		source = GlslGeneratorInstance(code.GetNode(), shaderType, GlslVersions::opengl33, true).Generate();
+	return Strings::File2String(fast_cast<GlslSource*>(&*source)->GetCode());
+}
+
+#ifdef ___INANITY_PLATFORM_WINDOWS
+static String GenerateHlsl(Expression code, ShaderType shaderType, bool optimize)
+{
+	ptr<ShaderSource> source;
+	if(optimize)
+	{
+		ptr<ShaderGenerator> generator = NEW(Hlsl11Generator());
+		source = generator->Generate(code, shaderType);
+	}
+	else
+		source = Hlsl11GeneratorInstance(code.GetNode(), shaderType).Generate();
+	return Strings::File2String(fast_cast<Hlsl11Source*>(&*source)->GetCode());
+}
+#endif
+
+static void Compare(const char* name, Expression code, ShaderType shaderType)
+{
+	Optimizer optimizer;
+	Expression optimized = optimizer.Optimize(code);
+	int countBefore = Optimizer::CountInstructions(code.GetNode());
+	int countAfter = Optimizer::CountInstructions(optimized.GetNode());
+	const Optimizer::Stats& stats = optimizer.GetStats();
+
+	std::cout << "===== " << name << " =====\n";
+	std::cout << "----- original -----\n" << GenerateGlsl(code, shaderType, false);
+	std::cout << "----- optimized -----\n" << GenerateGlsl(code, shaderType, true);
+	std::cout << "instructions: " << countBefore << " -> " << countAfter
+		<< " (folded " << stats.foldedCount
+		<< ", simplified " << stats.simplifiedCount
+		<< ", merged " << stats.mergedCount << ")\n";
+
+	Check(countAfter < countBefore, name);
+
+#ifdef ___INANITY_PLATFORM_WINDOWS
+	String hlsl = GenerateHlsl(code, shaderType, false);
+	String optimizedHlsl = GenerateHlsl(code, shaderType, true);
+	std::cout << "----- original HLSL -----\n" << hlsl;
+	std::cout << "----- optimized HLSL -----\n" << optimizedHlsl;
+	Check(optimizedHlsl.length() < hlsl.length(), (String(name) + " HLSL").c_str());
+#endif
+}
+
+/// Check that value is not folded into constant without literal.
+static void CheckNotFolded(const char* name, Value<float> value)
+{
+	Expression code = fragment(0, newvec4(value, value, value, value));
+	Optimizer optimizer;
+	optimizer.Optimize(code);
+	String glsl = GenerateGlsl(code, ShaderTypes::pixel, true);
+	std::cout << "===== " << name << " =====\n" << glsl;
+	Check(optimizer.GetStats().foldedCount == 0
+		&& glsl.find("inf") == String::npos && glsl.find("nan") == String::npos, name);
+}
+
+int main()
+{
+	try
+	{
+		ptr<VertexLayout> vl = NEW(VertexLayout(sizeof(Vertex)));
+		ptr<AttributeLayout> al = NEW(AttributeLayout());
+		ptr<AttributeLayoutSlot> als = al->AddSlot();
+		Value<vec3> aPosition = al->AddElement(als, vl->AddElement(&Vertex::position));
+		Value<vec3> aNormal = al->AddElement(als, vl->AddElement(&Vertex::normal));
+		Value<vec2> aTexcoord = al->AddElement(als, vl->AddElement(&Vertex::texcoord));
+
+		ptr<UniformGroup> ug = NEW(UniformGroup(0));
+		Uniform<mat4x4> uViewProj = ug->AddUniform<mat4x4>();
+		Uniform<vec3> uLightDirection = ug->AddUniform<vec3>();
+
+		Interpolant<vec3> iNormal(0);
+		Interpolant<vec2> iTexcoord(1);
+		Interpolant<float> iUnused(2);
+
+		// constant folding and CSE
+		{
+			Value<float> scale = Value<float>(2.0f) * Value<float>(0.5f) + Value<float>(0.0f);
+			Expression code = (
+				setPosition(mul(newvec4(aPosition * scale, 1.0f), uViewProj)),
+				iNormal.Set(normalize(aNormal) * newvec3(1.0f, 1.0f, 1.0f)["x"]),
+				iTexcoord.Set(aTexcoord["xy"]["yx"]["yx"]),
+				iUnused.Set(dot(normalize(aNormal), uLightDirection))
+			);
+			Compare("vertex", code, ShaderTypes::vertex);
+		}
+
+		// repeated subexpressions in pixel shader
+		{
+			Value<float> light = max(dot(normalize(iNormal), uLightDirection), Value<float>(0.0f));
+			Value<float> sameLight = max(dot(normalize(iNormal), uLightDirection), Value<float>(0.0f));
+			Expression code = (
+				fragment(0, newvec4(newvec3(light, sameLight, iTexcoord["x"]), -(-Value<float>(1.0f))))
+			);
+			Compare("pixel", code, ShaderTypes::pixel);
+		}
+
+		// folding which would overflow
+		CheckNotFolded("exp overflow", exp(Value<float>(100.0f)));
+		CheckNotFolded("multiply overflow", Value<float>(1e38f) * Value<float>(10.0f));
+		CheckNotFolded("int add overflow", (Value<int>(INT_MAX) + Value<int>(1)).Cast<float>());
+		CheckNotFolded("int multiply overflow", (Value<int>(65536) * Value<int>(65536)).Cast<float>());
+		CheckNotFolded("int negate overflow", (-Value<int>(INT_MIN)).Cast<float>());
+		CheckNotFolded("int divide overflow", (Value<int>(INT_MIN) / Value<int>(-1)).Cast<float>());
+		CheckNotFolded("cast out of range", Value<float>(1e10f).Cast<int>().Cast<float>());
+
+		// pruning of interpolants
+		{
+			Expression vertexCode = (
+				setPosition(newvec4(aPosition, 1.0f)),
+				iNormal.Set(aNormal),
+				iUnused.Set(length(aNormal))
+			);
+			Expression pixelCode = (
+				fragment(0, newvec4(iNormal, 1.0f))
+			);
+			Expression prunedCode = Optimizer::PruneInterpolants(vertexCode, pixelCode);
+			String pruned = GenerateGlsl(prunedCode, ShaderTypes::vertex, true);
+			std::cout << "===== pruned vertex =====\n" << pruned;
+			Check(pruned.find("v2") == String::npos, "unused interpolant removed");
+			Check(pruned.find("v0") != String::npos, "used interpolant kept");
+		}
+	}
+	catch(Exception* exception)
+	{
+		MakePointer(exception)->PrintStack(std::cout);
+		std::cout << "\n";
+		return 1;
+	}
+
+	std::cout << (failures ? "SOME TESTS FAILED\n" : "ALL TESTS PASSED\n");
+	return failures ? 1 : 0;
+}
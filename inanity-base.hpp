@@ -11,6 +11,7 @@
 #include "File.hpp"
 #include "FileInputStream.hpp"
 #include "FileSystem.hpp"
+#include "FixedStepTicker.hpp"
 #include "Handler.hpp"
 #include "ManagedHeap.hpp"
 #include "MemoryFile.hpp"
@@ -23,6 +24,7 @@
 #include "PoolObject.hpp"
 #include "Profiling.hpp"
 #include "ResourceManager.ipp"
+#include "SampledProfile.hpp"
 #include "Semaphore.hpp"
 #include "StreamReader.hpp"
 #include "StreamWriter.hpp"
@@ -30,8 +32,10 @@
 #include "StringTraveler.hpp"
 #include "Strings.hpp"
 #include "Thread.hpp"
+#include "ThreadPool.hpp"
 #include "Ticker.hpp"
 #include "Time.hpp"
+#include "TimeHistogram.hpp"
 #include "TypedPool.hpp"
 
 #endif
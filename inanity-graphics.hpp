@@ -14,6 +14,7 @@
 #include "graphics/AttributeLayoutSlot.hpp"
 #include "graphics/BlendState.hpp"
 #include "graphics/BmpImage.hpp"
+#include "graphics/CommandList.hpp"
 #include "graphics/Context.hpp"
 #include "graphics/DataType.hpp"
 #include "graphics/DepthStencilBuffer.hpp"
@@ -2,7 +2,9 @@
 #define ___INANITY_INANITY_LUA_HPP___
 
 #include "script/lua/Function.hpp"
+#include "script/lua/Profiler.hpp"
 #include "script/lua/State.hpp"
+#include "script/lua/StatePool.hpp"
 #include "script/lua/stuff.hpp"
 #include "script/lua/thunks.ipp"
 #include "script/lua/userdata.hpp"
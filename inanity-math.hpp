@@ -3,6 +3,7 @@
 
 #include "math/basic.hpp"
 #include "math/geometry.hpp"
+#include "math/batch.hpp"
 #include "math/eigen.hpp"
 
 #endif
@@ -4,5 +4,6 @@
 #include "script/Any.hpp"
 #include "script/Function.hpp"
 #include "script/State.hpp"
+#include "script/CodeCache.hpp"
 
 #endif
@@ -22,6 +22,7 @@
 #include "graphics/shaders/InterpolateNode.hpp"
 #include "graphics/shaders/Node.hpp"
 #include "graphics/shaders/OperationNode.hpp"
+#include "graphics/shaders/Optimizer.hpp"
 #include "graphics/shaders/SampleNode.hpp"
 #include "graphics/shaders/SamplerNode.hpp"
 #include "graphics/shaders/Sampler.ipp"
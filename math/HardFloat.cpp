@@ -129,34 +129,37 @@ HardFloat& HardFloat::operator/=(HardFloat b)
 	return *this;
 }
 
+// comparisons use cmpss instead of comiss, because compilers differ
+// in results of comiss intrinsics for NaNs; cmpss follows IEEE 754
+
 bool operator==(HardFloat a, HardFloat b) CHECKED_IMPL_BEGIN_OP2_BOOL(a, b, ==)
 {
-	return !!_mm_comieq_ss(_mm_load_ss(&a.f), _mm_load_ss(&b.f));
+	return (_mm_movemask_ps(_mm_cmpeq_ss(_mm_load_ss(&a.f), _mm_load_ss(&b.f))) & 1) != 0;
 } CHECKED_IMPL_END_OP0()
 
 bool operator!=(HardFloat a, HardFloat b) CHECKED_IMPL_BEGIN_OP2_BOOL(a, b, !=)
 {
-	return !!_mm_comineq_ss(_mm_load_ss(&a.f), _mm_load_ss(&b.f));
+	return (_mm_movemask_ps(_mm_cmpneq_ss(_mm_load_ss(&a.f), _mm_load_ss(&b.f))) & 1) != 0;
 } CHECKED_IMPL_END_OP0()
 
 bool operator<(HardFloat a, HardFloat b) CHECKED_IMPL_BEGIN_OP2_BOOL(a, b, <)
 {
-	return !!_mm_comilt_ss(_mm_load_ss(&a.f), _mm_load_ss(&b.f));
+	return (_mm_movemask_ps(_mm_cmplt_ss(_mm_load_ss(&a.f), _mm_load_ss(&b.f))) & 1) != 0;
 } CHECKED_IMPL_END_OP0()
 
 bool operator<=(HardFloat a, HardFloat b) CHECKED_IMPL_BEGIN_OP2_BOOL(a, b, <=)
 {
-	return !!_mm_comile_ss(_mm_load_ss(&a.f), _mm_load_ss(&b.f));
+	return (_mm_movemask_ps(_mm_cmple_ss(_mm_load_ss(&a.f), _mm_load_ss(&b.f))) & 1) != 0;
 } CHECKED_IMPL_END_OP0()
 
 bool operator>(HardFloat a, HardFloat b) CHECKED_IMPL_BEGIN_OP2_BOOL(a, b, >)
 {
-	return !!_mm_comigt_ss(_mm_load_ss(&a.f), _mm_load_ss(&b.f));
+	return (_mm_movemask_ps(_mm_cmpgt_ss(_mm_load_ss(&a.f), _mm_load_ss(&b.f))) & 1) != 0;
 } CHECKED_IMPL_END_OP0()
 
 bool operator>=(HardFloat a, HardFloat b) CHECKED_IMPL_BEGIN_OP2_BOOL(a, b, >=)
 {
-	return !!_mm_comige_ss(_mm_load_ss(&a.f), _mm_load_ss(&b.f));
+	return (_mm_movemask_ps(_mm_cmpge_ss(_mm_load_ss(&a.f), _mm_load_ss(&b.f))) & 1) != 0;
 } CHECKED_IMPL_END_OP0()
 
 HardFloat abs(HardFloat a) CHECKED_IMPL_BEGIN(a, abs)
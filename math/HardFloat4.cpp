@@ -0,0 +1,458 @@
+#include "HardFloat4.hpp"
+
+/* All functions here repeat algorithms of HardFloat's functions
+lane by lane, with branches replaced by selects, so results
+are bit-exact the same. Order of floating point operations
+must be kept exactly as in HardFloat.cpp. */
+
+BEGIN_INANITY_MATH
+
+static const __m128
+	zero = _mm_setzero_ps(),
+	one = _mm_set1_ps(1.0f),
+	signMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000)),
+	absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF)),
+	pi = _mm_castsi128_ps(_mm_set1_epi32(0x40490fdb)),
+	pi_2 = _mm_castsi128_ps(_mm_set1_epi32(0x3fc90fdb));
+
+static inline __m128 select(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+/// Negate lanes where mask is set.
+static inline __m128 negate(__m128 mask, __m128 a)
+{
+	return _mm_xor_ps(a, _mm_and_ps(mask, signMask));
+}
+
+HardFloat4::HardFloat4() : v(_mm_setzero_ps()) {}
+
+HardFloat4::HardFloat4(HardFloat a) : v(_mm_set1_ps((float)a)) {}
+
+HardFloat4::HardFloat4(HardFloat x, HardFloat y, HardFloat z, HardFloat w)
+: v(_mm_setr_ps((float)x, (float)y, (float)z, (float)w)) {}
+
+HardFloat4::HardFloat4(__m128 v) : v(v) {}
+
+HardFloat4 HardFloat4::load(const HardFloat* p)
+{
+	return HardFloat4(_mm_loadu_ps((const float*)p));
+}
+
+void HardFloat4::store(HardFloat* p) const
+{
+	_mm_storeu_ps((float*)p, v);
+}
+
+HardFloat HardFloat4::operator[](int i) const
+{
+	float t[4];
+	_mm_storeu_ps(t, v);
+	return HardFloat(t[i]);
+}
+
+__m128 HardFloat4::get() const
+{
+	return v;
+}
+
+HardFloat4 HardFloat4::operator-() const
+{
+	return HardFloat4(_mm_xor_ps(v, signMask));
+}
+
+HardFloat4 operator+(HardFloat4 a, HardFloat4 b)
+{
+	return HardFloat4(_mm_add_ps(a.v, b.v));
+}
+
+HardFloat4 operator-(HardFloat4 a, HardFloat4 b)
+{
+	return HardFloat4(_mm_sub_ps(a.v, b.v));
+}
+
+HardFloat4 operator*(HardFloat4 a, HardFloat4 b)
+{
+	return HardFloat4(_mm_mul_ps(a.v, b.v));
+}
+
+HardFloat4 operator/(HardFloat4 a, HardFloat4 b)
+{
+	return HardFloat4(_mm_div_ps(a.v, b.v));
+}
+
+HardFloat4 fmod(HardFloat4 a, HardFloat4 b)
+{
+	return HardFloat4(_mm_sub_ps(a.v, _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_div_ps(a.v, b.v))), b.v)));
+}
+
+HardFloat4& HardFloat4::operator+=(HardFloat4 b)
+{
+	v = _mm_add_ps(v, b.v);
+	return *this;
+}
+
+HardFloat4& HardFloat4::operator-=(HardFloat4 b)
+{
+	v = _mm_sub_ps(v, b.v);
+	return *this;
+}
+
+HardFloat4& HardFloat4::operator*=(HardFloat4 b)
+{
+	v = _mm_mul_ps(v, b.v);
+	return *this;
+}
+
+HardFloat4& HardFloat4::operator/=(HardFloat4 b)
+{
+	v = _mm_div_ps(v, b.v);
+	return *this;
+}
+
+HardFloat4 operator==(HardFloat4 a, HardFloat4 b)
+{
+	return HardFloat4(_mm_cmpeq_ps(a.v, b.v));
+}
+
+HardFloat4 operator!=(HardFloat4 a, HardFloat4 b)
+{
+	return HardFloat4(_mm_cmpneq_ps(a.v, b.v));
+}
+
+HardFloat4 operator<(HardFloat4 a, HardFloat4 b)
+{
+	return HardFloat4(_mm_cmplt_ps(a.v, b.v));
+}
+
+HardFloat4 operator<=(HardFloat4 a, HardFloat4 b)
+{
+	return HardFloat4(_mm_cmple_ps(a.v, b.v));
+}
+
+HardFloat4 operator>(HardFloat4 a, HardFloat4 b)
+{
+	return HardFloat4(_mm_cmpgt_ps(a.v, b.v));
+}
+
+HardFloat4 operator>=(HardFloat4 a, HardFloat4 b)
+{
+	return HardFloat4(_mm_cmpge_ps(a.v, b.v));
+}
+
+HardFloat4 select(HardFloat4 mask, HardFloat4 a, HardFloat4 b)
+{
+	return HardFloat4(select(mask.v, a.v, b.v));
+}
+
+bool any(HardFloat4 mask)
+{
+	return _mm_movemask_ps(mask.v) != 0;
+}
+
+bool all(HardFloat4 mask)
+{
+	return _mm_movemask_ps(mask.v) == 0xF;
+}
+
+HardFloat4 abs(HardFloat4 a)
+{
+	return HardFloat4(_mm_and_ps(a.v, absMask));
+}
+
+HardFloat4 floor(HardFloat4 a)
+{
+	__m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+	return HardFloat4(_mm_sub_ps(t, _mm_and_ps(_mm_cmplt_ps(a.v, t), one)));
+}
+
+HardFloat4 ceil(HardFloat4 a)
+{
+	__m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+	return HardFloat4(_mm_add_ps(t, _mm_and_ps(_mm_cmpgt_ps(a.v, t), one)));
+}
+
+HardFloat4 trunc(HardFloat4 a)
+{
+	return HardFloat4(_mm_cvtepi32_ps(_mm_cvttps_epi32(a.v)));
+}
+
+HardFloat4 sqrt(HardFloat4 a)
+{
+	return HardFloat4(_mm_sqrt_ps(a.v));
+}
+
+HardFloat4 sin(HardFloat4 a)
+{
+	// handle negative values
+	__m128 negative = _mm_cmplt_ps(a.v, zero);
+	__m128 x = negate(negative, a.v);
+
+	// reduce to range [0, pi]
+	__m128 reduce = _mm_cmpgt_ps(x, pi);
+	__m128i n = _mm_cvttps_epi32(_mm_div_ps(x, pi));
+	x = select(reduce, _mm_sub_ps(x, _mm_mul_ps(_mm_cvtepi32_ps(n), pi)), x);
+	__m128 odd = _mm_and_ps(reduce, _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(n, _mm_set1_epi32(1)), _mm_set1_epi32(1))));
+	// reduce to range [0, pi/2]
+	x = select(_mm_cmpgt_ps(x, pi_2), _mm_sub_ps(pi, x), x);
+
+	static const __m128
+		k1 = _mm_castsi128_ps(_mm_set1_epi32(0x3f7ff052)), //  0.99976073735983227f
+		k3 = _mm_castsi128_ps(_mm_set1_epi32(0xbe29c7cc)), // -0.16580121984779175f
+		k5 = _mm_castsi128_ps(_mm_set1_epi32(0x3bf7d14a)); //  0.00756279111686865f
+
+	__m128 x2 = _mm_mul_ps(x, x), x3 = _mm_mul_ps(x2, x), x5 = _mm_mul_ps(x3, x2);
+
+	x = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, k1), _mm_mul_ps(x3, k3)), _mm_mul_ps(x5, k5));
+
+	return HardFloat4(negate(negative, negate(odd, x)));
+}
+
+HardFloat4 cos(HardFloat4 a)
+{
+	return sin(HardFloat4(_mm_add_ps(a.v, pi_2)));
+}
+
+HardFloat4 atan(HardFloat4 a)
+{
+	// handle negative values
+	__m128 negative = _mm_cmplt_ps(a.v, zero);
+	__m128 x = negate(negative, a.v);
+
+	__m128 invert = _mm_cmpgt_ps(x, one);
+	x = select(invert, _mm_div_ps(one, x), x);
+
+	static const __m128
+		k1 = _mm_castsi128_ps(_mm_set1_epi32(0x3f7ff50e)), //  0.9998329769337240f
+		k3 = _mm_castsi128_ps(_mm_set1_epi32(0xbea75d21)), // -0.3268824051434949f
+		k5 = _mm_castsi128_ps(_mm_set1_epi32(0x3e22d89e)), //  0.1590294514698240f
+		k7 = _mm_castsi128_ps(_mm_set1_epi32(0xbd407012)); // -0.0469818803609288f
+
+	__m128 x2 = _mm_mul_ps(x, x), x4 = _mm_mul_ps(x2, x2), x6 = _mm_mul_ps(x4, x2);
+
+	x = _mm_mul_ps(x, _mm_add_ps(_mm_add_ps(_mm_add_ps(k1, _mm_mul_ps(x2, k3)), _mm_mul_ps(x4, k5)), _mm_mul_ps(x6, k7)));
+
+	return HardFloat4(negate(negative, select(invert, _mm_sub_ps(pi_2, x), x)));
+}
+
+HardFloat4 atan2(HardFloat4 y, HardFloat4 x)
+{
+	__m128 xs = _mm_cmpge_ps(x.v, zero);
+	__m128 ys = _mm_cmpge_ps(y.v, zero);
+
+	__m128 a = atan(y / x).v;
+	a = select(xs, a, select(ys, _mm_add_ps(a, pi), _mm_sub_ps(a, pi)));
+	a = select(_mm_cmpeq_ps(x.v, zero), negate(_mm_andnot_ps(ys, signMask), pi_2), a);
+	a = select(_mm_cmpeq_ps(y.v, zero), _mm_andnot_ps(xs, pi), a);
+
+	return HardFloat4(a);
+}
+
+HardFloat4 HardFloat4::fromUint32Const(uint32_t a)
+{
+	return HardFloat4(_mm_castsi128_ps(_mm_set1_epi32((int)a)));
+}
+
+//*** Vectors and matrices.
+
+/// Sum of products in the same order as in generic templates (starting from zero).
+static inline __m128 sum4(__m128 a0, __m128 b0, __m128 a1, __m128 b1, __m128 a2, __m128 b2, __m128 a3, __m128 b3)
+{
+	__m128 s = _mm_add_ps(zero, _mm_mul_ps(a0, b0));
+	s = _mm_add_ps(s, _mm_mul_ps(a1, b1));
+	s = _mm_add_ps(s, _mm_mul_ps(a2, b2));
+	return _mm_add_ps(s, _mm_mul_ps(a3, b3));
+}
+
+static inline __m128 load(const hvec4& a)
+{
+	return _mm_loadu_ps((const float*)a.t);
+}
+
+static inline hvec4 store(__m128 a)
+{
+	return hvec4(HardFloat4(a));
+}
+
+bool operator<(const hvec4& a, const hvec4& b)
+{
+	for(int i = 0; i < 4; ++i)
+	{
+		if(a.t[i] < b.t[i]) return true;
+		if(a.t[i] > b.t[i]) return false;
+	}
+	return false;
+}
+
+bool operator==(const hvec4& a, const hvec4& b)
+{
+	return _mm_movemask_ps(_mm_cmpeq_ps(load(a), load(b))) == 0xF;
+}
+
+hvec4 operator-(const hvec4& a)
+{
+	return store(_mm_xor_ps(load(a), signMask));
+}
+
+hvec4 operator+(const hvec4& a, const hvec4& b)
+{
+	return store(_mm_add_ps(load(a), load(b)));
+}
+
+hvec4& operator+=(hvec4& a, const hvec4& b)
+{
+	return a = a + b;
+}
+
+hvec4 operator-(const hvec4& a, const hvec4& b)
+{
+	return store(_mm_sub_ps(load(a), load(b)));
+}
+
+hvec4& operator-=(hvec4& a, const hvec4& b)
+{
+	return a = a - b;
+}
+
+hvec4 operator*(const hvec4& a, const hvec4& b)
+{
+	return store(_mm_mul_ps(load(a), load(b)));
+}
+
+hvec4& operator*=(hvec4& a, const hvec4& b)
+{
+	return a = a * b;
+}
+
+hvec4 operator*(const hvec4& a, HardFloat b)
+{
+	return store(_mm_mul_ps(load(a), _mm_set1_ps((float)b)));
+}
+
+hvec4& operator*=(hvec4& a, HardFloat b)
+{
+	return a = a * b;
+}
+
+hvec4 operator/(const hvec4& a, const hvec4& b)
+{
+	return store(_mm_div_ps(load(a), load(b)));
+}
+
+hvec4& operator/=(hvec4& a, const hvec4& b)
+{
+	return a = a / b;
+}
+
+hvec4 operator/(const hvec4& a, HardFloat b)
+{
+	return store(_mm_div_ps(load(a), _mm_set1_ps((float)b)));
+}
+
+hvec4& operator/=(hvec4& a, HardFloat b)
+{
+	return a = a / b;
+}
+
+HardFloat dot(const hvec4& a, const hvec4& b)
+{
+	// products are parallel, but the sum must be sequential
+	__m128 p = _mm_mul_ps(load(a), load(b));
+	__m128 s = _mm_add_ss(zero, p);
+	s = _mm_add_ss(s, _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1)));
+	s = _mm_add_ss(s, _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2)));
+	s = _mm_add_ss(s, _mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 3, 3)));
+	return HardFloat(s);
+}
+
+HardFloat length(const hvec4& a)
+{
+	return sqrt(dot(a, a));
+}
+
+hvec4 normalize(const hvec4& a)
+{
+	return a / length(a);
+}
+
+hvec4 conjugate(const hvec4& a)
+{
+	return store(_mm_xor_ps(load(a), _mm_setr_ps(-0.0f, -0.0f, -0.0f, 0.0f)));
+}
+
+static inline __m128 loadColumn(const hmat4x4& a, int j)
+{
+	return _mm_loadu_ps((const float*)a.t[j]);
+}
+
+static inline void storeColumn(hmat4x4& a, int j, __m128 c)
+{
+	_mm_storeu_ps((float*)a.t[j], c);
+}
+
+hmat4x4 operator+(const hmat4x4& a, const hmat4x4& b)
+{
+	hmat4x4 r;
+	for(int j = 0; j < 4; ++j)
+		storeColumn(r, j, _mm_add_ps(loadColumn(a, j), loadColumn(b, j)));
+	return r;
+}
+
+hmat4x4 operator-(const hmat4x4& a, const hmat4x4& b)
+{
+	hmat4x4 r;
+	for(int j = 0; j < 4; ++j)
+		storeColumn(r, j, _mm_sub_ps(loadColumn(a, j), loadColumn(b, j)));
+	return r;
+}
+
+hmat4x4 operator*(const hmat4x4& a, HardFloat b)
+{
+	__m128 s = _mm_set1_ps((float)b);
+	hmat4x4 r;
+	for(int j = 0; j < 4; ++j)
+		storeColumn(r, j, _mm_mul_ps(loadColumn(a, j), s));
+	return r;
+}
+
+hmat4x4 operator*(const hmat4x4& a, const hmat4x4& b)
+{
+	__m128 a0 = loadColumn(a, 0), a1 = loadColumn(a, 1), a2 = loadColumn(a, 2), a3 = loadColumn(a, 3);
+	hmat4x4 r;
+	for(int j = 0; j < 4; ++j)
+	{
+		__m128 c = loadColumn(b, j);
+		storeColumn(r, j, sum4(
+			a0, _mm_shuffle_ps(c, c, _MM_SHUFFLE(0, 0, 0, 0)),
+			a1, _mm_shuffle_ps(c, c, _MM_SHUFFLE(1, 1, 1, 1)),
+			a2, _mm_shuffle_ps(c, c, _MM_SHUFFLE(2, 2, 2, 2)),
+			a3, _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 3, 3))));
+	}
+	return r;
+}
+
+hvec4 operator*(const hmat4x4& a, const hvec4& b)
+{
+	__m128 c = load(b);
+	return store(sum4(
+		loadColumn(a, 0), _mm_shuffle_ps(c, c, _MM_SHUFFLE(0, 0, 0, 0)),
+		loadColumn(a, 1), _mm_shuffle_ps(c, c, _MM_SHUFFLE(1, 1, 1, 1)),
+		loadColumn(a, 2), _mm_shuffle_ps(c, c, _MM_SHUFFLE(2, 2, 2, 2)),
+		loadColumn(a, 3), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 3, 3))));
+}
+
+hvec4 operator*(const hvec4& a, const hmat4x4& b)
+{
+	// rows of b are transposed columns
+	__m128 r0 = loadColumn(b, 0), r1 = loadColumn(b, 1), r2 = loadColumn(b, 2), r3 = loadColumn(b, 3);
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	__m128 c = load(a);
+	return store(sum4(
+		r0, _mm_shuffle_ps(c, c, _MM_SHUFFLE(0, 0, 0, 0)),
+		r1, _mm_shuffle_ps(c, c, _MM_SHUFFLE(1, 1, 1, 1)),
+		r2, _mm_shuffle_ps(c, c, _MM_SHUFFLE(2, 2, 2, 2)),
+		r3, _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 3, 3))));
+}
+
+END_INANITY_MATH
@@ -0,0 +1,153 @@
+#ifndef ___INANITY_MATH_HARD_FLOAT4_HPP___
+#define ___INANITY_MATH_HARD_FLOAT4_HPP___
+
+#include "HardFloat.hpp"
+#include "basic.hpp"
+
+BEGIN_INANITY_MATH
+
+/// Class of four IEEE 754 deterministic floats, based on SSE2.
+/** Every lane gives bit-exact the same result as HardFloat
+with the same operation, including transcendent functions.
+Comparisons return masks of lanes (all bits set or cleared),
+which can be used in select, any and all.
+For correct work the .cpp has to be compiled without fast math. */
+class HardFloat4
+{
+public:
+	HardFloat4();
+	HardFloat4(const HardFloat4&) = default;
+
+	/// Set all lanes to the value.
+	explicit HardFloat4(HardFloat);
+	HardFloat4(HardFloat, HardFloat, HardFloat, HardFloat);
+	explicit HardFloat4(__m128);
+
+	/// Load from unaligned array of four floats.
+	static HardFloat4 load(const HardFloat*);
+	/// Store into unaligned array of four floats.
+	void store(HardFloat*) const;
+
+	HardFloat operator[](int) const;
+	__m128 get() const;
+
+	HardFloat4 operator-() const;
+
+	friend HardFloat4 operator+(HardFloat4, HardFloat4);
+	friend HardFloat4 operator-(HardFloat4, HardFloat4);
+	friend HardFloat4 operator*(HardFloat4, HardFloat4);
+	friend HardFloat4 operator/(HardFloat4, HardFloat4);
+	friend HardFloat4 fmod(HardFloat4, HardFloat4);
+
+	HardFloat4& operator+=(HardFloat4);
+	HardFloat4& operator-=(HardFloat4);
+	HardFloat4& operator*=(HardFloat4);
+	HardFloat4& operator/=(HardFloat4);
+
+	friend HardFloat4 operator==(HardFloat4, HardFloat4);
+	friend HardFloat4 operator!=(HardFloat4, HardFloat4);
+	friend HardFloat4 operator<(HardFloat4, HardFloat4);
+	friend HardFloat4 operator<=(HardFloat4, HardFloat4);
+	friend HardFloat4 operator>(HardFloat4, HardFloat4);
+	friend HardFloat4 operator>=(HardFloat4, HardFloat4);
+
+	/// Get lanes from a where mask is set, and from b otherwise.
+	friend HardFloat4 select(HardFloat4 mask, HardFloat4 a, HardFloat4 b);
+	/// Is mask set in any lane.
+	friend bool any(HardFloat4 mask);
+	/// Is mask set in all lanes.
+	friend bool all(HardFloat4 mask);
+
+	friend HardFloat4 abs(HardFloat4);
+	friend HardFloat4 floor(HardFloat4);
+	friend HardFloat4 ceil(HardFloat4);
+	friend HardFloat4 trunc(HardFloat4);
+	friend HardFloat4 sqrt(HardFloat4);
+	friend HardFloat4 sin(HardFloat4);
+	friend HardFloat4 cos(HardFloat4);
+	friend HardFloat4 atan(HardFloat4);
+	friend HardFloat4 atan2(HardFloat4, HardFloat4);
+
+	static HardFloat4 fromUint32Const(uint32_t);
+
+private:
+	__m128 v;
+};
+
+/// Vector of four deterministic floats.
+/** Stored as plain floats, so layout is the same as for other xvecs,
+but arithmetic is performed by HardFloat4 in all lanes at once.
+HardFloat has constructor, so it can't be in anonymous union,
+and there are no x, y, z, w members; use operator(). */
+template <>
+struct xvec<HardFloat, 4>
+{
+	HardFloat t[4];
+
+	xvec() {}
+	xvec(HardFloat x, HardFloat y, HardFloat z, HardFloat w)
+	{
+		t[0] = x;
+		t[1] = y;
+		t[2] = z;
+		t[3] = w;
+	}
+	explicit xvec(HardFloat4 a)
+	{
+		a.store(t);
+	}
+
+	explicit operator HardFloat4() const
+	{
+		return HardFloat4::load(t);
+	}
+
+	HardFloat& operator()(int i)
+	{
+		return t[i];
+	}
+
+	HardFloat operator()(int i) const
+	{
+		return t[i];
+	}
+};
+
+typedef xvec<HardFloat, 4> hvec4;
+typedef xmat<HardFloat, 4, 4> hmat4x4;
+
+/* Operations for vectors and matrices of deterministic floats.
+They are overloads of generic templates from basic.hpp and give
+bit-exact the same results (including order of summation in products),
+but are defined in .cpp, so they are never compiled with fast math. */
+
+bool operator<(const hvec4& a, const hvec4& b);
+bool operator==(const hvec4& a, const hvec4& b);
+hvec4 operator-(const hvec4& a);
+hvec4 operator+(const hvec4& a, const hvec4& b);
+hvec4& operator+=(hvec4& a, const hvec4& b);
+hvec4 operator-(const hvec4& a, const hvec4& b);
+hvec4& operator-=(hvec4& a, const hvec4& b);
+hvec4 operator*(const hvec4& a, const hvec4& b);
+hvec4& operator*=(hvec4& a, const hvec4& b);
+hvec4 operator*(const hvec4& a, HardFloat b);
+hvec4& operator*=(hvec4& a, HardFloat b);
+hvec4 operator/(const hvec4& a, const hvec4& b);
+hvec4& operator/=(hvec4& a, const hvec4& b);
+hvec4 operator/(const hvec4& a, HardFloat b);
+hvec4& operator/=(hvec4& a, HardFloat b);
+HardFloat dot(const hvec4& a, const hvec4& b);
+HardFloat length(const hvec4& a);
+hvec4 normalize(const hvec4& a);
+hvec4 conjugate(const hvec4& a);
+
+hmat4x4 operator+(const hmat4x4& a, const hmat4x4& b);
+hmat4x4 operator-(const hmat4x4& a, const hmat4x4& b);
+hmat4x4 operator*(const hmat4x4& a, HardFloat b);
+hmat4x4 operator*(const hmat4x4& a, const hmat4x4& b);
+hvec4 operator*(const hmat4x4& a, const hvec4& b);
+hvec4 operator*(const hvec4& a, const hmat4x4& b);
+
+END_INANITY_MATH
+
+#endif
@@ -327,6 +327,17 @@ inline xvec<T, 4> conjugate(const xvec<T, 4>& a)
 	return xvec<T, 4>(-a.x, -a.y, -a.z, a.w);
 }
 
+/// Product of quaternions: rotation b followed by rotation a.
+template <typename T>
+inline xvec<T, 4> quat_mul(const xvec<T, 4>& a, const xvec<T, 4>& b)
+{
+	return xvec<T, 4>(
+		a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+		a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+		a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+		a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z);
+}
+
 template <typename T>
 inline xvec<T, 3> normal(const xvec<T, 3>& a, const xvec<T, 3>& b, const xvec<T, 3>& c)
 {
@@ -452,6 +463,57 @@ inline xvec<T, 4> operator*(const xmat<T, 4, 4>& a, const xvec<T, 3>& b)
 	return a * xvec<T, 4>(b.x, b.y, b.z, 1);
 }
 
+template <typename T, int n, int m>
+inline xmat<T, m, n> transpose(const xmat<T, n, m>& a)
+{
+	xmat<T, m, n> r;
+	for(int j = 0; j < m; ++j)
+		for(int i = 0; i < n; ++i)
+			r(j, i) = a(i, j);
+	return r;
+}
+
+/// Inverse of 4x4 matrix by cofactors.
+/** Matrix has to be invertible. */
+template <typename T>
+inline xmat<T, 4, 4> inverse(const xmat<T, 4, 4>& a)
+{
+	// 2x2 determinants of upper and lower rows
+	T s0 = a(0, 0) * a(1, 1) - a(1, 0) * a(0, 1);
+	T s1 = a(0, 0) * a(1, 2) - a(1, 0) * a(0, 2);
+	T s2 = a(0, 0) * a(1, 3) - a(1, 0) * a(0, 3);
+	T s3 = a(0, 1) * a(1, 2) - a(1, 1) * a(0, 2);
+	T s4 = a(0, 1) * a(1, 3) - a(1, 1) * a(0, 3);
+	T s5 = a(0, 2) * a(1, 3) - a(1, 2) * a(0, 3);
+	T c5 = a(2, 2) * a(3, 3) - a(3, 2) * a(2, 3);
+	T c4 = a(2, 1) * a(3, 3) - a(3, 1) * a(2, 3);
+	T c3 = a(2, 1) * a(3, 2) - a(3, 1) * a(2, 2);
+	T c2 = a(2, 0) * a(3, 3) - a(3, 0) * a(2, 3);
+	T c1 = a(2, 0) * a(3, 2) - a(3, 0) * a(2, 2);
+	T c0 = a(2, 0) * a(3, 1) - a(3, 0) * a(2, 1);
+
+	T d = 1 / (s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0);
+
+	xmat<T, 4, 4> r;
+	r(0, 0) = (a(1, 1) * c5 - a(1, 2) * c4 + a(1, 3) * c3) * d;
+	r(0, 1) = (-a(0, 1) * c5 + a(0, 2) * c4 - a(0, 3) * c3) * d;
+	r(0, 2) = (a(3, 1) * s5 - a(3, 2) * s4 + a(3, 3) * s3) * d;
+	r(0, 3) = (-a(2, 1) * s5 + a(2, 2) * s4 - a(2, 3) * s3) * d;
+	r(1, 0) = (-a(1, 0) * c5 + a(1, 2) * c2 - a(1, 3) * c1) * d;
+	r(1, 1) = (a(0, 0) * c5 - a(0, 2) * c2 + a(0, 3) * c1) * d;
+	r(1, 2) = (-a(3, 0) * s5 + a(3, 2) * s2 - a(3, 3) * s1) * d;
+	r(1, 3) = (a(2, 0) * s5 - a(2, 2) * s2 + a(2, 3) * s1) * d;
+	r(2, 0) = (a(1, 0) * c4 - a(1, 1) * c2 + a(1, 3) * c0) * d;
+	r(2, 1) = (-a(0, 0) * c4 + a(0, 1) * c2 - a(0, 3) * c0) * d;
+	r(2, 2) = (a(3, 0) * s4 - a(3, 1) * s2 + a(3, 3) * s0) * d;
+	r(2, 3) = (-a(2, 0) * s4 + a(2, 1) * s2 - a(2, 3) * s0) * d;
+	r(3, 0) = (-a(1, 0) * c3 + a(1, 1) * c1 - a(1, 2) * c0) * d;
+	r(3, 1) = (a(0, 0) * c3 - a(0, 1) * c1 + a(0, 2) * c0) * d;
+	r(3, 2) = (-a(3, 0) * s3 + a(3, 1) * s1 - a(3, 2) * s0) * d;
+	r(3, 3) = (a(2, 0) * s3 - a(2, 1) * s1 + a(2, 2) * s0) * d;
+	return r;
+}
+
 template <typename T, int sn, int sm, int n, int m>
 inline xmat<T, sn, sm> submat(const xmat<T, n, m>& a, int si = 0, int sj = 0)
 {
@@ -558,4 +620,7 @@ typedef xquat<double> dquat;
 
 END_INANITY_MATH
 
+// SIMD specializations of the templates above
+#include "simd.hpp"
+
 #endif
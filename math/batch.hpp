@@ -0,0 +1,202 @@
+#ifndef ___INANITY_MATH_BATCH_HPP___
+#define ___INANITY_MATH_BATCH_HPP___
+
+#include "basic.hpp"
+#include <cfloat>
+#include <cstddef>
+
+/* Batch operations over arrays of vectors in SoA layout
+(separate arrays of x, y and z components).
+With SSE they process 4 vectors at once, with AVX - 8, and
+results are the same as of generic per-vector operations. */
+
+BEGIN_INANITY_MATH
+
+/// Transform points (x[i], y[i], z[i], 1) by affine matrix.
+/** Last row of matrix is ignored. Results may be written
+into source arrays. */
+inline void TransformPoints(const mat4x4& m,
+	const float* x, const float* y, const float* z,
+	float* rx, float* ry, float* rz, size_t count)
+{
+	size_t i = 0;
+
+#ifdef INANITY_MATH_AVX
+	{
+		__m256 m00 = _mm256_set1_ps(m(0, 0)), m01 = _mm256_set1_ps(m(0, 1)), m02 = _mm256_set1_ps(m(0, 2)), m03 = _mm256_set1_ps(m(0, 3));
+		__m256 m10 = _mm256_set1_ps(m(1, 0)), m11 = _mm256_set1_ps(m(1, 1)), m12 = _mm256_set1_ps(m(1, 2)), m13 = _mm256_set1_ps(m(1, 3));
+		__m256 m20 = _mm256_set1_ps(m(2, 0)), m21 = _mm256_set1_ps(m(2, 1)), m22 = _mm256_set1_ps(m(2, 2)), m23 = _mm256_set1_ps(m(2, 3));
+		for(; i + 8 <= count; i += 8)
+		{
+			__m256 vx = _mm256_loadu_ps(x + i), vy = _mm256_loadu_ps(y + i), vz = _mm256_loadu_ps(z + i);
+			_mm256_storeu_ps(rx + i, _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m00, vx), _mm256_mul_ps(m01, vy)), _mm256_mul_ps(m02, vz)), m03));
+			_mm256_storeu_ps(ry + i, _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m10, vx), _mm256_mul_ps(m11, vy)), _mm256_mul_ps(m12, vz)), m13));
+			_mm256_storeu_ps(rz + i, _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m20, vx), _mm256_mul_ps(m21, vy)), _mm256_mul_ps(m22, vz)), m23));
+		}
+	}
+#endif
+
+#ifdef INANITY_MATH_SSE
+	{
+		__m128 m00 = _mm_set1_ps(m(0, 0)), m01 = _mm_set1_ps(m(0, 1)), m02 = _mm_set1_ps(m(0, 2)), m03 = _mm_set1_ps(m(0, 3));
+		__m128 m10 = _mm_set1_ps(m(1, 0)), m11 = _mm_set1_ps(m(1, 1)), m12 = _mm_set1_ps(m(1, 2)), m13 = _mm_set1_ps(m(1, 3));
+		__m128 m20 = _mm_set1_ps(m(2, 0)), m21 = _mm_set1_ps(m(2, 1)), m22 = _mm_set1_ps(m(2, 2)), m23 = _mm_set1_ps(m(2, 3));
+		for(; i + 4 <= count; i += 4)
+		{
+			__m128 vx = _mm_loadu_ps(x + i), vy = _mm_loadu_ps(y + i), vz = _mm_loadu_ps(z + i);
+			_mm_storeu_ps(rx + i, _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, vx), _mm_mul_ps(m01, vy)), _mm_mul_ps(m02, vz)), m03));
+			_mm_storeu_ps(ry + i, _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m10, vx), _mm_mul_ps(m11, vy)), _mm_mul_ps(m12, vz)), m13));
+			_mm_storeu_ps(rz + i, _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m20, vx), _mm_mul_ps(m21, vy)), _mm_mul_ps(m22, vz)), m23));
+		}
+	}
+#endif
+
+	for(; i < count; ++i)
+	{
+		float vx = x[i], vy = y[i], vz = z[i];
+		rx[i] = m(0, 0) * vx + m(0, 1) * vy + m(0, 2) * vz + m(0, 3);
+		ry[i] = m(1, 0) * vx + m(1, 1) * vy + m(1, 2) * vz + m(1, 3);
+		rz[i] = m(2, 0) * vx + m(2, 1) * vy + m(2, 2) * vz + m(2, 3);
+	}
+}
+
+/// Transform normals by upper-left 3x3 part of matrix, and normalize them.
+/** For matrices with non-uniform scaling inverse transposed matrix
+should be passed. Normals must not become zero. Results may be written
+into source arrays. */
+inline void TransformNormals(const mat4x4& m,
+	const float* x, const float* y, const float* z,
+	float* rx, float* ry, float* rz, size_t count)
+{
+	size_t i = 0;
+
+#ifdef INANITY_MATH_AVX
+	{
+		__m256 m00 = _mm256_set1_ps(m(0, 0)), m01 = _mm256_set1_ps(m(0, 1)), m02 = _mm256_set1_ps(m(0, 2));
+		__m256 m10 = _mm256_set1_ps(m(1, 0)), m11 = _mm256_set1_ps(m(1, 1)), m12 = _mm256_set1_ps(m(1, 2));
+		__m256 m20 = _mm256_set1_ps(m(2, 0)), m21 = _mm256_set1_ps(m(2, 1)), m22 = _mm256_set1_ps(m(2, 2));
+		for(; i + 8 <= count; i += 8)
+		{
+			__m256 vx = _mm256_loadu_ps(x + i), vy = _mm256_loadu_ps(y + i), vz = _mm256_loadu_ps(z + i);
+			__m256 nx = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m00, vx), _mm256_mul_ps(m01, vy)), _mm256_mul_ps(m02, vz));
+			__m256 ny = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m10, vx), _mm256_mul_ps(m11, vy)), _mm256_mul_ps(m12, vz));
+			__m256 nz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m20, vx), _mm256_mul_ps(m21, vy)), _mm256_mul_ps(m22, vz));
+			__m256 l = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)), _mm256_mul_ps(nz, nz)));
+			_mm256_storeu_ps(rx + i, _mm256_div_ps(nx, l));
+			_mm256_storeu_ps(ry + i, _mm256_div_ps(ny, l));
+			_mm256_storeu_ps(rz + i, _mm256_div_ps(nz, l));
+		}
+	}
+#endif
+
+#ifdef INANITY_MATH_SSE
+	{
+		__m128 m00 = _mm_set1_ps(m(0, 0)), m01 = _mm_set1_ps(m(0, 1)), m02 = _mm_set1_ps(m(0, 2));
+		__m128 m10 = _mm_set1_ps(m(1, 0)), m11 = _mm_set1_ps(m(1, 1)), m12 = _mm_set1_ps(m(1, 2));
+		__m128 m20 = _mm_set1_ps(m(2, 0)), m21 = _mm_set1_ps(m(2, 1)), m22 = _mm_set1_ps(m(2, 2));
+		for(; i + 4 <= count; i += 4)
+		{
+			__m128 vx = _mm_loadu_ps(x + i), vy = _mm_loadu_ps(y + i), vz = _mm_loadu_ps(z + i);
+			__m128 nx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, vx), _mm_mul_ps(m01, vy)), _mm_mul_ps(m02, vz));
+			__m128 ny = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m10, vx), _mm_mul_ps(m11, vy)), _mm_mul_ps(m12, vz));
+			__m128 nz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m20, vx), _mm_mul_ps(m21, vy)), _mm_mul_ps(m22, vz));
+			__m128 l = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz)));
+			_mm_storeu_ps(rx + i, _mm_div_ps(nx, l));
+			_mm_storeu_ps(ry + i, _mm_div_ps(ny, l));
+			_mm_storeu_ps(rz + i, _mm_div_ps(nz, l));
+		}
+	}
+#endif
+
+	for(; i < count; ++i)
+	{
+		float vx = x[i], vy = y[i], vz = z[i];
+		float nx = m(0, 0) * vx + m(0, 1) * vy + m(0, 2) * vz;
+		float ny = m(1, 0) * vx + m(1, 1) * vy + m(1, 2) * vz;
+		float nz = m(2, 0) * vx + m(2, 1) * vy + m(2, 2) * vz;
+		float l = std::sqrt(nx * nx + ny * ny + nz * nz);
+		rx[i] = nx / l;
+		ry[i] = ny / l;
+		rz[i] = nz / l;
+	}
+}
+
+/// Compute axis-aligned bounding box of points.
+/** For empty array min is FLT_MAX and max is -FLT_MAX in all components. */
+inline void ComputeBoundingBox(const float* x, const float* y, const float* z, size_t count, vec3& min, vec3& max)
+{
+	min = vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+	max = vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	size_t i = 0;
+
+#ifdef INANITY_MATH_SSE
+	if(count >= 4)
+	{
+		__m128 minX = _mm_set1_ps(FLT_MAX), minY = minX, minZ = minX;
+		__m128 maxX = _mm_set1_ps(-FLT_MAX), maxY = maxX, maxZ = maxX;
+#ifdef INANITY_MATH_AVX
+		if(count >= 8)
+		{
+			__m256 minX8 = _mm256_set1_ps(FLT_MAX), minY8 = minX8, minZ8 = minX8;
+			__m256 maxX8 = _mm256_set1_ps(-FLT_MAX), maxY8 = maxX8, maxZ8 = maxX8;
+			for(; i + 8 <= count; i += 8)
+			{
+				__m256 vx = _mm256_loadu_ps(x + i), vy = _mm256_loadu_ps(y + i), vz = _mm256_loadu_ps(z + i);
+				minX8 = _mm256_min_ps(minX8, vx);
+				minY8 = _mm256_min_ps(minY8, vy);
+				minZ8 = _mm256_min_ps(minZ8, vz);
+				maxX8 = _mm256_max_ps(maxX8, vx);
+				maxY8 = _mm256_max_ps(maxY8, vy);
+				maxZ8 = _mm256_max_ps(maxZ8, vz);
+			}
+			minX = _mm_min_ps(_mm256_castps256_ps128(minX8), _mm256_extractf128_ps(minX8, 1));
+			minY = _mm_min_ps(_mm256_castps256_ps128(minY8), _mm256_extractf128_ps(minY8, 1));
+			minZ = _mm_min_ps(_mm256_castps256_ps128(minZ8), _mm256_extractf128_ps(minZ8, 1));
+			maxX = _mm_max_ps(_mm256_castps256_ps128(maxX8), _mm256_extractf128_ps(maxX8, 1));
+			maxY = _mm_max_ps(_mm256_castps256_ps128(maxY8), _mm256_extractf128_ps(maxY8, 1));
+			maxZ = _mm_max_ps(_mm256_castps256_ps128(maxZ8), _mm256_extractf128_ps(maxZ8, 1));
+		}
+#endif
+		for(; i + 4 <= count; i += 4)
+		{
+			__m128 vx = _mm_loadu_ps(x + i), vy = _mm_loadu_ps(y + i), vz = _mm_loadu_ps(z + i);
+			minX = _mm_min_ps(minX, vx);
+			minY = _mm_min_ps(minY, vy);
+			minZ = _mm_min_ps(minZ, vz);
+			maxX = _mm_max_ps(maxX, vx);
+			maxY = _mm_max_ps(maxY, vy);
+			maxZ = _mm_max_ps(maxZ, vz);
+		}
+		float t[6][4];
+		_mm_storeu_ps(t[0], minX);
+		_mm_storeu_ps(t[1], minY);
+		_mm_storeu_ps(t[2], minZ);
+		_mm_storeu_ps(t[3], maxX);
+		_mm_storeu_ps(t[4], maxY);
+		_mm_storeu_ps(t[5], maxZ);
+		for(int j = 0; j < 4; ++j)
+		{
+			if(t[0][j] < min.x) min.x = t[0][j];
+			if(t[1][j] < min.y) min.y = t[1][j];
+			if(t[2][j] < min.z) min.z = t[2][j];
+			if(t[3][j] > max.x) max.x = t[3][j];
+			if(t[4][j] > max.y) max.y = t[4][j];
+			if(t[5][j] > max.z) max.z = t[5][j];
+		}
+	}
+#endif
+
+	for(; i < count; ++i)
+	{
+		if(x[i] < min.x) min.x = x[i];
+		if(y[i] < min.y) min.y = y[i];
+		if(z[i] < min.z) min.z = z[i];
+		if(x[i] > max.x) max.x = x[i];
+		if(y[i] > max.y) max.y = y[i];
+		if(z[i] > max.z) max.z = z[i];
+	}
+}
+
+END_INANITY_MATH
+
+#endif
@@ -0,0 +1,309 @@
+#include "geometry.hpp"
+#include "batch.hpp"
+#include "../Time.hpp"
+#include "../Checks.hpp"
+#include <vector>
+#include <cstring>
+#include <iostream>
+
+/* Benchmark of SIMD specializations of vector and matrix operations.
+Generic templates are instantiated for Float - a wrapper of float,
+which gets the same scalar code as float had before specializations.
+Results of specializations are checked against generic ones:
+products must be bit-exact the same, inverse - close. */
+
+using namespace Inanity;
+using namespace Inanity::Math;
+
+/// Float for instantiating generic templates.
+struct Float
+{
+	float v;
+
+	Float() = default;
+	Float(float v) : v(v) {}
+};
+
+inline Float operator-(Float a) { return -a.v; }
+inline Float operator+(Float a, Float b) { return a.v + b.v; }
+inline Float operator-(Float a, Float b) { return a.v - b.v; }
+inline Float operator*(Float a, Float b) { return a.v * b.v; }
+inline Float operator/(Float a, Float b) { return a.v / b.v; }
+inline Float& operator+=(Float& a, Float b) { a.v += b.v; return a; }
+
+typedef xvec<Float, 3> gvec3;
+typedef xvec<Float, 4> gvec4;
+typedef xmat<Float, 4, 4> gmat4x4;
+
+/// Convert between float and Float vectors and matrices of the same layout.
+template <typename R, typename S>
+static R Cast(const S& s)
+{
+	static_assert(sizeof(R) == sizeof(S), "different layouts");
+	R r;
+	memcpy((void*)&r, &s, sizeof(r));
+	return r;
+}
+
+static const int valuesCount = 1 << 12;
+static const int iterationsCount = 200;
+
+static double GetTime(Time::Tick startTick)
+{
+	return (double)(Time::GetTick() - startTick) / (double)Time::GetTicksPerSecond();
+}
+
+static void Print(const char* name, double genericTime, double simdTime)
+{
+	std::cout << name << ": generic " << (genericTime * 1000) << " ms, simd " << (simdTime * 1000)
+		<< " ms, speedup " << (genericTime / simdTime) << "x\n";
+}
+
+static unsigned int randomState = 1;
+
+static float Random()
+{
+	randomState = randomState * 1664525U + 1013904223U;
+	return (float)(randomState >> 8) / (float)(1 << 24) * 2 - 1;
+}
+
+/// Are all floats bit-exact the same (zeros of any sign are equal).
+template <typename A, typename B>
+static bool Equal(const A& a, const B& b)
+{
+	const float* p = (const float*)&a;
+	const float* q = (const float*)&b;
+	for(size_t i = 0; i < sizeof(a) / sizeof(float); ++i)
+		if(p[i] != q[i])
+			return false;
+	return true;
+}
+
+int main()
+{
+	std::cout << "SIMD: "
+#if defined(INANITY_MATH_AVX)
+		"AVX"
+#elif defined(INANITY_MATH_SSE)
+		"SSE"
+#else
+		"none"
+#endif
+		<< "\n";
+
+	std::vector<mat4x4> matrices(valuesCount), matrixResults(valuesCount);
+	std::vector<gmat4x4> genericMatrixResults(valuesCount);
+	std::vector<vec4> vectors(valuesCount), vectorResults(valuesCount);
+	std::vector<gvec4> genericVectorResults(valuesCount);
+	for(int i = 0; i < valuesCount; ++i)
+	{
+		// transformations with translation, well-conditioned for inverse
+		quat q = normalize(vec4(Random(), Random(), Random(), Random()));
+		mat4x4 m = QuaternionToMatrix(q) * CreateScalingMatrix(vec3(1.5f + Random(), 1.5f + Random(), 1.5f + Random()));
+		m(0, 3) = Random() * 10;
+		m(1, 3) = Random() * 10;
+		m(2, 3) = Random() * 10;
+		matrices[i] = m;
+		vectors[i] = vec4(Random(), Random(), Random(), Random());
+	}
+
+	Time::Tick startTick;
+	double genericTime;
+	bool ok;
+
+	// matrix by matrix
+	startTick = Time::GetTick();
+	for(int k = 0; k < iterationsCount; ++k)
+		for(int i = 0; i < valuesCount; ++i)
+			genericMatrixResults[i] = Cast<gmat4x4>(matrices[i]) * Cast<gmat4x4>(matrices[(i + k) & (valuesCount - 1)]);
+	genericTime = GetTime(startTick);
+	startTick = Time::GetTick();
+	for(int k = 0; k < iterationsCount; ++k)
+		for(int i = 0; i < valuesCount; ++i)
+			matrixResults[i] = matrices[i] * matrices[(i + k) & (valuesCount - 1)];
+	Print("matrix * matrix", genericTime, GetTime(startTick));
+	ok = true;
+	for(int i = 0; i < valuesCount; ++i)
+		ok = ok && Equal(matrixResults[i], genericMatrixResults[i]);
+	Check("matrix * matrix", ok);
+
+	// matrix by vector
+	startTick = Time::GetTick();
+	for(int k = 0; k < iterationsCount; ++k)
+		for(int i = 0; i < valuesCount; ++i)
+			genericVectorResults[i] = Cast<gmat4x4>(matrices[i]) * Cast<gvec4>(vectors[(i + k) & (valuesCount - 1)]);
+	genericTime = GetTime(startTick);
+	startTick = Time::GetTick();
+	for(int k = 0; k < iterationsCount; ++k)
+		for(int i = 0; i < valuesCount; ++i)
+			vectorResults[i] = matrices[i] * vectors[(i + k) & (valuesCount - 1)];
+	Print("matrix * vector", genericTime, GetTime(startTick));
+	ok = true;
+	for(int i = 0; i < valuesCount; ++i)
+		ok = ok && Equal(vectorResults[i], genericVectorResults[i]);
+	Check("matrix * vector", ok);
+
+	// vector by matrix
+	startTick = Time::GetTick();
+	for(int k = 0; k < iterationsCount; ++k)
+		for(int i = 0; i < valuesCount; ++i)
+			genericVectorResults[i] = Cast<gvec4>(vectors[(i + k) & (valuesCount - 1)]) * Cast<gmat4x4>(matrices[i]);
+	genericTime = GetTime(startTick);
+	startTick = Time::GetTick();
+	for(int k = 0; k < iterationsCount; ++k)
+		for(int i = 0; i < valuesCount; ++i)
+			vectorResults[i] = vectors[(i + k) & (valuesCount - 1)] * matrices[i];
+	Print("vector * matrix", genericTime, GetTime(startTick));
+	ok = true;
+	for(int i = 0; i < valuesCount; ++i)
+		ok = ok && Equal(vectorResults[i], genericVectorResults[i]);
+	Check("vector * matrix", ok);
+
+	// transpose
+	startTick = Time::GetTick();
+	for(int k = 0; k < iterationsCount; ++k)
+		for(int i = 0; i < valuesCount; ++i)
+			genericMatrixResults[i] = transpose(Cast<gmat4x4>(matrices[(i + k) & (valuesCount - 1)]));
+	genericTime = GetTime(startTick);
+	startTick = Time::GetTick();
+	for(int k = 0; k < iterationsCount; ++k)
+		for(int i = 0; i < valuesCount; ++i)
+			matrixResults[i] = transpose(matrices[(i + k) & (valuesCount - 1)]);
+	Print("transpose", genericTime, GetTime(startTick));
+	ok = true;
+	for(int i = 0; i < valuesCount; ++i)
+		ok = ok && Equal(matrixResults[i], genericMatrixResults[i]);
+	Check("transpose", ok);
+
+	// inverse
+	startTick = Time::GetTick();
+	for(int k = 0; k < iterationsCount; ++k)
+		for(int i = 0; i < valuesCount; ++i)
+			genericMatrixResults[i] = inverse(Cast<gmat4x4>(matrices[(i + k) & (valuesCount - 1)]));
+	genericTime = GetTime(startTick);
+	startTick = Time::GetTick();
+	for(int k = 0; k < iterationsCount; ++k)
+		for(int i = 0; i < valuesCount; ++i)
+			matrixResults[i] = inverse(matrices[(i + k) & (valuesCount - 1)]);
+	Print("inverse", genericTime, GetTime(startTick));
+	ok = true;
+	for(int i = 0; i < valuesCount; ++i)
+	{
+		// both inverses give identity in product with source matrix
+		mat4x4 m = matrices[(i + iterationsCount - 1) & (valuesCount - 1)];
+		mat4x4 a = m * matrixResults[i], b = m * Cast<mat4x4>(genericMatrixResults[i]);
+		for(int j = 0; j < 4; ++j)
+			for(int l = 0; l < 4; ++l)
+				ok = ok && std::abs(a(j, l) - (j == l)) < 1e-4f && std::abs(b(j, l) - (j == l)) < 1e-4f;
+	}
+	Check("inverse", ok);
+
+	// quaternion product
+	startTick = Time::GetTick();
+	for(int k = 0; k < iterationsCount; ++k)
+		for(int i = 0; i < valuesCount; ++i)
+			genericVectorResults[i] = quat_mul(Cast<gvec4>(vectors[i]), Cast<gvec4>(vectors[(i + k) & (valuesCount - 1)]));
+	genericTime = GetTime(startTick);
+	startTick = Time::GetTick();
+	for(int k = 0; k < iterationsCount; ++k)
+		for(int i = 0; i < valuesCount; ++i)
+			vectorResults[i] = quat_mul(vectors[i], vectors[(i + k) & (valuesCount - 1)]);
+	Print("quaternion * quaternion", genericTime, GetTime(startTick));
+	ok = true;
+	for(int i = 0; i < valuesCount; ++i)
+		ok = ok && Equal(vectorResults[i], genericVectorResults[i]);
+	Check("quaternion * quaternion", ok);
+
+	// quaternion to matrix
+	startTick = Time::GetTick();
+	for(int k = 0; k < iterationsCount; ++k)
+		for(int i = 0; i < valuesCount; ++i)
+			genericMatrixResults[i] = QuaternionToMatrix(Cast<gvec4>(vectors[(i + k) & (valuesCount - 1)]));
+	genericTime = GetTime(startTick);
+	startTick = Time::GetTick();
+	for(int k = 0; k < iterationsCount; ++k)
+		for(int i = 0; i < valuesCount; ++i)
+			matrixResults[i] = QuaternionToMatrix(vectors[(i + k) & (valuesCount - 1)]);
+	Print("quaternion to matrix", genericTime, GetTime(startTick));
+	ok = true;
+	for(int i = 0; i < valuesCount; ++i)
+		ok = ok && Equal(matrixResults[i], genericMatrixResults[i]);
+	Check("quaternion to matrix", ok);
+
+	// batch operations, odd count to check tails
+	const int pointsCount = valuesCount * 4 + 7;
+	std::vector<gvec3> points(pointsCount), genericResults(pointsCount);
+	std::vector<float> x(pointsCount), y(pointsCount), z(pointsCount), rx(pointsCount), ry(pointsCount), rz(pointsCount);
+	for(int i = 0; i < pointsCount; ++i)
+	{
+		points[i] = gvec3(Random() * 100, Random() * 100, Random() * 100);
+		x[i] = points[i].x.v;
+		y[i] = points[i].y.v;
+		z[i] = points[i].z.v;
+	}
+	const int batchIterationsCount = iterationsCount / 4;
+
+	// transform points
+	gmat4x4 m = Cast<gmat4x4>(matrices[0]);
+	startTick = Time::GetTick();
+	for(int k = 0; k < batchIterationsCount; ++k)
+		for(int i = 0; i < pointsCount; ++i)
+		{
+			gvec4 r = m * points[i];
+			genericResults[i] = gvec3(r.x, r.y, r.z);
+		}
+	genericTime = GetTime(startTick);
+	startTick = Time::GetTick();
+	for(int k = 0; k < batchIterationsCount; ++k)
+		TransformPoints(matrices[0], &x[0], &y[0], &z[0], &rx[0], &ry[0], &rz[0], pointsCount);
+	Print("transform points", genericTime, GetTime(startTick));
+	ok = true;
+	for(int i = 0; i < pointsCount; ++i)
+		ok = ok && rx[i] == genericResults[i].x.v && ry[i] == genericResults[i].y.v && rz[i] == genericResults[i].z.v;
+	Check("transform points", ok);
+
+	// transform normals
+	xmat<Float, 3, 3> m3 = submat<Float, 3, 3>(m);
+	startTick = Time::GetTick();
+	for(int k = 0; k < batchIterationsCount; ++k)
+		for(int i = 0; i < pointsCount; ++i)
+		{
+			gvec3 n = m3 * points[i];
+			genericResults[i] = n / Float(std::sqrt(length2(n).v));
+		}
+	genericTime = GetTime(startTick);
+	startTick = Time::GetTick();
+	for(int k = 0; k < batchIterationsCount; ++k)
+		TransformNormals(matrices[0], &x[0], &y[0], &z[0], &rx[0], &ry[0], &rz[0], pointsCount);
+	Print("transform normals", genericTime, GetTime(startTick));
+	ok = true;
+	for(int i = 0; i < pointsCount; ++i)
+		ok = ok && rx[i] == genericResults[i].x.v && ry[i] == genericResults[i].y.v && rz[i] == genericResults[i].z.v;
+	Check("transform normals", ok);
+
+	// bounding box
+	vec3 genericMin, genericMax, min, max;
+	startTick = Time::GetTick();
+	for(int k = 0; k < batchIterationsCount; ++k)
+	{
+		genericMin = vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+		genericMax = vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for(int i = 0; i < pointsCount; ++i)
+			for(int j = 0; j < 3; ++j)
+			{
+				float v = points[i](j).v;
+				if(v < genericMin(j)) genericMin(j) = v;
+				if(v > genericMax(j)) genericMax(j) = v;
+			}
+	}
+	genericTime = GetTime(startTick);
+	startTick = Time::GetTick();
+	for(int k = 0; k < batchIterationsCount; ++k)
+		ComputeBoundingBox(&x[0], &y[0], &z[0], pointsCount, min, max);
+	Print("bounding box", genericTime, GetTime(startTick));
+	Check("bounding box", min == genericMin && max == genericMax);
+	ComputeBoundingBox(&x[0], &y[0], &z[0], 3, min, max);
+	Check("bounding box of 3", min == vec3(std::min(std::min(x[0], x[1]), x[2]), std::min(std::min(y[0], y[1]), y[2]), std::min(std::min(z[0], z[1]), z[2])));
+
+	return ReportChecks();
+}
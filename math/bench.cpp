@@ -0,0 +1,97 @@
+#include "HardFloat4.hpp"
+#include "../Time.hpp"
+#include <vector>
+#include <iostream>
+
+/* Benchmark of deterministic floats.
+Compares scalar HardFloat code (generic templates of xvec and xmat)
+with packed HardFloat4 code on the same data. */
+
+using namespace Inanity;
+using namespace Inanity::Math;
+
+static const int valuesCount = 1 << 16;
+static const int iterationsCount = 20;
+
+static double GetTime(Time::Tick startTick)
+{
+	return (double)(Time::GetTick() - startTick) / (double)Time::GetTicksPerSecond();
+}
+
+static void Print(const char* name, double scalarTime, double packedTime)
+{
+	std::cout << name << ": scalar " << (scalarTime * 1000) << " ms, packed " << (packedTime * 1000)
+		<< " ms, speedup " << (scalarTime / packedTime) << "x\n";
+}
+
+int main()
+{
+	std::vector<hvec4> vectors(valuesCount), results(valuesCount);
+	for(int i = 0; i < valuesCount; ++i)
+		for(int j = 0; j < 4; ++j)
+			vectors[i](j) = HardFloat((float)((i * 4 + j) % 2000 - 1000) * 0.01f);
+
+	hmat4x4 m;
+	for(int i = 0; i < 4; ++i)
+		for(int j = 0; j < 4; ++j)
+			m(i, j) = HardFloat((float)(i * 4 + j) * 0.1f);
+
+	// transform vectors by matrix
+	Time::Tick startTick = Time::GetTick();
+	for(int k = 0; k < iterationsCount; ++k)
+		for(int i = 0; i < valuesCount; ++i)
+			results[i] = Inanity::Math::operator*<HardFloat, 4, 4>(m, vectors[i]);
+	double scalarTime = GetTime(startTick);
+	startTick = Time::GetTick();
+	for(int k = 0; k < iterationsCount; ++k)
+		for(int i = 0; i < valuesCount; ++i)
+			results[i] = m * vectors[i];
+	Print("matrix by vector", scalarTime, GetTime(startTick));
+
+	// dot products and normalization
+	startTick = Time::GetTick();
+	for(int k = 0; k < iterationsCount; ++k)
+		for(int i = 0; i < valuesCount; ++i)
+			results[i] = Inanity::Math::operator/<HardFloat, 4>(vectors[i], sqrt(dot<HardFloat, 4>(vectors[i], vectors[i])));
+	scalarTime = GetTime(startTick);
+	startTick = Time::GetTick();
+	for(int k = 0; k < iterationsCount; ++k)
+		for(int i = 0; i < valuesCount; ++i)
+			results[i] = normalize(vectors[i]);
+	Print("normalize", scalarTime, GetTime(startTick));
+
+	// sin and cos of every component
+	startTick = Time::GetTick();
+	for(int k = 0; k < iterationsCount; ++k)
+		for(int i = 0; i < valuesCount; ++i)
+			for(int j = 0; j < 4; ++j)
+				results[i](j) = sin(vectors[i](j)) + cos(vectors[i](j));
+	scalarTime = GetTime(startTick);
+	startTick = Time::GetTick();
+	for(int k = 0; k < iterationsCount; ++k)
+		for(int i = 0; i < valuesCount; ++i)
+		{
+			HardFloat4 a(vectors[i]);
+			results[i] = hvec4(sin(a) + cos(a));
+		}
+	Print("sin + cos", scalarTime, GetTime(startTick));
+
+	// atan2 of neighbour components
+	startTick = Time::GetTick();
+	for(int k = 0; k < iterationsCount; ++k)
+		for(int i = 0; i < valuesCount; ++i)
+			for(int j = 0; j < 4; ++j)
+				results[i](j) = atan2(vectors[i](j), vectors[i]((j + 1) % 4));
+	scalarTime = GetTime(startTick);
+	startTick = Time::GetTick();
+	for(int k = 0; k < iterationsCount; ++k)
+		for(int i = 0; i < valuesCount; ++i)
+		{
+			HardFloat4 a(vectors[i]);
+			HardFloat4 b(vectors[i](1), vectors[i](2), vectors[i](3), vectors[i](0));
+			results[i] = hvec4(atan2(a, b));
+		}
+	Print("atan2", scalarTime, GetTime(startTick));
+
+	return 0;
+}
@@ -111,6 +111,41 @@ xmat<T, 4, 4> QuaternionToMatrix(const xquat<T>& q)
 	return r;
 }
 
+#ifdef INANITY_MATH_SSE
+
+/// Same as generic QuaternionToMatrix, computed in SSE registers.
+template <>
+inline mat4x4 QuaternionToMatrix<float>(const quat& q)
+{
+	__m128 v = to_m128(q);
+	__m128 two = _mm_set1_ps(2.0f);
+	__m128 sq = _mm_mul_ps(v, v);
+	// ww + xx - yy - zz, ww - xx + yy - zz, ww - xx - yy + zz
+	__m128 d = _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(3, 3, 3, 3));
+	d = _mm_add_ps(d, _mm_xor_ps(_mm_shuffle_ps(sq, sq, _MM_SHUFFLE(0, 0, 0, 0)), _mm_setr_ps(0, -0.0f, -0.0f, 0)));
+	d = _mm_add_ps(d, _mm_xor_ps(_mm_shuffle_ps(sq, sq, _MM_SHUFFLE(1, 1, 1, 1)), _mm_setr_ps(-0.0f, 0, -0.0f, 0)));
+	d = _mm_add_ps(d, _mm_xor_ps(_mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 2, 2, 2)), _mm_setr_ps(-0.0f, -0.0f, 0, 0)));
+	// wz2, -wy2, wx2
+	__m128 w2 = _mm_mul_ps(_mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)), _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 1, 2))), two);
+	w2 = _mm_xor_ps(w2, _mm_setr_ps(0, -0.0f, 0, 0));
+	// xy2, xz2, yz2
+	__m128 p2 = _mm_mul_ps(_mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 1, 0, 0)), _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 2, 2, 1))), two);
+	__m128 a = _mm_add_ps(p2, w2);
+	__m128 b = _mm_sub_ps(p2, w2);
+
+	// columns from diagonal and sums, with last component cleared
+	__m128 mask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+	mat4x4 r;
+	__m128 u = _mm_unpacklo_ps(d, a);
+	_mm_storeu_ps(r.t[0], _mm_and_ps(_mm_shuffle_ps(u, u, _MM_SHUFFLE(3, 3, 1, 0)), mask));
+	_mm_storeu_ps(r.t[1], _mm_and_ps(_mm_shuffle_ps(_mm_unpacklo_ps(b, d), a, _MM_SHUFFLE(2, 2, 3, 0)), mask));
+	_mm_storeu_ps(r.t[2], _mm_and_ps(_mm_shuffle_ps(b, d, _MM_SHUFFLE(2, 2, 2, 1)), mask));
+	_mm_storeu_ps(r.t[3], _mm_setr_ps(0, 0, 0, 1));
+	return r;
+}
+
+#endif
+
 END_INANITY_MATH
 
 #endif
@@ -0,0 +1,411 @@
+#ifndef ___INANITY_MATH_LUA_IPP___
+#define ___INANITY_MATH_LUA_IPP___
+
+/* Native representation of vectors and matrices in Lua.
+Vectors and matrices are passed as full userdata with
+lua_Numbers inside, and metatable shared by all of them, providing
+indexing (1-based, or by x, y, z, w with swizzling), arithmetic
+operators, comparison and conversion to string. No Script::Any
+objects are created while marshalling.
+Arrays (tables of numbers) are still accepted from scripts. */
+
+#include "basic.hpp"
+#include "../script/lua/values.ipp"
+#include <sstream>
+
+BEGIN_INANITY_LUA
+
+/// Userdata of vector or matrix.
+/** n * m lua_Numbers are following the structure, column-major. */
+struct MathUserData : public UserData
+{
+	/// Dimensions, m = 1 for vectors.
+	int n, m;
+
+	static const size_t dataOffset = (sizeof(UserData) + 2 * sizeof(int) + sizeof(lua_Number) - 1) / sizeof(lua_Number) * sizeof(lua_Number);
+
+	lua_Number* GetData()
+	{
+		return (lua_Number*)((char*)this + dataOffset);
+	}
+};
+
+inline MathUserData* PushMathUserData(lua_State* state, int n, int m);
+
+/// Get math userdata by index, or null if the value is not math userdata.
+/** Userdata is checked by metatable first, as other userdata
+(from other libraries, or created by scripts) may have no type field. */
+inline MathUserData* ToMathUserData(lua_State* state, int index)
+{
+	if(lua_type(state, index) != LUA_TUSERDATA || !lua_getmetatable(state, index))
+		return 0;
+	lua_pushlightuserdata(state, (void*)&PushMathUserData);
+	lua_rawget(state, LUA_REGISTRYINDEX);
+	bool isMath = lua_rawequal(state, -1, -2) != 0;
+	lua_pop(state, 2);
+	return isMath ? (MathUserData*)lua_touserdata(state, index) : 0;
+}
+
+/// Get index of component by letter, or -1.
+inline int GetMathComponent(char c)
+{
+	switch(c)
+	{
+	case 'x': case 'r': return 0;
+	case 'y': case 'g': return 1;
+	case 'z': case 'b': return 2;
+	case 'w': case 'a': return 3;
+	default: return -1;
+	}
+}
+
+inline int MathMetaTable_index(lua_State* state);
+inline int MathMetaTable_newindex(lua_State* state);
+inline int MathMetaTable_add(lua_State* state);
+inline int MathMetaTable_sub(lua_State* state);
+inline int MathMetaTable_mul(lua_State* state);
+inline int MathMetaTable_div(lua_State* state);
+inline int MathMetaTable_unm(lua_State* state);
+inline int MathMetaTable_eq(lua_State* state);
+inline int MathMetaTable_len(lua_State* state);
+inline int MathMetaTable_tostring(lua_State* state);
+
+/// Push new math userdata into stack.
+inline MathUserData* PushMathUserData(lua_State* state, int n, int m)
+{
+	MathUserData* userData = (MathUserData*)lua_newuserdata(state, MathUserData::dataOffset + n * m * sizeof(lua_Number));
+	userData->type = UserData::typeMath;
+	userData->n = n;
+	userData->m = m;
+
+	// metatable is shared by all math values, and stored in registry
+	// by address of the function
+	lua_pushlightuserdata(state, (void*)&PushMathUserData);
+	lua_rawget(state, LUA_REGISTRYINDEX);
+	if(lua_isnil(state, -1))
+	{
+		lua_pop(state, 1);
+		lua_createtable(state, 0, 10);
+		static const struct
+		{
+			const char* name;
+			lua_CFunction function;
+		} methods[] =
+		{
+			{ "__index", &MathMetaTable_index },
+			{ "__newindex", &MathMetaTable_newindex },
+			{ "__add", &MathMetaTable_add },
+			{ "__sub", &MathMetaTable_sub },
+			{ "__mul", &MathMetaTable_mul },
+			{ "__div", &MathMetaTable_div },
+			{ "__unm", &MathMetaTable_unm },
+			{ "__eq", &MathMetaTable_eq },
+			{ "__len", &MathMetaTable_len },
+			{ "__tostring", &MathMetaTable_tostring }
+		};
+		for(size_t i = 0; i < sizeof(methods) / sizeof(methods[0]); ++i)
+		{
+			lua_pushcfunction(state, methods[i].function);
+			lua_setfield(state, -2, methods[i].name);
+		}
+		lua_pushlightuserdata(state, (void*)&PushMathUserData);
+		lua_pushvalue(state, -2);
+		lua_rawset(state, LUA_REGISTRYINDEX);
+	}
+	lua_setmetatable(state, -2);
+
+	return userData;
+}
+
+/// Get elements of vector or matrix from stack.
+/** Accepts math userdata or array of numbers. */
+inline void GetMathElements(lua_State* state, int index, int n, int m, lua_Number* elements)
+{
+	if(MathUserData* userData = ToMathUserData(state, index))
+	{
+		if(userData->n != n || userData->m != m)
+		{
+			std::ostringstream stream;
+			stream << "Expected " << n << "x" << m << " math value for argument, but got " << userData->n << "x" << userData->m;
+			THROW(stream.str());
+		}
+		const lua_Number* data = userData->GetData();
+		for(int i = 0; i < n * m; ++i)
+			elements[i] = data[i];
+		return;
+	}
+
+	if(lua_istable(state, index))
+	{
+		for(int i = 0; i < n * m; ++i)
+		{
+			lua_rawgeti(state, index, i + 1);
+			int isnum;
+			elements[i] = lua_tonumberx(state, -1, &isnum);
+			lua_pop(state, 1);
+			if(!isnum)
+				THROW("Expected a number in array for math value");
+		}
+		return;
+	}
+
+	std::ostringstream stream;
+	stream << "Expected " << n << "x" << m << " math value for argument, but got ";
+	DescribeValue(state, index, stream);
+	THROW(stream.str());
+}
+
+//*** Metatable methods.
+/* All of them are called by Lua, so they report errors with lua_error. */
+
+inline int MathMetaTable_index(lua_State* state)
+{
+	MathUserData* userData = (MathUserData*)lua_touserdata(state, 1);
+	int size = userData->n * userData->m;
+	const lua_Number* data = userData->GetData();
+
+	int isnum;
+	lua_Integer i = lua_tointegerx(state, 2, &isnum);
+	if(isnum)
+	{
+		if(i >= 1 && i <= size)
+			lua_pushnumber(state, data[i - 1]);
+		else
+			lua_pushnil(state);
+		return 1;
+	}
+
+	// swizzle
+	size_t length;
+	const char* key = lua_tolstring(state, 2, &length);
+	if(key && length >= 1 && length <= 4 && userData->m == 1)
+	{
+		int components[4];
+		for(size_t j = 0; j < length; ++j)
+		{
+			components[j] = GetMathComponent(key[j]);
+			if(components[j] < 0 || components[j] >= userData->n)
+			{
+				lua_pushnil(state);
+				return 1;
+			}
+		}
+		if(length == 1)
+			lua_pushnumber(state, data[components[0]]);
+		else
+		{
+			lua_Number* resultData = PushMathUserData(state, (int)length, 1)->GetData();
+			for(size_t j = 0; j < length; ++j)
+				resultData[j] = data[components[j]];
+		}
+		return 1;
+	}
+
+	lua_pushnil(state);
+	return 1;
+}
+
+inline int MathMetaTable_newindex(lua_State* state)
+{
+	MathUserData* userData = (MathUserData*)lua_touserdata(state, 1);
+	int size = userData->n * userData->m;
+
+	int i = -1;
+	int isnum;
+	lua_Integer index = lua_tointegerx(state, 2, &isnum);
+	if(isnum)
+	{
+		if(index >= 1 && index <= size)
+			i = (int)index - 1;
+	}
+	else
+	{
+		size_t length;
+		const char* key = lua_tolstring(state, 2, &length);
+		if(key && length == 1 && userData->m == 1)
+		{
+			i = GetMathComponent(key[0]);
+			if(i >= userData->n)
+				i = -1;
+		}
+	}
+
+	lua_Number value = lua_tonumberx(state, 3, &isnum);
+	if(i < 0 || !isnum)
+	{
+		lua_pushliteral(state, "Invalid assignment to math value");
+		return lua_error(state);
+	}
+
+	userData->GetData()[i] = value;
+	return 0;
+}
+
+/// Perform elementwise binary operation.
+/** One of operands can be a number. */
+template <typename Operation>
+inline int MathBinaryOperation(lua_State* state, Operation operation)
+{
+	MathUserData* a = ToMathUserData(state, 1);
+	MathUserData* b = ToMathUserData(state, 2);
+	int isnum;
+	lua_Number scalar = 0;
+	if(!a || !b)
+	{
+		scalar = lua_tonumberx(state, a ? 2 : 1, &isnum);
+		if(!isnum)
+		{
+			lua_pushliteral(state, "Invalid operand of math operation");
+			return lua_error(state);
+		}
+	}
+	else if(a->n != b->n || a->m != b->m)
+	{
+		lua_pushliteral(state, "Math values of different dimensions");
+		return lua_error(state);
+	}
+
+	MathUserData* shape = a ? a : b;
+	int size = shape->n * shape->m;
+	lua_Number* result = PushMathUserData(state, shape->n, shape->m)->GetData();
+	const lua_Number* aData = a ? a->GetData() : 0;
+	const lua_Number* bData = b ? b->GetData() : 0;
+	for(int i = 0; i < size; ++i)
+		result[i] = operation(aData ? aData[i] : scalar, bData ? bData[i] : scalar);
+	return 1;
+}
+
+struct MathAdd { lua_Number operator()(lua_Number a, lua_Number b) const { return a + b; } };
+struct MathSub { lua_Number operator()(lua_Number a, lua_Number b) const { return a - b; } };
+struct MathMul { lua_Number operator()(lua_Number a, lua_Number b) const { return a * b; } };
+struct MathDiv { lua_Number operator()(lua_Number a, lua_Number b) const { return a / b; } };
+
+inline int MathMetaTable_add(lua_State* state)
+{
+	return MathBinaryOperation(state, MathAdd());
+}
+
+inline int MathMetaTable_sub(lua_State* state)
+{
+	return MathBinaryOperation(state, MathSub());
+}
+
+inline int MathMetaTable_mul(lua_State* state)
+{
+	return MathBinaryOperation(state, MathMul());
+}
+
+inline int MathMetaTable_div(lua_State* state)
+{
+	return MathBinaryOperation(state, MathDiv());
+}
+
+inline int MathMetaTable_unm(lua_State* state)
+{
+	MathUserData* a = (MathUserData*)lua_touserdata(state, 1);
+	int size = a->n * a->m;
+	lua_Number* result = PushMathUserData(state, a->n, a->m)->GetData();
+	const lua_Number* data = a->GetData();
+	for(int i = 0; i < size; ++i)
+		result[i] = -data[i];
+	return 1;
+}
+
+inline int MathMetaTable_eq(lua_State* state)
+{
+	MathUserData* a = ToMathUserData(state, 1);
+	MathUserData* b = ToMathUserData(state, 2);
+	bool equal = a && b && a->n == b->n && a->m == b->m;
+	for(int i = 0; equal && i < a->n * a->m; ++i)
+		equal = a->GetData()[i] == b->GetData()[i];
+	lua_pushboolean(state, equal);
+	return 1;
+}
+
+inline int MathMetaTable_len(lua_State* state)
+{
+	MathUserData* a = (MathUserData*)lua_touserdata(state, 1);
+	lua_pushinteger(state, a->n * a->m);
+	return 1;
+}
+
+inline int MathMetaTable_tostring(lua_State* state)
+{
+	MathUserData* a = (MathUserData*)lua_touserdata(state, 1);
+	std::ostringstream stream;
+	stream << (a->m == 1 ? "vec" : "mat") << a->n;
+	if(a->m != 1)
+		stream << "x" << a->m;
+	stream << "(";
+	for(int i = 0; i < a->n * a->m; ++i)
+		stream << (i ? ", " : "") << a->GetData()[i];
+	stream << ")";
+	lua_pushstring(state, stream.str().c_str());
+	return 1;
+}
+
+//*** Value specializations.
+
+template <typename T, int n>
+struct Value<Math::xvec<T, n> >
+{
+	typedef Math::xvec<T, n> ValueType;
+
+	static inline ValueType Get(lua_State* state, int index)
+	{
+		lua_Number elements[n];
+		GetMathElements(state, index, n, 1, elements);
+		ValueType r;
+		for(int i = 0; i < n; ++i)
+			r(i) = (T)elements[i];
+		return r;
+	}
+
+	static inline void Push(lua_State* state, const ValueType& value)
+	{
+		lua_Number* data = PushMathUserData(state, n, 1)->GetData();
+		for(int i = 0; i < n; ++i)
+			data[i] = (lua_Number)value(i);
+	}
+};
+
+template <typename T, int n>
+struct Value<const Math::xvec<T, n>&> : public Value<Math::xvec<T, n> >
+{
+};
+
+template <typename T, int n, int m>
+struct Value<Math::xmat<T, n, m> >
+{
+	typedef Math::xmat<T, n, m> ValueType;
+
+	static inline ValueType Get(lua_State* state, int index)
+	{
+		lua_Number elements[n * m];
+		GetMathElements(state, index, n, m, elements);
+		ValueType r;
+		int k = 0;
+		for(int j = 0; j < m; ++j)
+			for(int i = 0; i < n; ++i)
+				r(i, j) = (T)elements[k++];
+		return r;
+	}
+
+	static inline void Push(lua_State* state, const ValueType& value)
+	{
+		lua_Number* data = PushMathUserData(state, n, m)->GetData();
+		int k = 0;
+		for(int j = 0; j < m; ++j)
+			for(int i = 0; i < n; ++i)
+				data[k++] = (lua_Number)value(i, j);
+	}
+};
+
+template <typename T, int n, int m>
+struct Value<const Math::xmat<T, n, m>&> : public Value<Math::xmat<T, n, m> >
+{
+};
+
+END_INANITY_LUA
+
+#endif
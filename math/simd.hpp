@@ -0,0 +1,249 @@
+#ifndef ___INANITY_MATH_SIMD_HPP___
+#define ___INANITY_MATH_SIMD_HPP___
+
+#include "basic.hpp"
+
+/* SIMD specializations of generic templates for vec4, mat4x4 and quat.
+Explicit specializations (not overloads) are used, so they are chosen
+exactly when generic templates would be, without new implicit conversions.
+Products keep the order of summation of generic templates, so results are
+bit-exact the same (except sign of zero results, and as long as compiler
+doesn't contract generic code to FMA); inverse is computed differently
+and may differ in last bits.
+SSE is used when target supports SSE2, AVX - when compiled with AVX. */
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define INANITY_MATH_SSE
+#endif
+
+#ifdef INANITY_MATH_SSE
+
+#include <emmintrin.h>
+#ifdef __AVX__
+#include <immintrin.h>
+#define INANITY_MATH_AVX
+#endif
+
+BEGIN_INANITY_MATH
+
+inline __m128 to_m128(const vec4& a)
+{
+	return _mm_loadu_ps(a.t);
+}
+
+inline vec4 from_m128(__m128 a)
+{
+	vec4 r;
+	_mm_storeu_ps(r.t, a);
+	return r;
+}
+
+/// Linear combination of columns of matrix, as in products.
+inline __m128 combine_columns(const mat4x4& a, __m128 b)
+{
+	__m128 r = _mm_mul_ps(_mm_loadu_ps(a.t[0]), _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 0, 0, 0)));
+	r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(a.t[1]), _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 1, 1, 1))));
+	r = _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(a.t[2]), _mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 2, 2, 2))));
+	return _mm_add_ps(r, _mm_mul_ps(_mm_loadu_ps(a.t[3]), _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 3, 3, 3))));
+}
+
+template <>
+inline vec4 operator-<float, 4>(const vec4& a)
+{
+	return from_m128(_mm_xor_ps(to_m128(a), _mm_set1_ps(-0.0f)));
+}
+
+template <>
+inline vec4 operator+<float, 4>(const vec4& a, const vec4& b)
+{
+	return from_m128(_mm_add_ps(to_m128(a), to_m128(b)));
+}
+
+template <>
+inline vec4 operator-<float, 4>(const vec4& a, const vec4& b)
+{
+	return from_m128(_mm_sub_ps(to_m128(a), to_m128(b)));
+}
+
+template <>
+inline vec4 operator*<float, 4>(const vec4& a, const vec4& b)
+{
+	return from_m128(_mm_mul_ps(to_m128(a), to_m128(b)));
+}
+
+template <>
+inline vec4 operator*<float, 4>(const vec4& a, float b)
+{
+	return from_m128(_mm_mul_ps(to_m128(a), _mm_set1_ps(b)));
+}
+
+template <>
+inline vec4 operator/<float, 4>(const vec4& a, const vec4& b)
+{
+	return from_m128(_mm_div_ps(to_m128(a), to_m128(b)));
+}
+
+template <>
+inline vec4 quat_mul<float>(const quat& a, const quat& b)
+{
+	__m128 q = to_m128(b);
+	// terms of b for every component of a, with signs
+	__m128 bx = _mm_xor_ps(_mm_shuffle_ps(q, q, _MM_SHUFFLE(0, 1, 2, 3)), _mm_setr_ps(0, -0.0f, 0, -0.0f));
+	__m128 by = _mm_xor_ps(_mm_shuffle_ps(q, q, _MM_SHUFFLE(1, 0, 3, 2)), _mm_setr_ps(0, 0, -0.0f, -0.0f));
+	__m128 bz = _mm_xor_ps(_mm_shuffle_ps(q, q, _MM_SHUFFLE(2, 3, 0, 1)), _mm_setr_ps(-0.0f, 0, 0, -0.0f));
+	__m128 r = _mm_mul_ps(_mm_set1_ps(a.w), q);
+	r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a.x), bx));
+	r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a.y), by));
+	return from_m128(_mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(a.z), bz)));
+}
+
+template <>
+inline vec4 operator*<float, 4, 4>(const mat4x4& a, const vec4& b)
+{
+	return from_m128(combine_columns(a, to_m128(b)));
+}
+
+template <>
+inline vec4 operator*<float, 4, 4>(const vec4& a, const mat4x4& b)
+{
+	// dot products with columns, in order of generic template
+	__m128 c0 = _mm_loadu_ps(b.t[0]), c1 = _mm_loadu_ps(b.t[1]), c2 = _mm_loadu_ps(b.t[2]), c3 = _mm_loadu_ps(b.t[3]);
+	_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+	__m128 v = to_m128(a);
+	__m128 r = _mm_mul_ps(c0, _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+	r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+	r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+	return from_m128(_mm_add_ps(r, _mm_mul_ps(c3, _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)))));
+}
+
+template <>
+inline mat4x4 operator*<float, 4, 4, 4>(const mat4x4& a, const mat4x4& b)
+{
+	mat4x4 r;
+#ifdef INANITY_MATH_AVX
+	// two columns of result at once
+	__m256 a0 = _mm256_broadcast_ps((const __m128*)a.t[0]);
+	__m256 a1 = _mm256_broadcast_ps((const __m128*)a.t[1]);
+	__m256 a2 = _mm256_broadcast_ps((const __m128*)a.t[2]);
+	__m256 a3 = _mm256_broadcast_ps((const __m128*)a.t[3]);
+	for(int j = 0; j < 4; j += 2)
+	{
+		__m256 c = _mm256_loadu_ps(b.t[j]);
+		__m256 s = _mm256_mul_ps(a0, _mm256_permute_ps(c, _MM_SHUFFLE(0, 0, 0, 0)));
+		s = _mm256_add_ps(s, _mm256_mul_ps(a1, _mm256_permute_ps(c, _MM_SHUFFLE(1, 1, 1, 1))));
+		s = _mm256_add_ps(s, _mm256_mul_ps(a2, _mm256_permute_ps(c, _MM_SHUFFLE(2, 2, 2, 2))));
+		s = _mm256_add_ps(s, _mm256_mul_ps(a3, _mm256_permute_ps(c, _MM_SHUFFLE(3, 3, 3, 3))));
+		_mm256_storeu_ps(r.t[j], s);
+	}
+#else
+	for(int j = 0; j < 4; ++j)
+		_mm_storeu_ps(r.t[j], combine_columns(a, _mm_loadu_ps(b.t[j])));
+#endif
+	return r;
+}
+
+template <>
+inline mat4x4 transpose<float, 4, 4>(const mat4x4& a)
+{
+	__m128 c0 = _mm_loadu_ps(a.t[0]), c1 = _mm_loadu_ps(a.t[1]), c2 = _mm_loadu_ps(a.t[2]), c3 = _mm_loadu_ps(a.t[3]);
+	_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+	mat4x4 r;
+	_mm_storeu_ps(r.t[0], c0);
+	_mm_storeu_ps(r.t[1], c1);
+	_mm_storeu_ps(r.t[2], c2);
+	_mm_storeu_ps(r.t[3], c3);
+	return r;
+}
+
+/// Inverse by Cramer's rule, after Intel's "Streaming SIMD Extensions -
+/// Inverse of 4x4 Matrix". Inverse of transposed matrix is transposed
+/// inverse, so it works for column-major storage as is.
+template <>
+inline mat4x4 inverse<float>(const mat4x4& a)
+{
+	const float* src = a.t[0];
+	__m128 t0 = _mm_loadu_ps(src), t1 = _mm_loadu_ps(src + 4), t2 = _mm_loadu_ps(src + 8), t3 = _mm_loadu_ps(src + 12);
+	// rows are taken in order 0, 1, 2, 3 with halves swapped in 1 and 3
+	__m128 tmp = _mm_movelh_ps(t0, t1);
+	__m128 row1 = _mm_movelh_ps(t2, t3);
+	__m128 row0 = _mm_shuffle_ps(tmp, row1, 0x88);
+	row1 = _mm_shuffle_ps(row1, tmp, 0xDD);
+	tmp = _mm_movehl_ps(t1, t0);
+	__m128 row3 = _mm_movehl_ps(t3, t2);
+	__m128 row2 = _mm_shuffle_ps(tmp, row3, 0x88);
+	row3 = _mm_shuffle_ps(row3, tmp, 0xDD);
+
+	__m128 minor0, minor1, minor2, minor3;
+
+	tmp = _mm_mul_ps(row2, row3);
+	tmp = _mm_shuffle_ps(tmp, tmp, 0xB1);
+	minor0 = _mm_mul_ps(row1, tmp);
+	minor1 = _mm_mul_ps(row0, tmp);
+	tmp = _mm_shuffle_ps(tmp, tmp, 0x4E);
+	minor0 = _mm_sub_ps(_mm_mul_ps(row1, tmp), minor0);
+	minor1 = _mm_sub_ps(_mm_mul_ps(row0, tmp), minor1);
+	minor1 = _mm_shuffle_ps(minor1, minor1, 0x4E);
+
+	tmp = _mm_mul_ps(row1, row2);
+	tmp = _mm_shuffle_ps(tmp, tmp, 0xB1);
+	minor0 = _mm_add_ps(_mm_mul_ps(row3, tmp), minor0);
+	minor3 = _mm_mul_ps(row0, tmp);
+	tmp = _mm_shuffle_ps(tmp, tmp, 0x4E);
+	minor0 = _mm_sub_ps(minor0, _mm_mul_ps(row3, tmp));
+	minor3 = _mm_sub_ps(_mm_mul_ps(row0, tmp), minor3);
+	minor3 = _mm_shuffle_ps(minor3, minor3, 0x4E);
+
+	tmp = _mm_mul_ps(_mm_shuffle_ps(row1, row1, 0x4E), row3);
+	tmp = _mm_shuffle_ps(tmp, tmp, 0xB1);
+	row2 = _mm_shuffle_ps(row2, row2, 0x4E);
+	minor0 = _mm_add_ps(_mm_mul_ps(row2, tmp), minor0);
+	minor2 = _mm_mul_ps(row0, tmp);
+	tmp = _mm_shuffle_ps(tmp, tmp, 0x4E);
+	minor0 = _mm_sub_ps(minor0, _mm_mul_ps(row2, tmp));
+	minor2 = _mm_sub_ps(_mm_mul_ps(row0, tmp), minor2);
+	minor2 = _mm_shuffle_ps(minor2, minor2, 0x4E);
+
+	tmp = _mm_mul_ps(row0, row1);
+	tmp = _mm_shuffle_ps(tmp, tmp, 0xB1);
+	minor2 = _mm_add_ps(_mm_mul_ps(row3, tmp), minor2);
+	minor3 = _mm_sub_ps(_mm_mul_ps(row2, tmp), minor3);
+	tmp = _mm_shuffle_ps(tmp, tmp, 0x4E);
+	minor2 = _mm_sub_ps(_mm_mul_ps(row3, tmp), minor2);
+	minor3 = _mm_sub_ps(minor3, _mm_mul_ps(row2, tmp));
+
+	tmp = _mm_mul_ps(row0, row3);
+	tmp = _mm_shuffle_ps(tmp, tmp, 0xB1);
+	minor1 = _mm_sub_ps(minor1, _mm_mul_ps(row2, tmp));
+	minor2 = _mm_add_ps(_mm_mul_ps(row1, tmp), minor2);
+	tmp = _mm_shuffle_ps(tmp, tmp, 0x4E);
+	minor1 = _mm_add_ps(_mm_mul_ps(row2, tmp), minor1);
+	minor2 = _mm_sub_ps(minor2, _mm_mul_ps(row1, tmp));
+
+	tmp = _mm_mul_ps(row0, row2);
+	tmp = _mm_shuffle_ps(tmp, tmp, 0xB1);
+	minor1 = _mm_add_ps(_mm_mul_ps(row3, tmp), minor1);
+	minor3 = _mm_sub_ps(minor3, _mm_mul_ps(row1, tmp));
+	tmp = _mm_shuffle_ps(tmp, tmp, 0x4E);
+	minor1 = _mm_sub_ps(minor1, _mm_mul_ps(row3, tmp));
+	minor3 = _mm_add_ps(_mm_mul_ps(row1, tmp), minor3);
+
+	// determinant, and exact reciprocal of it in all lanes
+	__m128 det = _mm_mul_ps(row0, minor0);
+	det = _mm_add_ps(_mm_shuffle_ps(det, det, 0x4E), det);
+	det = _mm_add_ss(_mm_shuffle_ps(det, det, 0xB1), det);
+	det = _mm_div_ss(_mm_set_ss(1.0f), det);
+	det = _mm_shuffle_ps(det, det, 0x00);
+
+	mat4x4 r;
+	_mm_storeu_ps(r.t[0], _mm_mul_ps(det, minor0));
+	_mm_storeu_ps(r.t[1], _mm_mul_ps(det, minor1));
+	_mm_storeu_ps(r.t[2], _mm_mul_ps(det, minor2));
+	_mm_storeu_ps(r.t[3], _mm_mul_ps(det, minor3));
+	return r;
+}
+
+END_INANITY_MATH
+
+#endif
+
+#endif
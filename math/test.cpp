@@ -0,0 +1,268 @@
+#include "HardFloat4.hpp"
+#include "../FixedStepTicker.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+
+/* Cross-check of HardFloat4 with HardFloat.
+Every operation of packed floats must give bit-exact the same
+results as scalar floats, lane by lane. Arguments are special
+values (zeros, infinities, NaNs, denormals), random bit patterns,
+and random values in ranges of interest.
+Also checks scalar comparisons with NaNs, and FixedStepTicker
+which schedules deterministic simulation steps. */
+
+using namespace Inanity::Math;
+
+static uint32_t randomState = 1;
+
+static uint32_t NextRandom()
+{
+	// xorshift
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 17;
+	randomState ^= randomState << 5;
+	return randomState;
+}
+
+static uint32_t Bits(HardFloat a)
+{
+	uint32_t d;
+	memcpy(&d, &a, sizeof(d));
+	return d;
+}
+
+static HardFloat FromBits(uint32_t d)
+{
+	return HardFloat::fromUint32Const(d);
+}
+
+static const uint32_t specials[] =
+{
+	0x00000000, 0x80000000, // zeros
+	0x7f800000, 0xff800000, // infinities
+	0x7fc00000, 0xffc00000, // NaNs
+	0x00000001, 0x807fffff, // denormals
+	0x3f800000, 0xbf800000, // 1, -1
+	0x40490fdb, 0xc0490fdb, // pi, -pi
+	0x3fc90fdb, 0xbfc90fdb, // pi/2, -pi/2
+	0x4f000000, 0xcf000000, // 2^31, -2^31
+	0x7f7fffff, 0xff7fffff // max, lowest
+};
+static const int specialsCount = sizeof(specials) / sizeof(specials[0]);
+
+/// Get test value number i.
+static HardFloat GetValue(int i)
+{
+	if(i < specialsCount)
+		return FromBits(specials[i]);
+	switch(i % 3)
+	{
+	case 0:
+		// any bits
+		return FromBits(NextRandom());
+	case 1:
+		// [-10, 10], where trigonometry is usually used
+		return HardFloat((float)(int32_t)(NextRandom() % 2000001 - 1000000) * 0.00001f);
+	default:
+		// [-10^6, 10^6]
+		return HardFloat((float)(int32_t)(NextRandom() % 2000001 - 1000000));
+	}
+}
+
+static int failedCount = 0;
+
+static void Check(const char* name, HardFloat4 packed, HardFloat a, HardFloat b, HardFloat expected[4])
+{
+	for(int i = 0; i < 4; ++i)
+		if(Bits(packed[i]) != Bits(expected[i]))
+		{
+			if(failedCount++ < 20)
+				std::cout << "FAILED " << name << " lane " << i << std::hex
+					<< ": a=0x" << Bits(a) << " b=0x" << Bits(b)
+					<< " scalar=0x" << Bits(expected[i]) << " packed=0x" << Bits(packed[i]) << std::dec << "\n";
+			return;
+		}
+}
+
+static HardFloat Mask(bool a)
+{
+	return FromBits(a ? 0xFFFFFFFF : 0);
+}
+
+/// Check all operations with arguments put in lane k.
+static void CheckOperations(HardFloat a, HardFloat b)
+{
+	// put arguments in different lanes, surrounded by other values
+	HardFloat aa[4], bb[4];
+	for(int i = 0; i < 4; ++i)
+	{
+		aa[i] = GetValue(specialsCount + i);
+		bb[i] = GetValue(specialsCount + i);
+	}
+	int k = NextRandom() % 4;
+	aa[k] = a;
+	bb[k] = b;
+	HardFloat4 pa = HardFloat4::load(aa), pb = HardFloat4::load(bb);
+	HardFloat r[4];
+
+#define CHECK_OP(name, scalar, packed) \
+	for(int i = 0; i < 4; ++i) \
+	{ \
+		HardFloat a = aa[i], b = bb[i]; \
+		(void)b; \
+		r[i] = (scalar); \
+	} \
+	Check(name, (packed), aa[k], bb[k], r)
+
+	CHECK_OP("neg", -a, -pa);
+	CHECK_OP("add", a + b, pa + pb);
+	CHECK_OP("sub", a - b, pa - pb);
+	CHECK_OP("mul", a * b, pa * pb);
+	CHECK_OP("div", a / b, pa / pb);
+	CHECK_OP("fmod", fmod(a, b), fmod(pa, pb));
+	CHECK_OP("eq", Mask(a == b), pa == pb);
+	CHECK_OP("ne", Mask(a != b), pa != pb);
+	CHECK_OP("lt", Mask(a < b), pa < pb);
+	CHECK_OP("le", Mask(a <= b), pa <= pb);
+	CHECK_OP("gt", Mask(a > b), pa > pb);
+	CHECK_OP("ge", Mask(a >= b), pa >= pb);
+	CHECK_OP("select", a < b ? a : b, select(pa < pb, pa, pb));
+	CHECK_OP("abs", abs(a), abs(pa));
+	CHECK_OP("floor", floor(a), floor(pa));
+	CHECK_OP("ceil", ceil(a), ceil(pa));
+	CHECK_OP("trunc", trunc(a), trunc(pa));
+	CHECK_OP("sqrt", sqrt(a), sqrt(pa));
+	CHECK_OP("sin", sin(a), sin(pa));
+	CHECK_OP("cos", cos(a), cos(pa));
+	CHECK_OP("atan", atan(a), atan(pa));
+	CHECK_OP("atan2", atan2(a, b), atan2(pa, pb));
+
+#undef CHECK_OP
+}
+
+static void CheckVector(const char* name, const hvec4& packed, const hvec4& scalar)
+{
+	for(int i = 0; i < 4; ++i)
+		if(Bits(packed(i)) != Bits(scalar(i)))
+		{
+			if(failedCount++ < 20)
+				std::cout << "FAILED " << name << " component " << i << "\n";
+			return;
+		}
+}
+
+/// Check vector and matrix operations with generic templates.
+static void CheckVectors()
+{
+	hvec4 a, b;
+	hmat4x4 m, n;
+	for(int i = 0; i < 4; ++i)
+	{
+		a(i) = GetValue(specialsCount + 1 + (NextRandom() % 2));
+		b(i) = GetValue(specialsCount + 1 + (NextRandom() % 2));
+		for(int j = 0; j < 4; ++j)
+		{
+			m(i, j) = GetValue(specialsCount + 1 + (NextRandom() % 2));
+			n(i, j) = GetValue(specialsCount + 1 + (NextRandom() % 2));
+		}
+	}
+	HardFloat s = GetValue(specialsCount + 1);
+
+	CheckVector("vector add", a + b, Inanity::Math::operator+<HardFloat, 4>(a, b));
+	CheckVector("vector mul", a * b, Inanity::Math::operator*<HardFloat, 4>(a, b));
+	CheckVector("vector scale", a * s, Inanity::Math::operator*<HardFloat, 4>(a, s));
+	CheckVector("vector div", a / s, Inanity::Math::operator/<HardFloat, 4>(a, s));
+	HardFloat d = dot(a, b), genericDot = dot<HardFloat, 4>(a, b);
+	CheckVector("dot", hvec4(d, d, d, d), hvec4(genericDot, genericDot, genericDot, genericDot));
+	CheckVector("matrix by vector", m * a, Inanity::Math::operator*<HardFloat, 4, 4>(m, a));
+	CheckVector("vector by matrix", a * m, Inanity::Math::operator*<HardFloat, 4, 4>(a, m));
+	hmat4x4 p = m * n, genericP = Inanity::Math::operator*<HardFloat, 4, 4, 4>(m, n);
+	for(int j = 0; j < 4; ++j)
+		CheckVector("matrix by matrix", hvec4(p(0, j), p(1, j), p(2, j), p(3, j)),
+			hvec4(genericP(0, j), genericP(1, j), genericP(2, j), genericP(3, j)));
+}
+
+static void CheckTrue(const char* name, bool ok)
+{
+	if(!ok && failedCount++ < 20)
+		std::cout << "FAILED " << name << "\n";
+}
+
+/// Check that scalar comparisons with NaN follow IEEE 754.
+/** Comparisons are done with cmpss, so NaN is unordered: only != is
+true. comiss intrinsics of some compilers reported NaN as equal and
+less than anything. */
+static void CheckNanComparisons()
+{
+	HardFloat nan = FromBits(0x7fc00000), one = HardFloat(1.0f);
+	const HardFloat values[] = { nan, one, FromBits(0x7f800000), FromBits(0xff800000) };
+	for(int i = 0; i < (int)(sizeof(values) / sizeof(values[0])); ++i)
+	{
+		HardFloat a = nan, b = values[i];
+		for(int j = 0; j < 2; ++j)
+		{
+			CheckTrue("nan eq", !(a == b));
+			CheckTrue("nan ne", a != b);
+			CheckTrue("nan lt", !(a < b));
+			CheckTrue("nan le", !(a <= b));
+			CheckTrue("nan gt", !(a > b));
+			CheckTrue("nan ge", !(a >= b));
+			std::swap(a, b);
+		}
+	}
+	// used to recurse forever
+	CheckTrue("sin nan", sin(nan) != sin(nan));
+	CheckTrue("cos nan", cos(nan) != cos(nan));
+}
+
+/// Check accumulation of steps and clamping of their number.
+static void CheckFixedStepTicker()
+{
+	// times are exact in binary, so there is no rounding
+	Inanity::FixedStepTicker ticker(0.25f, 4);
+	CheckTrue("ticker step", ticker.GetStep() == 0.25f);
+	CheckTrue("ticker less than step", ticker.Advance(0.125f) == 0);
+	CheckTrue("ticker interpolation", ticker.GetInterpolation() == 0.5f);
+	CheckTrue("ticker accumulated", ticker.Advance(0.375f) == 2);
+	CheckTrue("ticker interpolation after steps", ticker.GetInterpolation() == 0);
+	CheckTrue("ticker remainder", ticker.Advance(0.625f) == 2);
+	CheckTrue("ticker interpolation of remainder", ticker.GetInterpolation() == 0.5f);
+	// exactly max steps are not clamped
+	CheckTrue("ticker max steps", ticker.Advance(0.875f) == 4);
+	CheckTrue("ticker interpolation after max steps", ticker.GetInterpolation() == 0);
+	// long frame is clamped, and extra time is dropped
+	CheckTrue("ticker clamp", ticker.Advance(10.125f) == 4);
+	CheckTrue("ticker interpolation after clamp", ticker.GetInterpolation() == 0);
+	CheckTrue("ticker after clamp", ticker.Advance(0.25f) == 1);
+
+	// small frames add up to the same number of steps
+	Inanity::FixedStepTicker smallTicker(0.0625f, 4);
+	int stepsCount = 0;
+	for(int i = 0; i < 1000; ++i)
+		stepsCount += smallTicker.Advance(0.015625f);
+	CheckTrue("ticker small frames", stepsCount == 250);
+}
+
+int main()
+{
+	const int valuesCount = 1000;
+	for(int i = 0; i < valuesCount; ++i)
+		for(int j = 0; j < valuesCount; j += (i < specialsCount ? 1 : 97))
+			CheckOperations(GetValue(i), GetValue(j));
+
+	for(int i = 0; i < 100000; ++i)
+		CheckVectors();
+
+	CheckNanComparisons();
+	CheckFixedStepTicker();
+
+	if(failedCount)
+	{
+		std::cout << failedCount << " checks FAILED\n";
+		return 1;
+	}
+	std::cout << "all checks passed\n";
+	return 0;
+}
@@ -0,0 +1,149 @@
+#ifndef ___INANITY_MATH_V8_IPP___
+#define ___INANITY_MATH_V8_IPP___
+
+/* Native representation of vectors and matrices in V8.
+Vectors and matrices are passed as typed arrays (Float32Array for
+float elements, Float64Array otherwise), column-major. Elements of
+typed arrays are external array data, so they are copied with memcpy
+(or converted in place if element types differ), without creating
+a handle per element. Ordinary arrays of numbers are still accepted
+from scripts, and read element by element. */
+
+#include "basic.hpp"
+#include "../script/v8/values.ipp"
+#include <cstring>
+
+BEGIN_INANITY_V8
+
+/// Typed array class for elements of type T.
+template <typename T>
+struct MathTypedArray
+{
+	typedef double ElementType;
+	static v8::Local<v8::TypedArray> New(v8::Local<v8::ArrayBuffer> buffer, size_t length)
+	{
+		return v8::Float64Array::New(buffer, 0, length);
+	}
+};
+
+template <>
+struct MathTypedArray<float>
+{
+	typedef float ElementType;
+	static v8::Local<v8::TypedArray> New(v8::Local<v8::ArrayBuffer> buffer, size_t length)
+	{
+		return v8::Float32Array::New(buffer, 0, length);
+	}
+};
+
+/// Copy elements, converting them.
+template <typename T, typename S>
+inline void CopyMathElements(T* to, const S* from, int count)
+{
+	for(int i = 0; i < count; ++i)
+		to[i] = (T)from[i];
+}
+
+/// Copy elements of the same type.
+template <typename T>
+inline void CopyMathElements(T* to, const T* from, int count)
+{
+	memcpy(to, from, count * sizeof(T));
+}
+
+/// Get elements of vector or matrix from V8 value.
+template <typename T>
+inline void GetMathElements(v8::Local<v8::Value> value, int count, T* elements)
+{
+	if(value->IsFloat32Array() || value->IsFloat64Array())
+	{
+		v8::Object* array = v8::Object::Cast(*value);
+		if(!array->HasIndexedPropertiesInExternalArrayData() || array->GetIndexedPropertiesExternalArrayDataLength() != count)
+			THROW("Wrong length of typed array for math value");
+		const void* data = array->GetIndexedPropertiesExternalArrayData();
+		if(array->GetIndexedPropertiesExternalArrayDataType() == v8::kExternalFloat32Array)
+			CopyMathElements(elements, (const float*)data, count);
+		else
+			CopyMathElements(elements, (const double*)data, count);
+		return;
+	}
+
+	if(!value->IsArray())
+		THROW("Expected typed array or array for math value");
+
+	v8::Object* array = v8::Object::Cast(*value);
+	for(int i = 0; i < count; ++i)
+		elements[i] = (T)array->Get((uint32_t)i)->NumberValue();
+}
+
+/// Create typed array for vector or matrix.
+template <typename T>
+inline v8::Local<v8::Value> NewMathValue(int count, const T* elements)
+{
+	typedef typename MathTypedArray<T>::ElementType ElementType;
+	v8::Isolate* isolate = State::GetCurrent()->GetIsolate();
+	v8::Local<v8::ArrayBuffer> buffer = v8::ArrayBuffer::New(isolate, count * sizeof(ElementType));
+	v8::Local<v8::TypedArray> array = MathTypedArray<T>::New(buffer, count);
+	CopyMathElements((ElementType*)array->GetIndexedPropertiesExternalArrayData(), elements, count);
+	return array;
+}
+
+template <typename T, int n>
+struct Value<Math::xvec<T, n> >
+{
+	typedef Math::xvec<T, n> ValueType;
+
+	static inline ValueType From(v8::Local<v8::Value> value)
+	{
+		ValueType r;
+		GetMathElements(value, n, r.t);
+		return r;
+	}
+
+	static inline v8::Local<v8::Value> To(const ValueType& value)
+	{
+		return NewMathValue(n, value.t);
+	}
+};
+
+template <typename T, int n>
+struct Value<const Math::xvec<T, n>&> : public Value<Math::xvec<T, n> >
+{
+};
+
+template <typename T, int n, int m>
+struct Value<Math::xmat<T, n, m> >
+{
+	typedef Math::xmat<T, n, m> ValueType;
+
+	static inline ValueType From(v8::Local<v8::Value> value)
+	{
+		T elements[n * m];
+		GetMathElements(value, n * m, elements);
+		ValueType r;
+		int k = 0;
+		for(int j = 0; j < m; ++j)
+			for(int i = 0; i < n; ++i)
+				r(i, j) = elements[k++];
+		return r;
+	}
+
+	static inline v8::Local<v8::Value> To(const ValueType& value)
+	{
+		T elements[n * m];
+		int k = 0;
+		for(int j = 0; j < m; ++j)
+			for(int i = 0; i < n; ++i)
+				elements[k++] = value(i, j);
+		return NewMathValue(n * m, elements);
+	}
+};
+
+template <typename T, int n, int m>
+struct Value<const Math::xmat<T, n, m>&> : public Value<Math::xmat<T, n, m> >
+{
+};
+
+END_INANITY_V8
+
+#endif
@@ -29,6 +29,10 @@ protected:
 	const char* fullName;
 
 	ParentClassBase* parent;
+	/// Chain of classes from the root of hierarchy to this class.
+	/** Class at depth d is stored at index d, so cast check
+	is a single comparison instead of walking parents. */
+	std::vector<const ClassBase*> ancestors;
 
 	ConstructorBase* constructor;
 	Methods methods;
@@ -55,7 +59,8 @@ public:
 
 	/// Check that object of this class could be
 	/// casted to target class.
-	bool CanCastTo(ClassBase* targetClass) const;
+	/** Constant time. */
+	bool CanCastTo(const ClassBase* targetClass) const;
 };
 
 /// Metainformation of class.
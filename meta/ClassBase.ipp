@@ -7,7 +7,10 @@ BEGIN_INANITY_META
 
 template <typename Traits>
 ClassBase<Traits>::ClassBase(const char* name, const char* fullName)
-: name(name), fullName(fullName) {}
+: name(name), fullName(fullName)
+{
+	ancestors.push_back(this);
+}
 
 template <typename Traits>
 const char* ClassBase<Traits>::GetName() const
@@ -25,6 +28,11 @@ template <typename Traits>
 void ClassBase<Traits>::SetParent(ParentClassBase* parent)
 {
 	this->parent = parent;
+
+	// parent's metainformation is fully constructed by this moment
+	// (MetaOf constructs it on first call), so its chain is final
+	ancestors = parent->ancestors;
+	ancestors.push_back(this);
 }
 
 template <typename Traits>
@@ -70,12 +78,10 @@ const typename ClassBase<Traits>::StaticMethods& ClassBase<Traits>::GetStaticMet
 }
 
 template <typename Traits>
-bool ClassBase<Traits>::CanCastTo(ClassBase* targetClass) const
+bool ClassBase<Traits>::CanCastTo(const ClassBase* targetClass) const
 {
-	for(const ClassBase* cls = this; cls; cls = cls->parent)
-		if(cls == targetClass)
-			return true;
-	return false;
+	size_t depth = targetClass->ancestors.size() - 1;
+	return depth < ancestors.size() && ancestors[depth] == targetClass;
 }
 
 END_INANITY_META
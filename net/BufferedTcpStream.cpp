@@ -0,0 +1,295 @@
+#include "BufferedTcpStream.hpp"
+#include "../MemoryFile.hpp"
+#include "../CriticalSection.hpp"
+#include "../CriticalCode.hpp"
+#include "../Exception.hpp"
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+BEGIN_INANITY_NET
+
+/// Block of buffered data.
+/** File of block has size of filled data. */
+class BufferedTcpStream::Block : public File
+{
+private:
+	char* data;
+	size_t size;
+
+public:
+	Block() : data(new char[blockSize]), size(0) {}
+	~Block()
+	{
+		delete [] data;
+	}
+
+	void* GetData() const
+	{
+		return data;
+	}
+	size_t GetSize() const
+	{
+		return size;
+	}
+
+	/// Copy data to the end of block, returns size copied.
+	size_t Append(const void* data, size_t size)
+	{
+		size_t toCopy = std::min(size, blockSize - this->size);
+		memcpy(this->data + this->size, data, toCopy);
+		this->size += toCopy;
+		return toCopy;
+	}
+	bool IsFull() const
+	{
+		return size == blockSize;
+	}
+	void Reset()
+	{
+		size = 0;
+	}
+};
+
+/// State shared by stream and its sent handlers.
+/** Changed in the thread of socket, so protected by critical section.
+Error is kept as text, so exception objects are not shared by threads. */
+class BufferedTcpStream::SharedState
+{
+public:
+	CriticalSection cs;
+	std::vector<ptr<Block> > freeBlocks;
+	String error;
+	bool failed;
+
+	SharedState() : failed(false) {}
+
+	void ReturnBlocks(std::vector<ptr<Block> >& blocks)
+	{
+		CriticalCode cc(cs);
+		for(size_t i = 0; i < blocks.size() && freeBlocks.size() < maxFreeBlocksCount; ++i)
+		{
+			blocks[i]->Reset();
+			freeBlocks.push_back(blocks[i]);
+		}
+		blocks.clear();
+	}
+
+	void SetError(ptr<Exception> exception)
+	{
+		std::ostringstream s;
+		exception->PrintStack(s);
+		CriticalCode cc(cs);
+		if(!failed)
+		{
+			failed = true;
+			error = s.str();
+		}
+	}
+};
+
+/// Handler returning sent blocks to stream.
+/** Set to the last sent file; socket sends files in order,
+so all blocks are sent when it's called. */
+class BufferedTcpStream::SentHandler : public SuccessHandler
+{
+private:
+	std::shared_ptr<SharedState> sharedState;
+
+public:
+	std::vector<ptr<Block> > blocks;
+
+	SentHandler(const std::shared_ptr<SharedState>& sharedState) : sharedState(sharedState) {}
+
+	void OnSuccess()
+	{
+		sharedState->ReturnBlocks(blocks);
+	}
+
+	void OnError(ptr<Exception> exception)
+	{
+		sharedState->SetError(exception);
+		sharedState->ReturnBlocks(blocks);
+	}
+};
+
+const size_t BufferedTcpStream::blockSize = 0x1000;
+const size_t BufferedTcpStream::maxFreeBlocksCount = 16;
+
+BufferedTcpStream::BufferedTcpStream(ptr<TcpSocket> socket, size_t flushSize, int maxDelay)
+: socket(socket), flushSize(flushSize),
+	maxDelayTicks(maxDelay > 0 ? Time::GetTicksPerSecond() * maxDelay / 1000000 + 1 : 0),
+	corksCount(0), pendingSize(0), firstWriteTick(0), sharedState(std::make_shared<SharedState>()) {}
+
+BufferedTcpStream::~BufferedTcpStream()
+{
+	// stream is destroyed, so blocks are not returned
+	try
+	{
+		CloseCurrentBlock();
+		SendPending(nullptr);
+	}
+	catch(Exception* exception)
+	{
+		MakePointer(exception);
+	}
+}
+
+ptr<BufferedTcpStream::Block> BufferedTcpStream::AllocateBlock()
+{
+	{
+		CriticalCode cc(sharedState->cs);
+		std::vector<ptr<Block> >& freeBlocks = sharedState->freeBlocks;
+		if(!freeBlocks.empty())
+		{
+			ptr<Block> block = freeBlocks.back();
+			freeBlocks.pop_back();
+			return block;
+		}
+	}
+	return NEW(Block());
+}
+
+void BufferedTcpStream::CheckError()
+{
+	String error;
+	{
+		CriticalCode cc(sharedState->cs);
+		if(!sharedState->failed)
+			return;
+		error = sharedState->error;
+	}
+	THROW("Can't send buffered data to socket: " + error);
+}
+
+void BufferedTcpStream::CloseCurrentBlock()
+{
+	if(currentBlock)
+	{
+		if(currentBlock->GetSize())
+		{
+			pendingFiles.push_back(currentBlock);
+			pendingBlocks.push_back(currentBlock);
+		}
+		currentBlock = nullptr;
+	}
+}
+
+void BufferedTcpStream::WriteDone()
+{
+	if(corksCount)
+		return;
+	if(pendingSize >= flushSize || (maxDelayTicks && Time::GetTick() - firstWriteTick >= maxDelayTicks))
+		Flush();
+}
+
+void BufferedTcpStream::SendPending(ptr<SentHandler> sentHandler)
+{
+	if(pendingFiles.empty())
+		return;
+
+	std::vector<ptr<File> > files;
+	std::swap(files, pendingFiles);
+	if(sentHandler)
+		std::swap(sentHandler->blocks, pendingBlocks);
+	else
+		pendingBlocks.clear();
+	pendingSize = 0;
+
+	for(size_t i = 0; i < files.size(); ++i)
+		socket->Send(files[i], i == files.size() - 1 ? sentHandler : nullptr);
+}
+
+void BufferedTcpStream::Write(const void* data, size_t size)
+{
+	if(!size)
+		return;
+
+	if(!pendingSize && maxDelayTicks)
+		firstWriteTick = Time::GetTick();
+	pendingSize += size;
+
+	while(size)
+	{
+		if(!currentBlock)
+			currentBlock = AllocateBlock();
+		size_t copied = currentBlock->Append(data, size);
+		data = (const char*)data + copied;
+		size -= copied;
+		if(currentBlock->IsFull())
+			CloseCurrentBlock();
+	}
+
+	WriteDone();
+}
+
+void BufferedTcpStream::Write(ptr<File> file)
+{
+	size_t size = file->GetSize();
+
+	// small files are copied, large ones are sent as is
+	if(size < blockSize / 2)
+	{
+		Write(file->GetData(), size);
+		return;
+	}
+
+	if(!pendingSize && maxDelayTicks)
+		firstWriteTick = Time::GetTick();
+	pendingSize += size;
+
+	CloseCurrentBlock();
+	pendingFiles.push_back(file);
+
+	WriteDone();
+}
+
+void BufferedTcpStream::Flush()
+{
+	BEGIN_TRY();
+
+	CheckError();
+
+	// little data is copied, so block is not tied up in sending
+	// (handler without blocks only records error)
+	if(pendingFiles.empty() && currentBlock && currentBlock->GetSize() <= blockSize / 8)
+	{
+		if(currentBlock->GetSize())
+		{
+			socket->Send(MemoryFile::CreateViaCopy(currentBlock->GetData(), currentBlock->GetSize()), NEW(SentHandler(sharedState)));
+			currentBlock->Reset();
+			pendingSize = 0;
+		}
+		return;
+	}
+
+	CloseCurrentBlock();
+	if(!pendingFiles.empty())
+		SendPending(NEW(SentHandler(sharedState)));
+
+	END_TRY("Can't flush buffered TCP stream");
+}
+
+void BufferedTcpStream::Cork()
+{
+	++corksCount;
+}
+
+void BufferedTcpStream::Uncork()
+{
+	if(corksCount && !--corksCount)
+		Flush();
+}
+
+void BufferedTcpStream::End()
+{
+	Flush();
+	socket->End();
+}
+
+size_t BufferedTcpStream::GetBufferedSize() const
+{
+	return pendingSize;
+}
+
+END_INANITY_NET
@@ -0,0 +1,100 @@
+#ifndef ___INANITY_NET_BUFFERED_TCP_STREAM_HPP___
+#define ___INANITY_NET_BUFFERED_TCP_STREAM_HPP___
+
+#include "TcpSocket.hpp"
+#include "../OutputStream.hpp"
+#include "../Time.hpp"
+#include "../String.hpp"
+#include <vector>
+#include <memory>
+
+BEGIN_INANITY_NET
+
+/// Buffered output stream over TCP socket.
+/** Small writes are accumulated into blocks, which are sent to socket
+all at once (so socket gathers them into a single write) on Flush(),
+or when size of buffered data or time since first buffered write
+reaches threshold. Time threshold is checked on writes only, so
+data written last stays in buffer until Flush().
+Large files are sent as is, without copying.
+Sent blocks are returned to stream and reused.
+Stream itself is not thread-safe, but blocks are returned in the
+thread of socket, so sent handlers don't reference stream (see
+ThreadPool about reference counters): free blocks and sending error
+are kept in separate state, shared with std::shared_ptr and protected
+by critical section. */
+class BufferedTcpStream : public OutputStream
+{
+private:
+	class Block;
+	class SharedState;
+	class SentHandler;
+
+	ptr<TcpSocket> socket;
+	/// Size of buffered data to send it.
+	size_t flushSize;
+	/// Maximum age of buffered data, in ticks, 0 if not limited.
+	Time::Tick maxDelayTicks;
+	/// Nesting level of corking.
+	int corksCount;
+
+	/// Block being filled.
+	ptr<Block> currentBlock;
+	/// Files ready to send, in order.
+	std::vector<ptr<File> > pendingFiles;
+	/// Blocks among pending files.
+	std::vector<ptr<Block> > pendingBlocks;
+	/// Total size of buffered data.
+	size_t pendingSize;
+	/// Time of first write into empty buffer.
+	Time::Tick firstWriteTick;
+
+	/// Free blocks, and sending error.
+	std::shared_ptr<SharedState> sharedState;
+
+	/// Size of one block.
+	static const size_t blockSize;
+	/// Maximum number of free blocks kept for reuse.
+	static const size_t maxFreeBlocksCount;
+
+	ptr<Block> AllocateBlock();
+	void CheckError();
+	/// Move current block to pending files.
+	void CloseCurrentBlock();
+	/// Flush if threshold is reached.
+	void WriteDone();
+	/// Send pending files to socket.
+	/** If sent handler is null, blocks are not returned. */
+	void SendPending(ptr<SentHandler> sentHandler);
+
+public:
+	/// Create stream.
+	/** \param flushSize Size of buffered data to send it automatically.
+	\param maxDelay Maximum time to hold buffered data in microseconds,
+	0 to not limit. */
+	BufferedTcpStream(ptr<TcpSocket> socket, size_t flushSize = 0x4000, int maxDelay = 0);
+	/// Sends buffered data.
+	~BufferedTcpStream();
+
+	//*** OutputStream's methods.
+	void Write(const void* data, size_t size) override;
+	void Write(ptr<File> file) override;
+
+	/// Send all buffered data.
+	/** Throws exception if previous sending failed. */
+	void Flush();
+	/// Don't send data automatically until Uncork().
+	/** Could be nested. Explicit Flush() still sends data. */
+	void Cork();
+	/// Cancel Cork(), send buffered data if not corked anymore.
+	void Uncork();
+	/// Send buffered data and close sending side of socket.
+	void End();
+
+	/// Get size of buffered data.
+	size_t GetBufferedSize() const;
+};
+
+END_INANITY_NET
+
+#endif
@@ -1,6 +1,15 @@
 #include "Fcgi.hpp"
 #include "../InputStream.hpp"
 #include "../OutputStream.hpp"
+#include "../Thread.hpp"
+#include "../ThreadPool.hpp"
+#include "../CriticalCode.hpp"
+#include "../Time.hpp"
+#include "../Exception.hpp"
+#if defined(___INANITY_PLATFORM_POSIX)
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
 
 BEGIN_INANITY_NET
 
@@ -119,9 +128,21 @@ bool Fcgi::Request::Accept()
 	return true;
 }
 
+// class Fcgi::Stats
+
+Fcgi::Stats::Stats()
+: failedRequestsCount(0), maxBusyWorkersCount(0) {}
+
+void Fcgi::Stats::AddRequest(long long microseconds, bool failed)
+{
+	times.Add(microseconds);
+	if(failed)
+		++failedRequestsCount;
+}
+
 // class Fcgi
 
-Fcgi::Fcgi(const char* socketName, int backlogSize)
+Fcgi::Fcgi(const char* socketName, int backlogSize) : busyWorkersCount(0), stopping(false)
 {
 	FCGX_Init();
 
@@ -130,6 +151,14 @@ Fcgi::Fcgi(const char* socketName, int backlogSize)
 		THROW("Can't open socket");
 }
 
+Fcgi::~Fcgi()
+{
+	Stop();
+#if defined(___INANITY_PLATFORM_POSIX)
+	close(fd);
+#endif
+}
+
 ptr<Fcgi::Request> Fcgi::Accept()
 {
 	ptr<Request> request = NEW(Request(fd));
@@ -140,4 +169,119 @@ ptr<Fcgi::Request> Fcgi::Accept()
 	return request;
 }
 
+void Fcgi::Start(ptr<RequestHandler> handler, int threadsCount)
+{
+	BEGIN_TRY();
+
+	if(!workers.empty())
+		THROW("Workers are already started");
+	if(stopping)
+		THROW("FCGI handler is stopped");
+
+	if(threadsCount <= 0)
+		threadsCount = ThreadPool::GetHardwareThreadsCount();
+
+	this->handler = handler;
+	workers.resize(threadsCount);
+	for(int i = 0; i < threadsCount; ++i)
+		workers[i] = NEW(Thread(Thread::ThreadHandler::BindCall([this](const Thread::ThreadHandler::Result&)
+		{
+			WorkerRoutine();
+		})));
+
+	END_TRY("Can't start FCGI workers");
+}
+
+void Fcgi::Stop()
+{
+	{
+		CriticalCode cc(criticalSection);
+		if(stopping)
+			return;
+		stopping = true;
+	}
+
+#if defined(___INANITY_PLATFORM_POSIX)
+	// wake up workers blocked in accept
+	shutdown(fd, SHUT_RDWR);
+#else
+	/* Listening socket can't be closed here: Windows version of libfcgi
+	keeps it in global state shared by all workers. Instead the worker
+	holding accept mutex polls shutdown flag with select() every second,
+	and others see the flag when they get the mutex. */
+	FCGX_ShutdownPending();
+#endif
+
+	for(size_t i = 0; i < workers.size(); ++i)
+		if(workers[i])
+			workers[i]->WaitEnd();
+	workers.clear();
+	handler = nullptr;
+}
+
+Fcgi::Stats Fcgi::GetStats()
+{
+	CriticalCode cc(criticalSection);
+	return stats;
+}
+
+void Fcgi::WorkerRoutine()
+{
+	/* Worker touches only its own request, and calls handler by plain
+	pointer (see ThreadPool about reference counters). */
+	RequestHandler* handler = this->handler;
+	const Time::Tick ticksPerSecond = Time::GetTicksPerSecond();
+
+	// request is initialized once, and reused for all accepted requests
+	ptr<Request> request;
+	try
+	{
+		request = NEW(Request(fd));
+	}
+	catch(Exception* exception)
+	{
+		MakePointer(exception);
+		return;
+	}
+
+	for(;;)
+	{
+		if(!request->Accept())
+		{
+			{
+				CriticalCode cc(criticalSection);
+				if(stopping)
+					break;
+			}
+			// accepting may fail because of lack of resources, retry later
+			Thread::Sleep(10);
+			continue;
+		}
+
+		{
+			CriticalCode cc(criticalSection);
+			if(++busyWorkersCount > stats.maxBusyWorkersCount)
+				stats.maxBusyWorkersCount = busyWorkersCount;
+		}
+
+		Time::Tick startTick = Time::GetTick();
+		bool failed = false;
+		try
+		{
+			handler->FireData(request);
+		}
+		catch(Exception* exception)
+		{
+			MakePointer(exception);
+			failed = true;
+		}
+		request->End();
+		long long time = (long long)((double)(Time::GetTick() - startTick) * 1e6 / (double)ticksPerSecond);
+
+		CriticalCode cc(criticalSection);
+		--busyWorkersCount;
+		stats.AddRequest(time, failed);
+	}
+}
+
 END_INANITY_NET
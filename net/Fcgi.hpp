@@ -3,26 +3,70 @@
 
 #include "net.hpp"
 #include "../Handler.hpp"
+#include "../CriticalSection.hpp"
+#include "../TimeHistogram.hpp"
 #include "../deps/fcgi/fcgiapp.h"
+#include <vector>
 
 BEGIN_INANITY
 
 class InputStream;
 class OutputStream;
+class Thread;
 
 END_INANITY
 
 BEGIN_INANITY_NET
 
-/// Simple class for single-threaded FCGI handler.
+/// Simple class for FCGI handler.
+/** Requests could be accepted one at a time with Accept(), or served
+by pool of worker threads started with Start(). Workers accept requests
+concurrently on the same listening socket, each reusing its own request
+object. Connections not accepted yet wait in the queue of listening
+socket, bounded by backlog size. */
 class Fcgi
 {
 private:
 	class InStream;
 	class OutStream;
 
+public:
+	class Request;
+	/// Handler of request in worker thread.
+	/** Called concurrently from all workers. Should output response
+	before returning, and should not keep a reference to request. */
+	typedef DataHandler<ptr<Request> > RequestHandler;
+
+	/// Statistics of requests served by workers.
+	struct Stats
+	{
+		/// Histogram of request handling times (and number of served requests).
+		TimeHistogram times;
+		/// Number of requests handler threw exception for.
+		size_t failedRequestsCount;
+		/// Maximum number of requests handled at once.
+		int maxBusyWorkersCount;
+
+		Stats();
+
+		/// Register a request.
+		void AddRequest(long long microseconds, bool failed);
+	};
+
+private:
 	int fd;
 
+	//*** Worker pool.
+	std::vector<ptr<Thread> > workers;
+	ptr<RequestHandler> handler;
+	CriticalSection criticalSection;
+	/// Protected by critical section.
+	Stats stats;
+	int busyWorkersCount;
+	bool stopping;
+
+	void WorkerRoutine();
+
 public:
 	class Request : public Object
 	{
@@ -54,8 +98,22 @@ public:
 
 public:
 	Fcgi(const char* socketName, int backlogSize);
+	~Fcgi();
 
 	ptr<Request> Accept();
+
+	/// Start worker threads serving requests.
+	/** \param threadsCount Number of workers, 0 for number of hardware threads. */
+	void Start(ptr<RequestHandler> handler, int threadsCount = 0);
+	/// Stop accepting requests, and wait for workers to finish current ones.
+	/** On POSIX listening socket is shut down, waking up workers blocked
+	in accept, so neither Start() nor Accept() could be used anymore.
+	On Windows libfcgi only sets shutdown flag, which accept checks once
+	a second, so Stop() blocks for up to a second before workers exit
+	(TCP sockets only: named pipes are not accepted by libfcgi there). */
+	void Stop();
+	/// Get statistics of workers.
+	Stats GetStats();
 };
 
 END_INANITY_NET
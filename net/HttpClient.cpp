@@ -9,6 +9,8 @@
 #include "../File.hpp"
 #include "../Strings.hpp"
 #include "../Exception.hpp"
+#include <deque>
+#include <vector>
 #include <sstream>
 #endif
 
@@ -76,14 +78,76 @@ void HttpClient::Fetch(ptr<Service> service, const String& url, const String& me
 	END_TRY("Can't fetch http");
 }
 
+// browser pools connections itself
+
+HttpClient::HttpClient(ptr<Service> service, int maxConnectionsPerHost, int maxConnections, int pipelineDepth)
+: service(service), maxConnectionsPerHost(maxConnectionsPerHost), maxConnections(maxConnections), pipelineDepth(pipelineDepth) {}
+
+void HttpClient::Fetch(const String& url, const String& method, const String& data, const String& contentType, ptr<SuccessHandler> handler, ptr<OutputStream> outputStream)
+{
+	Fetch(service, url, method, data, contentType, handler, outputStream);
+}
+
+void HttpClient::Close() {}
+
+int HttpClient::GetOpenedConnectionsCount()
+{
+	return 0;
+}
+
 #else
 
+/// Parse URL and format HTTP request.
+static ptr<File> FormatRequest(const String& url, const String& method, const String& data, const String& contentType, bool keepAlive, String& host, int& port)
+{
+	// разобрать URL
+	http_parser_url parsedUrl;
+	if(http_parser_parse_url(url.c_str(), url.length(), 0, &parsedUrl))
+		THROW("Can't parse url");
+	String schema = "http";
+	if(parsedUrl.field_set & (1 << UF_SCHEMA))
+		schema = url.substr(parsedUrl.field_data[UF_SCHEMA].off, parsedUrl.field_data[UF_SCHEMA].len);
+	host.clear();
+	if(parsedUrl.field_set & (1 << UF_HOST))
+		host = url.substr(parsedUrl.field_data[UF_HOST].off, parsedUrl.field_data[UF_HOST].len);
+	int defaultPort = schema == "https" ? 443 : 80;
+	port = defaultPort;
+	if(parsedUrl.field_set & (1 << UF_PORT))
+		port = parsedUrl.port;
+	String path = "/";
+	if(parsedUrl.field_set & (1 << UF_PATH))
+		path = url.substr(parsedUrl.field_data[UF_PATH].off, parsedUrl.field_data[UF_PATH].len);
+	String query = "";
+	if(parsedUrl.field_set & (1 << UF_QUERY))
+		query = url.substr(parsedUrl.field_data[UF_QUERY].off, parsedUrl.field_data[UF_QUERY].len);
+	if(!query.empty())
+		query = "?" + query;
+
+	// сформировать запрос
+	std::ostringstream request(std::ios::out | std::ios::binary);
+	request << (method.length() ? method : "GET") << " " << path << query << " HTTP/1.1\r\n";
+	request << "Connection: " << (keepAlive ? "keep-alive" : "close") << "\r\n";
+	request << "Host: " << host;
+	if(port != defaultPort)
+		request << ":" << port;
+	request << "\r\n";
+	request << "User-Agent: Inanity HttpClient/2.0\r\n";
+	if(contentType.length())
+		request << "Content-Type: " << contentType << "\r\n";
+	request << "Content-Length: " << data.length() << "\r\n";
+	request << "\r\n";
+	request << data;
+
+	return Strings::String2File(request.str());
+}
+
 class HttpClientRequest : public Object
 {
 private:
 	ptr<File> requestFile;
 	ptr<SuccessHandler> handler;
 	ptr<HttpStream> outputStream;
+	ptr<TcpSocket> socket;
 
 public:
 	HttpClientRequest(ptr<Service> service, const String& host, int port, ptr<File> requestFile, ptr<SuccessHandler> handler, ptr<OutputStream> outputStream)
@@ -97,7 +161,6 @@ private:
 	{
 		ptr<HttpClientRequest> self = this;
 
-		ptr<TcpSocket> socket;
 		try
 		{
 			socket = result.GetData();
@@ -112,13 +175,18 @@ private:
 		catch(Exception* exception)
 		{
 			if(socket)
+			{
 				socket->Close();
+				socket = nullptr;
+			}
 			handler->FireError(exception);
 		}
 	}
 
 	void OnReceive(const TcpSocket::ReceiveHandler::Result& result)
 	{
+		ptr<HttpClientRequest> self = this;
+
 		try
 		{
 			ptr<File> data = result.GetData();
@@ -129,6 +197,7 @@ private:
 			else
 			{
 				// корректный конец данных
+				socket = nullptr;
 				outputStream->End();
 				if(outputStream->IsCompleted())
 					handler->FireSuccess();
@@ -138,7 +207,12 @@ private:
 		}
 		catch(Exception* exception)
 		{
-			// ошибка получения
+			// ошибка получения или разбора, больше данные не нужны
+			if(socket)
+			{
+				socket->Close();
+				socket = nullptr;
+			}
 			handler->FireError(exception);
 		}
 	}
@@ -148,52 +222,428 @@ void HttpClient::Fetch(ptr<Service> service, const String& url, const String& me
 {
 	BEGIN_TRY();
 
-	// разобрать URL
-	http_parser_url parsedUrl;
-	if(http_parser_parse_url(url.c_str(), url.length(), 0, &parsedUrl))
-		THROW("Can't parse url");
-	String schema = "http";
-	if(parsedUrl.field_set & (1 << UF_SCHEMA))
-		schema = url.substr(parsedUrl.field_data[UF_SCHEMA].off, parsedUrl.field_data[UF_SCHEMA].len);
 	String host;
-	if(parsedUrl.field_set & (1 << UF_HOST))
-		host = url.substr(parsedUrl.field_data[UF_HOST].off, parsedUrl.field_data[UF_HOST].len);
-	int defaultPort = schema == "https" ? 443 : 80, port = defaultPort;
-	if(parsedUrl.field_set & (1 << UF_PORT))
-		port = parsedUrl.port;
-	String path = "/";
-	if(parsedUrl.field_set & (1 << UF_PATH))
-		path = url.substr(parsedUrl.field_data[UF_PATH].off, parsedUrl.field_data[UF_PATH].len);
-	String query = "";
-	if(parsedUrl.field_set & (1 << UF_QUERY))
-		query = url.substr(parsedUrl.field_data[UF_QUERY].off, parsedUrl.field_data[UF_QUERY].len);
-	if(!query.empty())
-		query = "?" + query;
+	int port;
+	ptr<File> requestFile = FormatRequest(url, method, data, contentType, false, host, port);
 
-	// сформировать запрос
-	std::ostringstream request(std::ios::out | std::ios::binary);
-	request << method << " " << path << query << " HTTP/1.1\r\n";
-	request << "Connection: close\r\n";
-	request << "Host: " << host;
-	if(port != defaultPort)
-		request << ":" << port;
-	request << "\r\n";
-	request << "User-Agent: Inanity HttpClient/2.0\r\n";
-	if(contentType.length())
-		request << "Content-Type: " << contentType << "\r\n";
-	request << "Content-Length: " << data.length() << "\r\n";
-	request << "\r\n";
-	request << data;
+	MakePointer(NEW(HttpClientRequest(service, host, port, requestFile, handler, outputStream)));
 
-	ptr<File> requestFile = Strings::String2File(request.str());
+	END_TRY("Can't fetch http");
+}
 
-	MakePointer(NEW(HttpClientRequest(service, host, port, requestFile, handler, outputStream)));
+/// Request to be sent by pooled connection.
+class HttpClient::Request : public Object
+{
+public:
+	ptr<File> requestFile;
+	ptr<SuccessHandler> handler;
+	ptr<OutputStream> outputStream;
+	/// Is it HEAD request (response has no body).
+	bool bodyless;
+	/// Could request be pipelined and sent again (GET or HEAD).
+	bool idempotent;
+	/// Was request already sent again after connection failure.
+	bool retried;
+
+	Request(ptr<File> requestFile, ptr<SuccessHandler> handler, ptr<OutputStream> outputStream, bool bodyless, bool idempotent)
+	: requestFile(requestFile), handler(handler), outputStream(outputStream), bodyless(bodyless), idempotent(idempotent), retried(false) {}
+};
+
+/// Host with its connections.
+class HttpClient::Host : public Object
+{
+public:
+	String name;
+	int port;
+	/// Requests waiting for connection.
+	std::deque<ptr<Request> > pendingRequests;
+	std::vector<ptr<Connection> > connections;
+
+	Host(const String& name, int port) : name(name), port(port) {}
+};
+
+/// Persistent connection to host.
+/** Retains reference to client until closed. */
+class HttpClient::Connection : public Object
+{
+private:
+	ptr<HttpClient> client;
+	ptr<Host> host;
+	ptr<TcpSocket> socket;
+	ptr<HttpStream> stream;
+	/// Sent requests waiting for responses, in order.
+	std::deque<ptr<Request> > requests;
+	/// Completed requests, and status codes of responses.
+	/** They are accumulated during parsing, and handlers are called after it. */
+	std::vector<std::pair<ptr<Request>, int> > completedRequests;
+	bool connected;
+	/// Connection accepts no more requests, and should be closed.
+	bool closing;
+	bool finished;
+
+public:
+	Connection(ptr<HttpClient> client, ptr<Host> host)
+	: client(client), host(host), connected(false), closing(false), finished(false) {}
+
+	void Connect()
+	{
+		stream = HttpStream::CreateResponseStream(nullptr);
+		stream->SetMessageHandler(Handler::Bind(MakePointer(this), &Connection::OnMessage));
+		client->service->ConnectTcp(host->name, host->port, Service::TcpSocketHandler::Bind(MakePointer(this), &Connection::OnConnect));
+	}
+
+	bool IsConnected() const
+	{
+		return connected;
+	}
+
+	bool IsIdle() const
+	{
+		return connected && !closing && requests.empty();
+	}
+
+	size_t GetRequestsCount() const
+	{
+		return requests.size();
+	}
+
+	/// Can request be sent right now.
+	bool CanSend(Request* request) const
+	{
+		if(!connected || closing)
+			return false;
+		if(requests.empty())
+			return true;
+		// pipeline only idempotent requests
+		if((int)requests.size() >= client->pipelineDepth || !request->idempotent)
+			return false;
+		for(size_t i = 0; i < requests.size(); ++i)
+			if(!requests[i]->idempotent)
+				return false;
+		return true;
+	}
+
+	void Send(ptr<Request> request)
+	{
+		if(requests.empty())
+			stream->SetOutputStream(request->outputStream, request->bodyless);
+		requests.push_back(request);
+		socket->Send(request->requestFile);
+	}
+
+	/// Close idle connection, to give its slot to other host.
+	void CloseIdle()
+	{
+		closing = true;
+		finished = true;
+		Remove();
+		stream->SetMessageHandler(nullptr);
+		socket->Close();
+	}
+
+	/// Close connection, and send its requests again or fail them.
+	void Finish(ptr<Exception> exception)
+	{
+		ptr<Connection> self = this;
+
+		std::vector<ptr<Request> > failedRequests;
+		if(finished)
+			return;
+		finished = true;
+
+		Remove();
+
+		// response of the first request could be partially written already
+		for(size_t i = requests.size(); i > 0; --i)
+		{
+			ptr<Request> request = requests[i - 1];
+			if((i == 1 && stream->IsInMessage()) || !request->idempotent || request->retried || client->closed)
+				failedRequests.push_back(request);
+			else
+			{
+				request->retried = true;
+				host->pendingRequests.push_front(request);
+			}
+		}
+		requests.clear();
+
+		// if host is not reachable, fail all its requests
+		if((!connected && host->connections.empty()) || client->closed)
+		{
+			failedRequests.insert(failedRequests.end(), host->pendingRequests.begin(), host->pendingRequests.end());
+			host->pendingRequests.clear();
+		}
+
+		if(!client->closed)
+			client->DispatchAll();
+
+		stream->SetMessageHandler(nullptr);
+		if(socket)
+			socket->Close();
+
+		if(!exception)
+			exception = NEW(Exception("HTTP connection closed"));
+		for(size_t i = 0; i < failedRequests.size(); ++i)
+			failedRequests[i]->handler->FireError(NEW(Exception("Can't fetch http", exception)));
+	}
+
+private:
+	/// Remove connection from host, and release its slot.
+	void Remove()
+	{
+		for(size_t i = 0; i < host->connections.size(); ++i)
+			if((Connection*)host->connections[i] == this)
+			{
+				host->connections.erase(host->connections.begin() + i);
+				break;
+			}
+		--client->connectionsCount;
+	}
+
+	void OnConnect(const Service::TcpSocketHandler::Result& result)
+	{
+		ptr<Connection> self = this;
+
+		try
+		{
+			ptr<TcpSocket> socket = result.GetData();
+
+			socket->SetNoDelay(true);
+			socket->SetReceiveHandler(TcpSocket::ReceiveHandler::Bind(MakePointer(this), &Connection::OnReceive));
+
+			this->socket = socket;
+			// connection could be closed while connecting
+			if(finished)
+				socket->Close();
+			else
+			{
+				connected = true;
+				client->Dispatch(host);
+			}
+		}
+		catch(Exception* exception)
+		{
+			Finish(exception);
+		}
+	}
+
+	void OnReceive(const TcpSocket::ReceiveHandler::Result& result)
+	{
+		ptr<Connection> self = this;
+
+		ptr<Exception> exception;
+		bool ended = false;
+		try
+		{
+			ptr<File> data = result.GetData();
+
+			if(data)
+				stream->OutputStream::Write(data);
+			else
+			{
+				// response could be delimited by end of connection
+				stream->End();
+				ended = true;
+			}
+		}
+		catch(Exception* e)
+		{
+			exception = e;
+		}
+
+		// call handlers of completed requests
+		std::vector<std::pair<ptr<Request>, int> > completedRequests;
+		std::swap(completedRequests, this->completedRequests);
+		for(size_t i = 0; i < completedRequests.size(); ++i)
+		{
+			int statusCode = completedRequests[i].second;
+			if(statusCode >= 200 && statusCode <= 299)
+				completedRequests[i].first->handler->FireSuccess();
+			else
+			{
+				std::ostringstream s;
+				s << "HTTP status " << statusCode;
+				completedRequests[i].first->handler->FireError(NEW(Exception(s.str())));
+			}
+		}
+
+		if(exception || ended || closing)
+			Finish(exception);
+	}
+
+	/// Called by stream when response is completed.
+	void OnMessage()
+	{
+		if(requests.empty())
+		{
+			// unexpected response
+			closing = true;
+			return;
+		}
+
+		completedRequests.push_back(std::make_pair(requests.front(), stream->GetStatusCode()));
+		requests.pop_front();
+
+		if(requests.empty())
+			stream->SetOutputStream(nullptr);
+		else
+			stream->SetOutputStream(requests.front()->outputStream, requests.front()->bodyless);
+
+		if(!stream->ShouldKeepAlive())
+			closing = true;
+		else if(!client->closed)
+		{
+			client->Dispatch(host);
+			// give connection slot to other hosts if they wait for it
+			if(requests.empty() && client->connectionsCount >= client->maxConnections && client->HasPendingRequests())
+				closing = true;
+		}
+	}
+};
+
+HttpClient::HttpClient(ptr<Service> service, int maxConnectionsPerHost, int maxConnections, int pipelineDepth)
+: service(service), maxConnectionsPerHost(maxConnectionsPerHost), maxConnections(maxConnections), pipelineDepth(pipelineDepth),
+	connectionsCount(0), openedConnectionsCount(0), closed(false) {}
+
+void HttpClient::Fetch(const String& url, const String& method, const String& data, const String& contentType, ptr<SuccessHandler> handler, ptr<OutputStream> outputStream)
+{
+	BEGIN_TRY();
+
+	String hostName;
+	int port;
+	ptr<File> requestFile = FormatRequest(url, method, data, contentType, true, hostName, port);
+	bool head = method == "HEAD";
+	ptr<Request> request = NEW(Request(requestFile, handler, outputStream, head, head || method.empty() || method == "GET"));
+
+	std::ostringstream key;
+	key << hostName << ":" << port;
+
+	if(closed)
+		THROW("HTTP client is closed");
+
+	ptr<Host>& host = hosts[key.str()];
+	if(!host)
+		host = NEW(Host(hostName, port));
+
+	host->pendingRequests.push_back(request);
+	Dispatch(host);
 
 	END_TRY("Can't fetch http");
 }
 
+void HttpClient::Dispatch(Host* host)
+{
+	size_t connectingCount = 0;
+	for(size_t i = 0; i < host->connections.size(); ++i)
+		if(!host->connections[i]->IsConnected())
+			++connectingCount;
+
+	while(!host->pendingRequests.empty())
+	{
+		ptr<Request> request = host->pendingRequests.front();
+
+		// choose idle connection, or least loaded one for pipelining
+		Connection* connection = nullptr;
+		for(size_t i = 0; i < host->connections.size(); ++i)
+		{
+			Connection* c = host->connections[i];
+			if(c->CanSend(request) && (!connection || c->GetRequestsCount() < connection->GetRequestsCount()))
+				connection = c;
+		}
+		bool idle = connection && connection->IsIdle();
+
+		// new connection is better than pipelining
+		if(!idle && host->pendingRequests.size() > connectingCount
+			&& (int)host->connections.size() < maxConnectionsPerHost
+			// host without connections takes slot of idle connection of other host,
+			// otherwise its requests would wait until some connection closes
+			&& (connectionsCount < maxConnections || (host->connections.empty() && CloseIdleConnection(host))))
+		{
+			ptr<Connection> newConnection = NEW(Connection(this, host));
+			host->connections.push_back(newConnection);
+			++connectionsCount;
+			++openedConnectionsCount;
+			++connectingCount;
+			newConnection->Connect();
+			continue;
+		}
+
+		// the rest of requests wait for connecting connections
+		if(!connection || (!idle && host->pendingRequests.size() <= connectingCount))
+			break;
+
+		host->pendingRequests.pop_front();
+		connection->Send(request);
+	}
+}
+
+void HttpClient::DispatchAll()
+{
+	for(std::unordered_map<String, ptr<Host> >::const_iterator i = hosts.begin(); i != hosts.end(); ++i)
+		Dispatch(i->second);
+}
+
+bool HttpClient::CloseIdleConnection(Host* exceptHost)
+{
+	for(std::unordered_map<String, ptr<Host> >::const_iterator i = hosts.begin(); i != hosts.end(); ++i)
+	{
+		Host* host = i->second;
+		if(host == exceptHost)
+			continue;
+		for(size_t j = 0; j < host->connections.size(); ++j)
+			if(host->connections[j]->IsIdle())
+			{
+				// connection is removed from host, so keep it alive until closed
+				ptr<Connection> connection = host->connections[j];
+				connection->CloseIdle();
+				return true;
+			}
+	}
+	return false;
+}
+
+bool HttpClient::HasPendingRequests() const
+{
+	for(std::unordered_map<String, ptr<Host> >::const_iterator i = hosts.begin(); i != hosts.end(); ++i)
+		if(!i->second->pendingRequests.empty())
+			return true;
+	return false;
+}
+
+void HttpClient::Close()
+{
+	ptr<HttpClient> self = this;
+
+	std::vector<ptr<Connection> > connections;
+	std::vector<ptr<Request> > requests;
+	closed = true;
+	for(std::unordered_map<String, ptr<Host> >::const_iterator i = hosts.begin(); i != hosts.end(); ++i)
+	{
+		Host* host = i->second;
+		connections.insert(connections.end(), host->connections.begin(), host->connections.end());
+		requests.insert(requests.end(), host->pendingRequests.begin(), host->pendingRequests.end());
+		host->pendingRequests.clear();
+	}
+
+	ptr<Exception> exception = NEW(Exception("HTTP client is closed"));
+	for(size_t i = 0; i < connections.size(); ++i)
+		connections[i]->Finish(exception);
+	for(size_t i = 0; i < requests.size(); ++i)
+		requests[i]->handler->FireError(NEW(Exception("Can't fetch http", exception)));
+}
+
+int HttpClient::GetOpenedConnectionsCount()
+{
+	return openedConnectionsCount;
+}
+
 #endif
 
+void HttpClient::Get(const String& url, ptr<SuccessHandler> handler, ptr<OutputStream> outputStream)
+{
+	Fetch(url, "GET", "", "", handler, outputStream);
+}
+
 void HttpClient::Get(ptr<Service> service, const String& url, ptr<SuccessHandler> handler, ptr<OutputStream> outputStream)
 {
 	return Fetch(service, url, "", "", "", handler, outputStream);
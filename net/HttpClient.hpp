@@ -4,6 +4,9 @@
 #include "net.hpp"
 #include "../Handler.hpp"
 #include "../String.hpp"
+#if !defined(___INANITY_PLATFORM_EMSCRIPTEN)
+#include <unordered_map>
+#endif
 
 BEGIN_INANITY
 
@@ -15,10 +18,69 @@ BEGIN_INANITY_NET
 
 class Service;
 
-/// HTTP client utility class.
+/// HTTP client.
+/** Static methods make one-shot requests, each over its own connection.
+Instance of client keeps per-host pool of persistent (HTTP/1.1 keep-alive)
+connections, limits number of connections (idle connection of one host
+is closed when other host needs a slot), and optionally pipelines
+idempotent requests (GET and HEAD). Response body (chunked too) is written
+into output stream as it arrives.
+Client retains a reference to itself while it has open connections,
+use Close() to close them. Client is not thread-safe (see ThreadPool
+about reference counters), so it should be used only in the thread
+running service (handlers are called there), or before service runs. */
 class HttpClient : public Object
 {
+#if !defined(___INANITY_PLATFORM_EMSCRIPTEN)
+private:
+	class Request;
+	class Host;
+	class Connection;
+#endif
+
+private:
+	ptr<Service> service;
+	/// Limits of connections.
+	int maxConnectionsPerHost, maxConnections;
+	/// Maximum number of requests sent to connection at once.
+	int pipelineDepth;
+
+#if !defined(___INANITY_PLATFORM_EMSCRIPTEN)
+	/// Hosts by "host:port".
+	std::unordered_map<String, ptr<Host> > hosts;
+	/// Number of open (or opening) connections.
+	int connectionsCount;
+	/// Number of connections opened ever.
+	int openedConnectionsCount;
+	bool closed;
+
+	/// Send pending requests of host, and open new connections if needed.
+	void Dispatch(Host* host);
+	/// Dispatch all hosts.
+	void DispatchAll();
+	/// Close idle connection of any host except given one.
+	/** \returns true if connection was closed, and its slot is free. */
+	bool CloseIdleConnection(Host* exceptHost);
+	/// Is there any host with pending requests.
+	bool HasPendingRequests() const;
+#endif
+
 public:
+	/// Create client.
+	/** \param pipelineDepth 1 disables pipelining. */
+	HttpClient(ptr<Service> service, int maxConnectionsPerHost = 6, int maxConnections = 32, int pipelineDepth = 1);
+
+	/// Make HTTP request using pooled connection.
+	void Fetch(const String& url, const String& method, const String& data, const String& contentType, ptr<SuccessHandler> handler, ptr<OutputStream> outputStream);
+	/// Make GET request using pooled connection.
+	void Get(const String& url, ptr<SuccessHandler> handler, ptr<OutputStream> outputStream);
+	/// Close all connections.
+	/** Requests not completed yet fail. */
+	void Close();
+
+	/// Get number of connections opened during lifetime of client.
+	int GetOpenedConnectionsCount();
+
 	/// General method for making HTTP request.
 	static void Fetch(ptr<Service> service, const String& url, const String& method, const String& data, const String& contentType, ptr<SuccessHandler> handler, ptr<OutputStream> outputStream);
 	/// Simple method for GET request.
@@ -0,0 +1,642 @@
+#include "HttpServer.hpp"
+#include "Service.hpp"
+#include "TcpListener.hpp"
+#include "TcpSocket.hpp"
+#include "../FileSystem.hpp"
+#include "../MemoryStream.hpp"
+#include "../EmptyFile.hpp"
+#include "../PartFile.hpp"
+#include "../Strings.hpp"
+#include "../Exception.hpp"
+#include <algorithm>
+#include <deque>
+#include <cctype>
+#include <cstdlib>
+#include <sstream>
+
+BEGIN_INANITY_NET
+
+/// Stream for body of request, limiting its size.
+/** Data over the limit is dropped instead of throwing exception,
+because exceptions can't go through parser. */
+class HttpServer::BodyStream : public OutputStream
+{
+private:
+	ptr<MemoryStream> stream;
+	size_t size;
+	size_t maxSize;
+
+public:
+	BodyStream(size_t maxSize)
+	: stream(NEW(MemoryStream())), size(0), maxSize(maxSize) {}
+
+	void Write(const void* data, size_t size)
+	{
+		this->size += size;
+		if(this->size <= maxSize)
+			stream->Write(data, size);
+	}
+
+	size_t GetSize() const
+	{
+		return size;
+	}
+
+	bool IsTooLarge() const
+	{
+		return size > maxSize;
+	}
+
+	ptr<File> ToFile()
+	{
+		return stream->ToFile();
+	}
+};
+
+/// Connection of HTTP server.
+/** Requests are parsed and responded in the thread of service. */
+class HttpServer::Connection : public Object
+{
+private:
+	ptr<HttpServer> server;
+	ptr<TcpSocket> socket;
+	ptr<HttpStream> stream;
+	/// Stream for body of current request.
+	ptr<BodyStream> bodyStream;
+	/// Requests waiting for responses, in order.
+	std::deque<ptr<Request> > requests;
+	/// Requests parsed during current receive.
+	std::vector<ptr<Request> > newRequests;
+	/// Request to respond with error status, closing connection.
+	ptr<Request> errorRequest;
+	int errorStatus;
+	/// No more requests are accepted.
+	bool closing;
+	/// Sending side is closed.
+	bool ended;
+
+public:
+	Connection(ptr<HttpServer> server, ptr<TcpSocket> socket)
+	: server(server), socket(socket), stream(HttpStream::CreateRequestStream(nullptr)),
+		bodyStream(NEW(BodyStream(server->maxBodySize))), errorStatus(0), closing(false), ended(false) {}
+
+	void Start()
+	{
+		stream->SetOutputStream(bodyStream);
+		stream->SetMessageHandler(Handler::Bind(MakePointer(this), &Connection::OnMessage));
+		socket->SetNoDelay(true);
+		socket->SetReceiveHandler(TcpSocket::ReceiveHandler::Bind(MakePointer(this), &Connection::OnReceive));
+	}
+
+	/// Mark request as responded, and send responses which are ready, in order.
+	void Flush(Request* respondedRequest)
+	{
+		respondedRequest->responded = true;
+
+		try
+		{
+			while(!requests.empty() && requests.front()->responded && !ended)
+			{
+				ptr<Request> request = requests.front();
+				requests.pop_front();
+
+				// head and body are sent as separate files, body is not copied
+				socket->Send(request->responseHead);
+				if(request->responseBody)
+					socket->Send(request->responseBody);
+
+				if(!request->keepAlive)
+					End();
+			}
+			if(requests.empty() && closing)
+				End();
+		}
+		catch(Exception* exception)
+		{
+			// connection is broken, responses are not needed anymore
+			MakePointer(exception);
+			requests.clear();
+			ended = true;
+			socket->Close();
+		}
+	}
+
+private:
+	/// Close sending side.
+	void End()
+	{
+		if(!ended)
+		{
+			ended = true;
+			closing = true;
+			requests.clear();
+			socket->End();
+		}
+	}
+
+	/// Stop accepting requests, and queue response with error status.
+	/** Error is sent after responses to previous requests, and then
+	connection is closed. */
+	void Fail(int status)
+	{
+		if(closing)
+			return;
+		closing = true;
+		errorRequest = NEW(Request(this, String(), String(), HttpStream::Headers(), nullptr, false));
+		errorStatus = status;
+		requests.push_back(errorRequest);
+	}
+
+	void OnReceive(const TcpSocket::ReceiveHandler::Result& result)
+	{
+		ptr<Connection> self = this;
+
+		ptr<File> data;
+		try
+		{
+			data = result.GetData();
+		}
+		catch(Exception* exception)
+		{
+			// receiving error, responses are not needed anymore
+			MakePointer(exception);
+			stream->SetMessageHandler(nullptr);
+			closing = true;
+			ended = true;
+			requests.clear();
+			socket->Close();
+			return;
+		}
+
+		try
+		{
+			if(data)
+			{
+				// data after last accepted request is ignored
+				if(!closing)
+				{
+					stream->OutputStream::Write(data);
+					if(bodyStream->IsTooLarge())
+						Fail(413);
+				}
+			}
+			else
+			{
+				// client closed its side, finish after responses
+				stream->SetMessageHandler(nullptr);
+				closing = true;
+				if(requests.empty())
+					End();
+			}
+		}
+		catch(Exception* exception)
+		{
+			// bad request
+			MakePointer(exception);
+			Fail(400);
+		}
+
+		// process requests outside of parser
+		std::vector<ptr<Request> > newRequests;
+		ptr<Request> errorRequest;
+		std::swap(newRequests, this->newRequests);
+		std::swap(errorRequest, this->errorRequest);
+		for(size_t i = 0; i < newRequests.size(); ++i)
+			server->Process(newRequests[i]);
+		if(errorRequest)
+		{
+			stream->SetMessageHandler(nullptr);
+			errorRequest->Respond(errorStatus);
+		}
+	}
+
+	/// Called by stream when request is parsed.
+	void OnMessage()
+	{
+		// requests after the one closing connection are ignored
+		if(closing)
+			return;
+
+		// whole body could come in one receive
+		if(bodyStream->IsTooLarge())
+		{
+			Fail(413);
+			return;
+		}
+
+		ptr<File> body;
+		if(bodyStream->GetSize())
+		{
+			body = bodyStream->ToFile();
+			bodyStream = NEW(BodyStream(server->maxBodySize));
+			stream->SetOutputStream(bodyStream);
+		}
+
+		bool keepAlive = stream->ShouldKeepAlive();
+		ptr<Request> request = NEW(Request(this, stream->GetMethod(), stream->GetUrl(), stream->GetHeaders(), body, keepAlive));
+		requests.push_back(request);
+		newRequests.push_back(request);
+
+		if(!keepAlive)
+			closing = true;
+	}
+};
+
+/// Handler serving files of file system.
+class HttpServer::FileSystemRoute : public HttpServer::RequestHandler
+{
+private:
+	String prefix;
+	ptr<FileSystem> fileSystem;
+
+	static int DecodeHex(char c)
+	{
+		if(c >= '0' && c <= '9') return c - '0';
+		if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+		if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+		return -1;
+	}
+
+	/// Does path have ".." segment, going to parent folder.
+	static bool HasParentSegment(const String& path)
+	{
+		size_t begin = 0;
+		for(;;)
+		{
+			size_t end = path.find_first_of("/\\", begin);
+			size_t length = (end == String::npos ? path.length() : end) - begin;
+			if(length == 2 && path.compare(begin, 2, "..") == 0)
+				return true;
+			if(end == String::npos)
+				return false;
+			begin = end + 1;
+		}
+	}
+
+	/// Decode percent-encoded path, returns false if it's invalid.
+	static bool DecodePath(const String& path, String& result)
+	{
+		result.clear();
+		for(size_t i = 0; i < path.length(); ++i)
+			if(path[i] == '%')
+			{
+				if(i + 2 >= path.length())
+					return false;
+				int a = DecodeHex(path[i + 1]), b = DecodeHex(path[i + 2]);
+				if(a < 0 || b < 0 || (a == 0 && b == 0))
+					return false;
+				result += (char)(a * 16 + b);
+				i += 2;
+			}
+			else
+				result += path[i];
+		return true;
+	}
+
+public:
+	FileSystemRoute(const String& prefix, ptr<FileSystem> fileSystem)
+	: prefix(prefix), fileSystem(fileSystem) {}
+
+	void OnData(ptr<Request> request)
+	{
+		if(request->GetMethod() != "GET" && request->GetMethod() != "HEAD")
+		{
+			request->AddHeader("Allow", "GET, HEAD");
+			request->Respond(405);
+			return;
+		}
+
+		String name;
+		if(!DecodePath(request->GetPath().substr(prefix.length()), name) || HasParentSegment(name))
+		{
+			request->Respond(400);
+			return;
+		}
+		if(name.empty() || name[0] != '/')
+			name = "/" + name;
+
+		ptr<File> file;
+		try
+		{
+			file = fileSystem->TryLoadFile(name);
+		}
+		catch(Exception* exception)
+		{
+			MakePointer(exception);
+		}
+
+		if(file)
+			request->Respond(200, file, GetContentType(name));
+		else
+			request->Respond(404);
+	}
+
+	void OnError(ptr<Exception>) {}
+};
+
+HttpServer::Route::Route(const String& prefix, ptr<RequestHandler> handler)
+: prefix(prefix), handler(handler) {}
+
+HttpServer::HttpServer(ptr<Service> service, int port, size_t maxBodySize)
+: requestsCount(0), maxBodySize(maxBodySize)
+{
+	BEGIN_TRY();
+
+	listener = service->ListenTcp(port, Service::TcpSocketHandler::Bind(MakePointer(this), &HttpServer::OnSocket));
+
+	END_TRY("Can't create HTTP server");
+}
+
+void HttpServer::AddRoute(const String& prefix, ptr<RequestHandler> handler)
+{
+	size_t i;
+	for(i = 0; i < routes.size() && routes[i].prefix.length() >= prefix.length(); ++i);
+	routes.insert(routes.begin() + i, Route(prefix, handler));
+}
+
+void HttpServer::AddFileSystem(const String& prefix, ptr<FileSystem> fileSystem)
+{
+	AddRoute(prefix, NEW(FileSystemRoute(prefix, fileSystem)));
+}
+
+void HttpServer::Close()
+{
+	if(listener)
+	{
+		listener->Close();
+		listener = nullptr;
+	}
+}
+
+int HttpServer::GetRequestsCount()
+{
+	return requestsCount;
+}
+
+void HttpServer::OnSocket(const DataHandler<ptr<TcpSocket> >::Result& result)
+{
+	try
+	{
+		MakePointer(NEW(Connection(this, result.GetData())))->Start();
+	}
+	catch(Exception* exception)
+	{
+		// failed connection doesn't stop server
+		MakePointer(exception);
+	}
+}
+
+void HttpServer::Process(ptr<Request> request)
+{
+	++requestsCount;
+	ptr<RequestHandler> handler;
+	for(size_t i = 0; i < routes.size(); ++i)
+		if(MatchPrefix(request->GetPath(), routes[i].prefix))
+		{
+			handler = routes[i].handler;
+			break;
+		}
+
+	if(!handler)
+	{
+		request->Respond(404);
+		return;
+	}
+
+	try
+	{
+		handler->FireData(request);
+	}
+	catch(Exception* exception)
+	{
+		MakePointer(exception);
+		try
+		{
+			request->Respond(500);
+		}
+		catch(Exception* exception)
+		{
+			// already responded
+			MakePointer(exception);
+		}
+	}
+}
+
+bool HttpServer::MatchPrefix(const String& path, const String& prefix)
+{
+	size_t length = prefix.length();
+	return path.compare(0, length, prefix) == 0
+		&& (path.length() == length || !length || prefix[length - 1] == '/' || path[length] == '/');
+}
+
+const char* HttpServer::GetContentType(const String& fileName)
+{
+	static const char* const types[][2] =
+	{
+		{ ".html", "text/html; charset=utf-8" },
+		{ ".htm", "text/html; charset=utf-8" },
+		{ ".css", "text/css" },
+		{ ".js", "application/javascript" },
+		{ ".json", "application/json" },
+		{ ".txt", "text/plain; charset=utf-8" },
+		{ ".xml", "application/xml" },
+		{ ".png", "image/png" },
+		{ ".jpg", "image/jpeg" },
+		{ ".jpeg", "image/jpeg" },
+		{ ".gif", "image/gif" },
+		{ ".svg", "image/svg+xml" },
+		{ ".ico", "image/x-icon" },
+		{ ".wasm", "application/wasm" },
+		{ ".ogg", "audio/ogg" },
+		{ ".wav", "audio/wav" }
+	};
+
+	size_t dot = fileName.rfind('.');
+	if(dot != String::npos)
+	{
+		String extension = fileName.substr(dot);
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		for(size_t i = 0; i < sizeof(types) / sizeof(types[0]); ++i)
+			if(extension == types[i][0])
+				return types[i][1];
+	}
+	return "application/octet-stream";
+}
+
+//** HttpServer::Request's methods.
+
+HttpServer::Request::Request(ptr<Connection> connection, const String& method, const String& url, const HttpStream::Headers& headers, ptr<File> body, bool keepAlive)
+: connection(connection), method(method), url(url), headers(headers), body(body), keepAlive(keepAlive), responded(false)
+{
+	size_t queryBegin = url.find('?');
+	path = url.substr(0, queryBegin);
+	if(queryBegin != String::npos)
+		query = url.substr(queryBegin + 1);
+}
+
+const String& HttpServer::Request::GetMethod() const
+{
+	return method;
+}
+
+const String& HttpServer::Request::GetUrl() const
+{
+	return url;
+}
+
+const String& HttpServer::Request::GetPath() const
+{
+	return path;
+}
+
+const String& HttpServer::Request::GetQuery() const
+{
+	return query;
+}
+
+const HttpStream::Headers& HttpServer::Request::GetHeaders() const
+{
+	return headers;
+}
+
+String HttpServer::Request::GetHeader(const String& name) const
+{
+	for(size_t i = 0; i < headers.size(); ++i)
+	{
+		const String& field = headers[i].first;
+		if(field.length() != name.length())
+			continue;
+		size_t j;
+		for(j = 0; j < name.length() && tolower((unsigned char)field[j]) == tolower((unsigned char)name[j]); ++j);
+		if(j == name.length())
+			return headers[i].second;
+	}
+	return String();
+}
+
+ptr<File> HttpServer::Request::GetBody() const
+{
+	return body;
+}
+
+void HttpServer::Request::AddHeader(const String& name, const String& value)
+{
+	responseHeaders += name + ": " + value + "\r\n";
+}
+
+bool HttpServer::Request::ParseRange(size_t size, size_t& begin, size_t& end) const
+{
+	String range = GetHeader("Range");
+	// only single range of bytes is supported
+	if(range.compare(0, 6, "bytes=") != 0 || range.find(',') != String::npos)
+		return true;
+
+	const char* s = range.c_str() + 6;
+	char* e;
+	if(*s == '-')
+	{
+		// suffix of given length
+		unsigned long long length = strtoull(s + 1, &e, 10);
+		if(e == s + 1 || *e)
+			return true;
+		if(!length || !size)
+			return false;
+		begin = length < size ? size - (size_t)length : 0;
+		end = size;
+		return true;
+	}
+
+	unsigned long long first = strtoull(s, &e, 10);
+	if(e == s || *e != '-')
+		return true;
+	s = e + 1;
+	unsigned long long last = size ? size - 1 : 0;
+	if(*s)
+	{
+		last = strtoull(s, &e, 10);
+		if(e == s || *e || last < first)
+			return true;
+	}
+	if(first >= size)
+		return false;
+	begin = (size_t)first;
+	end = (size_t)std::min<unsigned long long>(last + 1, size);
+	return true;
+}
+
+void HttpServer::Request::Respond(int status, ptr<File> body, const String& contentType)
+{
+	if(!connection)
+		THROW("HTTP request is already responded");
+
+	size_t size = body ? body->GetSize() : 0;
+	std::ostringstream head(std::ios::out | std::ios::binary);
+
+	// apply byte range
+	if(status == 200 && body)
+	{
+		size_t begin = 0, end = size;
+		if(!ParseRange(size, begin, end))
+		{
+			std::ostringstream s;
+			s << "bytes */" << size;
+			AddHeader("Content-Range", s.str());
+			status = 416;
+			body = nullptr;
+			size = 0;
+		}
+		else if(begin != 0 || end != size)
+		{
+			std::ostringstream s;
+			s << "bytes " << begin << "-" << (end - 1) << "/" << size;
+			AddHeader("Content-Range", s.str());
+			status = 206;
+			body = NEW(PartFile(body, begin, end - begin));
+			size = end - begin;
+		}
+		AddHeader("Accept-Ranges", "bytes");
+	}
+
+	const char* statusText;
+	switch(status)
+	{
+	case 200: statusText = "OK"; break;
+	case 204: statusText = "No Content"; break;
+	case 206: statusText = "Partial Content"; break;
+	case 301: statusText = "Moved Permanently"; break;
+	case 302: statusText = "Found"; break;
+	case 304: statusText = "Not Modified"; break;
+	case 400: statusText = "Bad Request"; break;
+	case 403: statusText = "Forbidden"; break;
+	case 404: statusText = "Not Found"; break;
+	case 405: statusText = "Method Not Allowed"; break;
+	case 413: statusText = "Payload Too Large"; break;
+	case 416: statusText = "Range Not Satisfiable"; break;
+	case 500: statusText = "Internal Server Error"; break;
+	default: statusText = "Unknown"; break;
+	}
+
+	head << "HTTP/1.1 " << status << " " << statusText << "\r\n";
+	head << "Content-Length: " << size << "\r\n";
+	if(contentType.length() && body)
+		head << "Content-Type: " << contentType << "\r\n";
+	if(!keepAlive)
+		head << "Connection: close\r\n";
+	head << responseHeaders << "\r\n";
+
+	responseHead = Strings::String2File(head.str());
+	// response to HEAD request has no body
+	if(size && method != "HEAD")
+		responseBody = body;
+
+	ptr<Connection> connection = this->connection;
+	this->connection = nullptr;
+	connection->Flush(this);
+}
+
+void HttpServer::Request::Respond(int status)
+{
+	Respond(status, nullptr);
+}
+
+END_INANITY_NET
@@ -0,0 +1,140 @@
+#ifndef ___INANITY_NET_HTTP_SERVER_HPP___
+#define ___INANITY_NET_HTTP_SERVER_HPP___
+
+#include "HttpStream.hpp"
+#include <vector>
+
+BEGIN_INANITY
+
+class File;
+class FileSystem;
+
+END_INANITY
+
+BEGIN_INANITY_NET
+
+class Service;
+class TcpListener;
+class TcpSocket;
+
+/// Embedded HTTP/1.1 server.
+/** Keeps connections alive, and accepts pipelined requests (responses
+are sent in order of requests). Requests are routed by longest path
+prefix to handlers (prefix matches whole segments of path, so "/static"
+matches "/static/a", but not "/staticfoo"). Response bodies are Files which are sent to socket
+as is, without copying, so files of PosixFileSystem (mapped to memory)
+or BlobFileSystem (parts of mapped blob) are served straight from memory.
+Single byte range requests are supported for successful responses.
+Bodies of requests are limited in size (413 is sent for bigger ones),
+malformed requests get 400, and connection is closed after that.
+There is no idle timeout: service has no timers, so idle or slow
+clients keep connections until they close them. Server exposed to
+untrusted clients should be put behind a proxy limiting that.
+Server is not thread-safe (see ThreadPool about reference counters):
+handlers are called in the thread of service, and requests should be
+responded there too. */
+class HttpServer : public Object
+{
+public:
+	class Request;
+	/// Handler of request.
+	/** Could respond later, but in the thread of service, and has to respond once. */
+	typedef DataHandler<ptr<Request> > RequestHandler;
+
+private:
+	class Connection;
+	class BodyStream;
+	class FileSystemRoute;
+
+	struct Route
+	{
+		String prefix;
+		ptr<RequestHandler> handler;
+
+		Route(const String& prefix, ptr<RequestHandler> handler);
+	};
+
+	ptr<TcpListener> listener;
+	/// Routes sorted by decreasing length of prefix.
+	std::vector<Route> routes;
+	int requestsCount;
+	size_t maxBodySize;
+
+	void OnSocket(const DataHandler<ptr<TcpSocket> >::Result& result);
+	void Process(ptr<Request> request);
+	/// Does path begin with route prefix, on the boundary of segment.
+	static bool MatchPrefix(const String& path, const String& prefix);
+
+public:
+	/// Create server listening port.
+	/** \param maxBodySize Maximum size of body of request in bytes. */
+	HttpServer(ptr<Service> service, int port, size_t maxBodySize = 16 * 1024 * 1024);
+
+	/// Route requests with path beginning with prefix to handler.
+	void AddRoute(const String& prefix, ptr<RequestHandler> handler);
+	/// Serve files of file system for paths beginning with prefix.
+	/** Path without prefix is the name of file. */
+	void AddFileSystem(const String& prefix, ptr<FileSystem> fileSystem);
+	/// Stop accepting connections.
+	void Close();
+
+	/// Get number of requests processed.
+	int GetRequestsCount();
+
+	/// Get MIME type by extension of file name.
+	static const char* GetContentType(const String& fileName);
+};
+
+/// Request to HTTP server.
+class HttpServer::Request : public Object
+{
+	friend class HttpServer::Connection;
+private:
+	ptr<Connection> connection;
+	String method;
+	String url;
+	String path;
+	String query;
+	HttpStream::Headers headers;
+	ptr<File> body;
+	bool keepAlive;
+	/// Headers to add to response.
+	String responseHeaders;
+	/// Formatted response, and its body.
+	ptr<File> responseHead;
+	ptr<File> responseBody;
+	bool responded;
+
+	/// Parse value of Range header.
+	/** Returns false if range is unsatisfiable. Leaves begin and end
+	unchanged if there is no range, or it is not supported. */
+	bool ParseRange(size_t size, size_t& begin, size_t& end) const;
+
+public:
+	Request(ptr<Connection> connection, const String& method, const String& url, const HttpStream::Headers& headers, ptr<File> body, bool keepAlive);
+
+	const String& GetMethod() const;
+	const String& GetUrl() const;
+	/// Get path part of URL.
+	const String& GetPath() const;
+	/// Get query part of URL (without '?').
+	const String& GetQuery() const;
+	const HttpStream::Headers& GetHeaders() const;
+	/// Get header value by case-insensitive name, or empty string.
+	String GetHeader(const String& name) const;
+	ptr<File> GetBody() const;
+
+	/// Add header to response.
+	void AddHeader(const String& name, const String& value);
+	/// Send response.
+	/** Should be called in the thread of service. If status is 200 and
+	request has satisfiable byte range, only the range is sent with
+	status 206. Body is not copied. */
+	void Respond(int status, ptr<File> body, const String& contentType = String());
+	/// Send empty response with status.
+	void Respond(int status);
+};
+
+END_INANITY_NET
+
+#endif
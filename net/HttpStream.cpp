@@ -1,4 +1,6 @@
 #include "HttpStream.hpp"
+#include "../Exception.hpp"
+#include <sstream>
 
 BEGIN_INANITY_NET
 
@@ -14,7 +16,7 @@ http_parser_settings HttpStream::settings = {
 };
 
 HttpStream::HttpStream(ptr<OutputStream> outputStream, enum http_parser_type type) :
-	outputStream(outputStream), lastWasHeaderField(false), completed(false)
+	outputStream(outputStream), lastWasHeaderField(false), completed(false), inMessage(false), bodyless(false)
 {
 	parser.data = this;
 	http_parser_init(&parser, type);
@@ -33,11 +35,38 @@ ptr<HttpStream> HttpStream::CreateResponseStream(ptr<OutputStream> outputStream)
 void HttpStream::Write(const void* data, size_t size)
 {
 	http_parser_execute(&parser, &settings, (const char*)data, size);
+	CheckError();
 }
 
 void HttpStream::End()
 {
 	http_parser_execute(&parser, &settings, 0, 0);
+	CheckError();
+}
+
+void HttpStream::CheckError()
+{
+	enum http_errno error = HTTP_PARSER_ERRNO(&parser);
+	if(error == HPE_OK)
+		return;
+
+	std::ostringstream s;
+	if(error == HPE_CB_status)
+		s << "HTTP status " << parser.status_code;
+	else
+		s << "Can't parse HTTP: " << http_errno_description(error);
+	THROW(s.str());
+}
+
+void HttpStream::SetOutputStream(ptr<OutputStream> outputStream, bool bodyless)
+{
+	this->outputStream = outputStream;
+	this->bodyless = bodyless;
+}
+
+void HttpStream::SetMessageHandler(ptr<Handler> messageHandler)
+{
+	this->messageHandler = messageHandler;
 }
 
 bool HttpStream::IsCompleted() const
@@ -45,6 +74,31 @@ bool HttpStream::IsCompleted() const
 	return completed;
 }
 
+bool HttpStream::IsInMessage() const
+{
+	return inMessage;
+}
+
+int HttpStream::GetStatusCode() const
+{
+	return parser.status_code;
+}
+
+bool HttpStream::ShouldKeepAlive() const
+{
+	return !!http_should_keep_alive(&parser);
+}
+
+const char* HttpStream::GetMethod() const
+{
+	return http_method_str((enum http_method)parser.method);
+}
+
+const String& HttpStream::GetUrl() const
+{
+	return url;
+}
+
 const HttpStream::Headers& HttpStream::GetHeaders() const
 {
 	return headers;
@@ -52,17 +106,32 @@ const HttpStream::Headers& HttpStream::GetHeaders() const
 
 int HttpStream::OnMessageBegin(http_parser* parser)
 {
+	HttpStream* stream = (HttpStream*)parser->data;
+
+	stream->url.clear();
+	stream->headers.clear();
+	stream->lastWasHeaderField = false;
+	stream->completed = false;
+	stream->inMessage = true;
+
 	return 0;
 }
 
 int HttpStream::OnUrl(http_parser* parser, const char* data, size_t size)
 {
+	HttpStream* stream = (HttpStream*)parser->data;
+
+	stream->url += String(data, size);
+
 	return 0;
 }
 
-int HttpStream::OnStatus(http_parser* parser, const char* data, size_t size)
+int HttpStream::OnStatus(http_parser* parser, const char*, size_t)
 {
-	return (parser->status_code >= 200 && parser->status_code <= 299) ? 0 : 1;
+	HttpStream* stream = (HttpStream*)parser->data;
+
+	// в постоянном режиме неуспешный ответ не прерывает соединение
+	return (stream->messageHandler || IsSuccessful(parser)) ? 0 : 1;
 }
 
 int HttpStream::OnHeaderField(http_parser* parser, const char* data, size_t size)
@@ -73,6 +142,7 @@ int HttpStream::OnHeaderField(http_parser* parser, const char* data, size_t size
 		stream->headers.back().first += String(data, size);
 	else
 		stream->headers.push_back(std::make_pair(String(data, size), String()));
+	stream->lastWasHeaderField = true;
 
 	return 0;
 }
@@ -82,20 +152,26 @@ int HttpStream::OnHeaderValue(http_parser* parser, const char* data, size_t size
 	HttpStream* stream = (HttpStream*)parser->data;
 
 	stream->headers.back().second += String(data, size);
+	stream->lastWasHeaderField = false;
 
 	return 0;
 }
 
 int HttpStream::OnHeadersComplete(http_parser* parser)
 {
-	return 0;
+	HttpStream* stream = (HttpStream*)parser->data;
+
+	// 1 указывает парсеру, что тела нет
+	return stream->bodyless ? 1 : 0;
 }
 
 int HttpStream::OnBody(http_parser* parser, const char* data, size_t size)
 {
 	HttpStream* stream = (HttpStream*)parser->data;
 
-	stream->outputStream->Write(data, size);
+	// тело (в том числе chunked) выводится сразу, без накопления
+	if(stream->outputStream && IsSuccessful(parser))
+		stream->outputStream->Write(data, size);
 
 	return 0;
 }
@@ -105,8 +181,18 @@ int HttpStream::OnMessageComplete(http_parser* parser)
 	HttpStream* stream = (HttpStream*)parser->data;
 
 	stream->completed = true;
+	stream->inMessage = false;
+	// обработчик может сбросить сам себя
+	ptr<Handler> messageHandler = stream->messageHandler;
+	if(messageHandler)
+		messageHandler->Fire();
 
 	return 0;
 }
 
+bool HttpStream::IsSuccessful(http_parser* parser)
+{
+	return parser->type != HTTP_RESPONSE || (parser->status_code >= 200 && parser->status_code <= 299);
+}
+
 END_INANITY_NET
@@ -13,7 +13,11 @@ BEGIN_INANITY_NET
 class TcpSocket;
 
 /// Класс фильтрующего потока, выполняющего разбор HTTP-запроса/ответа, и выводящего только тело ответа.
-/** Умеет также привязываться к TCP-сокету, и разбирать приходящие данные. */
+/** Умеет также привязываться к TCP-сокету, и разбирать приходящие данные.
+По умолчанию разбирает одно сообщение. Если установлен обработчик сообщений,
+то работает в постоянном режиме (HTTP/1.1 keep-alive): разбирает сообщения
+одно за другим, вызывая обработчик по завершении каждого, и не прерывает
+разбор на ответах с кодом не 2xx (их тело просто не выводится). */
 class HttpStream : public OutputStream
 {
 public:
@@ -23,9 +27,16 @@ private:
 	http_parser parser;
 	static http_parser_settings settings;
 	ptr<OutputStream> outputStream;
+	/// Обработчик завершения сообщения, для постоянного режима.
+	ptr<Handler> messageHandler;
+	String url;
 	Headers headers;
 	bool lastWasHeaderField;
 	bool completed;
+	/// Разбирается ли сейчас сообщение (начато, но не завершено).
+	bool inMessage;
+	/// Не имеет ли текущее сообщение тела (ответ на HEAD-запрос).
+	bool bodyless;
 
 	// обработчики событий парсера
 
@@ -37,6 +48,11 @@ private:
 	static int OnHeadersComplete(http_parser* parser);
 	static int OnBody(http_parser* parser, const char* data, size_t size);
 	static int OnMessageComplete(http_parser* parser);
+	/// Успешен ли ответ (запросы всегда успешны).
+	static bool IsSuccessful(http_parser* parser);
+
+	/// Выбросить исключение, если разбор завершился ошибкой.
+	void CheckError();
 
 	// обработчики сокета
 	void OnReceive(const DataHandler<ptr<File> >::Result& result);
@@ -48,12 +64,34 @@ public:
 	static ptr<HttpStream> CreateRequestStream(ptr<OutputStream> outputStream);
 	static ptr<HttpStream> CreateResponseStream(ptr<OutputStream> outputStream);
 
+	/// Разобрать данные.
+	/** Выбрасывает исключение, если данные некорректны, или (не в постоянном
+	режиме) код ответа не 2xx. */
 	void Write(const void* data, size_t size) override;
 	void End();
 
+	/// Установить поток для тела следующего сообщения.
+	/** bodyless указывает, что сообщение - ответ на HEAD-запрос,
+	и тела не имеет независимо от заголовков. */
+	void SetOutputStream(ptr<OutputStream> outputStream, bool bodyless = false);
+	/// Установить обработчик завершения сообщения, и включить постоянный режим.
+	/** Обработчик вызывается изнутри Write. Поток держит ссылку на обработчик,
+	поэтому для разрыва цикла ссылок её следует сбросить. */
+	void SetMessageHandler(ptr<Handler> messageHandler);
+
 	/// Завершено ли корректно получение HTTP-ответа.
 	bool IsCompleted() const;
-
+	/// Начато ли, но не завершено получение сообщения.
+	bool IsInMessage() const;
+	/// Код ответа последнего сообщения.
+	int GetStatusCode() const;
+	/// Можно ли продолжать использовать соединение после последнего сообщения.
+	bool ShouldKeepAlive() const;
+
+	/// Метод последнего сообщения (только для запросов).
+	const char* GetMethod() const;
+	/// URL последнего сообщения (только для запросов).
+	const String& GetUrl() const;
 	const Headers& GetHeaders() const;
 
 	void ReceiveFromSocket(ptr<TcpSocket> socket);
@@ -49,6 +49,9 @@ public:
 	/** Releases references to itself and all handlers. */
 	virtual void Close() = 0;
 
+	/// Get socket as output stream.
+	/** Every write is sent separately, so for many small writes
+	BufferedTcpStream is better. */
 	ptr<OutputStream> GetOutputStream();
 };
 
@@ -0,0 +1,469 @@
+#include "UdpConnection.hpp"
+#include "../MemoryFile.hpp"
+#include "../CriticalCode.hpp"
+#include "../Exception.hpp"
+#include <algorithm>
+
+BEGIN_INANITY_NET
+
+/* Format of datagram (numbers are little-endian):
+u16 sequence number
+u8 flags (bit 0 - acknowledgement fields are valid)
+u16 last received sequence number of other side
+u32 bitfield of received previous 32 sequence numbers
+then messages:
+u8 type
+u16 id (reliable or unreliable sequence number)
+u16 size
+data */
+
+/// Types of messages.
+enum MessageType
+{
+	messageTypeReliable = 1,
+	messageTypeUnreliable = 2
+};
+
+static const unsigned char flagAckValid = 1;
+
+/// Timeout of losing datagram until RTT is measured, in milliseconds.
+static const long long initialResendTimeout = 200;
+static const long long minResendTimeout = 20;
+static const long long maxResendTimeout = 2000;
+
+static void WriteShort(std::vector<unsigned char>& packet, unsigned short value)
+{
+	packet.push_back((unsigned char)value);
+	packet.push_back((unsigned char)(value >> 8));
+}
+
+static unsigned short ReadShort(const unsigned char* data)
+{
+	return (unsigned short)(data[0] | (data[1] << 8));
+}
+
+const size_t UdpConnection::headerSize = 9;
+const size_t UdpConnection::messageHeaderSize = 5;
+const size_t UdpConnection::maxReliableInFlight = 512;
+const size_t UdpConnection::maxSentPackets = 1024;
+
+//** UdpConnection::Stats's methods.
+
+UdpConnection::Stats::Stats()
+: rtt(0), rttVariation(0), packetsSent(0), packetsReceived(0), packetsAcked(0), packetsLost(0),
+	bytesSent(0), bytesReceived(0), messagesSent(0), messagesReceived(0), messagesResent(0),
+	duplicatesCount(0), staleCount(0) {}
+
+float UdpConnection::Stats::GetLossRate() const
+{
+	size_t resolvedCount = packetsAcked + packetsLost;
+	return resolvedCount ? (float)packetsLost / (float)resolvedCount : 0;
+}
+
+//** UdpConnection::ReliableMessage's methods.
+
+UdpConnection::ReliableMessage::ReliableMessage(ptr<File> data)
+: data(data), sent(false), inFlight(false), acked(false) {}
+
+//** UdpConnection's methods.
+
+UdpConnection::UdpConnection(ptr<UdpSocket> socket, size_t mtu)
+: socket(socket), mtu(mtu), closed(false),
+	localSequence(0), firstReliableId(0), nextUnreliableId(0),
+	remoteSequenceValid(false), remoteSequence(0), remoteAckBits(0), ackPending(false),
+	nextReliableId(0), lastUnreliableIdValid(false), lastUnreliableId(0),
+	rttValid(false), currentTime(0)
+{
+	if(mtu <= headerSize + messageHeaderSize || mtu > 0xffff)
+		THROW("Invalid MTU for UDP connection");
+
+	socket->SetReceiveHandler(UdpSocket::ReceiveHandler::Bind(MakePointer(this), &UdpConnection::OnReceive));
+}
+
+bool UdpConnection::SequenceGreater(unsigned short a, unsigned short b)
+{
+	return a != b && (unsigned short)(a - b) < 0x8000;
+}
+
+void UdpConnection::OnReceive(const UdpSocket::ReceiveHandler::Result& result)
+{
+	CriticalCode cc(cs);
+	try
+	{
+		// datagram is released in the thread of socket, and only
+		// a copy is passed to Update (see ThreadPool about reference counters)
+		ptr<File> datagram = result.GetData();
+		if(datagram)
+			receivedDatagrams.push_back(MemoryFile::CreateViaCopy(datagram->GetData(), datagram->GetSize()));
+		else
+			closed = true;
+	}
+	catch(Exception* exception)
+	{
+		MakePointer(exception);
+		closed = true;
+	}
+}
+
+void UdpConnection::SetMessageHandler(ptr<MessageHandler> messageHandler)
+{
+	this->messageHandler = messageHandler;
+}
+
+size_t UdpConnection::GetMaxMessageSize() const
+{
+	return mtu - headerSize - messageHeaderSize;
+}
+
+void UdpConnection::SendReliable(ptr<File> message)
+{
+	if(message->GetSize() > GetMaxMessageSize())
+		THROW("Message is too big for UDP connection");
+	reliableMessages.push_back(ReliableMessage(message));
+	++stats.messagesSent;
+}
+
+void UdpConnection::SendUnreliable(ptr<File> message)
+{
+	if(message->GetSize() > GetMaxMessageSize())
+		THROW("Message is too big for UDP connection");
+	unreliableMessages.push_back(message);
+	++stats.messagesSent;
+}
+
+void UdpConnection::Receive(ptr<File> datagram)
+{
+	CriticalCode cc(cs);
+	receivedDatagrams.push_back(datagram);
+}
+
+void UdpConnection::ProcessDatagram(ptr<File> datagram)
+{
+	const unsigned char* data = (const unsigned char*)datagram->GetData();
+	size_t size = datagram->GetSize();
+
+	// malformed datagrams are ignored, as anybody could send them
+	if(size < headerSize)
+		return;
+
+	unsigned short sequence = ReadShort(data);
+
+	// remember received sequence number, ignore duplicates
+	if(!remoteSequenceValid)
+	{
+		remoteSequenceValid = true;
+		remoteSequence = sequence;
+		remoteAckBits = 0;
+	}
+	else if(SequenceGreater(sequence, remoteSequence))
+	{
+		unsigned short shift = sequence - remoteSequence;
+		remoteAckBits = shift < 32 ? remoteAckBits << shift : 0;
+		if(shift <= 32)
+			remoteAckBits |= 1U << (shift - 1);
+		remoteSequence = sequence;
+	}
+	else
+	{
+		unsigned short back = remoteSequence - sequence;
+		if(back == 0)
+			return;
+		if(back <= 32)
+		{
+			unsigned int bit = 1U << (back - 1);
+			if(remoteAckBits & bit)
+				return;
+			remoteAckBits |= bit;
+		}
+	}
+
+	++stats.packetsReceived;
+	stats.bytesReceived += size;
+
+	if(data[2] & flagAckValid)
+		ProcessAcks(ReadShort(data + 3), data[5] | (data[6] << 8) | (data[7] << 16) | ((unsigned int)data[8] << 24));
+
+	for(size_t offset = headerSize; offset + messageHeaderSize <= size; )
+	{
+		unsigned char type = data[offset];
+		unsigned short id = ReadShort(data + offset + 1);
+		size_t messageSize = ReadShort(data + offset + 3);
+		offset += messageHeaderSize;
+		if(offset + messageSize > size)
+			break;
+		ptr<File> message = datagram->Slice(offset, messageSize);
+		offset += messageSize;
+		ackPending = true;
+
+		switch(type)
+		{
+		case messageTypeReliable:
+			if(id == nextReliableId)
+			{
+				++nextReliableId;
+				DeliverMessage(message);
+				// deliver messages which were waiting for this one
+				for(;;)
+				{
+					std::map<unsigned short, ptr<File> >::iterator i = pendingReliableMessages.find(nextReliableId);
+					if(i == pendingReliableMessages.end())
+						break;
+					message = i->second;
+					pendingReliableMessages.erase(i);
+					++nextReliableId;
+					DeliverMessage(message);
+				}
+			}
+			else if(SequenceGreater(id, nextReliableId) && (unsigned short)(id - nextReliableId) < maxReliableInFlight)
+			{
+				if(!pendingReliableMessages.insert(std::make_pair(id, message)).second)
+					++stats.duplicatesCount;
+			}
+			else
+				++stats.duplicatesCount;
+			break;
+		case messageTypeUnreliable:
+			if(!lastUnreliableIdValid || SequenceGreater(id, lastUnreliableId))
+			{
+				lastUnreliableIdValid = true;
+				lastUnreliableId = id;
+				DeliverMessage(message);
+			}
+			else
+				++stats.staleCount;
+			break;
+		}
+	}
+}
+
+void UdpConnection::ProcessAcks(unsigned short ack, unsigned int ackBits)
+{
+	for(std::deque<SentPacket>::iterator i = sentPackets.begin(); i != sentPackets.end(); )
+	{
+		unsigned short back = ack - i->sequence;
+		if(back == 0 || (back <= 32 && (ackBits & (1U << (back - 1)))))
+		{
+			PacketAcked(*i);
+			i = sentPackets.erase(i);
+		}
+		else
+			++i;
+	}
+
+	// packets out of acknowledgement window can't be acknowledged anymore
+	while(!sentPackets.empty() && SequenceGreater(ack, sentPackets.front().sequence)
+		&& (unsigned short)(ack - sentPackets.front().sequence) > 32)
+	{
+		PacketLost(sentPackets.front());
+		sentPackets.pop_front();
+	}
+}
+
+void UdpConnection::PacketAcked(const SentPacket& packet)
+{
+	// loss was detected by timeout, but datagram just was late
+	if(packet.lost)
+		--stats.packetsLost;
+	++stats.packetsAcked;
+
+	// update RTT as in RFC 6298; sequence numbers are not reused,
+	// so samples of late datagrams are unambiguous
+	float sample = (float)(currentTime - packet.time);
+	if(rttValid)
+	{
+		float error = sample - stats.rtt;
+		stats.rttVariation = stats.rttVariation * 0.75f + (error < 0 ? -error : error) * 0.25f;
+		stats.rtt = stats.rtt * 0.875f + sample * 0.125f;
+	}
+	else
+	{
+		rttValid = true;
+		stats.rtt = sample;
+		stats.rttVariation = sample / 2;
+	}
+
+	for(size_t i = 0; i < packet.reliableIds.size(); ++i)
+	{
+		size_t index = (unsigned short)(packet.reliableIds[i] - firstReliableId);
+		if(index < reliableMessages.size())
+		{
+			reliableMessages[index].acked = true;
+			reliableMessages[index].inFlight = false;
+		}
+	}
+
+	// free acknowledged messages from the beginning
+	while(!reliableMessages.empty() && reliableMessages.front().acked)
+	{
+		reliableMessages.pop_front();
+		++firstReliableId;
+	}
+}
+
+void UdpConnection::PacketLost(SentPacket& packet)
+{
+	if(packet.lost)
+		return;
+	packet.lost = true;
+	++stats.packetsLost;
+
+	// messages will be resent with next datagram
+	for(size_t i = 0; i < packet.reliableIds.size(); ++i)
+	{
+		size_t index = (unsigned short)(packet.reliableIds[i] - firstReliableId);
+		if(index < reliableMessages.size())
+			reliableMessages[index].inFlight = false;
+	}
+}
+
+void UdpConnection::DeliverMessage(ptr<File> message)
+{
+	++stats.messagesReceived;
+	if(messageHandler)
+		messageHandler->FireData(message);
+}
+
+long long UdpConnection::GetResendTimeout() const
+{
+	if(!rttValid)
+		return initialResendTimeout;
+	long long timeout = (long long)(stats.rtt + stats.rttVariation * 4) + 1;
+	return std::min(std::max(timeout, minResendTimeout), maxResendTimeout);
+}
+
+void UdpConnection::BeginPacket(std::vector<unsigned char>& packet)
+{
+	packet.clear();
+	WriteShort(packet, localSequence);
+	packet.push_back(remoteSequenceValid ? flagAckValid : 0);
+	WriteShort(packet, remoteSequence);
+	WriteShort(packet, (unsigned short)remoteAckBits);
+	WriteShort(packet, (unsigned short)(remoteAckBits >> 16));
+}
+
+void UdpConnection::SendPacket(std::vector<unsigned char>& packet, SentPacket& sentPacket)
+{
+	socket->Send(MemoryFile::CreateViaCopy(&*packet.begin(), packet.size()));
+	++stats.packetsSent;
+	stats.bytesSent += packet.size();
+
+	// datagram with messages waits for acknowledgement
+	if(packet.size() > headerSize)
+	{
+		sentPacket.sequence = localSequence;
+		sentPacket.time = currentTime;
+		sentPacket.lost = false;
+		sentPackets.push_back(sentPacket);
+		if(sentPackets.size() > maxSentPackets)
+		{
+			PacketLost(sentPackets.front());
+			sentPackets.pop_front();
+		}
+		ackPending = false;
+	}
+
+	++localSequence;
+	sentPacket.reliableIds.clear();
+	BeginPacket(packet);
+}
+
+void UdpConnection::AppendMessage(std::vector<unsigned char>& packet, SentPacket& sentPacket,
+	unsigned char type, unsigned short id, ptr<File> message)
+{
+	size_t size = message->GetSize();
+	if(packet.size() + messageHeaderSize + size > mtu)
+		SendPacket(packet, sentPacket);
+
+	packet.push_back(type);
+	WriteShort(packet, id);
+	WriteShort(packet, (unsigned short)size);
+	const unsigned char* data = (const unsigned char*)message->GetData();
+	packet.insert(packet.end(), data, data + size);
+
+	if(type == messageTypeReliable)
+		sentPacket.reliableIds.push_back(id);
+}
+
+void UdpConnection::Update(long long time)
+{
+	BEGIN_TRY();
+
+	currentTime = time;
+
+	std::vector<ptr<File> > datagrams;
+	bool closed;
+	{
+		CriticalCode cc(cs);
+		std::swap(datagrams, receivedDatagrams);
+		closed = this->closed;
+	}
+
+	for(size_t i = 0; i < datagrams.size(); ++i)
+		ProcessDatagram(datagrams[i]);
+
+	if(closed)
+		return;
+
+	// datagrams not acknowledged in time are lost
+	long long resendTimeout = GetResendTimeout();
+	for(size_t i = 0; i < sentPackets.size() && time - sentPackets[i].time >= resendTimeout; ++i)
+		PacketLost(sentPackets[i]);
+
+	// coalesce messages into datagrams
+	std::vector<unsigned char> packet;
+	packet.reserve(mtu);
+	SentPacket sentPacket;
+	BeginPacket(packet);
+	size_t packetsSent = stats.packetsSent;
+
+	size_t reliableCount = std::min(reliableMessages.size(), maxReliableInFlight);
+	for(size_t i = 0; i < reliableCount; ++i)
+	{
+		ReliableMessage& message = reliableMessages[i];
+		if(message.acked || message.inFlight)
+			continue;
+		if(message.sent)
+			++stats.messagesResent;
+		message.sent = true;
+		message.inFlight = true;
+		AppendMessage(packet, sentPacket, messageTypeReliable, (unsigned short)(firstReliableId + i), message.data);
+	}
+
+	for(size_t i = 0; i < unreliableMessages.size(); ++i)
+		AppendMessage(packet, sentPacket, messageTypeUnreliable, nextUnreliableId++, unreliableMessages[i]);
+	unreliableMessages.clear();
+
+	// send last datagram, or acknowledgement only if nothing was sent
+	if(packet.size() > headerSize || (ackPending && stats.packetsSent == packetsSent))
+		SendPacket(packet, sentPacket);
+	ackPending = false;
+
+	END_TRY("Can't update UDP connection");
+}
+
+size_t UdpConnection::GetUnackedReliableCount() const
+{
+	return reliableMessages.size();
+}
+
+bool UdpConnection::IsClosed()
+{
+	CriticalCode cc(cs);
+	return closed;
+}
+
+const UdpConnection::Stats& UdpConnection::GetStats() const
+{
+	return stats;
+}
+
+void UdpConnection::Close()
+{
+	{
+		CriticalCode cc(cs);
+		closed = true;
+	}
+	socket->Close();
+}
+
+END_INANITY_NET
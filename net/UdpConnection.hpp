@@ -0,0 +1,199 @@
+#ifndef ___INANITY_NET_UDP_CONNECTION_HPP___
+#define ___INANITY_NET_UDP_CONNECTION_HPP___
+
+#include "UdpSocket.hpp"
+#include "../CriticalSection.hpp"
+#include <vector>
+#include <deque>
+#include <map>
+
+BEGIN_INANITY_NET
+
+/// Connection over UDP socket with reliable and unreliable messages.
+/** Messages are coalesced into datagrams of MTU size. Every datagram
+has a sequence number, and acknowledges received datagrams of other
+side by last sequence number and bitfield of 32 previous ones.
+Reliable messages are delivered in order: message is resent
+(selectively, only not acknowledged ones) until datagram with it is
+acknowledged. Unreliable messages are sequenced: message older than
+already delivered one is dropped.
+Connection is pumped by Update(), which should be called periodically
+(for example, once per frame) by the thread owning connection: it
+processes received datagrams, calls message handler, resends lost
+messages and sends queued ones. Datagrams are received in the thread
+of socket, and passed to Update() under critical section. */
+class UdpConnection : public Object
+{
+public:
+	/// Handler of received messages.
+	typedef DataHandler<ptr<File> > MessageHandler;
+
+	/// Statistics of connection.
+	struct Stats
+	{
+		/// Smoothed round-trip time, in milliseconds.
+		float rtt;
+		/// Variation of round-trip time, in milliseconds.
+		float rttVariation;
+		/// Number of datagrams sent, including acknowledgement-only ones.
+		size_t packetsSent;
+		/// Number of datagrams received.
+		size_t packetsReceived;
+		/// Number of datagrams with messages acknowledged by other side.
+		size_t packetsAcked;
+		/// Number of datagrams with messages considered lost.
+		size_t packetsLost;
+		size_t bytesSent;
+		size_t bytesReceived;
+		/// Number of messages sent (not including resends).
+		size_t messagesSent;
+		/// Number of messages delivered to handler.
+		size_t messagesReceived;
+		/// Number of resends of reliable messages.
+		size_t messagesResent;
+		/// Number of received duplicates of reliable messages.
+		size_t duplicatesCount;
+		/// Number of unreliable messages dropped as out-of-order.
+		size_t staleCount;
+
+		Stats();
+
+		/// Get fraction of lost datagrams among resolved ones.
+		float GetLossRate() const;
+	};
+
+private:
+	/// Reliable message waiting for acknowledgement.
+	struct ReliableMessage
+	{
+		ptr<File> data;
+		/// Message was sent at least once.
+		bool sent;
+		/// Datagram with message is waiting for acknowledgement.
+		bool inFlight;
+		bool acked;
+
+		ReliableMessage(ptr<File> data);
+	};
+
+	/// Datagram waiting for acknowledgement.
+	struct SentPacket
+	{
+		unsigned short sequence;
+		long long time;
+		/// Ids of reliable messages in datagram.
+		std::vector<unsigned short> reliableIds;
+		/// Datagram is considered lost, but late acknowledgement is still accepted.
+		bool lost;
+	};
+
+	ptr<UdpSocket> socket;
+	ptr<MessageHandler> messageHandler;
+	size_t mtu;
+
+	/// Received datagrams, and closing flag, protected by critical section.
+	CriticalSection cs;
+	std::vector<ptr<File> > receivedDatagrams;
+	bool closed;
+
+	//*** Sending side.
+	unsigned short localSequence;
+	/// Id of first message in reliable buffer.
+	unsigned short firstReliableId;
+	/// Reliable messages from first not acknowledged one.
+	std::deque<ReliableMessage> reliableMessages;
+	/// Unreliable messages queued since last update.
+	std::vector<ptr<File> > unreliableMessages;
+	unsigned short nextUnreliableId;
+	/// Datagrams with messages not acknowledged yet, in order.
+	/** Lost datagrams are kept until they are out of acknowledgement window,
+	so RTT is measured even if it's larger than timeout. */
+	std::deque<SentPacket> sentPackets;
+
+	//*** Receiving side.
+	bool remoteSequenceValid;
+	unsigned short remoteSequence;
+	/// Bit i is set if datagram remoteSequence - 1 - i is received.
+	unsigned int remoteAckBits;
+	/// Received datagram with messages is not acknowledged yet.
+	bool ackPending;
+	/// Id of next reliable message to deliver.
+	unsigned short nextReliableId;
+	/// Reliable messages received out of order.
+	std::map<unsigned short, ptr<File> > pendingReliableMessages;
+	bool lastUnreliableIdValid;
+	unsigned short lastUnreliableId;
+
+	Stats stats;
+	/// Round-trip time is measured at least once.
+	bool rttValid;
+	/// Time of current update.
+	long long currentTime;
+
+	/// Size of datagram header.
+	static const size_t headerSize;
+	/// Size of message header.
+	static const size_t messageHeaderSize;
+	/// Maximum number of reliable messages in flight.
+	static const size_t maxReliableInFlight;
+	/// Maximum number of datagrams waiting for acknowledgement.
+	static const size_t maxSentPackets;
+
+	void OnReceive(const UdpSocket::ReceiveHandler::Result& result);
+	void ProcessDatagram(ptr<File> datagram);
+	void ProcessAcks(unsigned short ack, unsigned int ackBits);
+	void PacketAcked(const SentPacket& packet);
+	void PacketLost(SentPacket& packet);
+	void DeliverMessage(ptr<File> message);
+	/// Get timeout of considering datagram lost, in milliseconds.
+	long long GetResendTimeout() const;
+	/// Begin new datagram with header.
+	void BeginPacket(std::vector<unsigned char>& packet);
+	/// Send datagram, and track it if it has messages.
+	void SendPacket(std::vector<unsigned char>& packet, SentPacket& sentPacket);
+	/// Append message to datagram, sending it first if it's full.
+	void AppendMessage(std::vector<unsigned char>& packet, SentPacket& sentPacket,
+		unsigned char type, unsigned short id, ptr<File> message);
+
+	/// Is sequence number a newer than b (with wrapping).
+	static bool SequenceGreater(unsigned short a, unsigned short b);
+
+public:
+	/// Create connection over socket.
+	/** \param mtu Maximum size of datagram. */
+	UdpConnection(ptr<UdpSocket> socket, size_t mtu = 1200);
+
+	/// Set handler of received messages.
+	/** Handler is called by Update(). */
+	void SetMessageHandler(ptr<MessageHandler> messageHandler);
+
+	/// Get maximum size of message.
+	size_t GetMaxMessageSize() const;
+	/// Queue reliable ordered message.
+	void SendReliable(ptr<File> message);
+	/// Queue unreliable sequenced message.
+	void SendUnreliable(ptr<File> message);
+
+	/// Pass datagram received not through socket.
+	/** For example, first datagram received by UdpListener. */
+	void Receive(ptr<File> datagram);
+
+	/// Process received datagrams, and send messages.
+	/** \param time Current time in milliseconds, should not decrease. */
+	void Update(long long time);
+
+	/// Get number of reliable messages not acknowledged yet.
+	size_t GetUnackedReliableCount() const;
+	/// Is socket closed.
+	bool IsClosed();
+	const Stats& GetStats() const;
+
+	/// Close socket.
+	/** Socket refers to connection via receive handler,
+	so connection should be closed to be freed. */
+	void Close();
+};
+
+END_INANITY_NET
+
+#endif
@@ -0,0 +1,292 @@
+#include "Fcgi.hpp"
+#include "../OutputStream.hpp"
+#include "../Thread.hpp"
+#include "../ThreadPool.hpp"
+#include "../Time.hpp"
+#include "../Exception.hpp"
+#include "../deps/fcgi/fastcgi.h"
+#include "../Checks.hpp"
+#include <algorithm>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <iostream>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+/* Benchmark of FCGI handler against local FastCGI client.
+Client threads send requests concurrently, each request over its own
+connection (as web servers do without keep-alive). Handler simulates
+waiting for a backend (sleeps) or computing (hashes), and requests are
+served by single-threaded Accept() loop and by pools of workers.
+Reports requests/sec, client-side latency percentiles and statistics
+of workers. */
+
+using namespace Inanity;
+using namespace Inanity::Net;
+
+static const int port = 18082;
+
+/// Handle request: "sleep=<ms>" or "hash=<iterations>".
+static void Handle(ptr<Fcgi::Request> request)
+{
+	const char* query = request->GetParam("QUERY_STRING");
+	if(!query)
+		THROW("No query");
+
+	std::ostringstream body;
+	if(strncmp(query, "sleep=", 6) == 0)
+	{
+		Thread::Sleep(atoi(query + 6));
+		body << "slept";
+	}
+	else if(strncmp(query, "hash=", 5) == 0)
+	{
+		unsigned int hash = 2166136261U;
+		for(int i = atoi(query + 5); i > 0; --i)
+			hash = (hash ^ (unsigned int)i) * 16777619U;
+		body << "hash " << hash;
+	}
+	else
+		THROW("Unknown query");
+
+	String s = body.str();
+	request->OutputStatus("200 OK");
+	request->OutputContentType("text/plain");
+	request->OutputBeginResponse();
+	request->GetOutputStream()->Write(s.c_str(), s.length());
+}
+
+/// Simple FastCGI client, as a web server would do.
+class Client
+{
+private:
+	static void AppendRecord(String& data, int type, const String& content)
+	{
+		FCGI_Header header;
+		header.version = FCGI_VERSION_1;
+		header.type = (unsigned char)type;
+		header.requestIdB1 = 0;
+		header.requestIdB0 = 1;
+		header.contentLengthB1 = (unsigned char)(content.length() >> 8);
+		header.contentLengthB0 = (unsigned char)content.length();
+		header.paddingLength = 0;
+		header.reserved = 0;
+		data.append((const char*)&header, sizeof(header));
+		data += content;
+	}
+
+	static void AppendParam(String& data, const String& name, const String& value)
+	{
+		// names and values are short
+		data += (char)name.length();
+		data += (char)value.length();
+		data += name;
+		data += value;
+	}
+
+	static bool ReadAll(int s, void* data, size_t size)
+	{
+		while(size)
+		{
+			ssize_t r = recv(s, data, size, 0);
+			if(r <= 0)
+				return false;
+			data = (char*)data + r;
+			size -= r;
+		}
+		return true;
+	}
+
+public:
+	/// Make request, returns stdout of response, or empty string on error.
+	static String Request(const String& query)
+	{
+		int s = socket(AF_INET, SOCK_STREAM, 0);
+		if(s < 0)
+			return String();
+		sockaddr_in address;
+		memset(&address, 0, sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_port = htons(port);
+		address.sin_addr.s_addr = inet_addr("127.0.0.1");
+		if(connect(s, (sockaddr*)&address, sizeof(address)) < 0)
+		{
+			close(s);
+			return String();
+		}
+
+		String data;
+		FCGI_BeginRequestBody begin;
+		memset(&begin, 0, sizeof(begin));
+		begin.roleB0 = FCGI_RESPONDER;
+		AppendRecord(data, FCGI_BEGIN_REQUEST, String((const char*)&begin, sizeof(begin)));
+		String params;
+		AppendParam(params, "REQUEST_METHOD", "GET");
+		AppendParam(params, "QUERY_STRING", query);
+		AppendRecord(data, FCGI_PARAMS, params);
+		AppendRecord(data, FCGI_PARAMS, String());
+		AppendRecord(data, FCGI_STDIN, String());
+
+		String output;
+		bool ended = false;
+		if(send(s, data.c_str(), data.length(), 0) == (ssize_t)data.length())
+			for(;;)
+			{
+				FCGI_Header header;
+				if(!ReadAll(s, &header, sizeof(header)))
+					break;
+				size_t length = (header.contentLengthB1 << 8) | header.contentLengthB0;
+				String content(length + header.paddingLength, '\0');
+				if(content.length() && !ReadAll(s, &content[0], content.length()))
+					break;
+				if(header.type == FCGI_STDOUT)
+					output.append(content, 0, length);
+				else if(header.type == FCGI_END_REQUEST)
+				{
+					ended = true;
+					break;
+				}
+			}
+		close(s);
+
+		return ended ? output : String();
+	}
+};
+
+/// Run concurrent clients, and print results.
+static void RunClients(const char* name, int clientsCount, int requestsPerClient, const String& query, const String& expectedBody)
+{
+	std::vector<std::vector<Time::Tick> > latencies(clientsCount);
+	std::vector<int> failedCounts(clientsCount, 0);
+	std::vector<ptr<Thread> > threads(clientsCount);
+
+	Time::Tick startTick = Time::GetTick();
+	for(int i = 0; i < clientsCount; ++i)
+	{
+		std::vector<Time::Tick>* clientLatencies = &latencies[i];
+		int* failedCount = &failedCounts[i];
+		threads[i] = NEW(Thread(Thread::ThreadHandler::BindCall([=](const Thread::ThreadHandler::Result&)
+		{
+			for(int j = 0; j < requestsPerClient; ++j)
+			{
+				Time::Tick requestTick = Time::GetTick();
+				String output = Client::Request(query);
+				clientLatencies->push_back(Time::GetTick() - requestTick);
+				size_t bodyBegin = output.find("\r\n\r\n");
+				if(bodyBegin == String::npos || output.compare(bodyBegin + 4, String::npos, expectedBody) != 0)
+					++*failedCount;
+			}
+		})));
+	}
+	for(int i = 0; i < clientsCount; ++i)
+		threads[i]->WaitEnd();
+	double time = (double)(Time::GetTick() - startTick) / (double)Time::GetTicksPerSecond();
+
+	std::vector<Time::Tick> all;
+	int failedCount = 0;
+	for(int i = 0; i < clientsCount; ++i)
+	{
+		all.insert(all.end(), latencies[i].begin(), latencies[i].end());
+		failedCount += failedCounts[i];
+	}
+	std::sort(all.begin(), all.end());
+	Check(name, !failedCount);
+
+	double tickTime = 1000000.0 / (double)Time::GetTicksPerSecond();
+	std::cout << "  " << name << ": " << (int)(all.size() / time) << " requests/s, latency p50 "
+		<< (int)(all[all.size() / 2] * tickTime) << " us, p99 " << (int)(all[all.size() * 99 / 100] * tickTime)
+		<< " us, max " << (int)(all.back() * tickTime) << " us\n";
+}
+
+static void RunLoads(int requestsCount)
+{
+	RunClients("sleep 1 ms", 32, requestsCount / 32, "sleep=1", "slept");
+	RunClients("hash 100k", 32, requestsCount / 32, "hash=100000", "hash 3578651525");
+}
+
+static void PrintStats(const Fcgi::Stats& stats)
+{
+	const TimeHistogram& times = stats.times;
+	std::cout << "  workers: " << times.count << " requests, " << stats.failedRequestsCount
+		<< " failed, mean " << (times.count ? times.totalTime / (long long)times.count : 0)
+		<< " us, max " << times.maxTime << " us, max busy " << stats.maxBusyWorkersCount << ", histogram";
+	for(int i = 0; i < TimeHistogram::bucketsCount; ++i)
+		std::cout << " " << times.buckets[i];
+	std::cout << "\n";
+}
+
+int main()
+{
+	const int requestsCount = 2048;
+
+	try
+	{
+		std::ostringstream socketName;
+		socketName << ":" << port;
+
+		// single-threaded loop
+		{
+			std::cout << "single-threaded:\n";
+			Fcgi fcgi(socketName.str().c_str(), 128);
+			Fcgi* f = &fcgi;
+			ptr<Thread> thread = NEW(Thread(Thread::ThreadHandler::BindCall([f](const Thread::ThreadHandler::Result&)
+			{
+				while(ptr<Fcgi::Request> request = f->Accept())
+				{
+					try
+					{
+						Handle(request);
+					}
+					catch(Exception* exception)
+					{
+						MakePointer(exception);
+					}
+					request->End();
+				}
+			})));
+			RunLoads(requestsCount / 8);
+			fcgi.Stop();
+			thread->WaitEnd();
+		}
+
+		// pools of workers
+		static const int workersCounts[] = { 1, 4, 16, 0 };
+		for(size_t i = 0; i < sizeof(workersCounts) / sizeof(workersCounts[0]); ++i)
+		{
+			Fcgi fcgi(socketName.str().c_str(), 128);
+			fcgi.Start(Fcgi::RequestHandler::BindCall([](const Fcgi::RequestHandler::Result& result)
+			{
+				Handle(result.GetData());
+			}), workersCounts[i]);
+			if(workersCounts[i])
+				std::cout << workersCounts[i] << " workers:\n";
+			else
+				std::cout << "hardware threads workers:\n";
+
+			RunLoads(workersCounts[i] == 1 ? requestsCount / 8 : requestsCount);
+
+			// failed request is counted, and doesn't break worker
+			Check("bad request", Client::Request("bad") == String());
+			Check("after bad request", Client::Request("hash=1").find("hash ") != String::npos);
+
+			fcgi.Stop();
+			Fcgi::Stats stats = fcgi.GetStats();
+			PrintStats(stats);
+			Check("stats", stats.failedRequestsCount == 1
+				&& (int)stats.times.count == (workersCounts[i] == 1 ? requestsCount / 8 : requestsCount) / 32 * 32 * 2 + 2);
+			int workersCount = workersCounts[i] ? workersCounts[i] : ThreadPool::GetHardwareThreadsCount();
+			Check("concurrency", stats.maxBusyWorkersCount <= workersCount && (workersCount == 1) == (stats.maxBusyWorkersCount == 1));
+		}
+	}
+	catch(Exception* exception)
+	{
+		MakePointer(exception)->PrintStack(std::cout);
+		return 1;
+	}
+
+	return ReportChecks();
+}
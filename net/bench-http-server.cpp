@@ -0,0 +1,391 @@
+#include "AsioService.hpp"
+#include "TcpSocket.hpp"
+#include "HttpServer.hpp"
+#include "HttpClient.hpp"
+#include "../platform/PosixFileSystem.hpp"
+#include "../data/BlobFileSystem.hpp"
+#include "../data/BlobFileSystemBuilder.hpp"
+#include "../MemoryFile.hpp"
+#include "../MemoryStream.hpp"
+#include "../File.hpp"
+#include "../Strings.hpp"
+#include "../Thread.hpp"
+#include "../Time.hpp"
+#include "../Exception.hpp"
+#include "../Checks.hpp"
+#include <algorithm>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <sstream>
+#include <iostream>
+#include <unistd.h>
+
+/* Loopback load test of HTTP server.
+Server and clients run in separate services: server in its own thread,
+and clients in the main thread, which runs client service while waiting
+for responses (neither server nor client is thread-safe). Clients are
+virtual users sending requests one after another over keep-alive
+connections; requests/sec and latency percentiles are reported for
+in-memory responses, files of PosixFileSystem (mapped), files of
+BlobFileSystem, and for comparison, files copied on every request.
+Also checks ranges, HEAD, pipelining, errors, malformed requests and
+the limit of body size with raw requests. */
+
+using namespace Inanity;
+using namespace Inanity::Net;
+
+static const int port = 18081;
+static const int fileSize = 64 * 1024;
+static const size_t maxBodySize = 1024 * 1024;
+
+static String MakeData(int size, int seed)
+{
+	String data(size, ' ');
+	for(int i = 0; i < size; ++i)
+		data[i] = (char)('a' + (seed + i * 7) % 26);
+	return data;
+}
+
+static double GetTime(Time::Tick startTick)
+{
+	return (double)(Time::GetTick() - startTick) / (double)Time::GetTicksPerSecond();
+}
+
+/// Run client service until flag is set by handlers.
+static void RunUntil(ptr<AsioService> service, const bool& done)
+{
+	while(!done)
+		service->GetIoService().run_one();
+}
+
+/// Load of closed-loop virtual users.
+class Load : public Object
+{
+public:
+	ptr<AsioService> service;
+	ptr<HttpClient> client;
+	String url;
+	int requestsLeft;
+	int failedCount;
+	size_t expectedSize;
+	size_t wrongCount;
+	std::vector<Time::Tick> latencies;
+	int activeUsersCount;
+	bool done;
+
+	class User : public SuccessHandler
+	{
+	private:
+		ptr<Load> load;
+		ptr<MemoryStream> stream;
+		Time::Tick startTick;
+
+	public:
+		User(ptr<Load> load) : load(load) {}
+
+		void Start()
+		{
+			if(!load->requestsLeft)
+			{
+				load->done = !--load->activeUsersCount;
+				return;
+			}
+			--load->requestsLeft;
+			stream = NEW(MemoryStream());
+			startTick = Time::GetTick();
+			load->client->Get(load->url, this, stream);
+		}
+
+		void OnSuccess()
+		{
+			load->latencies.push_back(Time::GetTick() - startTick);
+			if(stream->ToFile()->GetSize() != load->expectedSize)
+				++load->wrongCount;
+			Start();
+		}
+
+		void OnError(ptr<Exception>)
+		{
+			++load->failedCount;
+			Start();
+		}
+	};
+
+	Load(ptr<AsioService> service, const String& url, int usersCount, int requestsCount, size_t expectedSize)
+	: service(service), client(NEW(HttpClient(service, usersCount, usersCount))), url(url), requestsLeft(requestsCount),
+		failedCount(0), expectedSize(expectedSize), wrongCount(0), activeUsersCount(0), done(false) {}
+
+	void Run(const char* name, int usersCount)
+	{
+		int requestsCount = requestsLeft;
+		Time::Tick startTick = Time::GetTick();
+		activeUsersCount = usersCount;
+		for(int i = 0; i < usersCount; ++i)
+			MakePointer(NEW(User(this)))->Start();
+		RunUntil(service, done);
+		double time = GetTime(startTick);
+		client->Close();
+
+		Check(name, !failedCount && !wrongCount && (int)latencies.size() == requestsCount);
+		std::sort(latencies.begin(), latencies.end());
+		double tickTime = 1000000.0 / (double)Time::GetTicksPerSecond();
+		std::cout << name << ", " << usersCount << " users: " << (int)(requestsCount / time) << " requests/s, latency p50 "
+			<< (int)(latencies[latencies.size() / 2] * tickTime) << " us, p99 " << (int)(latencies[latencies.size() * 99 / 100] * tickTime)
+			<< " us, max " << (int)(latencies.back() * tickTime) << " us\n";
+	}
+};
+
+/// Raw request over its own connection, returns whole response.
+class RawRequest : public Object
+{
+private:
+	ptr<MemoryStream> response;
+	bool done;
+	bool failed;
+
+	void OnConnect(const Service::TcpSocketHandler::Result& result)
+	{
+		try
+		{
+			ptr<TcpSocket> socket = result.GetData();
+			socket->SetReceiveHandler(TcpSocket::ReceiveHandler::Bind(MakePointer(this), &RawRequest::OnReceive));
+			socket->Send(Strings::String2File(request));
+		}
+		catch(Exception* exception)
+		{
+			MakePointer(exception);
+			failed = true;
+			done = true;
+		}
+	}
+
+	void OnReceive(const TcpSocket::ReceiveHandler::Result& result)
+	{
+		try
+		{
+			ptr<File> data = result.GetData();
+			if(data)
+				response->Write(data->GetData(), data->GetSize());
+			else
+				done = true;
+		}
+		catch(Exception* exception)
+		{
+			MakePointer(exception);
+			failed = true;
+			done = true;
+		}
+	}
+
+public:
+	String request;
+
+	RawRequest(const String& request) : response(NEW(MemoryStream())), done(false), failed(false), request(request) {}
+
+	String Run(ptr<AsioService> service)
+	{
+		service->ConnectTcp("127.0.0.1", port, Service::TcpSocketHandler::Bind(MakePointer(this), &RawRequest::OnConnect));
+		RunUntil(service, done);
+		return failed ? "failed" : Strings::File2String(response->ToFile());
+	}
+};
+
+class Result : public SuccessHandler
+{
+public:
+	ptr<AsioService> service;
+	ptr<MemoryStream> stream;
+	bool done;
+	bool succeeded;
+
+	Result(ptr<AsioService> service) : service(service), stream(NEW(MemoryStream())), done(false), succeeded(false) {}
+
+	void OnSuccess()
+	{
+		succeeded = true;
+		done = true;
+	}
+
+	void OnError(ptr<Exception>)
+	{
+		done = true;
+	}
+
+	String Get()
+	{
+		RunUntil(service, done);
+		return succeeded ? Strings::File2String(stream->ToFile()) : "failed";
+	}
+};
+
+static void CheckRequests(ptr<AsioService> service, const String& file)
+{
+	// pipelined requests with ranges, responses are in order
+	String response = ptr<RawRequest>(NEW(RawRequest(
+		"GET /files/data.bin HTTP/1.1\r\nHost: x\r\nRange: bytes=10-19\r\n\r\n"
+		"GET /files/data.bin HTTP/1.1\r\nHost: x\r\nRange: bytes=-5\r\n\r\n"
+		"GET /files/data.bin HTTP/1.1\r\nHost: x\r\nRange: bytes=65530-\r\n\r\n"
+		"GET /files/data.bin HTTP/1.1\r\nHost: x\r\nRange: bytes=70000-\r\n\r\n"
+		"HEAD /files/data.bin HTTP/1.1\r\nHost: x\r\n\r\n"
+		"GET /memory/echo?a=1 HTTP/1.1\r\nHost: x\r\nConnection: close\r\n\r\n"
+		"GET /memory/ignored HTTP/1.1\r\nHost: x\r\n\r\n")))->Run(service);
+
+	std::ostringstream expected;
+	expected << "HTTP/1.1 206 Partial Content\r\nContent-Length: 10\r\nContent-Type: application/octet-stream\r\n"
+		"Content-Range: bytes 10-19/65536\r\nAccept-Ranges: bytes\r\n\r\n" << file.substr(10, 10);
+	expected << "HTTP/1.1 206 Partial Content\r\nContent-Length: 5\r\nContent-Type: application/octet-stream\r\n"
+		"Content-Range: bytes 65531-65535/65536\r\nAccept-Ranges: bytes\r\n\r\n" << file.substr(65531);
+	expected << "HTTP/1.1 206 Partial Content\r\nContent-Length: 6\r\nContent-Type: application/octet-stream\r\n"
+		"Content-Range: bytes 65530-65535/65536\r\nAccept-Ranges: bytes\r\n\r\n" << file.substr(65530);
+	expected << "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Length: 0\r\n"
+		"Content-Range: bytes */65536\r\nAccept-Ranges: bytes\r\n\r\n";
+	expected << "HTTP/1.1 200 OK\r\nContent-Length: 65536\r\nContent-Type: application/octet-stream\r\nAccept-Ranges: bytes\r\n\r\n";
+	expected << "HTTP/1.1 200 OK\r\nContent-Length: 9\r\nContent-Type: text/plain\r\nConnection: close\r\nAccept-Ranges: bytes\r\n\r\n/echo?a=1";
+	Check("pipelined ranges", response == expected.str());
+
+	// errors
+	response = ptr<RawRequest>(NEW(RawRequest(
+		"GET /files/missing.bin HTTP/1.1\r\nHost: x\r\n\r\n"
+		"GET /files/%2e%2e/secret HTTP/1.1\r\nHost: x\r\n\r\n"
+		"POST /files/data.bin HTTP/1.1\r\nHost: x\r\nContent-Length: 3\r\n\r\nabc"
+		"GET /files/a..b.txt HTTP/1.1\r\nHost: x\r\n\r\n"
+		"GET /filesdata.bin HTTP/1.1\r\nHost: x\r\n\r\n"
+		"GET /nowhere HTTP/1.1\r\nHost: x\r\nConnection: close\r\n\r\n")))->Run(service);
+	Check("errors", response ==
+		"HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n"
+		"HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n"
+		"HTTP/1.1 405 Method Not Allowed\r\nContent-Length: 0\r\nAllow: GET, HEAD\r\n\r\n"
+		"HTTP/1.1 200 OK\r\nContent-Length: 4\r\nContent-Type: text/plain; charset=utf-8\r\nAccept-Ranges: bytes\r\n\r\ndots"
+		"HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n"
+		"HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+
+	// malformed request gets 400 after responses to previous ones, and closes connection
+	response = ptr<RawRequest>(NEW(RawRequest(
+		"GET /nowhere HTTP/1.1\r\nHost: x\r\n\r\n"
+		"NOT HTTP\r\n\r\n"
+		"GET /nowhere HTTP/1.1\r\nHost: x\r\n\r\n")))->Run(service);
+	Check("malformed", response ==
+		"HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n"
+		"HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+
+	// body over the limit gets 413, and closes connection
+	{
+		std::ostringstream request;
+		request << "POST /memory/echo HTTP/1.1\r\nHost: x\r\nContent-Length: " << (maxBodySize * 2) << "\r\n\r\n"
+			<< MakeData((int)maxBodySize * 2, 2)
+			<< "GET /memory/echo HTTP/1.1\r\nHost: x\r\n\r\n";
+		response = ptr<RawRequest>(NEW(RawRequest(request.str())))->Run(service);
+		Check("body limit", response ==
+			"HTTP/1.1 413 Payload Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+	}
+
+	// request body, with client of keep-alive pool
+	ptr<HttpClient> client = NEW(HttpClient(service));
+	std::ostringstream url;
+	url << "http://127.0.0.1:" << port << "/memory/echo";
+	ptr<Result> result = NEW(Result(service));
+	client->Fetch(url.str(), "POST", "posted data", "text/plain", result, result->stream);
+	Check("POST", result->Get() == "/echoposted data");
+	result = NEW(Result(service));
+	client->Get(url.str() + "/again", result, result->stream);
+	Check("keep-alive", result->Get() == "/echo/again" && client->GetOpenedConnectionsCount() == 1);
+	client->Close();
+
+	// one-shot request, with closing connection
+	result = NEW(Result(service));
+	HttpClient::Get(service, url.str() + "/once", result, result->stream);
+	Check("one-shot", result->Get() == "/echo/once");
+}
+
+int main()
+{
+	char folderName[] = "/tmp/inanity-bench-http-XXXXXX";
+	if(!mkdtemp(folderName))
+	{
+		std::cout << "Can't create temporary folder\n";
+		return 1;
+	}
+
+	try
+	{
+		String file = MakeData(fileSize, 0);
+		ptr<File> fileData = Strings::String2File(file);
+
+		// file systems with the same file
+		ptr<FileSystem> posixFileSystem = NEW(Platform::PosixFileSystem(folderName));
+		posixFileSystem->SaveFile(fileData, "/data.bin");
+		// dots in name are not a parent folder
+		posixFileSystem->SaveFile(Strings::String2File("dots"), "/a..b.txt");
+		ptr<MemoryStream> blobStream = NEW(MemoryStream());
+		{
+			ptr<Data::BlobFileSystemBuilder> builder = NEW(Data::BlobFileSystemBuilder(blobStream));
+			builder->AddFile("/data.bin", fileData);
+			builder->Finalize();
+		}
+		ptr<FileSystem> blobFileSystem = Data::BlobFileSystem::Load(blobStream->ToFile());
+
+		ptr<Service> serverService = NEW(AsioService());
+		ptr<AsioService> clientService = NEW(AsioService());
+
+		ptr<HttpServer> server = NEW(HttpServer(serverService, port, maxBodySize));
+		server->AddFileSystem("/files", posixFileSystem);
+		server->AddFileSystem("/blob", blobFileSystem);
+		ptr<File> smallData = Strings::String2File(MakeData(100, 1));
+		server->AddRoute("/memory", HttpServer::RequestHandler::BindCall([smallData](const HttpServer::RequestHandler::Result& result)
+		{
+			ptr<HttpServer::Request> request = result.GetData();
+			if(request->GetPath().compare(0, 12, "/memory/echo") == 0)
+			{
+				String echo = request->GetUrl().substr(7);
+				if(request->GetBody())
+					echo += Strings::File2String(request->GetBody());
+				request->Respond(200, Strings::String2File(echo), "text/plain");
+			}
+			else
+				request->Respond(200, smallData, "text/plain");
+		}));
+		// copies file on every request, for comparison
+		server->AddRoute("/copied", HttpServer::RequestHandler::BindCall([posixFileSystem](const HttpServer::RequestHandler::Result& result)
+		{
+			ptr<HttpServer::Request> request = result.GetData();
+			ptr<File> file = posixFileSystem->LoadFile("/data.bin");
+			ptr<File> copy = NEW(MemoryFile(file->GetSize()));
+			memcpy(copy->GetData(), file->GetData(), file->GetSize());
+			request->Respond(200, copy, "application/octet-stream");
+		}));
+
+		// server is used only by its thread from now on
+		ptr<Thread> serverThread = NEW(Thread(Thread::ThreadHandler::BindCall([serverService](const Thread::ThreadHandler::Result&)
+		{
+			serverService->Run();
+		})));
+
+		CheckRequests(clientService, file);
+
+		const int requestsCount = 20000;
+		std::ostringstream base;
+		base << "http://127.0.0.1:" << port;
+		MakePointer(NEW(Load(clientService, base.str() + "/memory/small", 1, requestsCount, 100)))->Run("memory 100 B", 1);
+		MakePointer(NEW(Load(clientService, base.str() + "/memory/small", 16, requestsCount, 100)))->Run("memory 100 B", 16);
+		MakePointer(NEW(Load(clientService, base.str() + "/files/data.bin", 16, requestsCount / 4, fileSize)))->Run("posix file 64 KiB", 16);
+		MakePointer(NEW(Load(clientService, base.str() + "/blob/data.bin", 16, requestsCount / 4, fileSize)))->Run("blob file 64 KiB", 16);
+		MakePointer(NEW(Load(clientService, base.str() + "/copied/data.bin", 16, requestsCount / 4, fileSize)))->Run("copied file 64 KiB", 16);
+		serverService->Stop();
+		serverThread->WaitEnd();
+		std::cout << server->GetRequestsCount() << " requests served\n";
+		server->Close();
+	}
+	catch(Exception* exception)
+	{
+		MakePointer(exception)->PrintStack(std::cout);
+		Check("no exceptions", false);
+	}
+
+	unlink((String(folderName) + "/data.bin").c_str());
+	unlink((String(folderName) + "/a..b.txt").c_str());
+	rmdir(folderName);
+
+	return ReportChecks();
+}
@@ -0,0 +1,442 @@
+#include "AsioService.hpp"
+#include "TcpListener.hpp"
+#include "TcpSocket.hpp"
+#include "HttpStream.hpp"
+#include "HttpClient.hpp"
+#include "../MemoryStream.hpp"
+#include "../File.hpp"
+#include "../Strings.hpp"
+#include "../Thread.hpp"
+#include "../Time.hpp"
+#include "../Exception.hpp"
+#include "../Checks.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <sstream>
+#include <iostream>
+
+/* Benchmark of HTTP client against local test server.
+Downloads a bank of small assets with one-shot requests (a connection
+per request), and with pooled keep-alive connections, with and without
+pipelining. Also checks chunked responses, HEAD requests, error statuses,
+server-closed connections, and sharing of connections limit by hosts. */
+
+using namespace Inanity;
+using namespace Inanity::Net;
+
+static const int port = 18080;
+static const int assetsCount = 2000;
+static const int assetSize = 1024;
+
+/// Body of asset, depends on asset number to catch mixed up responses.
+static String MakeBody(int number, int size)
+{
+	String body(size, ' ');
+	for(int i = 0; i < size; ++i)
+		body[i] = (char)('a' + (number + i) % 26);
+	return body;
+}
+
+/// Connection of test server.
+/** Urls are "/<size>/<number>", "/chunked/<size>/<number>",
+"/close/<size>/<number>", anything else is 404. */
+class ServerConnection : public Object
+{
+private:
+	ptr<TcpSocket> socket;
+	ptr<HttpStream> stream;
+
+public:
+	ServerConnection(ptr<TcpSocket> socket) : socket(socket), stream(HttpStream::CreateRequestStream(nullptr)) {}
+
+	void Start()
+	{
+		stream->SetMessageHandler(Handler::Bind(MakePointer(this), &ServerConnection::OnRequest));
+		socket->SetNoDelay(true);
+		socket->SetReceiveHandler(TcpSocket::ReceiveHandler::Bind(MakePointer(this), &ServerConnection::OnReceive));
+	}
+
+private:
+	void OnReceive(const TcpSocket::ReceiveHandler::Result& result)
+	{
+		try
+		{
+			ptr<File> data = result.GetData();
+			if(data)
+				stream->OutputStream::Write(data);
+			else
+			{
+				stream->SetMessageHandler(nullptr);
+				socket->End();
+			}
+		}
+		catch(Exception* exception)
+		{
+			MakePointer(exception);
+			stream->SetMessageHandler(nullptr);
+			socket->Close();
+		}
+	}
+
+	void OnRequest()
+	{
+		const String& url = stream->GetUrl();
+		bool head = !strcmp(stream->GetMethod(), "HEAD");
+		bool keepAlive = stream->ShouldKeepAlive();
+
+		bool chunked = false, close = false;
+		const char* s = url.c_str();
+		if(!strncmp(s, "/chunked/", 9))
+		{
+			chunked = true;
+			s += 8;
+		}
+		else if(!strncmp(s, "/close/", 7))
+		{
+			close = true;
+			s += 6;
+		}
+		int size, number;
+		bool found = sscanf(s, "/%d/%d", &size, &number) == 2;
+
+		std::ostringstream response(std::ios::out | std::ios::binary);
+		if(!found)
+			response << "HTTP/1.1 404 Not Found\r\nContent-Length: 9\r\n\r\nnot found";
+		else
+		{
+			String body = MakeBody(number, size);
+			response << "HTTP/1.1 200 OK\r\n";
+			if(close || !keepAlive)
+				response << "Connection: close\r\n";
+			if(chunked)
+			{
+				response << "Transfer-Encoding: chunked\r\n\r\n";
+				for(int i = 0; i < size; i += 1000)
+				{
+					int chunkSize = std::min(1000, size - i);
+					response << std::hex << chunkSize << std::dec << "\r\n" << body.substr(i, chunkSize) << "\r\n";
+				}
+				response << "0\r\n\r\n";
+			}
+			else
+			{
+				response << "Content-Length: " << size << "\r\n\r\n";
+				if(!head)
+					response << body;
+			}
+		}
+
+		try
+		{
+			socket->Send(Strings::String2File(response.str()));
+			if(close || !keepAlive)
+				socket->End();
+		}
+		catch(Exception* exception)
+		{
+			MakePointer(exception);
+		}
+	}
+};
+
+class Server : public Object
+{
+private:
+	ptr<TcpListener> listener;
+
+public:
+	Server(ptr<Service> service)
+	{
+		listener = service->ListenTcp(port, Service::TcpSocketHandler::Bind(MakePointer(this), &Server::OnSocket));
+	}
+
+	void Close()
+	{
+		listener->Close();
+	}
+
+private:
+	void OnSocket(const Service::TcpSocketHandler::Result& result)
+	{
+		try
+		{
+			MakePointer(NEW(ServerConnection(result.GetData())))->Start();
+		}
+		catch(Exception* exception)
+		{
+			MakePointer(exception);
+		}
+	}
+};
+
+/// Set of downloads waited by main thread.
+/** Client is used only in the thread of service, so main thread
+runs service itself until downloads are finished. */
+class Downloads : public Object
+{
+private:
+	ptr<AsioService> service;
+	int finishedCount, waitedCount;
+
+public:
+	int succeededCount, failedCount, wrongCount;
+
+	Downloads(ptr<AsioService> service)
+	: service(service), finishedCount(0), waitedCount(0), succeededCount(0), failedCount(0), wrongCount(0) {}
+
+	void Finish()
+	{
+		++finishedCount;
+	}
+
+	void Wait(int count)
+	{
+		waitedCount += count;
+		while(finishedCount < waitedCount)
+			service->GetIoService().run_one();
+	}
+
+	/// Wait with timeout, returns false if downloads are not finished in time.
+	bool Wait(int count, int milliseconds)
+	{
+		waitedCount += count;
+		while(finishedCount < waitedCount)
+			if(!service->GetIoService().poll_one())
+			{
+				if(milliseconds-- <= 0)
+					return false;
+				Thread::Sleep(1);
+			}
+		return true;
+	}
+};
+
+class Download : public SuccessHandler
+{
+private:
+	ptr<Downloads> downloads;
+	String expected;
+
+public:
+	ptr<MemoryStream> stream;
+
+	Download(ptr<Downloads> downloads, const String& expected)
+	: downloads(downloads), expected(expected), stream(NEW(MemoryStream())) {}
+
+	void OnSuccess()
+	{
+		ptr<File> data = stream->ToFile();
+		if(data->GetSize() == expected.length() && !memcmp(data->GetData(), expected.c_str(), expected.length()))
+			++downloads->succeededCount;
+		else
+			++downloads->wrongCount;
+		downloads->Finish();
+	}
+
+	void OnError(ptr<Exception>)
+	{
+		++downloads->failedCount;
+		downloads->Finish();
+	}
+};
+
+/// Get URL of asset.
+/** \param host Other loopback addresses are different hosts for client. */
+static String GetUrl(const char* kind, int size, int number, const char* host = "127.0.0.1")
+{
+	std::ostringstream s;
+	s << "http://" << host << ":" << port << kind << "/" << size << "/" << number;
+	return s.str();
+}
+
+/// One-shot downloads, keeping given number of them running.
+class OneShotDownloads : public Object
+{
+private:
+	ptr<AsioService> service;
+	ptr<Downloads> downloads;
+	int nextNumber;
+
+public:
+	OneShotDownloads(ptr<AsioService> service, ptr<Downloads> downloads)
+	: service(service), downloads(downloads), nextNumber(0) {}
+
+	void Start()
+	{
+		if(nextNumber >= assetsCount)
+			return;
+		int number = nextNumber++;
+		ptr<Download> download = NEW(Download(downloads, MakeBody(number, assetSize)));
+		// start next download after this one
+		HttpClient::Get(service, GetUrl("", assetSize, number), NEW(Chain(this, download)), download->stream);
+	}
+
+private:
+	class Chain : public SuccessHandler
+	{
+	private:
+		ptr<OneShotDownloads> owner;
+		ptr<Download> download;
+
+	public:
+		Chain(ptr<OneShotDownloads> owner, ptr<Download> download) : owner(owner), download(download) {}
+
+		void OnSuccess()
+		{
+			owner->Start();
+			download->FireSuccess();
+		}
+
+		void OnError(ptr<Exception> exception)
+		{
+			owner->Start();
+			download->FireError(exception);
+		}
+	};
+};
+
+static double GetTime(Time::Tick startTick)
+{
+	return (double)(Time::GetTick() - startTick) / (double)Time::GetTicksPerSecond();
+}
+
+static void Print(const char* name, double time, ptr<Downloads> downloads, int connectionsCount)
+{
+	Check(name, downloads->succeededCount == assetsCount && !downloads->failedCount && !downloads->wrongCount);
+	std::cout << name << ": " << (time * 1000) << " ms, " << (int)(assetsCount / time) << " requests/s, "
+		<< connectionsCount << " connections\n";
+}
+
+static void BenchOneShot(ptr<AsioService> service, int concurrency)
+{
+	ptr<Downloads> downloads = NEW(Downloads(service));
+	ptr<OneShotDownloads> oneShot = NEW(OneShotDownloads(service, downloads));
+	Time::Tick startTick = Time::GetTick();
+	for(int i = 0; i < concurrency; ++i)
+		oneShot->Start();
+	downloads->Wait(assetsCount);
+	Print("one-shot", GetTime(startTick), downloads, assetsCount);
+}
+
+static void BenchPooled(const char* name, ptr<AsioService> service, int maxConnectionsPerHost, int pipelineDepth)
+{
+	ptr<HttpClient> client = NEW(HttpClient(service, maxConnectionsPerHost, 32, pipelineDepth));
+	ptr<Downloads> downloads = NEW(Downloads(service));
+	Time::Tick startTick = Time::GetTick();
+	for(int i = 0; i < assetsCount; ++i)
+	{
+		ptr<Download> download = NEW(Download(downloads, MakeBody(i, assetSize)));
+		client->Get(GetUrl("", assetSize, i), download, download->stream);
+	}
+	downloads->Wait(assetsCount);
+	double time = GetTime(startTick);
+	int connectionsCount = client->GetOpenedConnectionsCount();
+	client->Close();
+	Check("connections limit", connectionsCount <= maxConnectionsPerHost);
+	Print(name, time, downloads, connectionsCount);
+}
+
+static void CheckRequests(ptr<AsioService> service)
+{
+	ptr<HttpClient> client = NEW(HttpClient(service, 2, 32, 4));
+	ptr<Downloads> downloads = NEW(Downloads(service));
+
+	// chunked response is streamed into output
+	ptr<Download> chunked = NEW(Download(downloads, MakeBody(7, 1 << 20)));
+	client->Get(GetUrl("/chunked", 1 << 20, 7), chunked, chunked->stream);
+	downloads->Wait(1);
+	Check("chunked", downloads->succeededCount == 1);
+
+	// HEAD response has no body
+	ptr<Download> head = NEW(Download(downloads, ""));
+	client->Fetch(GetUrl("", 100, 1), "HEAD", "", "", head, head->stream);
+	downloads->Wait(1);
+	Check("HEAD", downloads->succeededCount == 2);
+
+	// error status fails the request, but keeps connection
+	ptr<Download> missing = NEW(Download(downloads, ""));
+	client->Get(GetUrl("/missing", 1, 1), missing, missing->stream);
+	downloads->Wait(1);
+	ptr<Download> afterMissing = NEW(Download(downloads, MakeBody(3, 10)));
+	client->Get(GetUrl("", 10, 3), afterMissing, afterMissing->stream);
+	downloads->Wait(1);
+	Check("404", downloads->failedCount == 1 && downloads->succeededCount == 3);
+	Check("keep-alive", client->GetOpenedConnectionsCount() == 1);
+
+	// connection closed by server, with pipelined requests after it
+	for(int i = 0; i < 8; ++i)
+	{
+		ptr<Download> download = NEW(Download(downloads, MakeBody(i, 100)));
+		client->Get(GetUrl(i == 3 ? "/close" : "", 100, i), download, download->stream);
+	}
+	downloads->Wait(8);
+	Check("closed by server", downloads->succeededCount == 11 && downloads->failedCount == 1 && !downloads->wrongCount);
+
+	// POST is not pipelined, but works
+	ptr<Download> post = NEW(Download(downloads, MakeBody(5, 20)));
+	client->Fetch(GetUrl("", 20, 5), "POST", "data", "text/plain", post, post->stream);
+	downloads->Wait(1);
+	Check("POST", downloads->succeededCount == 12);
+
+	// one-shot request
+	ptr<Download> oneShot = NEW(Download(downloads, MakeBody(9, 5000)));
+	HttpClient::Get(service, GetUrl("/chunked", 5000, 9), oneShot, oneShot->stream);
+	downloads->Wait(1);
+	Check("one-shot chunked", downloads->succeededCount == 13);
+
+	client->Close();
+}
+
+/// Check that idle connection of one host doesn't block other hosts.
+static void CheckHosts(ptr<AsioService> service)
+{
+	ptr<HttpClient> client = NEW(HttpClient(service, 2, 1, 1));
+	ptr<Downloads> downloads = NEW(Downloads(service));
+
+	// the only connection slot is taken by idle keep-alive connection
+	ptr<Download> first = NEW(Download(downloads, MakeBody(1, 10)));
+	client->Get(GetUrl("", 10, 1), first, first->stream);
+	downloads->Wait(1);
+
+	// other host gets the slot
+	ptr<Download> second = NEW(Download(downloads, MakeBody(2, 10)));
+	client->Get(GetUrl("", 10, 2, "127.0.0.2"), second, second->stream);
+	Check("idle connection of other host", downloads->Wait(1, 5000) && downloads->succeededCount == 2);
+
+	// and gives it back
+	ptr<Download> third = NEW(Download(downloads, MakeBody(3, 10)));
+	client->Get(GetUrl("", 10, 3), third, third->stream);
+	Check("idle connection given back", downloads->Wait(1, 5000) && downloads->succeededCount == 3);
+	Check("connections of hosts", client->GetOpenedConnectionsCount() == 3);
+
+	client->Close();
+}
+
+int main()
+{
+	try
+	{
+		// server and client share service, run by main thread while waiting
+		ptr<AsioService> service = NEW(AsioService());
+		ptr<Server> server = NEW(Server(service));
+
+		CheckRequests(service);
+		CheckHosts(service);
+		BenchOneShot(service, 6);
+		BenchPooled("pooled, 6 connections", service, 6, 1);
+		BenchPooled("pooled, 1 connection", service, 1, 1);
+		BenchPooled("pipelined, 1 connection, depth 16", service, 1, 16);
+		BenchPooled("pipelined, 6 connections, depth 8", service, 6, 8);
+
+		server->Close();
+	}
+	catch(Exception* exception)
+	{
+		MakePointer(exception)->PrintStack(std::cout);
+		return 1;
+	}
+
+	return ReportChecks();
+}
@@ -0,0 +1,279 @@
+#include "AsioService.hpp"
+#include "TcpListener.hpp"
+#include "TcpSocket.hpp"
+#include "BufferedTcpStream.hpp"
+#include "../MemoryFile.hpp"
+#include "../File.hpp"
+#include "../Thread.hpp"
+#include "../Semaphore.hpp"
+#include "../Time.hpp"
+#include "../Exception.hpp"
+#include "../Checks.hpp"
+#include <cstring>
+#include <iostream>
+
+/* Benchmark of small-message throughput over loopback TCP.
+Client writes messages of three small fields (length, id, payload)
+into plain socket stream (every write is sent separately), and into
+buffered stream with automatic, per-message, corked and time-based
+flushing. Server checks received data by hash. */
+
+using namespace Inanity;
+using namespace Inanity::Net;
+
+static const int port = 18083;
+static const int payloadSize = 20;
+
+/// 64-bit FNV-1a hash, continued from given value.
+static unsigned long long Hash(unsigned long long hash, const void* data, size_t size)
+{
+	for(size_t i = 0; i < size; ++i)
+		hash = (hash ^ ((const unsigned char*)data)[i]) * 1099511628211ULL;
+	return hash;
+}
+
+static const unsigned long long initialHash = 14695981039346656037ULL;
+
+/// Connection of test server, hashes all received data.
+class ServerConnection : public Object
+{
+private:
+	ptr<TcpSocket> socket;
+	Semaphore* doneSemaphore;
+
+public:
+	unsigned long long hash;
+	size_t receivedSize;
+
+	ServerConnection(ptr<TcpSocket> socket, Semaphore* doneSemaphore)
+	: socket(socket), doneSemaphore(doneSemaphore), hash(initialHash), receivedSize(0) {}
+
+	void Start()
+	{
+		socket->SetReceiveHandler(TcpSocket::ReceiveHandler::Bind(MakePointer(this), &ServerConnection::OnReceive));
+	}
+
+private:
+	void OnReceive(const TcpSocket::ReceiveHandler::Result& result)
+	{
+		try
+		{
+			ptr<File> data = result.GetData();
+			if(data)
+			{
+				hash = Hash(hash, data->GetData(), data->GetSize());
+				receivedSize += data->GetSize();
+			}
+			else
+			{
+				socket->End();
+				doneSemaphore->Release();
+			}
+		}
+		catch(Exception* exception)
+		{
+			MakePointer(exception);
+			socket->Close();
+			doneSemaphore->Release();
+		}
+	}
+};
+
+/// Test server, accepts one connection at a time.
+class Server : public Object
+{
+private:
+	ptr<TcpListener> listener;
+
+public:
+	ptr<ServerConnection> connection;
+	Semaphore doneSemaphore;
+
+	Server(ptr<Service> service)
+	{
+		listener = service->ListenTcp(port, Service::TcpSocketHandler::Bind(MakePointer(this), &Server::OnSocket));
+	}
+
+	void Close()
+	{
+		listener->Close();
+	}
+
+private:
+	void OnSocket(const Service::TcpSocketHandler::Result& result)
+	{
+		try
+		{
+			connection = NEW(ServerConnection(result.GetData(), &doneSemaphore));
+			connection->Start();
+		}
+		catch(Exception* exception)
+		{
+			MakePointer(exception);
+		}
+	}
+};
+
+/// Client connection.
+class Client : public Object
+{
+private:
+	Semaphore semaphore;
+	ptr<TcpSocket> socket;
+
+	void OnConnect(const Service::TcpSocketHandler::Result& result)
+	{
+		try
+		{
+			socket = result.GetData();
+		}
+		catch(Exception* exception)
+		{
+			MakePointer(exception);
+		}
+		semaphore.Release();
+	}
+
+public:
+	ptr<TcpSocket> Connect(ptr<Service> service)
+	{
+		service->ConnectTcp("127.0.0.1", port, Service::TcpSocketHandler::Bind(MakePointer(this), &Client::OnConnect));
+		semaphore.Acquire();
+		if(!socket)
+			THROW("Can't connect");
+		socket->SetNoDelay(true);
+		return socket;
+	}
+};
+
+/// Way to flush buffered stream.
+enum Mode
+{
+	modePlain,
+	modeBuffered,
+	modeFlushMessage,
+	modeCorked,
+	modeDelay
+};
+
+/// Write messages, returns hash of written data.
+static unsigned long long WriteMessages(OutputStream* stream, BufferedTcpStream* bufferedStream, Mode mode, int messagesCount)
+{
+	unsigned long long hash = initialHash;
+	char payload[payloadSize];
+	for(int i = 0; i < messagesCount; ++i)
+	{
+		if(mode == modeCorked && i % 64 == 0)
+			bufferedStream->Cork();
+
+		unsigned int length = 8 + payloadSize;
+		unsigned long long id = i;
+		for(int j = 0; j < payloadSize; ++j)
+			payload[j] = (char)('a' + (i + j) % 26);
+		stream->Write(&length, sizeof(length));
+		stream->Write(&id, sizeof(id));
+		stream->Write(payload, payloadSize);
+		hash = Hash(hash, &length, sizeof(length));
+		hash = Hash(hash, &id, sizeof(id));
+		hash = Hash(hash, payload, payloadSize);
+
+		if(mode == modeFlushMessage)
+			bufferedStream->Flush();
+		if(mode == modeCorked && i % 64 == 63)
+			bufferedStream->Uncork();
+	}
+	if(mode == modeCorked && messagesCount % 64)
+		bufferedStream->Uncork();
+	return hash;
+}
+
+static void Run(ptr<Service> service, ptr<Server> server, const char* name, Mode mode, int messagesCount)
+{
+	ptr<TcpSocket> socket = MakePointer(NEW(Client()))->Connect(service);
+
+	Time::Tick startTick = Time::GetTick();
+	unsigned long long hash;
+	if(mode == modePlain)
+	{
+		hash = WriteMessages(socket->GetOutputStream(), nullptr, mode, messagesCount);
+		socket->End();
+	}
+	else
+	{
+		// in delay mode time threshold drives sending
+		ptr<BufferedTcpStream> stream = mode == modeDelay
+			? NEW(BufferedTcpStream(socket, 0x100000, 1000))
+			: NEW(BufferedTcpStream(socket));
+		hash = WriteMessages(stream, stream, mode, messagesCount);
+		stream->End();
+	}
+	server->doneSemaphore.Acquire();
+	double time = (double)(Time::GetTick() - startTick) / (double)Time::GetTicksPerSecond();
+
+	size_t size = (size_t)messagesCount * (4 + 8 + payloadSize);
+	Check(name, server->connection->hash == hash && server->connection->receivedSize == size);
+	std::cout << name << ": " << (int)(messagesCount / time) << " messages/s, "
+		<< (int)(size / time / (1024 * 1024)) << " MiB/s\n";
+}
+
+/// Check mixed small writes and large files.
+static void CheckMixed(ptr<Service> service, ptr<Server> server)
+{
+	ptr<TcpSocket> socket = MakePointer(NEW(Client()))->Connect(service);
+	ptr<BufferedTcpStream> stream = NEW(BufferedTcpStream(socket, 0x3000));
+
+	unsigned long long hash = initialHash;
+	size_t size = 0;
+	for(int i = 0; i < 200; ++i)
+	{
+		size_t partSize = (size_t)(i * 7919) % 10000 + 1;
+		ptr<File> file = NEW(MemoryFile(partSize));
+		for(size_t j = 0; j < partSize; ++j)
+			((char*)file->GetData())[j] = (char)(i + j);
+		if(i % 3)
+			stream->Write(file);
+		else
+			stream->Write(file->GetData(), partSize);
+		if(i % 10 == 0)
+			stream->Flush();
+		hash = Hash(hash, file->GetData(), partSize);
+		size += partSize;
+	}
+	stream->End();
+	server->doneSemaphore.Acquire();
+
+	Check("mixed writes", server->connection->hash == hash && server->connection->receivedSize == size);
+}
+
+int main()
+{
+	try
+	{
+		ptr<Service> service = NEW(AsioService());
+		ptr<Server> server = NEW(Server(service));
+		ptr<Thread> thread = NEW(Thread(Thread::ThreadHandler::BindCall([service](const Thread::ThreadHandler::Result&)
+		{
+			service->Run();
+		})));
+
+		CheckMixed(service, server);
+
+		const int messagesCount = 200000;
+		Run(service, server, "plain stream", modePlain, messagesCount / 4);
+		Run(service, server, "buffered, 16 KiB threshold", modeBuffered, messagesCount);
+		Run(service, server, "buffered, flush every message", modeFlushMessage, messagesCount / 4);
+		Run(service, server, "buffered, corked by 64 messages", modeCorked, messagesCount);
+		Run(service, server, "buffered, 1 ms threshold", modeDelay, messagesCount);
+
+		server->Close();
+		service->Stop();
+		thread->WaitEnd();
+	}
+	catch(Exception* exception)
+	{
+		MakePointer(exception)->PrintStack(std::cout);
+		return 1;
+	}
+
+	return ReportChecks();
+}
@@ -0,0 +1,432 @@
+#include "UdpConnection.hpp"
+#include "AsioService.hpp"
+#include "UdpListener.hpp"
+#include "UdpPacket.hpp"
+#include "../MemoryFile.hpp"
+#include "../File.hpp"
+#include "../Thread.hpp"
+#include "../Semaphore.hpp"
+#include "../CriticalSection.hpp"
+#include "../CriticalCode.hpp"
+#include "../Time.hpp"
+#include "../Exception.hpp"
+#include "../Checks.hpp"
+#include <vector>
+#include <map>
+#include <cstring>
+#include <iostream>
+
+/* Test and benchmark of UDP connection.
+Two connections are linked by simulated network with configurable
+latency, jitter and loss, driven by virtual time. Both sides send
+reliable messages and unreliable state updates; test checks that
+reliable messages are delivered completely and in order, and unreliable
+ones are never delivered out of order, and prints RTT, loss and
+coalescing statistics. Then connection is checked over real loopback
+UDP sockets. */
+
+using namespace Inanity;
+using namespace Inanity::Net;
+
+static const int port = 18084;
+
+/// Simulated network between two sockets.
+class SimulatedLink : public Object
+{
+public:
+	/// Parameters of one direction.
+	struct Params
+	{
+		/// Latency in milliseconds.
+		int latency;
+		/// Maximum additional random latency in milliseconds.
+		int jitter;
+		/// Probability of losing datagram.
+		float loss;
+	};
+
+	/// One end of link.
+	class Socket : public UdpSocket
+	{
+	private:
+		ptr<SimulatedLink> link;
+		int side;
+
+	public:
+		ptr<ReceiveHandler> receiveHandler;
+
+		Socket(ptr<SimulatedLink> link, int side) : link(link), side(side) {}
+
+		void Send(ptr<File> file)
+		{
+			link->Send(side, file);
+		}
+		void SetReceiveHandler(ptr<ReceiveHandler> receiveHandler)
+		{
+			if(this->receiveHandler)
+				THROW("Receive handler already set");
+			this->receiveHandler = receiveHandler;
+		}
+		void Close()
+		{
+			receiveHandler = nullptr;
+		}
+	};
+
+private:
+	Params params;
+	/// Current time.
+	long long time;
+	unsigned int random;
+	Socket* sockets[2];
+	/// Datagrams in flight, by delivery time.
+	std::multimap<long long, std::pair<int, ptr<File> > > datagrams;
+
+	float Random()
+	{
+		random = random * 1664525U + 1013904223U;
+		return (float)(random >> 8) / (float)(1 << 24);
+	}
+
+	void Send(int side, ptr<File> file)
+	{
+		if(Random() < params.loss)
+			return;
+		long long deliveryTime = time + params.latency + (long long)(Random() * params.jitter);
+		datagrams.insert(std::make_pair(deliveryTime, std::make_pair(1 - side, file)));
+	}
+
+public:
+	SimulatedLink(const Params& params) : params(params), time(0), random(12345)
+	{
+		sockets[0] = sockets[1] = nullptr;
+	}
+
+	ptr<Socket> CreateSocket(int side)
+	{
+		ptr<Socket> socket = NEW(Socket(this, side));
+		sockets[side] = socket;
+		return socket;
+	}
+
+	/// Deliver datagrams due to given time.
+	void Deliver(long long time)
+	{
+		this->time = time;
+		while(!datagrams.empty() && datagrams.begin()->first <= time)
+		{
+			std::pair<int, ptr<File> > datagram = datagrams.begin()->second;
+			datagrams.erase(datagrams.begin());
+			ptr<UdpSocket::ReceiveHandler> receiveHandler = sockets[datagram.first]->receiveHandler;
+			if(receiveHandler)
+				receiveHandler->FireData(datagram.second);
+		}
+	}
+};
+
+/// Side of test, sends and checks messages.
+class Peer : public Object
+{
+public:
+	ptr<UdpConnection> connection;
+	/// Number of next reliable message to send.
+	int nextSentId;
+	/// Number of next expected reliable message.
+	int nextReceivedId;
+	/// Last received unreliable message.
+	int lastUnreliableId;
+	int unreliableCount;
+	bool ok;
+
+	Peer(ptr<UdpSocket> socket, size_t mtu = 1200)
+	: connection(NEW(UdpConnection(socket, mtu))), nextSentId(0), nextReceivedId(0),
+		lastUnreliableId(-1), unreliableCount(0), ok(true)
+	{
+		connection->SetMessageHandler(UdpConnection::MessageHandler::Bind(MakePointer(this), &Peer::OnMessage));
+	}
+
+	/// Make message with number, of size depending on number.
+	static ptr<File> MakeMessage(int id, bool reliable)
+	{
+		size_t size = 8 + (size_t)(id * 7919) % 120;
+		ptr<File> file = NEW(MemoryFile(size));
+		unsigned char* data = (unsigned char*)file->GetData();
+		memcpy(data, &id, sizeof(id));
+		data[4] = reliable ? 'R' : 'U';
+		for(size_t i = 5; i < size; ++i)
+			data[i] = (unsigned char)(id + i);
+		return file;
+	}
+
+	void SendReliable(int count)
+	{
+		for(int i = 0; i < count; ++i)
+			connection->SendReliable(MakeMessage(nextSentId++, true));
+	}
+
+	void SendUnreliable(int id)
+	{
+		connection->SendUnreliable(MakeMessage(id, false));
+	}
+
+	void OnMessage(const UdpConnection::MessageHandler::Result& result)
+	{
+		ptr<File> message = result.GetData();
+		int id;
+		memcpy(&id, message->GetData(), sizeof(id));
+		ptr<File> expected = MakeMessage(id, ((const char*)message->GetData())[4] == 'R');
+		if(message->GetSize() != expected->GetSize() || memcmp(message->GetData(), expected->GetData(), message->GetSize()) != 0)
+			ok = false;
+		else if(((const char*)message->GetData())[4] == 'R')
+		{
+			if(id != nextReceivedId++)
+				ok = false;
+		}
+		else
+		{
+			if(id <= lastUnreliableId)
+				ok = false;
+			lastUnreliableId = id;
+			++unreliableCount;
+		}
+	}
+};
+
+static void PrintStats(const char* side, const UdpConnection::Stats& stats)
+{
+	std::cout << "  " << side << ": rtt " << stats.rtt << " ms (var " << stats.rttVariation << "), loss "
+		<< (int)(stats.GetLossRate() * 100 + 0.5f) << "%, " << stats.packetsSent << " datagrams for "
+		<< stats.messagesSent << " messages (" << (float)stats.bytesSent / (float)stats.packetsSent
+		<< " bytes avg), " << stats.messagesResent << " resent, " << stats.duplicatesCount << " duplicates, "
+		<< stats.staleCount << " stale\n";
+}
+
+/// Run simulated session.
+static void RunSimulated(const char* name, int latency, int jitter, float loss)
+{
+	SimulatedLink::Params params;
+	params.latency = latency;
+	params.jitter = jitter;
+	params.loss = loss;
+	ptr<SimulatedLink> link = NEW(SimulatedLink(params));
+	ptr<Peer> a = NEW(Peer(link->CreateSocket(0)));
+	ptr<Peer> b = NEW(Peer(link->CreateSocket(1)));
+
+	// 60 updates per second, sending for 10 seconds
+	const int updatesCount = 600;
+	const long long updateTime = 16;
+	Time::Tick startTick = Time::GetTick();
+	long long time = 0;
+	for(int i = 0; ; ++i)
+	{
+		if(i < updatesCount)
+		{
+			a->SendReliable(20);
+			b->SendReliable(2);
+			a->SendUnreliable(i);
+			b->SendUnreliable(i);
+		}
+		else if(!a->connection->GetUnackedReliableCount() && !b->connection->GetUnackedReliableCount())
+			break;
+		else if(i > updatesCount * 4)
+			break;
+
+		link->Deliver(time);
+		a->connection->Update(time);
+		b->connection->Update(time);
+		time += updateTime;
+	}
+	double processingTime = (double)(Time::GetTick() - startTick) / (double)Time::GetTicksPerSecond();
+
+	const UdpConnection::Stats& statsA = a->connection->GetStats();
+	const UdpConnection::Stats& statsB = b->connection->GetStats();
+
+	Check(name, a->ok && b->ok
+		&& b->nextReceivedId == a->nextSentId && a->nextReceivedId == b->nextSentId
+		&& !a->connection->GetUnackedReliableCount() && !b->connection->GetUnackedReliableCount());
+	// unreliable messages are lost together with datagrams only
+	Check(name, b->unreliableCount >= updatesCount * (1 - loss * 2) && b->unreliableCount <= updatesCount);
+	// round trip is latency twice plus waiting for update
+	Check(name, statsA.rtt >= latency * 2 && statsA.rtt <= (latency + jitter) * 2 + updateTime * 3);
+
+	std::cout << name << ": " << a->nextSentId + b->nextSentId << " reliable messages in "
+		<< time / 1000.0 << " s of simulated time, processed at "
+		<< (int)((a->nextSentId + b->nextSentId + updatesCount * 2) / processingTime) << " messages/s\n";
+	PrintStats("a", statsA);
+	PrintStats("b", statsB);
+
+	a->connection->Close();
+	b->connection->Close();
+}
+
+/// Check limits of message size.
+static void CheckMessageSize()
+{
+	SimulatedLink::Params params = { 10, 0, 0 };
+	ptr<SimulatedLink> link = NEW(SimulatedLink(params));
+	ptr<Peer> a = NEW(Peer(link->CreateSocket(0), 200));
+	ptr<Peer> b = NEW(Peer(link->CreateSocket(1), 200));
+
+	bool thrown = false;
+	try
+	{
+		a->connection->SendReliable(NEW(MemoryFile(a->connection->GetMaxMessageSize() + 1)));
+	}
+	catch(Exception* exception)
+	{
+		MakePointer(exception);
+		thrown = true;
+	}
+	Check("too big message", thrown);
+
+	// messages of maximum size take whole datagram each
+	a->connection->SendReliable(NEW(MemoryFile(a->connection->GetMaxMessageSize())));
+	a->connection->SendReliable(NEW(MemoryFile(a->connection->GetMaxMessageSize())));
+	a->connection->Update(0);
+	link->Deliver(10);
+	b->connection->Update(10);
+	Check("max size message", a->connection->GetStats().packetsSent == 2 && b->connection->GetStats().messagesReceived == 2);
+
+	a->connection->Close();
+	b->connection->Close();
+}
+
+/// Server of loopback test, accepts one connection.
+class Server : public Object
+{
+private:
+	ptr<UdpListener> listener;
+	CriticalSection cs;
+	ptr<Peer> peer;
+
+public:
+	Server(ptr<Service> service)
+	{
+		listener = service->ListenUdp(port, Service::UdpPacketHandler::Bind(MakePointer(this), &Server::OnPacket));
+	}
+
+	ptr<Peer> GetPeer()
+	{
+		CriticalCode cc(cs);
+		return peer;
+	}
+
+	void Close()
+	{
+		listener->Close();
+	}
+
+private:
+	void OnPacket(const Service::UdpPacketHandler::Result& result)
+	{
+		try
+		{
+			ptr<UdpPacket> packet = result.GetData();
+			ptr<Peer> peer = NEW(Peer(packet->CreateSocket()));
+			peer->connection->Receive(packet->GetData());
+			CriticalCode cc(cs);
+			this->peer = peer;
+		}
+		catch(Exception* exception)
+		{
+			MakePointer(exception);
+		}
+	}
+};
+
+/// Client of loopback test.
+class Client : public Object
+{
+private:
+	Semaphore semaphore;
+	ptr<UdpSocket> socket;
+
+	void OnConnect(const Service::UdpSocketHandler::Result& result)
+	{
+		try
+		{
+			socket = result.GetData();
+		}
+		catch(Exception* exception)
+		{
+			MakePointer(exception);
+		}
+		semaphore.Release();
+	}
+
+public:
+	ptr<UdpSocket> Connect(ptr<Service> service)
+	{
+		service->ConnectUdp("127.0.0.1", port, Service::UdpSocketHandler::Bind(MakePointer(this), &Client::OnConnect));
+		semaphore.Acquire();
+		if(!socket)
+			THROW("Can't connect");
+		return socket;
+	}
+};
+
+/// Run session over real loopback sockets.
+static void RunLoopback(ptr<Service> service)
+{
+	ptr<Server> server = NEW(Server(service));
+	ptr<Peer> client = NEW(Peer(MakePointer(NEW(Client()))->Connect(service)));
+
+	const int messagesCount = 5000;
+	Time::Tick startTick = Time::GetTick();
+	Time::Tick ticksPerMs = Time::GetTicksPerSecond() / 1000;
+	ptr<Peer> peer;
+	for(int i = 0; i < 10000; ++i)
+	{
+		if(client->nextSentId < messagesCount)
+			client->SendReliable(50);
+		long long time = (Time::GetTick() - startTick) / ticksPerMs;
+		client->connection->Update(time);
+		if(!peer)
+			peer = server->GetPeer();
+		if(peer)
+		{
+			peer->connection->Update(time);
+			if(peer->nextReceivedId == messagesCount && !client->connection->GetUnackedReliableCount())
+				break;
+		}
+		Thread::Sleep(1);
+	}
+	double time = (double)(Time::GetTick() - startTick) / (double)Time::GetTicksPerSecond();
+
+	Check("loopback", peer && peer->ok && peer->nextReceivedId == messagesCount && !client->connection->GetUnackedReliableCount());
+	std::cout << "loopback: " << messagesCount << " reliable messages in " << time << " s\n";
+	PrintStats("client", client->connection->GetStats());
+
+	client->connection->Close();
+	if(peer)
+		peer->connection->Close();
+	server->Close();
+}
+
+int main()
+{
+	try
+	{
+		CheckMessageSize();
+		RunSimulated("no loss, 50 ms", 50, 0, 0);
+		RunSimulated("5% loss, 50+10 ms", 50, 10, 0.05f);
+		RunSimulated("20% loss, 50+20 ms", 50, 20, 0.2f);
+		RunSimulated("20% loss, 150 ms", 150, 0, 0.2f);
+
+		ptr<Service> service = NEW(AsioService());
+		ptr<Thread> thread = NEW(Thread(Thread::ThreadHandler::BindCall([service](const Thread::ThreadHandler::Result&)
+		{
+			service->Run();
+		})));
+		RunLoopback(service);
+		service->Stop();
+		thread->WaitEnd();
+	}
+	catch(Exception* exception)
+	{
+		MakePointer(exception)->PrintStack(std::cout);
+		return 1;
+	}
+
+	return ReportChecks();
+}
@@ -5,12 +5,14 @@
 BEGIN_INANITY_PHYSICS
 
 BtRigidBody::BtRigidBody(ptr<BtWorld> world, ptr<BtShape> shape, const btTransform& startTransform)
-: RigidBody(world, shape), rigidBody(0), transform(startTransform)
+: RigidBody(world, shape), rigidBody(0), transform(startTransform), movedIndex(-1)
 {
 }
 
 BtRigidBody::~BtRigidBody()
 {
+	if(movedIndex >= 0)
+		fast_cast<BtWorld*>(&*world)->RemoveMovedBody(this);
 	if(rigidBody)
 	{
 		world.FastCast<BtWorld>()->GetInternalDynamicsWorld()->removeRigidBody(rigidBody);
@@ -71,6 +73,8 @@ void BtRigidBody::getWorldTransform(btTransform& transform) const
 void BtRigidBody::setWorldTransform(const btTransform& transform)
 {
 	this->transform = transform;
+	if(movedIndex < 0)
+		fast_cast<BtWorld*>(&*world)->AddMovedBody(this);
 }
 
 END_INANITY_PHYSICS
@@ -18,6 +18,11 @@ private:
 	btRigidBody* rigidBody;
 	/// Текущая трансформация твёрдого тела.
 	btTransform transform;
+	/// Index of body in world's list of bodies moved by last
+	/// simulation step, or -1 if body is not moved.
+	int movedIndex;
+
+	friend class BtWorld;
 
 public:
 	BtRigidBody(ptr<BtWorld> world, ptr<BtShape> shape, const btTransform& startTransform);
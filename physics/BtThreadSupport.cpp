@@ -0,0 +1,200 @@
+#include "BtThreadSupport.hpp"
+#include "../CriticalCode.hpp"
+#include "../Exception.hpp"
+
+BEGIN_INANITY_PHYSICS
+
+/// Reusable barrier on semaphores.
+/** Two turnstiles are needed, so fast thread can't pass next
+barrier while others still leave current one. */
+class BtThreadSupportBarrier : public btBarrier
+{
+private:
+	CriticalSection criticalSection;
+	Semaphore enterSemaphore, leaveSemaphore;
+	int maxCount;
+	/// Number of threads inside. Protected by critical section.
+	int count;
+
+public:
+	BtThreadSupportBarrier() : maxCount(1), count(0) {}
+
+	void sync()
+	{
+		{
+			CriticalCode cc(criticalSection);
+			if(++count == maxCount)
+				enterSemaphore.Release(maxCount);
+		}
+		enterSemaphore.Acquire();
+
+		{
+			CriticalCode cc(criticalSection);
+			if(--count == 0)
+				leaveSemaphore.Release(maxCount);
+		}
+		leaveSemaphore.Acquire();
+	}
+
+	void setMaxCount(int n)
+	{
+		maxCount = n;
+	}
+
+	int getMaxCount()
+	{
+		return maxCount;
+	}
+};
+
+class BtThreadSupportCriticalSection : public btCriticalSection
+{
+private:
+	CriticalSection criticalSection;
+
+public:
+	unsigned int getSharedParam(int i)
+	{
+		return mCommonBuff[i];
+	}
+
+	void setSharedParam(int i, unsigned int p)
+	{
+		mCommonBuff[i] = p;
+	}
+
+	void lock()
+	{
+		criticalSection.Enter();
+	}
+
+	void unlock()
+	{
+		criticalSection.Leave();
+	}
+};
+
+BtThreadSupport::BtThreadSupport(TaskFunc taskFunc, LocalMemoryFunc localMemoryFunc, FreeLocalMemoryFunc freeLocalMemoryFunc, int threadsCount)
+: taskFunc(taskFunc), freeLocalMemoryFunc(freeLocalMemoryFunc)
+{
+	try
+	{
+		workers.resize(threadsCount, nullptr);
+		for(int i = 0; i < threadsCount; ++i)
+		{
+			Worker* worker = new Worker();
+			workers[i] = worker;
+			worker->userPtr = nullptr;
+			worker->localMemory = localMemoryFunc();
+			worker->thread = NEW(Thread(Thread::ThreadHandler::BindCall([this, i](const Thread::ThreadHandler::Result&)
+			{
+				WorkerRoutine(i);
+			})));
+		}
+	}
+	catch(Exception* exception)
+	{
+		stopSPU();
+		THROW_SECONDARY("Can't create bullet thread support", exception);
+	}
+}
+
+BtThreadSupport::~BtThreadSupport()
+{
+	stopSPU();
+}
+
+void BtThreadSupport::WorkerRoutine(int taskId)
+{
+	Worker* worker = workers[taskId];
+	for(;;)
+	{
+		worker->startSemaphore.Acquire();
+		if(!worker->userPtr)
+			break;
+
+		taskFunc(worker->userPtr, worker->localMemory);
+
+		{
+			CriticalCode cc(criticalSection);
+			finishedTasks.push_back(taskId);
+		}
+		doneSemaphore.Release();
+	}
+}
+
+void BtThreadSupport::sendRequest(uint32_t, ppu_address_t uiArgument0, uint32_t uiArgument1)
+{
+	// the only command is to process task with specified id
+	Worker* worker = workers[uiArgument1];
+	worker->userPtr = (void*)uiArgument0;
+	worker->startSemaphore.Release();
+}
+
+void BtThreadSupport::waitForResponse(unsigned int* puiArgument0, unsigned int* puiArgument1)
+{
+	doneSemaphore.Acquire();
+
+	CriticalCode cc(criticalSection);
+	*puiArgument0 = finishedTasks.back();
+	*puiArgument1 = 0;
+	finishedTasks.pop_back();
+}
+
+void BtThreadSupport::startSPU() {}
+
+void BtThreadSupport::stopSPU()
+{
+	for(size_t i = 0; i < workers.size(); ++i)
+	{
+		Worker* worker = workers[i];
+		if(!worker)
+			continue;
+		if(worker->thread)
+		{
+			worker->userPtr = nullptr;
+			worker->startSemaphore.Release();
+			worker->thread->WaitEnd();
+		}
+		if(worker->localMemory && freeLocalMemoryFunc)
+			freeLocalMemoryFunc(worker->localMemory);
+		delete worker;
+	}
+	workers.clear();
+}
+
+void BtThreadSupport::setNumTasks(int) {}
+
+int BtThreadSupport::getNumTasks() const
+{
+	return (int)workers.size();
+}
+
+btBarrier* BtThreadSupport::createBarrier()
+{
+	btBarrier* barrier = new BtThreadSupportBarrier();
+	barrier->setMaxCount(getNumTasks());
+	return barrier;
+}
+
+btCriticalSection* BtThreadSupport::createCriticalSection()
+{
+	return new BtThreadSupportCriticalSection();
+}
+
+void BtThreadSupport::deleteBarrier(btBarrier* barrier)
+{
+	delete barrier;
+}
+
+void BtThreadSupport::deleteCriticalSection(btCriticalSection* criticalSection)
+{
+	delete criticalSection;
+}
+
+void* BtThreadSupport::getThreadLocalMemory(int taskId)
+{
+	return workers[taskId]->localMemory;
+}
+
+END_INANITY_PHYSICS
@@ -0,0 +1,73 @@
+#ifndef ___INANITY_PHYSICS_BT_THREAD_SUPPORT_HPP___
+#define ___INANITY_PHYSICS_BT_THREAD_SUPPORT_HPP___
+
+#include "physics.hpp"
+#include "../Thread.hpp"
+#include "../Semaphore.hpp"
+#include "../CriticalSection.hpp"
+#include "../deps/bullet/repo/src/BulletMultiThreaded/btThreadSupportInterface.h"
+#include <vector>
+
+BEGIN_INANITY_PHYSICS
+
+/// Thread support for BulletMultiThreaded tasks, running on engine threads.
+/** Used instead of Bullet's own platform thread supports, which
+print debug output, and (in POSIX version) share global semaphore
+between instances, so parallel dispatcher and solver can't be used
+together. Owned by Bullet objects' owner, so it's not an Object. */
+class BtThreadSupport : public btThreadSupportInterface
+{
+public:
+	/// Task function, called in worker thread.
+	typedef void (*TaskFunc)(void* userPtr, void* localMemory);
+	/// Function allocating local memory of worker thread.
+	typedef void* (*LocalMemoryFunc)();
+	/// Function freeing local memory of worker thread.
+	typedef void (*FreeLocalMemoryFunc)(void* localMemory);
+
+private:
+	struct Worker
+	{
+		ptr<Thread> thread;
+		/// Released to start task (or to stop thread if task is null).
+		Semaphore startSemaphore;
+		/// Task argument.
+		void* userPtr;
+		void* localMemory;
+	};
+	std::vector<Worker*> workers;
+	TaskFunc taskFunc;
+	FreeLocalMemoryFunc freeLocalMemoryFunc;
+
+	CriticalSection criticalSection;
+	/// Ids of finished tasks, not yet reported. Protected by critical section.
+	std::vector<int> finishedTasks;
+	/// Released once for each finished task.
+	Semaphore doneSemaphore;
+
+	void WorkerRoutine(int taskId);
+
+public:
+	/// Create thread support.
+	/** \param freeLocalMemoryFunc Function freeing local memory
+	of worker threads when they are stopped, or null. */
+	BtThreadSupport(TaskFunc taskFunc, LocalMemoryFunc localMemoryFunc, FreeLocalMemoryFunc freeLocalMemoryFunc, int threadsCount);
+	~BtThreadSupport();
+
+	//*** btThreadSupportInterface's methods.
+	void sendRequest(uint32_t uiCommand, ppu_address_t uiArgument0, uint32_t uiArgument1);
+	void waitForResponse(unsigned int* puiArgument0, unsigned int* puiArgument1);
+	void startSPU();
+	void stopSPU();
+	void setNumTasks(int numTasks);
+	int getNumTasks() const;
+	btBarrier* createBarrier();
+	btCriticalSection* createCriticalSection();
+	void deleteBarrier(btBarrier* barrier);
+	void deleteCriticalSection(btCriticalSection* criticalSection);
+	void* getThreadLocalMemory(int taskId);
+};
+
+END_INANITY_PHYSICS
+
+#endif
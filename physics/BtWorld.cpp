@@ -2,21 +2,114 @@
 #include "BtShape.hpp"
 #include "BtRigidBody.hpp"
 #include "BtCharacter.hpp"
+#include "BtThreadSupport.hpp"
+#include "../ThreadPool.hpp"
+#include "../CriticalSection.hpp"
+#include "../CriticalCode.hpp"
 #include "../Exception.hpp"
+#include "../deps/bullet/repo/src/BulletCollision/CollisionDispatch/btSimulationIslandManager.h"
+#include "../deps/bullet/repo/src/BulletMultiThreaded/SpuGatheringCollisionDispatcher.h"
+#include "../deps/bullet/repo/src/BulletMultiThreaded/SpuNarrowPhaseCollisionTask/SpuGatheringCollisionTask.h"
+#include "../deps/bullet/repo/src/BulletMultiThreaded/btParallelConstraintSolver.h"
+#include "../deps/bullet/repo/src/BulletCollision/NarrowPhaseCollision/btGjkPairDetector.h"
+#include "../deps/bullet/repo/src/BulletCollision/NarrowPhaseCollision/btGjkEpaPenetrationDepthSolver.h"
+#include "../deps/bullet/repo/src/BulletCollision/NarrowPhaseCollision/btPointCollector.h"
+#include "../deps/bullet/repo/src/BulletCollision/CollisionShapes/btConcaveShape.h"
+#include "../deps/bullet/repo/src/BulletCollision/CollisionShapes/btTriangleShape.h"
+#include "../deps/bullet/repo/src/BulletCollision/CollisionShapes/btTriangleCallback.h"
+#include <algorithm>
+
+/* Bullet remembers every collision local store in this global array,
+to free all of them at once by deleteCollisionLocalStoreMemory. It would
+free stores of all worlds, so worlds take ownership of their stores
+instead. */
+struct CollisionTask_LocalStoreMemory;
+extern btAlignedObjectArray<CollisionTask_LocalStoreMemory*> sLocalStorePointers;
 
 BEGIN_INANITY_PHYSICS
 
-BtWorld::BtWorld() :
+/// Protects Bullet's global array of collision local stores.
+static CriticalSection& GetCollisionLocalStoresCriticalSection()
+{
+	static CriticalSection criticalSection;
+	return criticalSection;
+}
+
+static void* CreateCollisionLocalStore()
+{
+	CriticalCode cc(GetCollisionLocalStoresCriticalSection());
+	void* localStore = createCollisionLocalStoreMemory();
+	sLocalStorePointers.remove((CollisionTask_LocalStoreMemory*)localStore);
+	return localStore;
+}
+
+static void FreeCollisionLocalStore(void* localStore)
+{
+	btAlignedFree(localStore);
+}
+
+BtWorld::Config::Config() :
+	broadphase(Broadphases::dbvt),
+	worldMin(-1000, -1000, -1000), worldMax(1000, 1000, 1000),
+	maxBodiesCount(16384), threadsCount(1) {}
+
+BtWorld::BtWorld(const Config& config) :
 	collisionConfiguration(0), collisionDispatcher(0), broadphase(0),
-	solver(0), dynamicsWorld(0)
+	solver(0), dynamicsWorld(0), collisionThreadSupport(0), solverThreadSupport(0)
 {
 	try
 	{
-		collisionConfiguration = new btDefaultCollisionConfiguration();
-		collisionDispatcher = new btCollisionDispatcher(collisionConfiguration);
-		broadphase = new btDbvtBroadphase();
-		solver = new btSequentialImpulseConstraintSolver();
-		dynamicsWorld = new btDiscreteDynamicsWorld(collisionDispatcher, broadphase, solver, collisionConfiguration);
+		int threadsCount = config.threadsCount > 0 ? config.threadsCount : ThreadPool::GetHardwareThreadsCount();
+		bool multiThreaded = threadsCount > 1;
+
+		btDefaultCollisionConstructionInfo collisionConstructionInfo;
+		// parallel solver requires contacts in contiguous pool, so pool can't grow
+		if(multiThreaded)
+			collisionConstructionInfo.m_defaultMaxPersistentManifoldPoolSize = config.maxBodiesCount * 2;
+		collisionConfiguration = new btDefaultCollisionConfiguration(collisionConstructionInfo);
+
+		if(multiThreaded)
+		{
+			collisionThreadSupport = new BtThreadSupport(processCollisionTask, CreateCollisionLocalStore, FreeCollisionLocalStore, threadsCount);
+			collisionDispatcher = new SpuGatheringCollisionDispatcher(collisionThreadSupport, threadsCount, collisionConfiguration);
+			collisionDispatcher->setDispatcherFlags(btCollisionDispatcher::CD_DISABLE_CONTACTPOOL_DYNAMIC_ALLOCATION);
+		}
+		else
+			collisionDispatcher = new btCollisionDispatcher(collisionConfiguration);
+
+		switch(config.broadphase)
+		{
+		case Broadphases::dbvt:
+			broadphase = new btDbvtBroadphase();
+			break;
+		case Broadphases::sweepAndPrune:
+			// 16-bit version is more compact, but limited in number of handles
+			if(config.maxBodiesCount < 0x7fff)
+				broadphase = new btAxisSweep3(toBt(config.worldMin), toBt(config.worldMax), (unsigned short)config.maxBodiesCount);
+			else
+				broadphase = new bt32BitAxisSweep3(toBt(config.worldMin), toBt(config.worldMax), config.maxBodiesCount);
+			break;
+		default:
+			THROW("Invalid broadphase");
+		}
+
+		if(multiThreaded)
+		{
+			solverThreadSupport = new BtThreadSupport(SolverThreadFunc, SolverlsMemoryFunc, nullptr, threadsCount);
+			solver = new btParallelConstraintSolver(solverThreadSupport);
+		}
+		else
+			solver = new btSequentialImpulseConstraintSolver();
+
+		btDiscreteDynamicsWorld* discreteDynamicsWorld = new btDiscreteDynamicsWorld(collisionDispatcher, broadphase, solver, collisionConfiguration);
+		dynamicsWorld = discreteDynamicsWorld;
+
+		if(multiThreaded)
+		{
+			// parallel solver processes all islands at once
+			discreteDynamicsWorld->getSimulationIslandManager()->setSplitIslands(false);
+			discreteDynamicsWorld->getSolverInfo().m_solverMode = SOLVER_SIMD | SOLVER_USE_WARMSTARTING;
+		}
 
 		broadphase->getOverlappingPairCache()->setInternalGhostPairCallback(new btGhostPairCallback());
 
@@ -34,10 +127,14 @@ BtWorld::~BtWorld()
 		delete dynamicsWorld;
 	if(solver)
 		delete solver;
+	if(solverThreadSupport)
+		delete solverThreadSupport;
 	if(broadphase)
 		delete broadphase;
 	if(collisionDispatcher)
 		delete collisionDispatcher;
+	if(collisionThreadSupport)
+		delete collisionThreadSupport;
 	if(collisionConfiguration)
 		delete collisionConfiguration;
 }
@@ -121,6 +218,8 @@ ptr<RigidBody> BtWorld::CreateRigidBody(ptr<Shape> abstractShape, float mass, co
 		ptr<BtRigidBody> rigidBody = NEW(BtRigidBody(this, shape, toBt(startTransform)));
 		btRigidBody::btRigidBodyConstructionInfo info(mass, &*rigidBody, shape->GetInternalObject(), localInertia);
 		btRigidBody* internalRigidBody = new btRigidBody(info);
+		// user pointer marks objects which are bodies, for queries
+		internalRigidBody->setUserPointer((BtRigidBody*)rigidBody);
 		rigidBody->SetInternalObject(internalRigidBody);
 
 		dynamicsWorld->addRigidBody(internalRigidBody);
@@ -164,7 +263,345 @@ ptr<Character> BtWorld::CreateCharacter(ptr<Shape> abstractShape, const mat4x4&
 
 void BtWorld::Simulate(float time)
 {
+	for(size_t i = 0; i < movedBodies.size(); ++i)
+		movedBodies[i]->movedIndex = -1;
+	movedBodies.clear();
+
 	dynamicsWorld->stepSimulation(time, 100);
 }
 
+int BtWorld::GetMovedBodiesCount() const
+{
+	return (int)movedBodies.size();
+}
+
+void BtWorld::GetMovedTransforms(BodyTransform* transforms) const
+{
+	for(size_t i = 0; i < movedBodies.size(); ++i)
+	{
+		BtRigidBody* body = movedBodies[i];
+		transforms[i].body = body;
+		transforms[i].transform = fromBt(body->transform);
+	}
+}
+
+void BtWorld::AddMovedBody(BtRigidBody* body)
+{
+	body->movedIndex = (int)movedBodies.size();
+	movedBodies.push_back(body);
+}
+
+void BtWorld::RemoveMovedBody(BtRigidBody* body)
+{
+	// move last body into the place of removed one
+	BtRigidBody* lastBody = movedBodies.back();
+	movedBodies[body->movedIndex] = lastBody;
+	lastBody->movedIndex = body->movedIndex;
+	movedBodies.pop_back();
+	body->movedIndex = -1;
+}
+
+void BtWorld::BeginCandidates(int queriesCount)
+{
+	candidates.clear();
+	candidatesOffsets.clear();
+	candidatesOffsets.reserve(queriesCount + 1);
+}
+
+/// Callback collecting bodies found by broadphase.
+struct BtCandidatesCallback : public btBroadphaseRayCallback
+{
+	std::vector<btCollisionObject*>& candidates;
+
+	BtCandidatesCallback(std::vector<btCollisionObject*>& candidates) : candidates(candidates) {}
+
+	bool process(const btBroadphaseProxy* proxy)
+	{
+		btCollisionObject* object = (btCollisionObject*)proxy->m_clientObject;
+		if(object->getUserPointer())
+			candidates.push_back(object);
+		return true;
+	}
+};
+
+void BtWorld::CollectRayCandidates(const btVector3& from, const btVector3& to, const btVector3& aabbMin, const btVector3& aabbMax)
+{
+	candidatesOffsets.push_back((int)candidates.size());
+
+	BtCandidatesCallback callback(candidates);
+	// the same as in btCollisionWorld::rayTest
+	btVector3 direction = to - from;
+	btScalar length = direction.length();
+	if(length > 0)
+		direction /= length;
+	for(int i = 0; i < 3; ++i)
+	{
+		callback.m_rayDirectionInverse[i] = direction[i] == btScalar(0) ? btScalar(BT_LARGE_FLOAT) : btScalar(1) / direction[i];
+		callback.m_signs[i] = callback.m_rayDirectionInverse[i] < 0;
+	}
+	callback.m_lambda_max = length;
+
+	broadphase->rayTest(from, to, callback, aabbMin, aabbMax);
+}
+
+void BtWorld::CollectAabbCandidates(const btVector3& aabbMin, const btVector3& aabbMax)
+{
+	candidatesOffsets.push_back((int)candidates.size());
+
+	BtCandidatesCallback callback(candidates);
+	broadphase->aabbTest(aabbMin, aabbMax, callback);
+}
+
+void BtWorld::RunQueries(int count, ThreadPool* threadPool, const std::function<void(int, int)>& process)
+{
+	// small batches are not worth waking threads
+	const int minQueriesInTask = 64;
+	if(!threadPool || count < minQueriesInTask * 2)
+	{
+		process(0, count);
+		return;
+	}
+
+	// few tasks per thread, to balance load
+	int tasksCount = std::min(threadPool->GetThreadsCount() * 4, count / minQueriesInTask);
+	const std::function<void(int, int)>* processPtr = &process;
+	for(int i = 0; i < tasksCount; ++i)
+	{
+		int begin = (int)((long long)count * i / tasksCount);
+		int end = (int)((long long)count * (i + 1) / tasksCount);
+		threadPool->Queue(Handler::BindCall([processPtr, begin, end]()
+		{
+			(*processPtr)(begin, end);
+		}));
+	}
+	threadPool->Wait();
+}
+
+/// Get body of collision object found by query.
+static inline RigidBody* GetQueryBody(const btCollisionObject* object)
+{
+	return (BtRigidBody*)object->getUserPointer();
+}
+
+void BtWorld::CastRays(const RayQuery* queries, Hit* hits, int count, ThreadPool* threadPool)
+{
+	BEGIN_TRY();
+
+	// broadphase is not thread-safe, so candidates are collected first
+	BeginCandidates(count);
+	for(int i = 0; i < count; ++i)
+		CollectRayCandidates(toBt(queries[i].from), toBt(queries[i].to));
+	candidatesOffsets.push_back((int)candidates.size());
+
+	RunQueries(count, threadPool, [this, queries, hits](int begin, int end)
+	{
+		for(int i = begin; i < end; ++i)
+		{
+			btVector3 from = toBt(queries[i].from), to = toBt(queries[i].to);
+			btTransform fromTransform(btMatrix3x3::getIdentity(), from), toTransform(btMatrix3x3::getIdentity(), to);
+			btCollisionWorld::ClosestRayResultCallback callback(from, to);
+			for(int j = candidatesOffsets[i]; j < candidatesOffsets[i + 1]; ++j)
+			{
+				btCollisionObject* object = candidates[j];
+				btCollisionWorld::rayTestSingle(fromTransform, toTransform, object, object->getCollisionShape(), object->getWorldTransform(), callback);
+			}
+
+			Hit& hit = hits[i];
+			if(callback.hasHit())
+			{
+				hit.body = GetQueryBody(callback.m_collisionObject);
+				hit.fraction = callback.m_closestHitFraction;
+				hit.point = fromBt(callback.m_hitPointWorld);
+				hit.normal = fromBt(callback.m_hitNormalWorld);
+			}
+			else
+			{
+				hit.body = nullptr;
+				hit.fraction = 1;
+				hit.point = queries[i].to;
+				hit.normal = vec3(0, 0, 0);
+			}
+		}
+	});
+
+	END_TRY("Can't cast bullet rays");
+}
+
+void BtWorld::CastShapes(const SweepQuery* queries, Hit* hits, int count, ThreadPool* threadPool)
+{
+	BEGIN_TRY();
+
+	BeginCandidates(count);
+	for(int i = 0; i < count; ++i)
+	{
+		const btCollisionShape* shape = fast_cast<BtShape*>(queries[i].shape)->GetInternalObject();
+		if(!shape->isConvex())
+			THROW("Only convex shapes can be swept");
+
+		// AABB of shape relative to its origin, in both orientations
+		btTransform from = toBt(queries[i].from), to = toBt(queries[i].to);
+		btVector3 aabbMin, aabbMax, toAabbMin, toAabbMax;
+		shape->getAabb(btTransform(from.getBasis()), aabbMin, aabbMax);
+		shape->getAabb(btTransform(to.getBasis()), toAabbMin, toAabbMax);
+		aabbMin.setMin(toAabbMin);
+		aabbMax.setMax(toAabbMax);
+
+		CollectRayCandidates(from.getOrigin(), to.getOrigin(), aabbMin, aabbMax);
+	}
+	candidatesOffsets.push_back((int)candidates.size());
+
+	RunQueries(count, threadPool, [this, queries, hits](int begin, int end)
+	{
+		for(int i = begin; i < end; ++i)
+		{
+			const btConvexShape* shape = (const btConvexShape*)fast_cast<BtShape*>(queries[i].shape)->GetInternalObject();
+			btTransform from = toBt(queries[i].from), to = toBt(queries[i].to);
+			btCollisionWorld::ClosestConvexResultCallback callback(from.getOrigin(), to.getOrigin());
+			for(int j = candidatesOffsets[i]; j < candidatesOffsets[i + 1]; ++j)
+			{
+				btCollisionObject* object = candidates[j];
+				btCollisionWorld::objectQuerySingle(shape, from, to, object, object->getCollisionShape(), object->getWorldTransform(), callback, 0);
+			}
+
+			Hit& hit = hits[i];
+			if(callback.hasHit())
+			{
+				hit.body = GetQueryBody(callback.m_hitCollisionObject);
+				hit.fraction = callback.m_closestHitFraction;
+				hit.point = fromBt(callback.m_hitPointWorld);
+				hit.normal = fromBt(callback.m_hitNormalWorld);
+			}
+			else
+			{
+				hit.body = nullptr;
+				hit.fraction = 1;
+				hit.point = fromBt(to.getOrigin());
+				hit.normal = vec3(0, 0, 0);
+			}
+		}
+	});
+
+	END_TRY("Can't cast bullet shapes");
+}
+
+/// Check if shapes overlap.
+/** Compound shapes are checked child by child. */
+static bool ConvexShapesOverlap(const btConvexShape* a, const btTransform& aTransform, const btConvexShape* b, const btTransform& bTransform)
+{
+	btVoronoiSimplexSolver simplexSolver;
+	btGjkEpaPenetrationDepthSolver penetrationDepthSolver;
+	btGjkPairDetector detector(a, b, &simplexSolver, &penetrationDepthSolver);
+	btGjkPairDetector::ClosestPointInput input;
+	input.m_transformA = aTransform;
+	input.m_transformB = bTransform;
+	btPointCollector output;
+	detector.getClosestPoints(input, output, 0);
+	return output.m_hasResult && output.m_distance <= 0;
+}
+
+/// Test convex shape against triangles of concave shape (such as triangle mesh).
+/** Only triangles near convex shape are tested; Bullet's shared
+collision algorithms are not used, so it's safe in worker threads. */
+static bool ConvexConcaveShapesOverlap(const btConvexShape* a, const btTransform& aTransform, const btConcaveShape* b, const btTransform& bTransform)
+{
+	class Callback : public btTriangleCallback
+	{
+	private:
+		const btConvexShape* convex;
+		btTransform convexTransform;
+
+	public:
+		bool overlap;
+
+		Callback(const btConvexShape* convex, const btTransform& convexTransform)
+		: convex(convex), convexTransform(convexTransform), overlap(false) {}
+
+		void processTriangle(btVector3* triangle, int partId, int triangleIndex)
+		{
+			if(overlap)
+				return;
+			btTriangleShape triangleShape(triangle[0], triangle[1], triangle[2]);
+			overlap = ConvexShapesOverlap(convex, convexTransform, &triangleShape, btTransform::getIdentity());
+		}
+	};
+
+	// triangles are in space of concave shape
+	btTransform aInB = bTransform.inverse() * aTransform;
+	btVector3 aabbMin, aabbMax;
+	a->getAabb(aInB, aabbMin, aabbMax);
+	Callback callback(a, aInB);
+	b->processAllTriangles(&callback, aabbMin, aabbMax);
+	return callback.overlap;
+}
+
+static bool ShapesOverlap(const btCollisionShape* a, const btTransform& aTransform, const btCollisionShape* b, const btTransform& bTransform)
+{
+	if(a->isCompound())
+	{
+		const btCompoundShape* compound = (const btCompoundShape*)a;
+		for(int i = 0; i < compound->getNumChildShapes(); ++i)
+			if(ShapesOverlap(compound->getChildShape(i), aTransform * compound->getChildTransform(i), b, bTransform))
+				return true;
+		return false;
+	}
+	if(b->isCompound())
+		return ShapesOverlap(b, bTransform, a, aTransform);
+
+	if(a->isConvex() && b->isConvex())
+		return ConvexShapesOverlap((const btConvexShape*)a, aTransform, (const btConvexShape*)b, bTransform);
+	// concave shapes are not created by world, but may be added to
+	// internal world directly (static triangle meshes, heightfields)
+	if(a->isConvex() && b->isConcave())
+		return ConvexConcaveShapesOverlap((const btConvexShape*)a, aTransform, (const btConcaveShape*)b, bTransform);
+	if(a->isConcave() && b->isConvex())
+		return ConvexConcaveShapesOverlap((const btConvexShape*)b, bTransform, (const btConcaveShape*)a, aTransform);
+	// query shapes are convex, so pairs of other shapes can't get here;
+	// consider their AABBs overlapping
+	return true;
+}
+
+void BtWorld::TestOverlaps(const OverlapQuery* queries, int count, std::vector<Overlap>& overlaps, ThreadPool* threadPool)
+{
+	BEGIN_TRY();
+
+	BeginCandidates(count);
+	for(int i = 0; i < count; ++i)
+	{
+		btVector3 aabbMin, aabbMax;
+		fast_cast<BtShape*>(queries[i].shape)->GetInternalObject()->getAabb(toBt(queries[i].transform), aabbMin, aabbMax);
+		CollectAabbCandidates(aabbMin, aabbMax);
+	}
+	candidatesOffsets.push_back((int)candidates.size());
+
+	// flags of overlapping candidates; threads write different elements
+	std::vector<char> candidatesOverlap(candidates.size());
+	char* candidatesOverlapPtr = candidatesOverlap.empty() ? nullptr : &candidatesOverlap[0];
+
+	RunQueries(count, threadPool, [this, queries, candidatesOverlapPtr](int begin, int end)
+	{
+		for(int i = begin; i < end; ++i)
+		{
+			const btCollisionShape* shape = fast_cast<BtShape*>(queries[i].shape)->GetInternalObject();
+			btTransform transform = toBt(queries[i].transform);
+			for(int j = candidatesOffsets[i]; j < candidatesOffsets[i + 1]; ++j)
+			{
+				btCollisionObject* object = candidates[j];
+				candidatesOverlapPtr[j] = ShapesOverlap(shape, transform, object->getCollisionShape(), object->getWorldTransform());
+			}
+		}
+	});
+
+	for(int i = 0; i < count; ++i)
+		for(int j = candidatesOffsets[i]; j < candidatesOffsets[i + 1]; ++j)
+			if(candidatesOverlap[j])
+			{
+				Overlap overlap;
+				overlap.query = i;
+				overlap.body = GetQueryBody(candidates[j]);
+				overlaps.push_back(overlap);
+			}
+
+	END_TRY("Can't test bullet overlaps");
+}
+
 END_INANITY_PHYSICS
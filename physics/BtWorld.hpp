@@ -3,21 +3,85 @@
 
 #include "World.hpp"
 #include "bt.hpp"
+#include <functional>
+
+class btThreadSupportInterface;
 
 BEGIN_INANITY_PHYSICS
 
+class BtRigidBody;
+
 /// Класс физического мира Bullet.
 class BtWorld : public World
 {
+public:
+	/// Broadphase algorithm.
+	struct Broadphases
+	{
+		enum _
+		{
+			/// Dynamic AABB tree, works with unbounded worlds.
+			dbvt,
+			/// Sweep and prune over world bounds; faster for many
+			/// slowly moving bodies inside known bounds.
+			sweepAndPrune
+		};
+	};
+	typedef Broadphases::_ Broadphase;
+
+	/// World configuration.
+	struct Config
+	{
+		Broadphase broadphase;
+		/// World bounds (sweep and prune only).
+		vec3 worldMin, worldMax;
+		/// Maximum number of bodies.
+		/** Limits sweep and prune broadphase; in multi-threaded world
+		sets size of contact pool, which can't grow. */
+		int maxBodiesCount;
+		/// Number of threads for collision dispatch and constraint solving.
+		/** 1 for single-threaded world, 0 for number of hardware threads.
+		Multi-threaded world uses parallel dispatcher and solver of
+		BulletMultiThreaded on engine threads; callbacks of Bullet objects
+		(such as motion states) are still called in the thread calling Simulate.
+		Parallel dispatcher and solver have overhead of their own, so with
+		few cores multi-threaded world may be slower than single-threaded;
+		measure with physicsbench before enabling. */
+		int threadsCount;
+
+		Config();
+	};
+
 private:
 	btDefaultCollisionConfiguration* collisionConfiguration;
 	btCollisionDispatcher* collisionDispatcher;
 	btBroadphaseInterface* broadphase;
 	btConstraintSolver* solver;
 	btDynamicsWorld* dynamicsWorld;
+	/// Threads of parallel dispatcher and solver, or null.
+	btThreadSupportInterface* collisionThreadSupport;
+	btThreadSupportInterface* solverThreadSupport;
+
+	/// Bodies moved by last simulation step.
+	std::vector<BtRigidBody*> movedBodies;
+
+	/// Objects found by broadphase for batch queries.
+	std::vector<btCollisionObject*> candidates;
+	/// Index of first candidate for every query, and end of last query's candidates.
+	std::vector<int> candidatesOffsets;
+
+	/// Start collecting candidates for new batch.
+	void BeginCandidates(int queriesCount);
+	/// Collect candidates of ray (or shape with given AABB moving along ray).
+	void CollectRayCandidates(const btVector3& from, const btVector3& to,
+		const btVector3& aabbMin = btVector3(0, 0, 0), const btVector3& aabbMax = btVector3(0, 0, 0));
+	/// Collect candidates overlapping AABB.
+	void CollectAabbCandidates(const btVector3& aabbMin, const btVector3& aabbMax);
+	/// Run processing of queries, in parallel if thread pool is specified.
+	static void RunQueries(int count, ThreadPool* threadPool, const std::function<void(int, int)>& process);
 
 public:
-	BtWorld();
+	BtWorld(const Config& config = Config());
 	~BtWorld();
 
 	btDynamicsWorld* GetInternalDynamicsWorld() const;
@@ -29,6 +93,17 @@ public:
 	ptr<RigidBody> CreateRigidBody(ptr<Shape> shape, float mass, const mat4x4& startTransform);
 	ptr<Character> CreateCharacter(ptr<Shape> shape, const mat4x4& startTransform);
 	void Simulate(float time);
+	int GetMovedBodiesCount() const;
+	void GetMovedTransforms(BodyTransform* transforms) const;
+	void CastRays(const RayQuery* queries, Hit* hits, int count, ThreadPool* threadPool = nullptr);
+	void CastShapes(const SweepQuery* queries, Hit* hits, int count, ThreadPool* threadPool = nullptr);
+	void TestOverlaps(const OverlapQuery* queries, int count, std::vector<Overlap>& overlaps, ThreadPool* threadPool = nullptr);
+
+	/// Register body moved by simulation.
+	/** Called by BtRigidBody. */
+	void AddMovedBody(BtRigidBody* body);
+	/// Unregister moved body (when it's destroyed), in constant time.
+	void RemoveMovedBody(BtRigidBody* body);
 };
 
 END_INANITY_PHYSICS
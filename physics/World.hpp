@@ -4,6 +4,12 @@
 #include "physics.hpp"
 #include <vector>
 
+BEGIN_INANITY
+
+class ThreadPool;
+
+END_INANITY
+
 BEGIN_INANITY_PHYSICS
 
 class Shape;
@@ -11,9 +17,61 @@ class RigidBody;
 class Character;
 
 /// Абстрактный класс физического мира.
+/** Batch methods use raw pointers to bodies and shapes, so no
+reference counting is done per element (and it's safe to do work
+in other threads); bodies must stay alive while results are used. */
 class World : public Object
 {
 public:
+	/// Transform of body moved by simulation.
+	struct BodyTransform
+	{
+		RigidBody* body;
+		mat4x4 transform;
+	};
+
+	/// Ray query.
+	struct RayQuery
+	{
+		vec3 from;
+		vec3 to;
+	};
+
+	/// Query sweeping convex shape between two transforms.
+	struct SweepQuery
+	{
+		Shape* shape;
+		mat4x4 from;
+		mat4x4 to;
+	};
+
+	/// Query for bodies overlapping shape.
+	struct OverlapQuery
+	{
+		Shape* shape;
+		mat4x4 transform;
+	};
+
+	/// Closest hit of ray or sweep query.
+	struct Hit
+	{
+		/// Body hit, or null if nothing is hit.
+		RigidBody* body;
+		/// Fraction of path before hit (1 if nothing is hit).
+		float fraction;
+		/// Point and normal of hit, in world space.
+		vec3 point;
+		vec3 normal;
+	};
+
+	/// Body found by overlap query.
+	struct Overlap
+	{
+		/// Index of query.
+		int query;
+		RigidBody* body;
+	};
+
 	/// Создать форму-коробку.
 	virtual ptr<Shape> CreateBoxShape(const vec3& halfSize) = 0;
 	/// Создать форму-сферу.
@@ -32,6 +90,24 @@ public:
 
 	/// Выполнить шаг симуляции.
 	virtual void Simulate(float time) = 0;
+
+	//*** Batch methods.
+
+	/// Get number of bodies moved by last simulation step.
+	virtual int GetMovedBodiesCount() const = 0;
+	/// Write transforms of bodies moved by last simulation step.
+	/** \param transforms Array of GetMovedBodiesCount() elements. */
+	virtual void GetMovedTransforms(BodyTransform* transforms) const = 0;
+
+	/// Cast rays, and get closest hits.
+	/** \param threadPool Pool to do queries in parallel, or null. */
+	virtual void CastRays(const RayQuery* queries, Hit* hits, int count, ThreadPool* threadPool = nullptr) = 0;
+	/// Sweep convex shapes, and get closest hits.
+	virtual void CastShapes(const SweepQuery* queries, Hit* hits, int count, ThreadPool* threadPool = nullptr) = 0;
+	/// Find bodies overlapping convex shapes.
+	/** Shapes are tested exactly, concave body shapes by their triangles.
+	Overlaps are added to the vector, ordered by query. */
+	virtual void TestOverlaps(const OverlapQuery* queries, int count, std::vector<Overlap>& overlaps, ThreadPool* threadPool = nullptr) = 0;
 };
 
 END_INANITY_PHYSICS
@@ -0,0 +1,186 @@
+#include "../inanity-base.hpp"
+#include "../inanity-physics.hpp"
+#include "../inanity-bullet.hpp"
+#include <iostream>
+#include <sstream>
+#include <cmath>
+
+/* Benchmark of Bullet world configurations.
+Steps a world with stacks of boxes using different broadphases
+and numbers of threads, and prints time per step.
+Then compares batch methods of world with one by one calls. */
+
+using namespace Inanity;
+using namespace Inanity::Physics;
+
+static const int stacksSide = 12;
+static const int stackHeight = 20;
+static const int stepsCount = 300;
+
+static void Bench(const char* name, const BtWorld::Config& config)
+{
+	ptr<BtWorld> world = NEW(BtWorld(config));
+
+	// ground
+	ptr<Shape> groundShape = world->CreateBoxShape(vec3(100, 100, 1));
+	ptr<RigidBody> ground = world->CreateRigidBody(groundShape, 0, CreateTranslationMatrix(vec3(0, 0, -1)));
+
+	// stacks of boxes
+	ptr<Shape> boxShape = world->CreateBoxShape(vec3(0.5f, 0.5f, 0.5f));
+	std::vector<ptr<RigidBody> > bodies;
+	for(int i = 0; i < stacksSide; ++i)
+		for(int j = 0; j < stacksSide; ++j)
+			for(int k = 0; k < stackHeight; ++k)
+				bodies.push_back(world->CreateRigidBody(boxShape, 1,
+					CreateTranslationMatrix(vec3((i - stacksSide / 2) * 2.0f, (j - stacksSide / 2) * 2.0f, k * 1.0f + 0.5f))));
+
+	Time::Tick startTick = Time::GetTick();
+	for(int i = 0; i < stepsCount; ++i)
+		world->Simulate(1.0f / 60);
+	double time = (double)(Time::GetTick() - startTick) / (double)Time::GetTicksPerSecond();
+
+	// average height tells if stacks are still standing
+	float height = 0;
+	for(size_t i = 0; i < bodies.size(); ++i)
+		height += bodies[i]->GetPosition().z;
+	height /= (float)bodies.size();
+
+	std::cout << name << ", " << bodies.size() << " bodies: "
+		<< (time * 1000 / stepsCount) << " ms per step, average height " << height << "\n";
+}
+
+static double GetTime(Time::Tick startTick)
+{
+	return (double)(Time::GetTick() - startTick) / (double)Time::GetTicksPerSecond();
+}
+
+/// Compares reading body transforms and queries one by one and in batches.
+static void BenchBatches(int bodiesCount, int queriesCount)
+{
+	ptr<BtWorld> world = NEW(BtWorld());
+	ptr<Shape> groundShape = world->CreateBoxShape(vec3(100, 100, 1));
+	ptr<RigidBody> ground = world->CreateRigidBody(groundShape, 0, CreateTranslationMatrix(vec3(0, 0, -1)));
+
+	// falling boxes, so all of them are moving
+	int side = (int)sqrt((float)bodiesCount);
+	ptr<Shape> boxShape = world->CreateBoxShape(vec3(0.4f, 0.4f, 0.4f));
+	std::vector<ptr<RigidBody> > bodies;
+	for(int i = 0; i < bodiesCount; ++i)
+		bodies.push_back(world->CreateRigidBody(boxShape, 1,
+			CreateTranslationMatrix(vec3((i % side - side / 2) * 1.0f, (i / side - side / 2) * 1.0f, 10.0f + (i % 7)))));
+	world->Simulate(1.0f / 60);
+
+	// just after start all bodies move, later most of them sleep on the ground
+	for(int pass = 0; pass < 2; ++pass)
+	{
+		if(pass)
+			for(int i = 0; i < 300; ++i)
+				world->Simulate(1.0f / 60);
+
+		std::vector<mat4x4> transforms(bodiesCount);
+		const int iterations = 100;
+
+		Time::Tick startTick = Time::GetTick();
+		for(int k = 0; k < iterations; ++k)
+			for(int i = 0; i < bodiesCount; ++i)
+				transforms[i] = bodies[i]->GetTransform();
+		double oneByOneTime = GetTime(startTick) / iterations;
+
+		std::vector<World::BodyTransform> movedTransforms;
+		startTick = Time::GetTick();
+		for(int k = 0; k < iterations; ++k)
+		{
+			movedTransforms.resize(world->GetMovedBodiesCount());
+			if(!movedTransforms.empty())
+				world->GetMovedTransforms(&movedTransforms[0]);
+		}
+		double batchTime = GetTime(startTick) / iterations;
+
+		std::cout << bodiesCount << " body transforms" << (pass ? " after settling" : "") << ": one by one " << (oneByOneTime * 1000) << " ms, "
+			<< movedTransforms.size() << " moved in batch " << (batchTime * 1000) << " ms\n";
+	}
+
+	// vertical rays and spheres among the boxes
+	std::vector<World::RayQuery> rayQueries(queriesCount);
+	std::vector<World::OverlapQuery> overlapQueries(queriesCount);
+	ptr<Shape> sphereShape = world->CreateSphereShape(1.0f);
+	unsigned random = 1;
+	for(int i = 0; i < queriesCount; ++i)
+	{
+		random = random * 1103515245 + 12345;
+		float x = (float)((random >> 8) % 1000) / 1000.0f * side - side / 2;
+		random = random * 1103515245 + 12345;
+		float y = (float)((random >> 8) % 1000) / 1000.0f * side - side / 2;
+		rayQueries[i].from = vec3(x, y, 50);
+		rayQueries[i].to = vec3(x, y, -5);
+		overlapQueries[i].shape = sphereShape;
+		overlapQueries[i].transform = CreateTranslationMatrix(vec3(x, y, 0.5f));
+	}
+
+	// Bullet's own ray test for every ray
+	btDynamicsWorld* dynamicsWorld = world->GetInternalDynamicsWorld();
+	int bulletHitsCount = 0;
+	Time::Tick startTick = Time::GetTick();
+	for(int i = 0; i < queriesCount; ++i)
+	{
+		btCollisionWorld::ClosestRayResultCallback callback(toBt(rayQueries[i].from), toBt(rayQueries[i].to));
+		dynamicsWorld->rayTest(toBt(rayQueries[i].from), toBt(rayQueries[i].to), callback);
+		bulletHitsCount += callback.hasHit();
+	}
+	double bulletTime = GetTime(startTick);
+
+	ptr<ThreadPool> threadPool = NEW(ThreadPool());
+	std::vector<World::Hit> hits(queriesCount);
+	for(int parallel = 0; parallel < 2; ++parallel)
+	{
+		startTick = Time::GetTick();
+		world->CastRays(&rayQueries[0], &hits[0], queriesCount, parallel ? (ThreadPool*)threadPool : nullptr);
+		double rayTime = GetTime(startTick);
+		int hitsCount = 0;
+		for(int i = 0; i < queriesCount; ++i)
+			hitsCount += hits[i].body != nullptr;
+
+		std::vector<World::Overlap> overlaps;
+		startTick = Time::GetTick();
+		world->TestOverlaps(&overlapQueries[0], queriesCount, overlaps, parallel ? (ThreadPool*)threadPool : nullptr);
+		double overlapTime = GetTime(startTick);
+
+		if(!parallel)
+			std::cout << queriesCount << " rays: bullet's ray tests " << (bulletTime * 1000) << " ms (" << bulletHitsCount << " hits)\n";
+		std::cout << queriesCount << " rays in batch" << (parallel ? " on thread pool" : "") << ": " << (rayTime * 1000) << " ms (" << hitsCount << " hits)\n";
+		std::cout << queriesCount << " overlaps in batch" << (parallel ? " on thread pool" : "") << ": " << (overlapTime * 1000) << " ms (" << overlaps.size() << " found)\n";
+	}
+}
+
+int main()
+{
+	try
+	{
+		int hardwareThreadsCount = ThreadPool::GetHardwareThreadsCount();
+
+		for(int broadphase = 0; broadphase < 2; ++broadphase)
+			for(int threadsCount = 1; threadsCount <= hardwareThreadsCount * 2; threadsCount *= 2)
+			{
+				BtWorld::Config config;
+				config.broadphase = broadphase ? BtWorld::Broadphases::sweepAndPrune : BtWorld::Broadphases::dbvt;
+				config.worldMin = vec3(-100, -100, -10);
+				config.worldMax = vec3(100, 100, 100);
+				config.threadsCount = threadsCount;
+
+				std::ostringstream name;
+				name << (broadphase ? "sweep and prune" : "dbvt") << ", " << threadsCount << " threads";
+				Bench(name.str().c_str(), config);
+			}
+
+		BenchBatches(10000, 10000);
+	}
+	catch(Exception* exception)
+	{
+		std::ostringstream s;
+		MakePointer(exception)->PrintStack(s);
+		std::cout << s.str() << '\n';
+		return 1;
+	}
+
+	return 0;
+}
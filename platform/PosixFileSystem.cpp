@@ -364,6 +364,12 @@ ptr<File> PosixFileSystem::TryLoadFile(const String& fileName)
 	return TryLoadPartOfFile(fileName, 0, 0, nullptr);
 }
 
+bool PosixFileSystem::IsFileExists(const String& fileName)
+{
+	struct stat st;
+	return stat(GetFullName(fileName).c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
+
 ptr<PosixFileSystem> PosixFileSystem::GetNativeFileSystem()
 {
 	//этот метод сделан просто для лучшей понятности
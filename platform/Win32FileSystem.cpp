@@ -361,6 +361,12 @@ ptr<File> Win32FileSystem::TryLoadFile(const String& fileName)
 	return TryLoadPartOfFile(fileName, 0, 0, nullptr);
 }
 
+bool Win32FileSystem::IsFileExists(const String& fileName)
+{
+	DWORD attributes = GetFileAttributes(Strings::UTF82Unicode(GetFullName(fileName)).c_str());
+	return attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_DIRECTORY);
+}
+
 ptr<Win32FileSystem> Win32FileSystem::GetNativeFileSystem()
 {
 	//этот метод сделан просто для лучшей понятности
@@ -0,0 +1,145 @@
+#include "CodeCache.hpp"
+#include "../FileSystem.hpp"
+#include "../File.hpp"
+#include "../PartFile.hpp"
+#include "../FileInputStream.hpp"
+#include "../MemoryStream.hpp"
+#include "../StreamReader.hpp"
+#include "../StreamWriter.hpp"
+#include "../CriticalCode.hpp"
+#include "../Exception.hpp"
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+
+BEGIN_INANITY_SCRIPT
+
+const char CodeCache::magic[4] = { 'I', 'S', 'C', 'C' };
+const int CodeCache::formatVersion = 1;
+
+CodeCache::Stats::Stats()
+: hitsCount(0), missesCount(0), rejectedCount(0), engineRejectedCount(0), savesCount(0), failedSavesCount(0) {}
+
+CodeCache::CodeCache(ptr<FileSystem> fileSystem)
+: fileSystem(fileSystem) {}
+
+String CodeCache::GetFileName(const String& engineTag, unsigned long long sourceHash)
+{
+	// engine tag is hashed too, so different engines don't overwrite each other's entries
+	std::ostringstream stream;
+	stream << '/' << std::hex << std::setfill('0')
+		<< std::setw(16) << sourceHash
+		<< std::setw(8) << (unsigned)Hash(engineTag.c_str(), engineTag.length());
+	return stream.str();
+}
+
+ptr<File> CodeCache::TryLoad(const String& engineTag, ptr<File> source)
+{
+	unsigned long long sourceHash = Hash(source->GetData(), source->GetSize());
+
+	CriticalCode cc(criticalSection);
+
+	ptr<File> file;
+	try
+	{
+		file = fileSystem->TryLoadFile(GetFileName(engineTag, sourceHash));
+	}
+	catch(Exception* exception)
+	{
+		MakePointer(exception);
+	}
+	if(!file)
+	{
+		++stats.missesCount;
+		return nullptr;
+	}
+
+	try
+	{
+		StreamReader reader(NEW(FileInputStream(file)));
+		char fileMagic[sizeof(magic)];
+		reader.Read(fileMagic, sizeof(fileMagic));
+		if(memcmp(fileMagic, magic, sizeof(magic)) != 0
+			|| reader.ReadShortly() != (size_t)formatVersion
+			|| reader.ReadString() != engineTag
+			|| reader.ReadShortlyBig() != (bigsize_t)source->GetSize()
+			|| reader.Read<unsigned long long>() != sourceHash)
+		{
+			++stats.rejectedCount;
+			return nullptr;
+		}
+
+		size_t codeSize = reader.ReadShortly();
+		size_t offset = (size_t)reader.GetReadSize();
+		if(offset + codeSize != file->GetSize())
+		{
+			++stats.rejectedCount;
+			return nullptr;
+		}
+
+		++stats.hitsCount;
+		return NEW(PartFile(file, offset, codeSize));
+	}
+	catch(Exception* exception)
+	{
+		// truncated entry
+		MakePointer(exception);
+		++stats.rejectedCount;
+		return nullptr;
+	}
+}
+
+void CodeCache::Save(const String& engineTag, ptr<File> source, ptr<File> code)
+{
+	unsigned long long sourceHash = Hash(source->GetData(), source->GetSize());
+
+	CriticalCode cc(criticalSection);
+
+	try
+	{
+		ptr<MemoryStream> stream = NEW(MemoryStream());
+		StreamWriter writer(stream);
+		writer.Write(magic, sizeof(magic));
+		writer.WriteShortly(formatVersion);
+		writer.WriteString(engineTag);
+		writer.WriteShortlyBig(source->GetSize());
+		writer.Write(sourceHash);
+		writer.WriteShortly(code->GetSize());
+		writer.Write(code->GetData(), code->GetSize());
+
+		fileSystem->SaveFile(stream->ToFile(), GetFileName(engineTag, sourceHash));
+		++stats.savesCount;
+	}
+	catch(Exception* exception)
+	{
+		// file system may be read-only, or fail temporarily
+		MakePointer(exception);
+		++stats.failedSavesCount;
+	}
+}
+
+void CodeCache::Reject()
+{
+	CriticalCode cc(criticalSection);
+	++stats.engineRejectedCount;
+}
+
+CodeCache::Stats CodeCache::GetStats()
+{
+	CriticalCode cc(criticalSection);
+	return stats;
+}
+
+unsigned long long CodeCache::Hash(const void* data, size_t size)
+{
+	const unsigned char* bytes = (const unsigned char*)data;
+	unsigned long long hash = 14695981039346656037ULL;
+	for(size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+END_INANITY_SCRIPT
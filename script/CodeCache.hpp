@@ -0,0 +1,88 @@
+#ifndef ___INANITY_SCRIPT_CODE_CACHE_HPP___
+#define ___INANITY_SCRIPT_CODE_CACHE_HPP___
+
+#include "script.hpp"
+#include "../String.hpp"
+#include "../CriticalSection.hpp"
+
+BEGIN_INANITY
+
+class File;
+class FileSystem;
+
+END_INANITY
+
+BEGIN_INANITY_SCRIPT
+
+/// Cache of compiled script code.
+/** Stores engine-specific compiled code (Lua bytecode, V8 code cache)
+in a file system, keyed by content hash of script source.
+Every entry has a header with engine tag (engine version and platform),
+and size and hash of the source, which are checked on load.
+Cache is optional by nature: file system errors are not thrown,
+invalid entries are just missed and overwritten.
+Entries may be prepared offline: run scripts with cache in a writable
+file system, and pack it with the rest of data.
+Cache may be shared by states working in different threads (like
+states of Lua::StatePool): its methods are serialized by a critical
+section, so file system is never used by two threads at once. */
+class CodeCache : public Object
+{
+public:
+	/// Statistics of cache usage.
+	struct Stats
+	{
+		/// Number of lookups returned code.
+		/** Includes code rejected by engine later. */
+		size_t hitsCount;
+		/// Number of lookups found nothing suitable.
+		size_t missesCount;
+		/// Number of entries found invalid by header.
+		size_t rejectedCount;
+		/// Number of returned code rejected by engine.
+		size_t engineRejectedCount;
+		/// Number of saved entries.
+		size_t savesCount;
+		/// Number of failed saves (for example, in read-only file system).
+		size_t failedSavesCount;
+
+		Stats();
+	};
+
+private:
+	ptr<FileSystem> fileSystem;
+	Stats stats;
+	CriticalSection criticalSection;
+
+	static const char magic[4];
+	/// Version of entry format.
+	static const int formatVersion;
+
+	/// Get name of entry file.
+	static String GetFileName(const String& engineTag, unsigned long long sourceHash);
+
+public:
+	/// Create cache.
+	/** \param fileSystem File system to store entries in.
+	If it's read-only, saves just fail (and are counted). */
+	CodeCache(ptr<FileSystem> fileSystem);
+
+	/// Get compiled code of source, or null if there is no valid entry.
+	/** \param engineTag String identifying engine version and
+	settings, code of which is compatible. */
+	ptr<File> TryLoad(const String& engineTag, ptr<File> source);
+	/// Save compiled code of source.
+	void Save(const String& engineTag, ptr<File> source, ptr<File> code);
+	/// Report that code returned by TryLoad was rejected by engine.
+	/** Caller should compile source and save it again. */
+	void Reject();
+
+	Stats GetStats();
+
+	/// Calculate hash of data (64-bit FNV-1a).
+	static unsigned long long Hash(const void* data, size_t size);
+};
+
+END_INANITY_SCRIPT
+
+#endif
@@ -2,7 +2,10 @@
 #define ___INANITY_SCRIPT_STATE_HPP___
 
 #include "convert.hpp"
+#include "CodeCache.hpp"
 #include "../String.hpp"
+#include "../SampledProfile.hpp"
+#include "../TimeHistogram.hpp"
 
 BEGIN_INANITY
 
@@ -20,9 +23,53 @@ class Any;
 exchanged between instances of State class. */
 class State : public Object
 {
+public:
+	/// Memory statistics of the state.
+	/** Fields not supported by engine are zero. */
+	struct MemoryStats
+	{
+		/// Size of memory currently allocated by script engine, in bytes.
+		size_t allocatedSize;
+		/// Maximum allocated size ever reached.
+		size_t peakAllocatedSize;
+		/// Number of allocations (including reallocations).
+		size_t allocationsCount;
+		/// Number of frees.
+		size_t freesCount;
+		/// Number of garbage collections forced by memory limits.
+		size_t emergencyCollectionsCount;
+		/// Number of allocations failed because of memory limits.
+		size_t failedAllocationsCount;
+
+		MemoryStats();
+	};
+
+	/// Garbage collection statistics.
+	struct GarbageCollectionStats
+	{
+		/// Histogram of pause times.
+		TimeHistogram pauses;
+		/// Number of finished collection cycles.
+		size_t cyclesCount;
+
+		GarbageCollectionStats();
+	};
+
+protected:
+	/// Cache of compiled code used by LoadScript, or null.
+	ptr<CodeCache> codeCache;
+
 public:
 	/// Loads a script from file.
-	virtual ptr<Function> LoadScript(ptr<File> file) = 0;
+	/** If code cache is set, compiled code is taken from cache
+	(or put in it), so script is not parsed again.
+	\param name Name of script, used in error messages and profiles. */
+	virtual ptr<Function> LoadScript(ptr<File> file, const String& name = "noname") = 0;
+
+	/// Set cache of compiled code (null to disable caching).
+	/** Cache may be shared by states, also in different threads. */
+	void SetCodeCache(ptr<CodeCache> codeCache);
+	ptr<CodeCache> GetCodeCache() const;
 
 	/// Unregister instance of object if exposed to script.
 	/** Invalidates object instances in script (if they exist), and releases a reference.
@@ -38,6 +85,40 @@ public:
 	virtual ptr<Any> NewArray(int length = 0) = 0;
 	virtual ptr<Any> NewDict() = 0;
 
+	/// Get memory statistics.
+	virtual MemoryStats GetMemoryStats() const;
+
+	//*** Garbage collection control.
+	/** Intended usage is to disable automatic collection (if engine
+	allows it), and do collection steps in idle time of every frame. */
+
+	/// Do garbage collection work for at most specified time.
+	/** Time may be exceeded by one indivisible step of collector.
+	Engine measuring idle time coarser (V8 - in milliseconds) does
+	nothing if time is less than its unit.
+	\return true if collection cycle is finished. */
+	virtual bool CollectGarbageStep(int microseconds);
+	/// Do full garbage collection.
+	virtual void CollectGarbage();
+	/// Enable or disable automatic garbage collection.
+	/** Engines may ignore it. */
+	virtual void SetAutomaticGarbageCollection(bool enabled);
+	/// Get garbage collection statistics.
+	/** Depending on engine, statistics covers all pauses
+	or only explicit collection calls. */
+	virtual GarbageCollectionStats GetGarbageCollectionStats() const;
+
+	//*** Sampling profiler.
+
+	/// Start profiler.
+	/** \param interval Sampling interval: number of VM instructions
+	for Lua, microseconds for V8. */
+	virtual void StartProfiling(int interval);
+	/// Stop profiler and get samples collected since start.
+	/** If engine profiling is enabled (see Profiling.hpp), samples
+	are also added to engine's profiling report. */
+	virtual ptr<SampledProfile> StopProfiling();
+
 	/// Convert value-type to script value.
 	template <typename T>
 	ptr<Any> ConvertValue(const T& value)
@@ -46,6 +127,49 @@ public:
 	}
 };
 
+inline State::MemoryStats::MemoryStats()
+: allocatedSize(0), peakAllocatedSize(0), allocationsCount(0), freesCount(0),
+	emergencyCollectionsCount(0), failedAllocationsCount(0) {}
+
+inline State::GarbageCollectionStats::GarbageCollectionStats()
+: cyclesCount(0) {}
+
+inline void State::SetCodeCache(ptr<CodeCache> codeCache)
+{
+	this->codeCache = codeCache;
+}
+
+inline ptr<CodeCache> State::GetCodeCache() const
+{
+	return codeCache;
+}
+
+inline State::MemoryStats State::GetMemoryStats() const
+{
+	return MemoryStats();
+}
+
+inline bool State::CollectGarbageStep(int)
+{
+	return true;
+}
+
+inline void State::CollectGarbage() {}
+
+inline void State::SetAutomaticGarbageCollection(bool) {}
+
+inline State::GarbageCollectionStats State::GetGarbageCollectionStats() const
+{
+	return GarbageCollectionStats();
+}
+
+inline void State::StartProfiling(int) {}
+
+inline ptr<SampledProfile> State::StopProfiling()
+{
+	return NEW(SampledProfile());
+}
+
 END_INANITY_SCRIPT
 
 #endif
@@ -1,6 +1,7 @@
 #include "Function.hpp"
 #include "Any.hpp"
 #include "State.hpp"
+#include "../../Profiling.hpp"
 
 BEGIN_INANITY_LUA
 
@@ -9,6 +10,8 @@ Function::Function(ptr<Any> function)
 
 ptr<Script::Any> Function::Run()
 {
+	PROFILE_SCOPE();
+
 	return function->Call();
 }
 
@@ -0,0 +1,96 @@
+#include "Profiler.hpp"
+#include "State.hpp"
+#include "../../Profiling.hpp"
+#include <cstdio>
+
+BEGIN_INANITY_LUA
+
+Profiler::Profiler(lua_State* state, int interval, int nativeSamplePeriod)
+: state(state), profile(NEW(SampledProfile())), nativeTicks(0), pendingNativeTicks(0), nativeCallsCountdown(nativeCallsPeriod), nativeCallsRandom(1)
+{
+	Time::Tick ticksPerSecond = Time::GetTicksPerSecond();
+	nanosecondsPerTick = 1e9 / (double)ticksPerSecond;
+	nativeSampleTicks = (Time::Tick)((double)nativeSamplePeriod * 1e-6 * (double)ticksPerSecond);
+	lastSampleTick = Time::GetTick();
+	lua_sethook(state, &Hook, LUA_MASKCOUNT, interval > 0 ? interval : 1);
+}
+
+Profiler::~Profiler()
+{
+	lua_sethook(state, 0, 0, 0);
+}
+
+void Profiler::Hook(lua_State* state, lua_Debug*)
+{
+	Profiler* profiler = State::GetStateByLuaState(state)->GetProfiler();
+	if(!profiler)
+		return;
+
+	Time::Tick tick = Time::GetTick();
+	Time::Tick ticks = tick - profiler->lastSampleTick - profiler->nativeTicks;
+	profiler->lastSampleTick = tick;
+	profiler->nativeTicks = 0;
+
+	if(ticks > 0)
+		profiler->AddSample(profiler->GetStack(0), ticks);
+}
+
+String Profiler::GetStack(int level) const
+{
+	// frames are got from the innermost one, so
+	// they are prepended to stack
+	String stack;
+	lua_Debug ar;
+	for(; lua_getstack(state, level, &ar); ++level)
+	{
+		if(!lua_getinfo(state, "Sn", &ar))
+			break;
+
+		String frame;
+		if(ar.what[0] == 'C')
+		{
+			frame = "[native] ";
+			frame += ar.name ? ar.name : "<function>";
+		}
+		else if(ar.what[0] == 'm')
+		{
+			frame = "[main] ";
+			frame += ar.short_src;
+		}
+		else
+		{
+			char line[16];
+			sprintf(line, ":%d", ar.linedefined);
+			frame = ar.name ? ar.name : "<function>";
+			frame += ' ';
+			frame += ar.short_src;
+			frame += line;
+		}
+
+		if(!stack.empty())
+			frame += ';';
+		stack.insert(0, frame);
+	}
+	return stack;
+}
+
+void Profiler::AddSample(const String& stack, Time::Tick ticks)
+{
+	long long weight = (long long)((double)ticks * nanosecondsPerTick);
+	profile->AddSample(stack, weight);
+#ifdef ___INANITY_PROFILING
+	Profiling::Sample(stack.c_str(), weight);
+#endif
+}
+
+ptr<SampledProfile> Profiler::GetProfile()
+{
+	if(pendingNativeTicks > 0)
+	{
+		AddSample("[native]", pendingNativeTicks);
+		pendingNativeTicks = 0;
+	}
+	return profile;
+}
+
+END_INANITY_LUA
@@ -0,0 +1,94 @@
+#ifndef ___INANITY_SCRIPT_LUA_PROFILER_HPP___
+#define ___INANITY_SCRIPT_LUA_PROFILER_HPP___
+
+#include "lua.hpp"
+#include "lualib.hpp"
+#include "../../SampledProfile.hpp"
+#include "../../Time.hpp"
+
+BEGIN_INANITY_LUA
+
+/// Sampling profiler of Lua state.
+/** Count hook takes a sample of script stack every given number
+of VM instructions. Weight of sample is time elapsed since previous
+sample, excluding time of native calls.
+Native calls are timed by thunks with random intervals (so periodic
+patterns of calls don't skew results), nativeCallsPeriod calls
+on average, and their time is scaled accordingly. The time is accumulated, and attributed
+to the stack of the call which makes accumulated time exceed
+sampling period, so stacks are taken with bounded frequency. */
+class Profiler : public Object
+{
+private:
+	lua_State* state;
+	ptr<SampledProfile> profile;
+	double nanosecondsPerTick;
+	/// Tick of previous script sample.
+	Time::Tick lastSampleTick;
+	/// Ticks spent in native calls since previous script sample.
+	Time::Tick nativeTicks;
+	/// Ticks spent in native calls, not yet attributed to stack.
+	Time::Tick pendingNativeTicks;
+	/// Sampling period of native calls, in ticks.
+	Time::Tick nativeSampleTicks;
+	/// Number of native calls to skip before timing next one.
+	int nativeCallsCountdown;
+	/// State of random generator for countdowns.
+	unsigned nativeCallsRandom;
+
+	/// Only one of this number of native calls is timed.
+	static const int nativeCallsPeriod = 8;
+
+	static void Hook(lua_State* state, lua_Debug* ar);
+
+	/// Get collapsed stack of script, from given level to the outermost.
+	String GetStack(int level) const;
+	void AddSample(const String& stack, Time::Tick ticks);
+
+public:
+	/// Create profiler.
+	/** \param interval Number of VM instructions between samples.
+	\param nativeSamplePeriod Sampling period of native calls, in microseconds. */
+	Profiler(lua_State* state, int interval, int nativeSamplePeriod = 100);
+	~Profiler();
+
+	/// Get samples.
+	/** Flushes native time not yet attributed to stack. */
+	ptr<SampledProfile> GetProfile();
+
+	/// Check if native call should be timed.
+	/** Called by thunks when profiler is active. */
+	inline bool IsNativeCallTimed()
+	{
+		if(--nativeCallsCountdown > 0)
+			return false;
+		// uniform in [1, 2 * period - 1], so mean is period
+		nativeCallsRandom = nativeCallsRandom * 1103515245 + 12345;
+		nativeCallsCountdown = 1 + (int)((nativeCallsRandom >> 16) % (2 * nativeCallsPeriod - 1));
+		return true;
+	}
+
+	/// Register finished timed native call.
+	/** Native function should be on top of Lua call stack. */
+	inline void NativeCall(Time::Tick startTick)
+	{
+		Time::Tick ticks = (Time::GetTick() - startTick) * nativeCallsPeriod;
+		nativeTicks += ticks;
+		pendingNativeTicks += ticks;
+		if(pendingNativeTicks >= nativeSampleTicks)
+		{
+			AddSample(GetStack(0), pendingNativeTicks);
+			pendingNativeTicks = 0;
+		}
+	}
+
+	/// Check if profiler is active for Lua state.
+	static inline bool IsActive(lua_State* state)
+	{
+		return lua_gethook(state) == &Hook;
+	}
+};
+
+END_INANITY_LUA
+
+#endif
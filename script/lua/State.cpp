@@ -1,20 +1,33 @@
 #include "State.hpp"
 #include "Any.hpp"
 #include "Function.hpp"
+#include "Profiler.hpp"
 #include "stuff.hpp"
 #include "values.ipp"
 #include "userdata.hpp"
 #include "../../File.hpp"
+#include "../../MemoryStream.hpp"
 #include "../../Exception.hpp"
+#include "../../Time.hpp"
+#include "../../Profiling.hpp"
 #include <cstdlib>
+#include <cstring>
+#include <new>
 #include <sstream>
 
 BEGIN_INANITY_LUA
 
-State::States State::states;
-
-State::State()
+State::State(bool usePools)
+: state(0), softMemoryLimit(0), hardMemoryLimit(0), softMemoryThreshold(0), collectionRequested(false)
 {
+	// create pools before state, as state is allocated by them
+	if(usePools)
+		for(size_t i = 0; i < poolsCount; ++i)
+		{
+			size_t chunkSize = (i + 1) * poolGranularity;
+			pools[i] = NEW(ChunkPool(chunkSize, 0x4000 / chunkSize));
+		}
+
 	// создать состояние
 	state = lua_newstate(Alloc, this);
 	if(!state)
@@ -23,25 +36,154 @@ State::State()
 	// установить функцию окончания
 	lua_atpanic(state, Panic);
 
+	// create cache of objects' userdata
+	CreateObjectCache(state);
+
 	// create pool of Any objects
 	anyPool = NEW(ObjectPool<Any>());
-
-	// add state to global list of states
-	states.insert(std::make_pair(state, this));
 }
 
 State::~State()
 {
-	states.erase(state);
+	profiler = nullptr;
 	lua_close(state);
 }
 
 void* State::Alloc(void* self, void* ptr, size_t osize, size_t nsize)
 {
-	if(nsize)
-		return realloc(ptr, nsize);
-	free(ptr);
-	return 0;
+	// if block is null, osize contains type of object, not size
+	return ((State*)self)->Reallocate(ptr, ptr ? osize : 0, nsize);
+}
+
+void* State::Reallocate(void* block, size_t oldSize, size_t newSize)
+{
+	// free
+	if(!newSize)
+	{
+		if(block)
+		{
+			FreeBlock(block, oldSize);
+			memoryStats.allocatedSize -= oldSize;
+			++memoryStats.freesCount;
+			// re-arm soft limit when memory is below it again
+			if(memoryStats.allocatedSize < softMemoryLimit)
+				softMemoryThreshold = softMemoryLimit;
+		}
+		return 0;
+	}
+
+	// check limits; Lua never fails shrinking blocks
+	if(newSize > oldSize)
+	{
+		size_t newAllocatedSize = memoryStats.allocatedSize - oldSize + newSize;
+		// collector may be stopped by SetAutomaticGarbageCollection,
+		// or by script with collectgarbage("stop"); state is null
+		// while it's being created
+		bool collectorRunning = state && lua_gc(state, LUA_GCISRUNNING, 0);
+		if(!collectorRunning)
+			collectionRequested = false;
+		if(collectionRequested)
+		{
+			// this is a retry after emergency collection
+			collectionRequested = false;
+			if(hardMemoryLimit && newAllocatedSize > hardMemoryLimit)
+			{
+				++memoryStats.failedAllocationsCount;
+				return 0;
+			}
+			// if memory is still above soft limit, do not collect
+			// on every allocation, but wait for some growth
+			if(softMemoryLimit && newAllocatedSize > softMemoryThreshold)
+				softMemoryThreshold = newAllocatedSize + newAllocatedSize / 2;
+		}
+		else if(collectorRunning && ((hardMemoryLimit && newAllocatedSize > hardMemoryLimit) || (softMemoryThreshold && newAllocatedSize > softMemoryThreshold)))
+		{
+			// fail allocation, so Lua runs emergency full collection and retries
+			collectionRequested = true;
+			++memoryStats.emergencyCollectionsCount;
+			return 0;
+		}
+		else if(hardMemoryLimit && newAllocatedSize > hardMemoryLimit)
+		{
+			// collector is stopped, so Lua fails without collection
+			++memoryStats.failedAllocationsCount;
+			return 0;
+		}
+	}
+
+	void* newBlock;
+	size_t oldSizeClass = block ? GetSizeClass(oldSize) : poolsCount;
+	size_t newSizeClass = GetSizeClass(newSize);
+	// block stays in the same size class
+	if(block && oldSizeClass == newSizeClass && newSizeClass < poolsCount)
+		newBlock = block;
+	// both sizes are large (or new block is allocated by system allocator)
+	else if(oldSizeClass == poolsCount && newSizeClass == poolsCount)
+		newBlock = realloc(block, newSize);
+	// block moves between size classes
+	else
+	{
+		newBlock = AllocateBlock(newSize);
+		if(newBlock && block)
+		{
+			memcpy(newBlock, block, oldSize < newSize ? oldSize : newSize);
+			FreeBlock(block, oldSize);
+		}
+	}
+
+	if(!newBlock)
+	{
+		// Lua never fails shrinking, so keep old block; it is at least
+		// as big as new size, so it can be freed into pool of new size
+		// class later (system block is then kept by pool, not freed)
+		if(block && newSize <= oldSize)
+			newBlock = block;
+		else
+		{
+			++memoryStats.failedAllocationsCount;
+			return 0;
+		}
+	}
+
+	memoryStats.allocatedSize = memoryStats.allocatedSize - oldSize + newSize;
+	if(memoryStats.allocatedSize > memoryStats.peakAllocatedSize)
+		memoryStats.peakAllocatedSize = memoryStats.allocatedSize;
+	++memoryStats.allocationsCount;
+
+	return newBlock;
+}
+
+void* State::AllocateBlock(size_t size)
+{
+	size_t sizeClass = GetSizeClass(size);
+	if(sizeClass < poolsCount)
+	{
+		// exceptions must not go through Lua
+		try
+		{
+			return pools[sizeClass]->Allocate();
+		}
+		catch(const std::bad_alloc&)
+		{
+			return 0;
+		}
+	}
+	return malloc(size);
+}
+
+void State::FreeBlock(void* block, size_t size)
+{
+	size_t sizeClass = GetSizeClass(size);
+	if(sizeClass < poolsCount)
+		pools[sizeClass]->Free(block);
+	else
+		free(block);
+}
+
+size_t State::GetSizeClass(size_t size) const
+{
+	size_t sizeClass = (size - 1) / poolGranularity;
+	return sizeClass < poolsCount && pools[sizeClass] ? sizeClass : poolsCount;
 }
 
 int State::Panic(lua_State* state)
@@ -67,12 +209,36 @@ lua_State* State::GetState()
 	return state;
 }
 
+void State::SetMemoryLimits(size_t softLimit, size_t hardLimit)
+{
+	softMemoryLimit = softLimit;
+	hardMemoryLimit = hardLimit;
+	softMemoryThreshold = softLimit;
+}
+
+void State::SetIncrementalGarbageCollection(int pause, int stepMultiplier)
+{
+	lua_gc(state, LUA_GCINC, 0);
+	lua_gc(state, LUA_GCSETPAUSE, pause);
+	lua_gc(state, LUA_GCSETSTEPMUL, stepMultiplier);
+}
+
+void State::SetGenerationalGarbageCollection(int majorIncrement)
+{
+	lua_gc(state, LUA_GCGEN, 0);
+	lua_gc(state, LUA_GCSETMAJORINC, majorIncrement);
+}
+
 ptr<State> State::GetStateByLuaState(lua_State* state)
 {
-	States::const_iterator i = states.find(state);
-	if(i != states.end())
-		return i->second;
-	return 0;
+	void* self;
+	lua_getallocf(state, &self);
+	return (State*)self;
+}
+
+Profiler* State::GetProfiler() const
+{
+	return profiler;
 }
 
 ptr<Any> State::CreateAny()
@@ -80,7 +246,7 @@ ptr<Any> State::CreateAny()
 	return anyPool->New(this);
 }
 
-ptr<Script::Function> State::LoadScript(ptr<File> file)
+int State::TryLoadChunk(ptr<File> file, const String& name, const char* mode)
 {
 	/// Класс читателя.
 	/** Чтение выполняется в один приём. */
@@ -93,7 +259,7 @@ ptr<Script::Function> State::LoadScript(ptr<File> file)
 	public:
 		Reader(ptr<File> file) : file(file), read(false) {}
 
-		static const char* Callback(lua_State* state, void* data, size_t* size)
+		static const char* Callback(lua_State*, void* data, size_t* size)
 		{
 			Reader* reader = (Reader*)data;
 			if(reader->read)
@@ -108,12 +274,123 @@ ptr<Script::Function> State::LoadScript(ptr<File> file)
 	};
 
 	Reader reader(file);
-	if(lua_load(state, Reader::Callback, &reader, "=noname", 0) == LUA_OK)
-		return NEW(Function(CreateAny()));
-	// обработать ошибку
-	ProcessError(state);
-	// ProcessError никогда не возвращает управления
-	return 0;
+	return lua_load(state, Reader::Callback, &reader, ("=" + name).c_str(), mode);
+}
+
+void State::LoadChunk(ptr<File> file, const String& name)
+{
+	// mode is not specified, so both text and bytecode are accepted
+	if(TryLoadChunk(file, name, 0) != LUA_OK)
+		// ProcessError never returns
+		ProcessError(state);
+}
+
+void State::LoadCachedChunk(ptr<File> file, const String& name)
+{
+	// precompiled scripts are not cached
+	if(file->GetSize() && *(const char*)file->GetData() == LUA_SIGNATURE[0])
+	{
+		LoadChunk(file, name);
+		return;
+	}
+
+	const String& tag = GetCodeCacheTag();
+
+	ptr<File> bytecode = codeCache->TryLoad(tag, file);
+	if(bytecode)
+	{
+		if(TryLoadChunk(bytecode, name, "b") == LUA_OK)
+			return;
+		lua_pop(state, 1);
+		codeCache->Reject();
+	}
+
+	LoadChunk(file, name);
+	ptr<File> code;
+	try
+	{
+		code = DumpChunk();
+	}
+	catch(Exception* exception)
+	{
+		lua_pop(state, 1);
+		throw;
+	}
+	codeCache->Save(tag, file, code);
+}
+
+ptr<File> State::DumpChunk()
+{
+	struct Writer
+	{
+		static int Callback(lua_State* state, const void* data, size_t size, void* stream)
+		{
+			// exceptions must not go through Lua
+			try
+			{
+				((MemoryStream*)stream)->Write(data, size);
+				return 0;
+			}
+			catch(Exception* exception)
+			{
+				MakePointer(exception);
+				return 1;
+			}
+		}
+	};
+
+	ptr<MemoryStream> stream = NEW(MemoryStream());
+	if(lua_dump(state, Writer::Callback, (MemoryStream*)stream))
+		THROW("Can't dump bytecode");
+	return stream->ToFile();
+}
+
+String State::MakeCodeCacheTag()
+{
+	// bytecode depends on Lua version and sizes of types
+	std::ostringstream stream;
+	stream << LUA_RELEASE << " " << sizeof(void*) * 8 << "-bit, "
+		<< sizeof(lua_Number) << "-byte numbers, " << sizeof(lua_Integer) << "-byte integers";
+	return stream.str();
+}
+
+const String& State::GetCodeCacheTag()
+{
+	// initialization of local static is thread-safe
+	static const String tag = MakeCodeCacheTag();
+	return tag;
+}
+
+ptr<Script::Function> State::LoadScript(ptr<File> file, const String& name)
+{
+	PROFILE_SCOPE();
+
+	if(codeCache)
+		LoadCachedChunk(file, name);
+	else
+		LoadChunk(file, name);
+	return NEW(Function(CreateAny()));
+}
+
+ptr<File> State::CompileScript(ptr<File> file, const String& name)
+{
+	BEGIN_TRY();
+
+	LoadChunk(file, name);
+	ptr<File> bytecode;
+	try
+	{
+		bytecode = DumpChunk();
+	}
+	catch(Exception* exception)
+	{
+		lua_pop(state, 1);
+		throw;
+	}
+	lua_pop(state, 1);
+	return bytecode;
+
+	END_TRY("Can't compile Lua script");
 }
 
 void State::ReclaimInstance(RefCounted* object)
@@ -162,4 +439,67 @@ ptr<Script::Any> State::NewDict()
 	return NewArray(0);
 }
 
+State::MemoryStats State::GetMemoryStats() const
+{
+	return memoryStats;
+}
+
+bool State::CollectGarbageStep(int microseconds)
+{
+	Time::Tick ticksPerSecond = Time::GetTicksPerSecond();
+	Time::Tick startTick = Time::GetTick();
+	Time::Tick endTick = startTick + (Time::Tick)((double)microseconds * (double)ticksPerSecond * 1e-6);
+
+	// do minimal steps until time is over or cycle is finished
+	bool finished;
+	Time::Tick tick;
+	do
+	{
+		finished = lua_gc(state, LUA_GCSTEP, 0) != 0;
+		tick = Time::GetTick();
+	}
+	while(!finished && tick < endTick);
+
+	garbageCollectionStats.pauses.Add((long long)((double)(tick - startTick) * 1e6 / (double)ticksPerSecond));
+	if(finished)
+		++garbageCollectionStats.cyclesCount;
+
+	return finished;
+}
+
+void State::CollectGarbage()
+{
+	Time::Tick startTick = Time::GetTick();
+	lua_gc(state, LUA_GCCOLLECT, 0);
+	garbageCollectionStats.pauses.Add((long long)((double)(Time::GetTick() - startTick) * 1e6 / (double)Time::GetTicksPerSecond()));
+	++garbageCollectionStats.cyclesCount;
+}
+
+void State::SetAutomaticGarbageCollection(bool enabled)
+{
+	lua_gc(state, enabled ? LUA_GCRESTART : LUA_GCSTOP, 0);
+}
+
+State::GarbageCollectionStats State::GetGarbageCollectionStats() const
+{
+	return garbageCollectionStats;
+}
+
+void State::StartProfiling(int interval)
+{
+	// restart profiling if it's already started
+	profiler = nullptr;
+	profiler = NEW(Profiler(state, interval));
+}
+
+ptr<SampledProfile> State::StopProfiling()
+{
+	if(!profiler)
+		return NEW(SampledProfile());
+
+	ptr<SampledProfile> profile = profiler->GetProfile();
+	profiler = nullptr;
+	return profile;
+}
+
 END_INANITY_LUA
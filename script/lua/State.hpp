@@ -9,11 +9,12 @@
 #include "lualib.hpp"
 #include "../State.hpp"
 #include "../../ObjectPool.hpp"
-#include <unordered_map>
+#include "../../ChunkPool.hpp"
 
 BEGIN_INANITY_LUA
 
 class Any;
+class Profiler;
 
 /// The state for Lua interpreter.
 class State : public Inanity::Script::State
@@ -24,12 +25,56 @@ private:
 	/// Pool of Any objects.
 	ptr<ObjectPool<Any> > anyPool;
 
-	typedef std::unordered_map<lua_State*, State*> States;
-	static States states;
+	/// Granularity of size classes of small blocks.
+	static const size_t poolGranularity = 16;
+	/// Number of size classes; larger blocks are allocated by system allocator.
+	static const size_t poolsCount = 16;
+	/// Pools of small blocks, by size class.
+	/** Empty if pooling is disabled. */
+	ptr<ChunkPool> pools[poolsCount];
+
+	/// Memory limits, 0 if not set.
+	size_t softMemoryLimit, hardMemoryLimit;
+	/// Allocated size triggering next collection by soft limit.
+	size_t softMemoryThreshold;
+	/// Allocation was failed to make Lua run emergency collection.
+	/** Next growing allocation is the retry. Requested only while
+	collector is running, as Lua doesn't collect and retry otherwise. */
+	bool collectionRequested;
+	MemoryStats memoryStats;
+
+	/// Active profiler, if any.
+	ptr<Profiler> profiler;
+
+	GarbageCollectionStats garbageCollectionStats;
 
 private:
 	/// Lua allocation callback.
 	static void* Alloc(void* self, void* ptr, size_t osize, size_t nsize);
+	/// Allocate, reallocate or free block.
+	void* Reallocate(void* block, size_t oldSize, size_t newSize);
+	/// Allocate block from pool or system allocator.
+	void* AllocateBlock(size_t size);
+	/// Free block allocated by AllocateBlock.
+	void FreeBlock(void* block, size_t size);
+	/// Get index of size class for block, or poolsCount if block is not pooled.
+	size_t GetSizeClass(size_t size) const;
+
+	/// Load chunk and push it (or error message) in stack.
+	/** \param name Name of chunk (without Lua's "=" or "@" prefix).
+	\param mode Lua load mode ("t", "b", or 0 for both).
+	\return Lua status code. */
+	int TryLoadChunk(ptr<File> file, const String& name, const char* mode);
+	/// Load chunk from source or bytecode, and push it in stack.
+	void LoadChunk(ptr<File> file, const String& name);
+	/// Load chunk using code cache, and push it in stack.
+	void LoadCachedChunk(ptr<File> file, const String& name);
+	/// Dump bytecode of function on top of stack.
+	ptr<File> DumpChunk();
+	/// Make code cache tag for this Lua build.
+	static String MakeCodeCacheTag();
+	/// Get code cache tag for this Lua build.
+	static const String& GetCodeCacheTag();
 	/// Lua fatal error callback.
 	static int Panic(lua_State* state);
 
@@ -37,13 +82,18 @@ private:
 	void InternalRegister(MetaProvider::ClassBase* classMeta);
 
 public:
-	State();
+	/// Create state.
+	/** \param usePools Allocate small blocks from per-state pools
+	of size classes, instead of system allocator. */
+	State(bool usePools = true);
 	~State();
 
 	/// Get internal Lua state.
 	lua_State* GetState();
 
 	/// Get state by Lua state.
+	/** State is stored as allocator's data of Lua state,
+	so no global registry (and locking) is needed. */
 	static ptr<State> GetStateByLuaState(lua_State* state);
 
 	/// Register class.
@@ -53,11 +103,39 @@ public:
 		InternalRegister(Meta::MetaOf<MetaProvider, ClassType>());
 	}
 
+	/// Compile script into bytecode.
+	/** Bytecode can be loaded by LoadScript of any Lua state
+	(with the same Lua version and platform), skipping parsing.
+	Name of script is stored in bytecode. */
+	ptr<File> CompileScript(ptr<File> file, const String& name = "noname");
+
+	/// Get active profiler, or null.
+	Profiler* GetProfiler() const;
+
 	/// Create any value by grabbing one from stack.
 	ptr<Any> CreateAny();
 
+	/// Set memory limits, in bytes (0 for no limit).
+	/** When allocated size exceeds soft limit, full garbage collection
+	is run. Allocations exceeding hard limit fail with memory error,
+	if garbage collection doesn't free enough memory.
+	When automatic garbage collection is disabled, soft limit
+	is ignored, and hard limit fails allocations without collection. */
+	void SetMemoryLimits(size_t softLimit, size_t hardLimit);
+
+	/// Switch garbage collector to incremental mode (default).
+	/** \param pause Memory growth between cycles, in percents (Lua's default is 200).
+	\param stepMultiplier Speed of collection relative to allocation, in percents (default is 200). */
+	void SetIncrementalGarbageCollection(int pause = 200, int stepMultiplier = 200);
+	/// Switch garbage collector to generational mode.
+	/** Generational mode is experimental in Lua 5.2. Every step
+	of collector is a full minor or major collection.
+	\param majorIncrement Memory growth since last major collection
+	causing the next major one, in percents (default is 100). */
+	void SetGenerationalGarbageCollection(int majorIncrement = 100);
+
 	//*** Script::State methods.
-	ptr<Script::Function> LoadScript(ptr<File> file);
+	ptr<Script::Function> LoadScript(ptr<File> file, const String& name = "noname");
 	void ReclaimInstance(RefCounted* object);
 	ptr<Script::Any> NewBoolean(bool boolean);
 	ptr<Script::Any> NewNumber(int number);
@@ -66,6 +144,13 @@ public:
 	ptr<Script::Any> NewString(const String& string);
 	ptr<Script::Any> NewArray(int length = 0);
 	ptr<Script::Any> NewDict();
+	MemoryStats GetMemoryStats() const;
+	bool CollectGarbageStep(int microseconds);
+	void CollectGarbage();
+	void SetAutomaticGarbageCollection(bool enabled);
+	GarbageCollectionStats GetGarbageCollectionStats() const;
+	void StartProfiling(int interval);
+	ptr<SampledProfile> StopProfiling();
 };
 
 END_INANITY_LUA
@@ -0,0 +1,81 @@
+#include "StatePool.hpp"
+#include "Function.hpp"
+#include "Any.hpp"
+#include "../../File.hpp"
+#include "../../CriticalCode.hpp"
+#include "../../Exception.hpp"
+
+BEGIN_INANITY_LUA
+
+//*** class StatePool::PooledState
+
+StatePool::PooledState::PooledState(ptr<State> state) : state(state) {}
+
+ptr<State> StatePool::PooledState::GetState() const
+{
+	return state;
+}
+
+ptr<Script::Any> StatePool::PooledState::GetScriptResult(int scriptIndex) const
+{
+	return scriptResults[scriptIndex];
+}
+
+//*** class StatePool
+
+StatePool::StatePool(int statesCount)
+{
+	BEGIN_TRY();
+
+	if(statesCount <= 0)
+		THROW("Wrong number of states");
+
+	states.resize(statesCount);
+	freeStates.resize(statesCount);
+	for(int i = 0; i < statesCount; ++i)
+	{
+		states[i] = NEW(PooledState(NEW(State())));
+		freeStates[i] = states[i];
+	}
+	freeStatesSemaphore.Release(statesCount);
+
+	END_TRY("Can't create Lua state pool");
+}
+
+int StatePool::PreloadScript(ptr<File> file, const String& name)
+{
+	BEGIN_TRY();
+
+	ptr<File> bytecode = states[0]->state->CompileScript(file, name);
+	for(size_t i = 0; i < states.size(); ++i)
+		states[i]->scriptResults.push_back(states[i]->state->LoadScript(bytecode, name)->Run());
+
+	return (int)states[0]->scriptResults.size() - 1;
+
+	END_TRY("Can't preload script into Lua state pool");
+}
+
+ptr<StatePool::PooledState> StatePool::Acquire()
+{
+	freeStatesSemaphore.Acquire();
+
+	CriticalCode cc(criticalSection);
+	PooledState* state = freeStates.back();
+	freeStates.pop_back();
+	return state;
+}
+
+void StatePool::Release(ptr<PooledState>& state)
+{
+	// drop the reference before other thread could acquire the state
+	PooledState* pooledState = state;
+	state = nullptr;
+
+	{
+		CriticalCode cc(criticalSection);
+		freeStates.push_back(pooledState);
+	}
+	freeStatesSemaphore.Release();
+}
+
+END_INANITY_LUA
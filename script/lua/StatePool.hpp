@@ -0,0 +1,86 @@
+#ifndef ___INANITY_SCRIPT_LUA_STATE_POOL_HPP___
+#define ___INANITY_SCRIPT_LUA_STATE_POOL_HPP___
+
+#include "State.hpp"
+#include "../../CriticalSection.hpp"
+#include "../../Semaphore.hpp"
+#include <vector>
+
+BEGIN_INANITY
+
+class File;
+
+END_INANITY
+
+BEGIN_INANITY_LUA
+
+/// Pool of independent Lua states for parallel script execution.
+/** Pool is set up by owner thread: it creates states, registers classes
+and preloads scripts in all of them. After that worker threads acquire
+states, use them exclusively, and release them back.
+C++ objects exposed to scripts must not be shared between states
+used concurrently (see ThreadPool about reference counters). */
+class StatePool : public Object
+{
+public:
+	/// State in the pool, together with results of preloaded scripts.
+	class PooledState : public Object
+	{
+		friend class StatePool;
+	private:
+		ptr<State> state;
+		std::vector<ptr<Script::Any> > scriptResults;
+
+	public:
+		PooledState(ptr<State> state);
+
+		ptr<State> GetState() const;
+		/// Get result of preloaded script.
+		/** \param scriptIndex Index returned by StatePool::PreloadScript. */
+		ptr<Script::Any> GetScriptResult(int scriptIndex) const;
+	};
+
+private:
+	/// All states. Used only by owner thread.
+	std::vector<ptr<PooledState> > states;
+
+	CriticalSection criticalSection;
+	/// States available for acquiring. Protected by critical section.
+	/** Pointers are not counted, states are held by states vector. */
+	std::vector<PooledState*> freeStates;
+	/// Counts free states.
+	Semaphore freeStatesSemaphore;
+
+public:
+	/// Create pool.
+	/** \param statesCount Number of states, usually number of worker threads. */
+	StatePool(int statesCount);
+
+	//*** Setup methods, for owner thread only.
+
+	/// Register class in all states.
+	template <typename ClassType>
+	void Register()
+	{
+		for(size_t i = 0; i < states.size(); ++i)
+			states[i]->state->Register<ClassType>();
+	}
+
+	/// Run script in all states, and remember its result.
+	/** Script is parsed once, and loaded into states as bytecode.
+	\return Index of script's result for PooledState::GetScriptResult. */
+	int PreloadScript(ptr<File> file, const String& name = "noname");
+
+	//*** Methods for worker threads.
+
+	/// Acquire a free state, waiting for one if needed.
+	ptr<PooledState> Acquire();
+	/// Release acquired state.
+	/** Clears passed pointer. Any other references to the state
+	and its values must be released before. */
+	void Release(ptr<PooledState>& state);
+};
+
+END_INANITY_LUA
+
+#endif
@@ -0,0 +1,399 @@
+#include "../../inanity-base.hpp"
+#include "../../inanity-lua.hpp"
+#include "../../inanity-math.hpp"
+
+#include "impl.ipp"
+#include "../../inanity-base-meta.ipp"
+#include "../../inanity-math-script.ipp"
+
+#include <iostream>
+#include <sstream>
+#include <map>
+
+/* Micro-benchmarks of Lua bindings.
+Every benchmark runs a script loop calling C++ functions,
+and prints time per call. */
+
+using namespace Inanity;
+using namespace Inanity::Math;
+
+Script::State* globalState;
+
+class BenchClass : public Object
+{
+public:
+	//*** Math values marshalling.
+	static vec3 addvec3(const vec3& a, const vec3& b)
+	{
+		return a + b;
+	}
+	static mat4x4 identity(const mat4x4& a)
+	{
+		return a;
+	}
+	/// The same through generic arrays (Script::Any per element).
+	static ptr<Script::Any> addvec3any(ptr<Script::Any> a, ptr<Script::Any> b)
+	{
+		vec3 r = Script::ConvertFromScript<Script::Lua::MetaProvider, vec3>(a) + Script::ConvertFromScript<Script::Lua::MetaProvider, vec3>(b);
+		return Script::ConvertToScript<Script::Lua::MetaProvider, vec3>(globalState, r);
+	}
+	static ptr<Script::Any> identityany(ptr<Script::Any> a)
+	{
+		mat4x4 r = Script::ConvertFromScript<Script::Lua::MetaProvider, mat4x4>(a);
+		return Script::ConvertToScript<Script::Lua::MetaProvider, mat4x4>(globalState, r);
+	}
+
+	META_DECLARE_CLASS(BenchClass);
+};
+
+/// Small object with bound methods.
+class BenchObject : public Object
+{
+private:
+	int value;
+
+public:
+	BenchObject() : value(0) {}
+
+	int get() const
+	{
+		return value;
+	}
+	void set(int value)
+	{
+		this->value = value;
+	}
+	ptr<BenchObject> self()
+	{
+		return this;
+	}
+	void add(ptr<BenchObject> other)
+	{
+		value += other->value;
+	}
+
+	META_DECLARE_CLASS(BenchObject);
+};
+
+/// Derived objects, to measure cast checks through class hierarchy.
+class BenchDerived1 : public BenchObject
+{
+public:
+	META_DECLARE_CLASS(BenchDerived1);
+};
+class BenchDerived2 : public BenchDerived1
+{
+public:
+	META_DECLARE_CLASS(BenchDerived2);
+};
+class BenchDerived3 : public BenchDerived2
+{
+public:
+	META_DECLARE_CLASS(BenchDerived3);
+};
+
+META_CLASS(BenchObject, BenchObject);
+	META_CONSTRUCTOR();
+	META_METHOD(get);
+	META_METHOD(set);
+	META_METHOD(self);
+	META_METHOD(add);
+META_CLASS_END();
+
+META_CLASS(BenchDerived1, BenchDerived1);
+	META_CLASS_PARENT(BenchObject);
+META_CLASS_END();
+
+META_CLASS(BenchDerived2, BenchDerived2);
+	META_CLASS_PARENT(BenchDerived1);
+META_CLASS_END();
+
+META_CLASS(BenchDerived3, BenchDerived3);
+	META_CLASS_PARENT(BenchDerived2);
+	META_CONSTRUCTOR();
+META_CLASS_END();
+
+META_CLASS(BenchClass, Bench);
+	META_STATIC_METHOD(addvec3);
+	META_STATIC_METHOD(identity);
+	META_STATIC_METHOD(addvec3any);
+	META_STATIC_METHOD(identityany);
+META_CLASS_END();
+
+static void Bench(ptr<Script::Lua::State> state, const char* name, const char* setup, const char* body, int iterations)
+{
+	std::ostringstream code;
+	code << setup << "\nfor i = 1, " << iterations << " do\n" << body << "\nend\n";
+	ptr<Script::Function> function = state->LoadScript(Strings::String2File(code.str()), name);
+
+	Time::Tick startTick = Time::GetTick();
+	function->Run();
+	Time::Tick endTick = Time::GetTick();
+
+	double nanoseconds = (double)(endTick - startTick) / (double)Time::GetTicksPerSecond() * 1e9 / iterations;
+	std::cout << name << ": " << nanoseconds << " ns per iteration, " << (1e9 / nanoseconds) << " per second\n";
+}
+
+static void PrintMemoryStats(ptr<Script::Lua::State> state)
+{
+	Script::State::MemoryStats stats = state->GetMemoryStats();
+	std::cout << "  allocated: " << stats.allocatedSize
+		<< ", peak: " << stats.peakAllocatedSize
+		<< ", allocations: " << stats.allocationsCount
+		<< ", frees: " << stats.freesCount
+		<< ", emergency collections: " << stats.emergencyCollectionsCount
+		<< ", failed: " << stats.failedAllocationsCount << "\n";
+}
+
+static void PrintGarbageCollectionStats(ptr<Script::Lua::State> state)
+{
+	Script::State::GarbageCollectionStats stats = state->GetGarbageCollectionStats();
+	std::cout << "  pauses: " << stats.pauses.count
+		<< ", cycles: " << stats.cyclesCount
+		<< ", total: " << stats.pauses.totalTime << " us"
+		<< ", max: " << stats.pauses.maxTime << " us\n  histogram (us):";
+	for(int i = 0; i < TimeHistogram::bucketsCount; ++i)
+		if(stats.pauses.buckets[i])
+			std::cout << " [" << (i ? (1 << i) : 0) << "+]: " << stats.pauses.buckets[i];
+	std::cout << "\n";
+}
+
+/// Runs "frames" of allocation-heavy script, measuring frame times.
+/** If budget is not zero, automatic collection is disabled, and
+collection is done in time slices at the end of every frame. */
+static void BenchFrames(const char* name, const char* body, int budget)
+{
+	ptr<Script::Lua::State> state = NEW(Script::Lua::State());
+	state->LoadScript(Strings::String2File("window = {}"))->Run();
+	std::ostringstream code;
+	code << "for i = 1, 2000 do\n" << body << "\nend\n";
+	ptr<Script::Function> frame = state->LoadScript(Strings::String2File(code.str()));
+
+	if(budget)
+		state->SetAutomaticGarbageCollection(false);
+
+	const int framesCount = 500;
+	double maxFrameTime = 0, totalFrameTime = 0;
+	for(int i = 0; i < framesCount; ++i)
+	{
+		Time::Tick startTick = Time::GetTick();
+		frame->Run();
+		Time::Tick endTick = Time::GetTick();
+		double frameTime = (double)(endTick - startTick) * 1e6 / (double)Time::GetTicksPerSecond();
+		totalFrameTime += frameTime;
+		if(frameTime > maxFrameTime)
+			maxFrameTime = frameTime;
+
+		if(budget)
+			state->CollectGarbageStep(budget);
+	}
+
+	std::cout << name << ": script time per frame " << (totalFrameTime / framesCount) << " us, max " << maxFrameTime << " us\n";
+	PrintMemoryStats(state);
+	if(budget)
+		PrintGarbageCollectionStats(state);
+}
+
+/// Runs entity scripts on one state, and on pool of states across threads.
+static void BenchStatePool(int entitiesCount)
+{
+	ptr<File> entityScript = Strings::String2File(
+		"return function(first, count)\n"
+		"  local sum = 0\n"
+		"  for e = first, first + count - 1 do\n"
+		"    local x, y, vx, vy = e, -e, 1, 0\n"
+		"    for step = 1, 200 do\n"
+		"      vx = vx - x * 0.01; vy = vy - y * 0.01\n"
+		"      x = x + vx * 0.1; y = y + vy * 0.1\n"
+		"    end\n"
+		"    sum = sum + x + y\n"
+		"  end\n"
+		"  return sum\n"
+		"end\n");
+
+	const int entitiesInJob = 100;
+	const int jobsCount = entitiesCount / entitiesInJob;
+	std::vector<double> results(jobsCount);
+
+	// one state
+	double oneStateTime;
+	{
+		ptr<Script::Lua::State> state = NEW(Script::Lua::State());
+		ptr<Script::Any> function = state->LoadScript(entityScript)->Run();
+		Time::Tick startTick = Time::GetTick();
+		for(int i = 0; i < jobsCount; ++i)
+			results[i] = function->Call(state->NewNumber(i * entitiesInJob), state->NewNumber(entitiesInJob))->AsDouble();
+		oneStateTime = (double)(Time::GetTick() - startTick) / (double)Time::GetTicksPerSecond();
+	}
+	double oneStateSum = 0;
+	for(int i = 0; i < jobsCount; ++i)
+		oneStateSum += results[i];
+
+	// pool of states
+	ptr<ThreadPool> threadPool = NEW(ThreadPool());
+	ptr<Script::Lua::StatePool> statePool = NEW(Script::Lua::StatePool(threadPool->GetThreadsCount()));
+	int scriptIndex = statePool->PreloadScript(entityScript);
+
+	Time::Tick startTick = Time::GetTick();
+	Script::Lua::StatePool* statePoolPtr = statePool;
+	double* resultsPtr = &results[0];
+	for(int i = 0; i < jobsCount; ++i)
+		threadPool->Queue(Handler::BindCall([statePoolPtr, scriptIndex, resultsPtr, i, entitiesInJob]()
+		{
+			ptr<Script::Lua::StatePool::PooledState> pooledState = statePoolPtr->Acquire();
+			{
+				ptr<Script::Lua::State> state = pooledState->GetState();
+				resultsPtr[i] = pooledState->GetScriptResult(scriptIndex)->Call(state->NewNumber(i * entitiesInJob), state->NewNumber(entitiesInJob))->AsDouble();
+			}
+			statePoolPtr->Release(pooledState);
+		}));
+	threadPool->Wait();
+	double poolTime = (double)(Time::GetTick() - startTick) / (double)Time::GetTicksPerSecond();
+	double poolSum = 0;
+	for(int i = 0; i < jobsCount; ++i)
+		poolSum += results[i];
+
+	std::cout << entitiesCount << " entity scripts: one state " << (oneStateTime * 1000) << " ms, "
+		<< threadPool->GetThreadsCount() << " states on " << threadPool->GetThreadsCount() << " threads " << (poolTime * 1000) << " ms"
+		<< (oneStateSum == poolSum ? "" : " (RESULTS DIFFER)") << "\n";
+}
+
+/// File system keeping files in memory, to store code cache.
+class BenchFileSystem : public FileSystem
+{
+private:
+	std::map<String, ptr<File> > files;
+
+public:
+	ptr<File> TryLoadFile(const String& fileName)
+	{
+		std::map<String, ptr<File> >::const_iterator i = files.find(fileName);
+		return i == files.end() ? nullptr : i->second;
+	}
+
+	void SaveFile(ptr<File> file, const String& fileName)
+	{
+		files[fileName] = file;
+	}
+};
+
+/// Loads set of scripts in new states, without code cache, with empty cache and with filled cache.
+static void BenchCodeCache(int scriptsCount)
+{
+	std::vector<ptr<File> > scripts(scriptsCount);
+	for(int i = 0; i < scriptsCount; ++i)
+	{
+		std::ostringstream code;
+		code << "local M = {}\n";
+		for(int j = 0; j < 20; ++j)
+			code << "function M.f" << j << "(a, b, c)\n"
+				"  local t = { x = a + " << i << ", y = b * " << j << ", z = c }\n"
+				"  if t.x > t.y then return t.x - t.y, 'greater' elseif t.x < t.y then return t.y - t.x, 'less' end\n"
+				"  for k = 1, 10 do t.z = (t.z or 0) + k * a end\n"
+				"  return t.z, tostring(t.x) .. ':' .. tostring(t.y)\n"
+				"end\n";
+		code << "return M\n";
+		scripts[i] = Strings::String2File(code.str());
+	}
+
+	ptr<Script::CodeCache> codeCache = NEW(Script::CodeCache(NEW(BenchFileSystem())));
+
+	const char* names[] = { "no cache", "empty cache", "filled cache" };
+	for(int pass = 0; pass < 3; ++pass)
+	{
+		ptr<Script::Lua::State> state = NEW(Script::Lua::State());
+		if(pass)
+			state->SetCodeCache(codeCache);
+		Time::Tick startTick = Time::GetTick();
+		for(int i = 0; i < scriptsCount; ++i)
+			state->LoadScript(scripts[i])->Run();
+		double time = (double)(Time::GetTick() - startTick) / (double)Time::GetTicksPerSecond();
+		std::cout << "loading " << scriptsCount << " scripts, " << names[pass] << ": " << (time * 1000) << " ms\n";
+	}
+
+	Script::CodeCache::Stats stats = codeCache->GetStats();
+	std::cout << "code cache: " << stats.hitsCount << " hits, " << stats.missesCount << " misses, "
+		<< stats.rejectedCount << " rejected, " << stats.engineRejectedCount << " rejected by engine, "
+		<< stats.savesCount << " saves\n";
+}
+
+int main()
+{
+	try
+	{
+		ptr<Script::Lua::State> state = NEW(Script::Lua::State());
+		state->Register<BenchClass>();
+		state->Register<BenchObject>();
+		state->Register<BenchDerived3>();
+		globalState = state;
+
+		const int iterations = 1000000;
+
+		// vec3 and mat4x4 marshalling
+		const char* vec3Setup = "local a = Bench.addvec3({1, 2, 3}, {0, 0, 0}); local b = Bench.addvec3({4, 5, 6}, {0, 0, 0})";
+		const char* mat4x4Setup = "local m = Bench.identity({1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1})";
+		Bench(state, "vec3 native", vec3Setup, "a = Bench.addvec3(a, b)", iterations);
+		Bench(state, "vec3 array", "local a = {1, 2, 3}; local b = {4, 5, 6}", "a = Bench.addvec3any(a, b)", iterations);
+		Bench(state, "mat4x4 native", mat4x4Setup, "m = Bench.identity(m)", iterations);
+		Bench(state, "mat4x4 array", "local m = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1}", "m = Bench.identityany(m)", iterations);
+		Bench(state, "vec3 native arithmetic", vec3Setup, "a = (a + b) * 0.5", iterations);
+
+		// object bindings
+		Bench(state, "method get", "local o = BenchObject()", "o:get()", iterations);
+		Bench(state, "method set", "local o = BenchObject()", "o:set(i)", iterations);
+		Bench(state, "method returning object", "local o = BenchObject()", "o = o:self()", iterations);
+		Bench(state, "method with object argument", "local o = BenchObject(); local p = BenchObject()", "o:add(p)", iterations);
+		Bench(state, "derived object argument", "local o = BenchDerived3(); local p = BenchDerived3()", "o:add(p)", iterations);
+
+		// allocation-heavy workload: tables, closures and strings,
+		// with sliding window of live objects
+		const char* allocationSetup = "local window = {}";
+		const char* allocationBody = "local t = { i, i + 1, x = i, y = { i } }; local f = function() return t end; local s = 'key' .. i; t[s] = f; window[i % 5000] = t";
+		{
+			ptr<Script::Lua::State> systemState = NEW(Script::Lua::State(false));
+			Bench(systemState, "allocations, system allocator", allocationSetup, allocationBody, iterations);
+			PrintMemoryStats(systemState);
+		}
+		{
+			ptr<Script::Lua::State> pooledState = NEW(Script::Lua::State(true));
+			Bench(pooledState, "allocations, pooled allocator", allocationSetup, allocationBody, iterations);
+			PrintMemoryStats(pooledState);
+		}
+		{
+			ptr<Script::Lua::State> limitedState = NEW(Script::Lua::State(true));
+			limitedState->SetMemoryLimits(1 << 20, 16 << 20);
+			Bench(limitedState, "allocations, pooled allocator, 1 Mb soft limit", allocationSetup, allocationBody, iterations);
+			PrintMemoryStats(limitedState);
+		}
+
+		// garbage collection scheduled into frame loop
+		const char* frameBody = "local t = { i, x = i, y = { i } }; window[i % 3000] = t; window['k' .. (i % 3000)] = function() return t end";
+		BenchFrames("frames, automatic collection", frameBody, 0);
+		BenchFrames("frames, 500 us collection slices", frameBody, 500);
+
+		// parallel execution on pool of states
+		BenchStatePool(100000);
+
+		BenchCodeCache(500);
+
+		// sampling profiler
+		{
+			const char* profileSetup = "local o = BenchObject(); local function inner(x) local s = 0; for j = 1, 10 do s = s + x * j end; return s end";
+			const char* profileBody = "o:set(inner(i)); o:get()";
+			Bench(state, "profiled code, no profiler", profileSetup, profileBody, iterations);
+			state->StartProfiling(10000);
+			Bench(state, "profiled code, profiler with 10000 instructions interval", profileSetup, profileBody, iterations);
+			ptr<SampledProfile> profile = state->StopProfiling();
+			profile->WriteReport(std::cout, 5);
+		}
+	}
+	catch(Exception* exception)
+	{
+		std::ostringstream s;
+		MakePointer(exception)->PrintStack(s);
+		std::cout << s.str() << '\n';
+		return 1;
+	}
+
+	return 0;
+}
@@ -6,37 +6,30 @@
 
 BEGIN_INANITY_LUA
 
-int MetaTable_index(lua_State* state)
-{
-	// в стеке лежит: сначала userdata, затем индекс
-	// а в замыкании лежит таблица методов
+/// Key of object cache table in registry.
+static char objectCacheKey;
 
-	// проверить, что объект не отозван (только для объектов)
-	UserData* userData = (UserData*)lua_touserdata(state, -2);
-	if(userData->type == UserData::typeObject && !((ObjectUserData*)userData)->object)
-	{
-		// вернуть понятную ошибку
-		lua_pushliteral(state, "Object reclaimed");
-		lua_error(state);
-		// управление не возвращается
-	}
+int MethodsTable_index(lua_State* state)
+{
+	// в стеке лежит: сначала таблица методов, затем индекс
+	// сюда попадаем, только если такого метода нет
 
-	// продублировать индекс
+	// вернуть понятную ошибку
+	lua_pushliteral(state, "No such method: ");
 	lua_pushvalue(state, 2);
-	// получить метод
-	lua_gettable(state, lua_upvalueindex(1));
-
-	// если такого метода нет
-	if(lua_isnil(state, -1))
-	{
-		// вернуть понятную ошибку
-		lua_pushliteral(state, "No such method: ");
-		lua_pushvalue(state, 2);
-		lua_concat(state, 2);
-		lua_error(state);
-	}
+	lua_concat(state, 2);
+	lua_error(state);
+	// управление не возвращается
+	return 0;
+}
 
-	return 1;
+/// Set metatable reporting missing methods to methods table on top of the stack.
+static void SetMethodsTableMetaTable(lua_State* state)
+{
+	lua_createtable(state, 0, 1);                        // methods metatable
+	lua_pushcfunction(state, &MethodsTable_index);       // methods metatable MethodsTable_index
+	lua_setfield(state, -2, "__index");                  // methods metatable
+	lua_setmetatable(state, -2);                         // methods
 }
 
 /// Функция для сообщения об ошибке - попытке создать объект класса без конструктора.
@@ -85,9 +78,8 @@ void PushClassMetaTable(lua_State* state, MetaProvider::ClassBase* cls)
 		function->PushThunk(state);                        // metatable "__index" staticMethods functionName thunk
 		lua_settable(state, -3);                           // metatable "__index" staticMethods
 	}
-	// таблица методов попадает в замыкание
-	lua_pushcclosure(state, &MetaTable_index, 1);        // metatable "__index" __index
-	// положить обработчик в таблицу
+	SetMethodsTableMetaTable(state);
+	// таблица методов сама является индексатором
 	lua_settable(state, -3);                             // metatable
 
 	// всё.
@@ -177,39 +169,56 @@ void ReclaimObjectFromUserData(lua_State* state)
 {
 	ObjectUserData* userData = (ObjectUserData*)lua_touserdata(state, -1);
 	// if object is not reclaimed yet, reclaim it
-	RefCounted* object = userData->object;
-	if(object)
+	// cache entry is not touched here: Lua clears weak values
+	// before running finalizers, and the cache may already
+	// contain new userdata for the same object
+	if(userData->object)
 	{
 		// dereference object
 		userData->object->Dereference();
 		// clear pointer
 		userData->object = 0;
-
-		// remove userdata from registry
-		lua_pushlightuserdata(state, object);
-		lua_pushnil(state);
-		lua_settable(state, LUA_REGISTRYINDEX);
 	}
+	lua_pop(state, 1);
 }
 
 void ReclaimObject(lua_State* state, RefCounted* object)
 {
 	// find an object by pointer
-	lua_pushlightuserdata(state, object);
-	lua_gettable(state, LUA_REGISTRYINDEX);
+	PushObjectCache(state);                            // cache
+	lua_rawgetp(state, -1, object);                    // cache userdata
 	// if object doesn't exist, just pop nil from stack
 	if(lua_isnil(state, -1))
-		lua_pop(state, 1);
-	// else reclaim the object
+		lua_pop(state, 1);                               // cache
+	// else reclaim the object, and remove it from cache
 	else
-		ReclaimObjectFromUserData(state);
+	{
+		ReclaimObjectFromUserData(state);                // cache
+		lua_pushnil(state);                              // cache nil
+		lua_rawsetp(state, -2, object);                  // cache
+	}
+	lua_pop(state, 1);                                 //
+}
+
+void CreateObjectCache(lua_State* state)
+{
+	lua_newtable(state);                               // cache
+	lua_createtable(state, 0, 1);                      // cache metatable
+	lua_pushliteral(state, "v");                       // cache metatable "v"
+	lua_setfield(state, -2, "__mode");                 // cache metatable
+	lua_setmetatable(state, -2);                       // cache
+	lua_rawsetp(state, LUA_REGISTRYINDEX, &objectCacheKey); //
+}
+
+void PushObjectCache(lua_State* state)
+{
+	lua_rawgetp(state, LUA_REGISTRYINDEX, &objectCacheKey);
 }
 
 void PushObjectMetaTable(lua_State* state, MetaProvider::ClassBase* cls)
 {
 	// получить метатаблицу объектов
-	lua_pushlightuserdata(state, cls);                   // cls
-	lua_gettable(state, LUA_REGISTRYINDEX);              // metatable
+	lua_rawgetp(state, LUA_REGISTRYINDEX, cls);          // metatable
 	// если её нет, сделать
 	if(!lua_istable(state, -1))
 	{
@@ -217,15 +226,14 @@ void PushObjectMetaTable(lua_State* state, MetaProvider::ClassBase* cls)
 		lua_pop(state, 1);                                 //
 
 		// таблица методов нужна только в __index.
-		// так пусть она будет у __index в замыкании :)
-		// и никуда больше её не сохранять, здорово ^_^
+		// так пусть она сама будет __index, тогда поиск метода
+		// делает сама виртуальная машина, без вызова C-функции
 
 		// создать метатаблицу
 		// использовать адрес структуры класса как индекс в реестре
-		lua_pushlightuserdata(state, cls);                 // cls
-		lua_createtable(state, 0, 2);                      // cls metatable
+		lua_createtable(state, 0, 2);                      // metatable
 		// задать индексатор
-		lua_pushliteral(state, "__index");                 // cls metatable "__index"
+		lua_pushliteral(state, "__index");                 // metatable "__index"
 
 		// вот в этом месте создать таблицу методов
 		// посчитать количество методов
@@ -233,7 +241,7 @@ void PushObjectMetaTable(lua_State* state, MetaProvider::ClassBase* cls)
 		for(MetaProvider::ClassBase* c = cls; c; c = c->GetParent())
 			methodsCount += c->GetMethods().size();
 		// создать таблицу
-		lua_createtable(state, 0, (int)methodsCount);      // cls metatable "__index" methods
+		lua_createtable(state, 0, (int)methodsCount);      // metatable "__index" methods
 		// и наполнить методами
 		for(MetaProvider::ClassBase* c = cls; c; c = c->GetParent())
 		{
@@ -241,25 +249,22 @@ void PushObjectMetaTable(lua_State* state, MetaProvider::ClassBase* cls)
 			for(size_t i = 0; i < methods.size(); ++i)
 			{
 				MetaProvider::MethodBase* method = methods[i];
-				lua_pushstring(state, method->GetName());      // cls metatable "__index" methods methodName
-				method->PushThunk(state);                      // cls metatable "__index" methods methodName thunk
-				lua_settable(state, -3);                       // cls metatable "__index" methods
+				lua_pushstring(state, method->GetName());      // metatable "__index" methods methodName
+				method->PushThunk(state);                      // metatable "__index" methods methodName thunk
+				lua_settable(state, -3);                       // metatable "__index" methods
 			}
 		}
-		// и засунуть её в замыкание
-		lua_pushcclosure(state, &MetaTable_index, 1);      // cls metatable "__index" MetaTable_index
-		lua_settable(state, -3);                           // cls metatable
+		SetMethodsTableMetaTable(state);
+		lua_settable(state, -3);                           // metatable
 
 		// задать деструктор
-		lua_pushliteral(state, "__gc");                    // cls metatable "__gc"
-		lua_pushcclosure(state, &ObjectMetaTable_gc, 0);   // cls metatable "__gc" ObjectMetaTable_gc
-		lua_settable(state, -3);                           // cls metatable
-
-		// немного попереставлять, чтобы потом осталась метатаблица
-		lua_pushvalue(state, -1);                          // cls metatable metatable
-		lua_insert(state, lua_absindex(state, -3));        // metatable cls metatable
-		// и положить метатаблицу в реестр
-		lua_settable(state, LUA_REGISTRYINDEX);            // metatable
+		lua_pushliteral(state, "__gc");                    // metatable "__gc"
+		lua_pushcclosure(state, &ObjectMetaTable_gc, 0);   // metatable "__gc" ObjectMetaTable_gc
+		lua_settable(state, -3);                           // metatable
+
+		// положить метатаблицу в реестр
+		lua_pushvalue(state, -1);                          // metatable metatable
+		lua_rawsetp(state, LUA_REGISTRYINDEX, cls);        // metatable
 	}
 }
 
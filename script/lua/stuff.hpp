@@ -15,9 +15,11 @@ END_INANITY
 
 BEGIN_INANITY_LUA
 
-/// General routine which indexes metatables (of classes and objects).
-/** Assumes that closure contains methods table. */
-int MetaTable_index(lua_State* state);
+/// Index handler of methods tables (of classes and objects).
+/** Methods table itself is the __index of class or object metatable,
+so lookup is done by Lua VM; this handler is called only for
+missing methods, and raises an error. */
+int MethodsTable_index(lua_State* state);
 
 /// Push class metatable in stack.
 void PushClassMetaTable(lua_State* state, MetaProvider::ClassBase* cls);
@@ -29,10 +31,19 @@ void RegisterClassMeta(lua_State* state, MetaProvider::ClassBase* cls);
 int ObjectMetaTable_gc(lua_State* state);
 
 /// Reclaim object from userdata on top of the stack.
+/** Pops userdata from stack. */
 void ReclaimObjectFromUserData(lua_State* state);
 /// Reclaim object by pointer.
 void ReclaimObject(lua_State* state, RefCounted* object);
 
+/// Create object cache in registry.
+/** Object cache is a weak-valued table mapping object pointers
+(as light userdata) to userdata of objects, so the same userdata
+is reused while it's alive in Lua, and collected when it's not. */
+void CreateObjectCache(lua_State* state);
+/// Push object cache table in stack.
+void PushObjectCache(lua_State* state);
+
 /// Push object metatable in stack.
 void PushObjectMetaTable(lua_State* state, MetaProvider::ClassBase* cls);
 
@@ -1,10 +1,16 @@
 #include "../../inanity-base.hpp"
 #include "../../inanity-lua.hpp"
 #include "../../inanity-platform.hpp"
+#include "../../Checks.hpp"
 
 #include "impl.ipp"
 #include "../../inanity-base-meta.ipp"
 
+extern "C"
+{
+#include "../../deps/lua/src/lualib.h"
+}
+
 #include <iostream>
 #include <sstream>
 
@@ -57,7 +63,7 @@ static void Run()
 
 		state->Register<TestClass>();
 
-		ptr<Script::Function> function = state->LoadScript(Platform::FileSystem::GetNativeFileSystem()->LoadFile("script/lua/test.lua"));
+		ptr<Script::Function> function = state->LoadScript(Platform::FileSystem::GetNativeFileSystem()->LoadFile("script/lua/test.lua"), "test.lua");
 
 		function->Run();
 	}
@@ -69,9 +75,75 @@ static void Run()
 	}
 }
 
+/// Run script, return false if it fails.
+static bool TryRun(ptr<Script::Lua::State> state, const char* code)
+{
+	try
+	{
+		state->LoadScript(Strings::String2File(code))->Run();
+		return true;
+	}
+	catch(Exception* exception)
+	{
+		MakePointer(exception);
+		return false;
+	}
+}
+
+static void TestMemoryLimits()
+{
+	// garbage only, so soft limit is kept by emergency collections
+	const char* garbage = "for i = 1, 100000 do local t = { i, { i } } end";
+	// data live while script runs, growing until limit
+	const char* growth = "local data = {}; for i = 1, 1000000 do data[i] = { i } end";
+
+	{
+		ptr<Script::Lua::State> state = NEW(Script::Lua::State());
+		state->SetMemoryLimits(256 << 10, 0);
+		// lazy collector, so soft limit is reached before regular cycle
+		state->SetIncrementalGarbageCollection(10000, 200);
+		Check("soft limit: script runs", TryRun(state, garbage));
+		Script::State::MemoryStats stats = state->GetMemoryStats();
+		Check("soft limit: emergency collections", stats.emergencyCollectionsCount > 0);
+		Check("soft limit: no failed allocations", stats.failedAllocationsCount == 0);
+	}
+
+	{
+		ptr<Script::Lua::State> state = NEW(Script::Lua::State());
+		state->SetMemoryLimits(0, 1 << 20);
+		Check("hard limit: script fails", !TryRun(state, growth));
+		Script::State::MemoryStats stats = state->GetMemoryStats();
+		Check("hard limit: failed allocations", stats.failedAllocationsCount > 0);
+		Check("hard limit: peak under limit", stats.peakAllocatedSize <= (1 << 20));
+		Check("hard limit: state works after failure", TryRun(state, "x = { 1, 2, 3 }"));
+	}
+
+	// collector stopped by script: allocations fail without emergency
+	// collections, and limits work again after restart
+	{
+		ptr<Script::Lua::State> state = NEW(Script::Lua::State());
+		// base library with collectgarbage
+		lua_pushcfunction(state->GetState(), luaopen_base);
+		lua_call(state->GetState(), 0, 0);
+		state->SetMemoryLimits(256 << 10, 1 << 20);
+		state->SetIncrementalGarbageCollection(10000, 200);
+		Check("stopped collector: script fails", !TryRun(state, "collectgarbage('stop'); local data = {}; for i = 1, 1000000 do data[i] = { i } end"));
+		Script::State::MemoryStats stats = state->GetMemoryStats();
+		Check("stopped collector: no emergency collections", stats.emergencyCollectionsCount == 0);
+		Check("stopped collector: peak under hard limit", stats.peakAllocatedSize <= (1 << 20));
+		state->CollectGarbage();
+		Check("restarted collector: script runs", TryRun(state, "collectgarbage('restart')"));
+		Check("restarted collector: garbage is collected", TryRun(state, garbage));
+		stats = state->GetMemoryStats();
+		Check("restarted collector: emergency collections", stats.emergencyCollectionsCount > 0);
+		Check("restarted collector: allocated under soft limit", stats.allocatedSize <= (256 << 10));
+	}
+}
+
 int main()
 {
 	Run();
+	TestMemoryLimits();
 
-	return 0;
+	return ReportChecks();
 }
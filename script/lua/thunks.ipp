@@ -4,6 +4,8 @@
 #include "thunks.hpp"
 #include "values.hpp"
 #include "stuff.hpp"
+#include "State.hpp"
+#include "Profiler.hpp"
 #include "lualib.hpp"
 #include "../../meta/Tuple.hpp"
 #include "../../meta/Callable.hpp"
@@ -75,6 +77,17 @@ struct CalleeThunk
 			state.argsCount = lua_gettop(luaState);
 			state.gotArgsCount = 0;
 
+			// measure time of call, if profiler is active and wants it
+			if(Profiler::IsActive(luaState) && State::GetStateByLuaState(luaState)->GetProfiler()->IsNativeCallTimed())
+			{
+				Time::Tick startTick = Time::GetTick();
+				int resultsCount = CallAndReturn<Helper, ReturnType, Args>::Do(luaState, Args(state));
+				// call may stop or restart profiling, so get profiler again
+				if(Profiler* profiler = State::GetStateByLuaState(luaState)->GetProfiler())
+					profiler->NativeCall(startTick);
+				return resultsCount;
+			}
+
 			// получить аргументы, выполнить вызов и положить результат в стек
 			// возвращается количество результатов
 			return CallAndReturn<Helper, ReturnType, Args>::Do(luaState, Args(state));
@@ -17,6 +17,8 @@ struct UserData
 	{
 		typeClass,
 		typeObject,
+		/// Vector or matrix stored by value (see math/lua.ipp).
+		typeMath
 	} type;
 };
 
@@ -276,14 +276,18 @@ struct Value<ptr<ObjectType> >
 			THROW(stream.str());
 		}
 
-		// проверить тип объекта, в случае необходимости привести к вышестоящему типу
-		for(MetaProvider::ClassBase* cls = userData->cls; cls; cls = cls->GetParent())
-			if(cls == Meta::MetaOf<MetaProvider, ObjectType>())
-				// вернуть объект
-				return (ObjectType*)userData->object;
-		// если здесь, значит, мы проверили всю цепочку наследования, а тип не нашли
-		const char* fullClassName = Meta::MetaOf<MetaProvider, ObjectType>()->GetFullName();
-		THROW(String("Can't cast object of type '") + userData->cls->GetFullName() + "' to expected type '" + fullClassName + "'");
+		// проверить тип объекта (за константное время)
+		if(!userData->cls->CanCastTo(Meta::MetaOf<MetaProvider, ObjectType>()))
+		{
+			const char* fullClassName = Meta::MetaOf<MetaProvider, ObjectType>()->GetFullName();
+			THROW(String("Can't cast object of type '") + userData->cls->GetFullName() + "' to expected type '" + fullClassName + "'");
+		}
+
+		// проверить, что объект не отозван
+		if(!userData->object)
+			THROW("Object reclaimed");
+
+		return (ObjectType*)userData->object;
 	}
 
 	static inline void Push(lua_State* state, ptr<ObjectType> value)
@@ -295,32 +299,33 @@ struct Value<ptr<ObjectType> >
 			return;
 		}
 
+		RefCounted* object = (RefCounted*)(ObjectType*)value;
+
 		// попробовать найти существующее userdata для объекта
-		lua_pushlightuserdata(state, (ObjectType*)value);		// value
-		lua_gettable(state, LUA_REGISTRYINDEX);							// userdata
+		PushObjectCache(state);                       // cache
+		lua_rawgetp(state, -1, object);               // cache userdata
 		// если нет, сделать
 		if(lua_isnil(state, -1))
 		{
 			// выбросить nil из стека
-			lua_pop(state, 1);																//
+			lua_pop(state, 1);                          // cache
 
-			ObjectUserData* userData = (ObjectUserData*)lua_newuserdata(state, sizeof(ObjectUserData));
+			ObjectUserData* userData = (ObjectUserData*)lua_newuserdata(state, sizeof(ObjectUserData)); // cache userdata
 			userData->type = UserData::typeObject;
-			userData->object = (RefCounted*)(ObjectType*)value;
+			userData->object = object;
 			userData->cls = Meta::MetaOf<MetaProvider, ObjectType>();
 			// указать метатаблицу
-			PushObjectMetaTable(state, userData->cls);
-			lua_setmetatable(state, -2);
+			PushObjectMetaTable(state, userData->cls);  // cache userdata metatable
+			lua_setmetatable(state, -2);                // cache userdata
 			// задать дополнительную ссылку объекту
-			userData->object->Reference();
+			object->Reference();
 
-			// положить адрес объекта
-			lua_pushlightuserdata(state, (ObjectType*)value);
-			// продублировать userdata в стеке
-			lua_pushvalue(state, -2);
 			// сохранить userdata по адресу объекта, для повторного использования
-			lua_settable(state, LUA_REGISTRYINDEX);
+			lua_pushvalue(state, -1);                   // cache userdata userdata
+			lua_rawsetp(state, -3, object);             // cache userdata
 		}
+		// выбросить кэш из стека
+		lua_remove(state, -2);                        // userdata
 	}
 };
 
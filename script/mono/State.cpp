@@ -120,7 +120,7 @@ ptr<Assembly> State::LoadAssembly(const String& fileName)
 	END_TRY("Can't load Mono assembly");
 }
 
-ptr<Function> State::LoadScript(ptr<File> file)
+ptr<Function> State::LoadScript(ptr<File> file, const String& name)
 {
 	THROW("Mono state doesn't support loading scripts");
 }
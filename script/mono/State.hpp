@@ -70,7 +70,7 @@ public:
 	ptr<Assembly> LoadAssembly(const String& fileName);
 
 	//*** Script::State's methods.
-	ptr<Function> LoadScript(ptr<File> file);
+	ptr<Function> LoadScript(ptr<File> file, const String& name = "noname");
 	void ReclaimInstance(RefCounted* object);
 	ptr<Script::Any> NewBoolean(bool boolean);
 	ptr<Script::Any> NewNumber(int number);
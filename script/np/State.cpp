@@ -61,7 +61,7 @@ Platform::NpapiPluginInstance* State::GetPluginInstance() const
 	return pluginInstance;
 }
 
-ptr<Function> State::LoadScript(ptr<File> file)
+ptr<Function> State::LoadScript(ptr<File> file, const String& name)
 {
 	THROW("Not implemented");
 }
@@ -62,7 +62,7 @@ public:
 	Platform::NpapiPluginInstance* GetPluginInstance() const;
 
 	//*** Script::State's methods.
-	ptr<Function> LoadScript(ptr<File> file);
+	ptr<Function> LoadScript(ptr<File> file, const String& name = "noname");
 	void ReclaimInstance(RefCounted* object);
 	ptr<Script::Any> NewBoolean(bool boolean);
 	ptr<Script::Any> NewNumber(int number);
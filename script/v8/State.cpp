@@ -5,16 +5,23 @@
 #include "MetaProvider.ipp"
 #include "Any.hpp"
 #include "../../File.hpp"
+#include "../../MemoryFile.hpp"
+#include "../../Profiling.hpp"
 #include <sstream>
+#include <cstring>
 
 BEGIN_INANITY_V8
 
-State::State()
+State::State() : garbageCollectionStartTick(0), profilingInterval(0)
 {
 	// create isolate
 	isolate = v8::Isolate::New();
 	isolate->SetData(0, this);
 
+	// measure garbage collection pauses
+	isolate->AddGCPrologueCallback(&GarbageCollectionPrologue);
+	isolate->AddGCEpilogueCallback(&GarbageCollectionEpilogue);
+
 	v8::Isolate::Scope isolateScope(isolate);
 
 	v8::HandleScope handleScope(isolate);
@@ -51,6 +58,20 @@ State::~State()
 	isolate->Dispose();
 }
 
+void State::GarbageCollectionPrologue(v8::Isolate* isolate, v8::GCType type, v8::GCCallbackFlags flags)
+{
+	GetFromIsolate(isolate)->garbageCollectionStartTick = Time::GetTick();
+}
+
+void State::GarbageCollectionEpilogue(v8::Isolate* isolate, v8::GCType type, v8::GCCallbackFlags flags)
+{
+	State* state = GetFromIsolate(isolate);
+	state->garbageCollectionStats.pauses.Add((long long)((double)(Time::GetTick() - state->garbageCollectionStartTick) * 1e6 / (double)Time::GetTicksPerSecond()));
+	// count full collections as cycles
+	if(type == v8::kGCTypeMarkSweepCompact)
+		++state->garbageCollectionStats.cyclesCount;
+}
+
 State::Scope::Scope(State* state) : state(state), handleScope(state->isolate)
 {
 	state->isolate->Enter();
@@ -345,24 +366,75 @@ State* State::GetFromIsolate(v8::Isolate* isolate)
 	return (State*)isolate->GetData(0);
 }
 
-ptr<Script::Function> State::LoadScript(ptr<File> file)
+ptr<Script::Function> State::LoadScript(ptr<File> file, const String& name)
 {
+	PROFILE_SCOPE();
+
 	Scope scope(this);
 
 	v8::TryCatch tryCatch;
 
-	v8::Local<v8::Script> script = v8::Script::Compile(
-		v8::String::NewFromUtf8(
-			isolate,
-			(const char*)file->GetData(),
-			v8::String::kNormalString,
-			file->GetSize()));
+	v8::Local<v8::String> sourceString = v8::String::NewFromUtf8(
+		isolate,
+		(const char*)file->GetData(),
+		v8::String::kNormalString,
+		file->GetSize());
+
+	v8::ScriptOrigin origin(v8::String::NewFromUtf8(isolate, name.c_str()));
+
+	v8::Local<v8::Script> script = codeCache
+		? CompileCachedScript(sourceString, origin, file)
+		: v8::Script::Compile(sourceString, &origin);
 
 	ProcessErrors(tryCatch);
 
 	return NEW(Function(this, script));
 }
 
+v8::Local<v8::Script> State::CompileCachedScript(v8::Local<v8::String> sourceString, const v8::ScriptOrigin& origin, ptr<File> file)
+{
+	const String& tag = GetCodeCacheTag();
+
+	ptr<File> code = codeCache->TryLoad(tag, file);
+	if(code)
+	{
+		// source takes ownership of cached data (but not of its buffer)
+		v8::ScriptCompiler::Source source(sourceString, origin,
+			new v8::ScriptCompiler::CachedData((const uint8_t*)code->GetData(), (int)code->GetSize()));
+		v8::Local<v8::Script> script = v8::ScriptCompiler::Compile(isolate, &source, v8::ScriptCompiler::kConsumeCodeCache);
+		// V8 checks version, flags and source itself, and rejects unsuitable cache
+		if(script.IsEmpty() || !source.GetCachedData()->rejected)
+			return script;
+		codeCache->Reject();
+	}
+
+	v8::ScriptCompiler::Source source(sourceString, origin);
+	v8::Local<v8::Script> script = v8::ScriptCompiler::Compile(isolate, &source, v8::ScriptCompiler::kProduceCodeCache);
+	const v8::ScriptCompiler::CachedData* cachedData = source.GetCachedData();
+	if(!script.IsEmpty() && cachedData)
+	{
+		code = NEW(MemoryFile(cachedData->length));
+		memcpy(code->GetData(), cachedData->data, cachedData->length);
+		codeCache->Save(tag, file, code);
+	}
+
+	return script;
+}
+
+String State::MakeCodeCacheTag()
+{
+	std::ostringstream stream;
+	stream << "V8 " << v8::V8::GetVersion() << " " << sizeof(void*) * 8 << "-bit";
+	return stream.str();
+}
+
+const String& State::GetCodeCacheTag()
+{
+	// initialization of local static is thread-safe
+	static const String tag = MakeCodeCacheTag();
+	return tag;
+}
+
 void State::ReclaimInstance(RefCounted* object)
 {
 	Scope scope(this);
@@ -420,4 +492,101 @@ ptr<Script::Any> State::NewDict()
 	return CreateAny(v8::Object::New(isolate));
 }
 
+State::MemoryStats State::GetMemoryStats() const
+{
+	v8::HeapStatistics heapStatistics;
+	isolate->GetHeapStatistics(&heapStatistics);
+
+	MemoryStats stats;
+	stats.allocatedSize = heapStatistics.used_heap_size();
+	return stats;
+}
+
+bool State::CollectGarbageStep(int microseconds)
+{
+	// V8 accepts idle time in whole milliseconds, and rounding
+	// shorter time up would exceed it
+	if(microseconds < 1000)
+		return false;
+
+	Scope scope(this);
+
+	return isolate->IdleNotification(microseconds / 1000);
+}
+
+void State::CollectGarbage()
+{
+	Scope scope(this);
+
+	isolate->LowMemoryNotification();
+}
+
+State::GarbageCollectionStats State::GetGarbageCollectionStats() const
+{
+	return garbageCollectionStats;
+}
+
+void State::StartProfiling(int interval)
+{
+	Scope scope(this);
+
+	v8::CpuProfiler* cpuProfiler = isolate->GetCpuProfiler();
+	cpuProfiler->SetSamplingInterval(interval);
+	cpuProfiler->StartProfiling(v8::String::NewFromUtf8(isolate, "Inanity"), true);
+	profilingInterval = interval;
+}
+
+ptr<SampledProfile> State::StopProfiling()
+{
+	Scope scope(this);
+
+	ptr<SampledProfile> profile = NEW(SampledProfile());
+
+	v8::CpuProfile* cpuProfile = isolate->GetCpuProfiler()->StopProfiling(v8::String::NewFromUtf8(isolate, "Inanity"));
+	if(!cpuProfile)
+		return profile;
+
+	// weight of one sample is average time between samples (in nanoseconds)
+	int samplesCount = cpuProfile->GetSamplesCount();
+	long long sampleWeight = samplesCount
+		? (long long)(cpuProfile->GetEndTime() - cpuProfile->GetStartTime()) * 1000 / samplesCount
+		: (long long)profilingInterval * 1000;
+
+	const v8::CpuProfileNode* root = cpuProfile->GetTopDownRoot();
+	for(int i = 0; i < root->GetChildrenCount(); ++i)
+		AddProfileNode(profile, root->GetChild(i), String(), sampleWeight);
+
+	cpuProfile->Delete();
+
+	return profile;
+}
+
+void State::AddProfileNode(ptr<SampledProfile> profile, const v8::CpuProfileNode* node, const String& parentStack, long long sampleWeight)
+{
+	v8::String::Utf8Value functionName(node->GetFunctionName());
+	v8::String::Utf8Value scriptName(node->GetScriptResourceName());
+
+	std::ostringstream frame;
+	frame << (functionName.length() ? *functionName : "<anonymous>");
+	if(scriptName.length())
+		frame << ' ' << *scriptName << ':' << node->GetLineNumber();
+
+	String stack = parentStack.empty() ? frame.str() : parentStack + ';' + frame.str();
+
+	unsigned hitCount = node->GetHitCount();
+	if(hitCount)
+	{
+		long long weight = hitCount * sampleWeight;
+		profile->AddSample(stack, weight);
+#ifdef ___INANITY_PROFILING
+		// samples are collected by V8 before this point, so scopes
+		// of the caller are not theirs
+		Profiling::Sample(stack.c_str(), weight, false);
+#endif
+	}
+
+	for(int i = 0; i < node->GetChildrenCount(); ++i)
+		AddProfileNode(profile, node->GetChild(i), stack, sampleWeight);
+}
+
 END_INANITY_V8
@@ -5,6 +5,7 @@
 #include "MetaProvider.hpp"
 #include "../State.hpp"
 #include "../../ObjectPool.hpp"
+#include "../../Time.hpp"
 #include "v8lib.hpp"
 #include <unordered_map>
 
@@ -29,6 +30,13 @@ private:
 	/// Pool of script values.
 	ptr<ObjectPool<Any> > anyPool;
 
+	/// Tick of the beginning of current garbage collection.
+	Time::Tick garbageCollectionStartTick;
+	GarbageCollectionStats garbageCollectionStats;
+
+	/// Sampling interval of CPU profiler, in microseconds.
+	int profilingInterval;
+
 public:
 	class Scope
 	{
@@ -51,6 +59,17 @@ private:
 	void InternalUnregisterInstance(RefCounted* object, MetaProvider::ClassBase* classMeta);
 	/// Dereference object and clear references to it from script.
 	void InternalReclaimInstance(Instances::iterator i);
+	/// Callbacks measuring garbage collection pauses.
+	static void GarbageCollectionPrologue(v8::Isolate* isolate, v8::GCType type, v8::GCCallbackFlags flags);
+	static void GarbageCollectionEpilogue(v8::Isolate* isolate, v8::GCType type, v8::GCCallbackFlags flags);
+	/// Add samples of CPU profile node and its children to profile.
+	static void AddProfileNode(ptr<SampledProfile> profile, const v8::CpuProfileNode* node, const String& parentStack, long long sampleWeight);
+	/// Compile script using code cache.
+	v8::Local<v8::Script> CompileCachedScript(v8::Local<v8::String> sourceString, const v8::ScriptOrigin& origin, ptr<File> file);
+	/// Make code cache tag for this V8 build.
+	static String MakeCodeCacheTag();
+	/// Get code cache tag for this V8 build.
+	static const String& GetCodeCacheTag();
 
 public:
 	State();
@@ -72,7 +91,7 @@ public:
 	}
 
 	// Script::State's methods.
-	ptr<Script::Function> LoadScript(ptr<File> file);
+	ptr<Script::Function> LoadScript(ptr<File> file, const String& name = "noname");
 	void ReclaimInstance(RefCounted* object);
 	ptr<Script::Any> NewBoolean(bool boolean);
 	ptr<Script::Any> NewNumber(int number);
@@ -81,6 +100,12 @@ public:
 	ptr<Script::Any> NewString(const String& string);
 	ptr<Script::Any> NewArray(int length = 0);
 	ptr<Script::Any> NewDict();
+	MemoryStats GetMemoryStats() const;
+	bool CollectGarbageStep(int microseconds);
+	void CollectGarbage();
+	GarbageCollectionStats GetGarbageCollectionStats() const;
+	void StartProfiling(int interval);
+	ptr<SampledProfile> StopProfiling();
 
 	//******* DON'T CALL EXPLICITLY
 
@@ -8,6 +8,7 @@
 #include "MetaProvider.ipp"
 #include "thunks.ipp"
 #include "values.ipp"
+#include "../../math/v8.ipp"
 #include "../../meta/Callable.ipp"
 
 #endif
@@ -128,7 +128,7 @@ int main(int argc, char* argv[])
 		ptr<Script::V8::State> state = NEW(Script::V8::State());
 		globalState = state;
 		state->Register<TestClass>();
-		state->LoadScript(Platform::FileSystem::GetNativeFileSystem()->LoadFile("script/v8/test.js"))->Run();
+		state->LoadScript(Platform::FileSystem::GetNativeFileSystem()->LoadFile("script/v8/test.js"), "test.js")->Run();
 	}
 	catch(Exception* exception)
 	{
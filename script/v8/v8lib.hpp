@@ -2,5 +2,6 @@
 #define ___INANITY_SCRIPT_V8_V8LIB_HPP___
 
 #include "../../deps/v8/repo/include/v8.h"
+#include "../../deps/v8/repo/include/v8-profiler.h"
 
 #endif